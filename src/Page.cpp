@@ -56,36 +56,18 @@ int PageModel::duplicateEntity(int sourceId)
 
     // Rebuild filter chain using registry and copy parameters/enabled flags
     size_t n = src.filterChain.filterCount();
-    if (n > 0)
+    for (size_t i = 0; i < n; ++i)
     {
-        const auto &all = FilterRegistry::instance().all();
-        for (size_t i = 0; i < n; ++i)
-        {
-            const FilterBase *fb = src.filterChain.filterAt(i);
-            if (!fb) continue;
+        const FilterBase *fb = src.filterChain.filterAt(i);
+        if (!fb) continue;
 
-            std::unique_ptr<FilterBase> fNew;
-            for (const auto &info : all)
-            {
-                if (info.name == fb->name())
-                {
-                    fNew = info.factory();
-                    break;
-                }
-            }
-            if (!fNew) continue;
+        std::unique_ptr<FilterBase> fNew = FilterRegistry::instance().clone(*fb);
+        if (!fNew) continue;
 
-            // Copy parameter values
-            for (const auto &kv : fb->m_parameters)
-            {
-                fNew->setParameter(kv.first, kv.second.value);
-            }
-
-            size_t idx = dst.filterChain.addFilter(std::move(fNew));
-            // Maintain enabled/disabled state
-            bool enabled = src.filterChain.isFilterEnabled(i);
-            dst.filterChain.setFilterEnabled(idx, enabled);
-        }
+        size_t idx = dst.filterChain.addFilter(std::move(fNew));
+        // Maintain enabled/disabled state
+        bool enabled = src.filterChain.isFilterEnabled(i);
+        dst.filterChain.setFilterEnabled(idx, enabled);
     }
 
     entities[dst.id] = std::move(dst);
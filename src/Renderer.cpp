@@ -12,6 +12,18 @@ Renderer::Renderer()
    m_floatImages.init();
 }
 
+const Bitmap &Renderer::maskPreview(int entityId, const LayerPtr &layer)
+{
+   MaskPreview &mp = m_maskPreviews[entityId];
+   if (mp.source.lock() != layer)
+   {
+      bitmapFromMask(*asMaskConstPtr(layer), mp.bitmap);
+      mp.source = layer;
+   }
+   mp.drawn = true;
+   return mp.bitmap;
+}
+
 void Renderer::render(const Camera &camera, const PageModel &page, const InteractionState &uiState)
 {
    m_lines.clear();
@@ -35,7 +47,7 @@ void Renderer::render(const Camera &camera, const PageModel &page, const Interac
          if (!psPtr)
             continue;
          const PathSet &ps = *psPtr;
-         for (const auto &path : ps.paths)
+         for (const auto &path : ps)
          {
             Color pathCol = entity.color;
             for (size_t i = 1; i < path.points.size(); ++i)
@@ -66,6 +78,10 @@ void Renderer::render(const Camera &camera, const PageModel &page, const Interac
             const Bitmap &bm = *bmptr;
             m_images.addBitmap(id, bm, transform);
          }
+         else if (isMaskLayer(layer))
+         {
+            m_images.addBitmap(id, maskPreview(id, layer), transform);
+         }
          else if (const FloatImage *fiptr = asFloatImageConstPtr(layer))
          {
             const FloatImage &fi = *fiptr;
@@ -78,6 +94,20 @@ void Renderer::render(const Camera &camera, const PageModel &page, const Interac
       }
    }
 
+   // Drop mask previews of entities that were deleted, hidden or no longer end in a mask
+   for (auto it = m_maskPreviews.begin(); it != m_maskPreviews.end();)
+   {
+      if (it->second.drawn)
+      {
+         it->second.drawn = false;
+         ++it;
+      }
+      else
+      {
+         it = m_maskPreviews.erase(it);
+      }
+   }
+
    // draw hovered
    if (uiState.hoveredId)
    {
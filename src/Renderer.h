@@ -10,6 +10,9 @@
 
 #include <glog/logging.h>
 
+#include <memory>
+#include <unordered_map>
+
 
 #define HANDLE_RENDER_RADIUS_MM 3.0f
 class Renderer
@@ -40,6 +43,17 @@ private:
     FloatImageRenderer m_floatImages{};
     float m_nodeDiameterPx{8.0f};
 
+    // Masks are drawn through the bitmap renderer; the expanded 8-bit copy is kept per
+    // entity until the chain produces a new mask layer
+    struct MaskPreview
+    {
+        std::weak_ptr<ILayerData> source;
+        Bitmap bitmap;
+        bool drawn{false}; // this frame; previews not drawn are dropped after it
+    };
+    std::unordered_map<int, MaskPreview> m_maskPreviews;
+    const Bitmap &maskPreview(int entityId, const LayerPtr &layer);
+
     void renderPage(const Camera &camera, const PageModel &page);
     void drawRect(const Vec2 &min, const Vec2 &max, const Color &col);
     void drawHandle(const Vec2 &center, float sizeMm, const Color &col);
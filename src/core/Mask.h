@@ -0,0 +1,171 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#if defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+#include "core/Vec2.h"
+#include "core/Pathset.h" // for BoundingBox
+#include "core/Bitmap.h"
+#include "filters/LayerBase.h"
+
+// Binary image, one bit per pixel. A set bit is ink (a black pixel).
+// Rows are padded to whole 64-bit words: pixel x of row y is bit (x % 64) of
+// words[y * wordsPerRow + x / 64]. Padding bits past width_px are always clear.
+struct Mask : public ILayerData
+{
+    size_t width_px{0};
+    size_t height_px{0};
+    // millimeters per pixel (square pixels)
+    float pixel_size_mm{1.0f};
+    size_t wordsPerRow{0};
+    std::vector<uint64_t> words;
+
+    // Reallocate to w x h, all pixels clear
+    void resize(size_t w, size_t h)
+    {
+        width_px = w;
+        height_px = h;
+        wordsPerRow = (w + 63) / 64;
+        words.assign(wordsPerRow * h, 0);
+    }
+
+    bool empty() const { return width_px == 0 || height_px == 0 || words.empty(); }
+
+    uint64_t *row(size_t y) { return words.data() + y * wordsPerRow; }
+    const uint64_t *row(size_t y) const { return words.data() + y * wordsPerRow; }
+
+    bool get(size_t x, size_t y) const { return (row(y)[x >> 6] >> (x & 63)) & 1u; }
+    void set(size_t x, size_t y, bool on)
+    {
+        uint64_t &w = row(y)[x >> 6];
+        const uint64_t bit = uint64_t(1) << (x & 63);
+        w = on ? (w | bit) : (w & ~bit);
+    }
+
+    // Valid bits of the last word in each row
+    uint64_t tailMask() const
+    {
+        const size_t r = width_px & 63;
+        return r ? ((uint64_t(1) << r) - 1) : ~uint64_t(0);
+    }
+
+    // Number of ink pixels
+    size_t countSet() const;
+
+    // Local-space bounds in millimeters
+    BoundingBox aabb() const
+    {
+        Vec2 max(static_cast<float>(width_px) * pixel_size_mm,
+                 static_cast<float>(height_px) * pixel_size_mm);
+        return BoundingBox(Vec2(0.0f, 0.0f), max);
+    }
+
+    LayerKind kind() const override { return LayerKind::Mask; }
+};
+
+// Word-level helpers: each call answers a question for 64 pixels at once
+namespace maskbits
+{
+    inline int popcount(uint64_t v)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        return static_cast<int>(__popcnt64(v));
+#elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_popcountll(v);
+#else
+        int n = 0;
+        for (; v; v &= v - 1) ++n;
+        return n;
+#endif
+    }
+
+    // Index of the lowest set bit; v must be non-zero
+    inline int lowestBit(uint64_t v)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long idx;
+        _BitScanForward64(&idx, v);
+        return static_cast<int>(idx);
+#elif defined(__GNUC__) || defined(__clang__)
+        return __builtin_ctzll(v);
+#else
+        return popcount((v & (0 - v)) - 1);
+#endif
+    }
+
+    // Word i of a row, shifted so bit b holds the pixel at b - 1 (west neighbour)
+    inline uint64_t west(const uint64_t *row, size_t i)
+    {
+        return (row[i] << 1) | (i > 0 ? row[i - 1] >> 63 : 0);
+    }
+
+    // Word i of a row, shifted so bit b holds the pixel at b + 1 (east neighbour)
+    inline uint64_t east(const uint64_t *row, size_t i, size_t wordsPerRow)
+    {
+        return (row[i] >> 1) | (i + 1 < wordsPerRow ? row[i + 1] << 63 : 0);
+    }
+
+    // Ink pixels of word i with a background 4-neighbour. up/down are the rows above and
+    // below, nullptr outside the image; everything outside counts as background.
+    inline uint64_t edge4(const uint64_t *up, const uint64_t *row, const uint64_t *down, size_t i, size_t wordsPerRow)
+    {
+        const uint64_t n = up ? up[i] : 0;
+        const uint64_t s = down ? down[i] : 0;
+        return row[i] & ~(n & s & west(row, i) & east(row, i, wordsPerRow));
+    }
+}
+
+inline size_t Mask::countSet() const
+{
+    size_t n = 0;
+    for (uint64_t w : words)
+        n += static_cast<size_t>(maskbits::popcount(w));
+    return n;
+}
+
+// Cut used when a Bitmap reaches a Mask filter with no Threshold in between (mid grey,
+// as the tracing filters used before they took masks)
+constexpr uint8_t kImplicitInkCut = 128;
+
+// Bitmap -> Mask: ink where pixel < cut
+inline void maskFromBitmap(const Bitmap &in, Mask &out, uint8_t cut)
+{
+    out.pixel_size_mm = in.pixel_size_mm;
+    out.resize(in.width_px, in.height_px);
+    if (in.pixels.empty())
+        return;
+    for (size_t y = 0; y < in.height_px; ++y)
+    {
+        const uint8_t *src = in.pixels.data() + y * in.width_px;
+        uint64_t *dst = out.row(y);
+        for (size_t i = 0; i < out.wordsPerRow; ++i)
+        {
+            const size_t x0 = i * 64;
+            const size_t n = (in.width_px - x0 < 64) ? in.width_px - x0 : 64;
+            uint64_t w = 0;
+            for (size_t b = 0; b < n; ++b)
+                w |= static_cast<uint64_t>(src[x0 + b] < cut) << b;
+            dst[i] = w;
+        }
+    }
+}
+
+// Mask -> Bitmap: ink is black (0), everything else white (255)
+inline void bitmapFromMask(const Mask &in, Bitmap &out)
+{
+    out.width_px = in.width_px;
+    out.height_px = in.height_px;
+    out.pixel_size_mm = in.pixel_size_mm;
+    out.pixels.resize(in.width_px * in.height_px);
+    if (in.empty())
+        return;
+    for (size_t y = 0; y < in.height_px; ++y)
+    {
+        const uint64_t *src = in.row(y);
+        uint8_t *dst = out.pixels.data() + y * in.width_px;
+        for (size_t x = 0; x < in.width_px; ++x)
+            dst[x] = ((src[x >> 6] >> (x & 63)) & 1u) ? 0 : 255;
+    }
+}
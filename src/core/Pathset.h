@@ -1,14 +1,26 @@
 #pragma once
 #include <vector>
+#include <cstdint>
+#include <algorithm>
 #include "core/Vec2.h"
 #include "core/Color.h"
+#include "core/Span.h"
 #include "filters/LayerBase.h"
 
+// Standalone polyline. Used to build single paths (fonts, generators); PathSet does not
+// store these, see below.
 struct Path {
     std::vector<Vec2> points;
     bool closed{false};
 };
 
+// Read-only view of one path inside a PathSet. Mirrors Path's fields so loops written
+// against Path (path.points.size(), path.points[i], path.closed) read the same.
+struct PathView {
+    Span<const Vec2> points;
+    bool closed{false};
+};
+
 
 struct BoundingBox {
     Vec2 min;
@@ -29,30 +41,148 @@ struct BoundingBox {
     }
 };
 
+// Per-path flag bits
+enum PathFlags : uint8_t {
+    PathClosed = 1u << 0,
+};
+
+// All paths share one contiguous point buffer (CSR layout): path i is
+// points[offsets[i] .. offsets[i + 1]) with flags[i]. offsets always holds size() + 1
+// entries, so an empty set has offsets == {0}.
+//
+// Paths are appended either whole (addPath) or point by point (addPoint ... endPath).
+// Existing paths can be read as PathView and edited in place through pathPoints(), but
+// not resized; filters that change point counts write a new PathSet.
 struct PathSet : public ILayerData {
-    std::vector<Path> paths;
+    std::vector<Vec2> points;
+    std::vector<uint32_t> offsets{0};
+    std::vector<uint8_t> flags;
     Color color {1.0f, 1.0f, 1.0f, 1.0f};
     mutable BoundingBox aabb;
 
     PathSet() = default;
 
+    // Number of paths
+    size_t size() const { return flags.size(); }
+    bool empty() const { return flags.empty(); }
+    size_t pointCount() const { return points.size(); }
+
+    void clear() {
+        points.clear();
+        offsets.assign(1, 0);
+        flags.clear();
+    }
+
+    void reserve(size_t pathCount, size_t pointTotal) {
+        offsets.reserve(pathCount + 1);
+        flags.reserve(pathCount);
+        points.reserve(pointTotal);
+    }
+
+    size_t pathSize(size_t i) const { return offsets[i + 1] - offsets[i]; }
+    bool closed(size_t i) const { return (flags[i] & PathClosed) != 0; }
+
+    PathView operator[](size_t i) const {
+        return PathView{Span<const Vec2>(points.data() + offsets[i], pathSize(i)), closed(i)};
+    }
+
+    // Mutable points of path i (the count is fixed)
+    Span<Vec2> pathPoints(size_t i) { return Span<Vec2>(points.data() + offsets[i], pathSize(i)); }
+
+    // Append a whole path. pts may point into this set (e.g. duplicating one of its paths).
+    void addPath(const Vec2 *pts, size_t n, bool isClosed = false) {
+        pts = reserveFor(pts, n);
+        for (size_t k = 0; k < n; ++k)
+            points.push_back(pts[k]);
+        endPath(isClosed);
+    }
+    void addPath(Span<const Vec2> pts, bool isClosed = false) { addPath(pts.data(), pts.size(), isClosed); }
+    void addPath(const std::vector<Vec2> &pts, bool isClosed = false) { addPath(pts.data(), pts.size(), isClosed); }
+    void addPath(const PathView &p) { addPath(p.points, p.closed); }
+    void addPath(const Path &p) { addPath(p.points, p.closed); }
+
+    // Append a path with its points in reverse order
+    void addPathReversed(const PathView &p) {
+        const Vec2 *pts = reserveFor(p.points.data(), p.points.size());
+        for (size_t k = p.points.size(); k-- > 0;)
+            points.push_back(pts[k]);
+        endPath(p.closed);
+    }
+
+    void addSegment(const Vec2 &a, const Vec2 &b) {
+        points.push_back(a);
+        points.push_back(b);
+        endPath(false);
+    }
+
+    // Incremental building: addPoint() any number of times, then endPath() to commit the
+    // points as a path or discardPath() to drop them.
+    void addPoint(const Vec2 &p) { points.push_back(p); }
+    size_t openPathSize() const { return points.size() - offsets.back(); }
+    void endPath(bool isClosed = false) {
+        offsets.push_back(static_cast<uint32_t>(points.size()));
+        flags.push_back(isClosed ? PathClosed : 0);
+    }
+    void discardPath() { points.resize(offsets.back()); }
+
+    // Append every path of another set
+    void append(const PathSet &o) {
+        const uint32_t base = static_cast<uint32_t>(points.size());
+        points.insert(points.end(), o.points.begin(), o.points.end());
+        for (size_t i = 1; i < o.offsets.size(); ++i)
+            offsets.push_back(base + o.offsets[i]);
+        flags.insert(flags.end(), o.flags.begin(), o.flags.end());
+    }
+
+    // Conversions for code that still wants owning paths
+    Path toPath(size_t i) const {
+        PathView v = (*this)[i];
+        return Path{std::vector<Vec2>(v.points.begin(), v.points.end()), v.closed};
+    }
+    void assign(const std::vector<Path> &paths) {
+        clear();
+        size_t total = 0;
+        for (const Path &p : paths)
+            total += p.points.size();
+        reserve(paths.size(), total);
+        for (const Path &p : paths)
+            addPath(p);
+    }
+
+    // Range-for over PathView
+    struct const_iterator {
+        const PathSet *set;
+        size_t i;
+        PathView operator*() const { return (*set)[i]; }
+        const_iterator &operator++() { ++i; return *this; }
+        bool operator!=(const const_iterator &o) const { return i != o.i; }
+        bool operator==(const const_iterator &o) const { return i == o.i; }
+    };
+    const_iterator begin() const { return const_iterator{this, 0}; }
+    const_iterator end() const { return const_iterator{this, size()}; }
+
     /// @brief Compute the axis-aligned bounding box of the pathset, in local space
     void computeAABB() const  {
         aabb.min = Vec2(0,0);
         aabb.max = Vec2(0,0);
-        bool first = true;
-        for (const auto& path : paths) {
-            for (const auto& p : path.points) {
-                if (first) {
-                    aabb.min = p;
-                    aabb.max = p;
-                    first = false;
-                } else {
-                    aabb.expandToInclude(p);
-                }
-            }
-        }
+        if (points.empty())
+            return;
+        aabb.min = points.front();
+        aabb.max = points.front();
+        for (const auto& p : points)
+            aabb.expandToInclude(p);
     }
 
     LayerKind kind() const override { return LayerKind::PathSet; }
-};
\ No newline at end of file
+
+private:
+    // Make room for n more points; returns src, rebased if it pointed into our buffer
+    const Vec2 *reserveFor(const Vec2 *src, size_t n) {
+        const Vec2 *base = points.data();
+        const bool inside = src >= base && src < base + points.size();
+        const size_t at = inside ? static_cast<size_t>(src - base) : 0;
+        if (points.size() + n > points.capacity())
+            points.reserve(std::max(points.size() + n, points.capacity() * 2));
+        return inside ? points.data() + at : src;
+    }
+};
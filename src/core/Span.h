@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+// Non-owning view of a contiguous array (a minimal std::span for C++17)
+template <typename T>
+struct Span
+{
+    T *ptr{nullptr};
+    size_t count{0};
+
+    Span() = default;
+    Span(T *p, size_t n) : ptr(p), count(n) {}
+
+    // Span<const T> from Span<T>
+    template <typename U>
+    Span(const Span<U> &o) : ptr(o.ptr), count(o.count) {}
+
+    // Any contiguous container with data() / size(), e.g. std::vector (lvalues only)
+    template <typename C, typename = decltype(std::declval<C &>().data())>
+    Span(C &c) : ptr(c.data()), count(c.size()) {}
+
+    T *data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+
+    T &operator[](size_t i) const { return ptr[i]; }
+    T &front() const { return ptr[0]; }
+    T &back() const { return ptr[count - 1]; }
+
+    T *begin() const { return ptr; }
+    T *end() const { return ptr + count; }
+
+    Span subspan(size_t offset, size_t n) const { return Span(ptr + offset, n); }
+};
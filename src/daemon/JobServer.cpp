@@ -0,0 +1,725 @@
+#include "daemon/JobServer.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+#include <glog/logging.h>
+#include <nlohmann/json.hpp>
+
+#include "Page.h"
+#include "plotters/PlotProgramCache.h"
+#include "utils/Serialization.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using nlohmann::json;
+
+namespace
+{
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+using PollFd = WSAPOLLFD;
+const SocketHandle kNoSocket = INVALID_SOCKET;
+void closeSocket(SocketHandle s) { closesocket(s); }
+int pollSockets(PollFd *fds, size_t n, int timeoutMs) { return WSAPoll(fds, static_cast<ULONG>(n), timeoutMs); }
+bool setNonBlocking(SocketHandle s)
+{
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+}
+bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+// AF_UNIX socket files are reparse points with their own tag
+bool isSocketFile(const std::string &path)
+{
+    WIN32_FIND_DATAA fd;
+    HANDLE h = FindFirstFileA(path.c_str(), &fd);
+    if (h == INVALID_HANDLE_VALUE) return false;
+    FindClose(h);
+    return (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && fd.dwReserved0 == IO_REPARSE_TAG_AF_UNIX;
+}
+// Socket files take the ACL of their directory
+bool restrictToOwner(const std::string &) { return true; }
+#else
+using SocketHandle = int;
+using PollFd = pollfd;
+const SocketHandle kNoSocket = -1;
+void closeSocket(SocketHandle s) { ::close(s); }
+int pollSockets(PollFd *fds, size_t n, int timeoutMs) { return ::poll(fds, static_cast<nfds_t>(n), timeoutMs); }
+bool setNonBlocking(SocketHandle s) { return fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0; }
+bool wouldBlock() { return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR; }
+bool isSocketFile(const std::string &path)
+{
+    std::error_code ec;
+    return std::filesystem::is_socket(std::filesystem::symlink_status(path, ec));
+}
+bool restrictToOwner(const std::string &path) { return ::chmod(path.c_str(), 0600) == 0; }
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// A client that sends more than this without a newline is dropped
+constexpr size_t kMaxLineBytes = size_t(256) << 20;
+// ...and so is one that stops reading its replies
+constexpr size_t kMaxPendingBytes = size_t(16) << 20;
+// Finished jobs kept around for "jobs"
+constexpr size_t kMaxFinishedJobs = 256;
+
+json statsToJson(const PlotSpooler::Stats &s)
+{
+    return json{
+        {"commands_queued", s.commandsQueued},
+        {"commands_sent", s.commandsSent},
+        {"planned_pen_down_mm", s.plannedPenDownMm},
+        {"done_pen_down_mm", s.donePenDownMm},
+        {"queued_ms", s.queuedMs},
+        {"elapsed_ms", s.elapsedMs},
+        {"planned_ms", s.plannedMs},
+        {"done_ms", s.doneMs},
+        {"pen_overlap_ms", s.penOverlapMs},
+        {"percent_complete", s.percentComplete},
+        {"eta_ms", s.etaMs},
+        {"underruns", s.underruns},
+        {"underrun_ms", s.underrunMs}};
+}
+
+json okReply() { return json{{"ok", true}}; }
+json errorReply(const std::string &error) { return json{{"ok", false}, {"error", error}}; }
+
+bool finished(JobServer::JobState state)
+{
+    return state == JobServer::JobState::Done || state == JobServer::JobState::Cancelled ||
+           state == JobServer::JobState::Failed;
+}
+
+// Runs on a worker thread: filter chains that have not produced output yet are evaluated
+// here, since nothing renders them in the daemon
+std::shared_ptr<const PlotProgram> compileProject(std::shared_ptr<PageModel> page, PlotterConfig cfg,
+                                                  std::optional<int> entity, bool liftPen)
+{
+    for (auto &kv : page->entities)
+    {
+        Entity &e = kv.second;
+        if (e.type() != EntityType::PathSet && (!entity || *entity == kv.first))
+            e.filterChain.outputBlocking();
+    }
+    std::string err;
+    std::shared_ptr<const PlotProgram> program =
+        PlotProgramCache::instance().get(*page, cfg, PlotSpooler::compileOptions(liftPen), entity, &err);
+    if (!program)
+        throw std::runtime_error(err.empty() ? "Nothing to plot" : err);
+    return program;
+}
+
+} // namespace
+
+struct JobServer::Client
+{
+    SocketHandle fd{kNoSocket};
+    std::string in;
+    std::string out;
+    bool watching{false};
+    bool closed{false};
+};
+
+struct JobServer::Net
+{
+    SocketHandle listenFd{kNoSocket};
+    std::vector<std::unique_ptr<Client>> clients;
+#ifdef _WIN32
+    bool wsaStarted{false};
+#endif
+};
+
+JobServer::JobServer() : JobServer(Options()) {}
+
+JobServer::JobServer(Options options) : m_options(std::move(options)), m_net(std::make_unique<Net>()) {}
+
+JobServer::~JobServer()
+{
+    stop();
+    std::lock_guard<std::mutex> lk(m_mutex);
+    // Stop every device at once, then wait for each spooler thread to leave the port
+    // before closing it
+    for (auto &d : m_devices)
+        d->spooler->requestCancel();
+    for (auto &d : m_devices)
+    {
+        d->spooler->cancel();
+        d->serial->disconnect();
+    }
+}
+
+int JobServer::addDevice(const std::string &port, std::string *errorOut)
+{
+    auto d = std::make_unique<Device>();
+    d->port = port;
+    d->serial = std::make_unique<SerialController>();
+    if (!d->serial->connect(port, 115200, errorOut))
+        return -1;
+    d->axidraw = std::make_unique<AxiDrawController>(*d->serial, d->axState);
+    d->axState.penUpPos = m_options.defaultConfig.penUpPos;
+    d->axState.penDownPos = m_options.defaultConfig.penDownPos;
+    std::string ierr;
+    if (!d->axidraw->initialize(&ierr))
+        LOG(WARNING) << "minotaurd: initializing " << port << " failed: " << ierr;
+    d->spooler = std::make_unique<PlotSpooler>(*d->serial, *d->axidraw);
+
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_devices.push_back(std::move(d));
+    LOG(INFO) << "minotaurd: device " << m_devices.size() - 1 << " on " << port;
+    return static_cast<int>(m_devices.size()) - 1;
+}
+
+size_t JobServer::deviceCount() const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    return m_devices.size();
+}
+
+bool JobServer::start(std::string *errorOut)
+{
+    if (m_thread.joinable())
+    {
+        if (errorOut) *errorOut = "Already running";
+        return false;
+    }
+
+    if (!m_options.socketPath.empty())
+    {
+#ifdef _WIN32
+        WSADATA wsa;
+        if (!m_net->wsaStarted && WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+        {
+            if (errorOut) *errorOut = "WSAStartup failed";
+            return false;
+        }
+        m_net->wsaStarted = true;
+#endif
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if (m_options.socketPath.size() >= sizeof(addr.sun_path))
+        {
+            if (errorOut) *errorOut = "Socket path too long: " + m_options.socketPath;
+            return false;
+        }
+        std::copy(m_options.socketPath.begin(), m_options.socketPath.end(), addr.sun_path);
+
+        // A socket left behind by an earlier run would make bind fail. Anything else at
+        // that path is not ours to delete.
+        std::error_code ec;
+        if (isSocketFile(m_options.socketPath))
+        {
+            std::filesystem::remove(m_options.socketPath, ec);
+        }
+        else if (std::filesystem::exists(m_options.socketPath, ec))
+        {
+            if (errorOut) *errorOut = "Not a socket, refusing to replace: " + m_options.socketPath;
+            return false;
+        }
+
+        SocketHandle fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool ok = fd != kNoSocket && bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        // Nobody can connect before listen(), so there is no window before this applies
+        ok = ok && restrictToOwner(m_options.socketPath);
+        ok = ok && listen(fd, 16) == 0 && setNonBlocking(fd);
+        if (!ok)
+        {
+            if (fd != kNoSocket) closeSocket(fd);
+            if (errorOut) *errorOut = "Could not listen on " + m_options.socketPath;
+            return false;
+        }
+        m_net->listenFd = fd;
+        LOG(INFO) << "minotaurd: listening on " << m_options.socketPath;
+    }
+
+    m_stop = false;
+    m_thread = std::thread([this] { serve(); });
+    return true;
+}
+
+void JobServer::stop()
+{
+    m_stop = true;
+    if (m_thread.joinable())
+        m_thread.join();
+
+    for (auto &c : m_net->clients) closeSocket(c->fd);
+    m_net->clients.clear();
+    if (m_net->listenFd != kNoSocket)
+    {
+        closeSocket(m_net->listenFd);
+        m_net->listenFd = kNoSocket;
+        std::error_code ec;
+        if (isSocketFile(m_options.socketPath))
+            std::filesystem::remove(m_options.socketPath, ec);
+    }
+#ifdef _WIN32
+    if (m_net->wsaStarted)
+    {
+        WSACleanup();
+        m_net->wsaStarted = false;
+    }
+#endif
+}
+
+std::string JobServer::request(const std::string &line)
+{
+    return handle(line, nullptr);
+}
+
+JobServer::JobState JobServer::jobState(int jobId) const
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    const Job *job = findJobLocked(jobId);
+    return job ? job->state : JobState::Failed;
+}
+
+const char *JobServer::stateName(JobState state)
+{
+    switch (state)
+    {
+    case JobState::Queued: return "queued";
+    case JobState::Running: return "running";
+    case JobState::Paused: return "paused";
+    case JobState::Done: return "done";
+    case JobState::Cancelled: return "cancelled";
+    case JobState::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+JobServer::Job *JobServer::findJobLocked(int jobId)
+{
+    for (auto &j : m_jobs)
+        if (j->id == jobId) return j.get();
+    return nullptr;
+}
+
+const JobServer::Job *JobServer::findJobLocked(int jobId) const
+{
+    for (const auto &j : m_jobs)
+        if (j->id == jobId) return j.get();
+    return nullptr;
+}
+
+void JobServer::setStateLocked(Job &job, JobState state, const std::string &error)
+{
+    job.state = state;
+    if (!error.empty()) job.error = error;
+    json ev{{"event", "job"}, {"job", job.id}, {"state", stateName(state)}};
+    if (job.runningOn >= 0) ev["device"] = job.runningOn;
+    if (!job.error.empty()) ev["error"] = job.error;
+    m_events.push_back(ev.dump());
+    LOG(INFO) << "minotaurd: job " << job.id << " " << stateName(state) << (error.empty() ? "" : ": ") << error;
+}
+
+void JobServer::tickLocked()
+{
+    // Compiles that have landed
+    for (auto &job : m_jobs)
+    {
+        if (!job->compiling.valid() ||
+            job->compiling.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+        try
+        {
+            job->program = job->compiling.get();
+        }
+        catch (const std::exception &ex)
+        {
+            if (!finished(job->state)) setStateLocked(*job, JobState::Failed, ex.what());
+        }
+    }
+
+    // Jobs whose spooler has stopped
+    for (size_t i = 0; i < m_devices.size(); ++i)
+    {
+        Device &d = *m_devices[i];
+        Job *job = d.jobId >= 0 ? findJobLocked(d.jobId) : nullptr;
+        if (!job) continue;
+        job->lastStats = d.spooler->stats();
+        if (d.spooler->isRunning()) continue;
+
+        d.jobId = -1;
+        if (job->cancelRequested)
+            setStateLocked(*job, JobState::Cancelled);
+        else if (job->lastStats.doneMs >= job->lastStats.plannedMs)
+            setStateLocked(*job, JobState::Done);
+        else
+            setStateLocked(*job, JobState::Failed, d.serial->isConnected() ? "Streaming stopped early" : "Device disconnected");
+        job->runningOn = -1;
+    }
+
+    dispatchLocked();
+
+    // Forget the oldest finished jobs
+    size_t finishedCount = 0;
+    for (const auto &j : m_jobs) finishedCount += finished(j->state) ? 1 : 0;
+    for (auto it = m_jobs.begin(); it != m_jobs.end() && finishedCount > kMaxFinishedJobs;)
+    {
+        if (finished((*it)->state) && !(*it)->compiling.valid())
+        {
+            it = m_jobs.erase(it);
+            --finishedCount;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void JobServer::dispatchLocked()
+{
+    for (size_t i = 0; i < m_devices.size(); ++i)
+    {
+        Device &d = *m_devices[i];
+        if (d.jobId >= 0 || !d.serial->isConnected()) continue;
+
+        // Highest priority first, then oldest
+        Job *best = nullptr;
+        for (auto &j : m_jobs)
+        {
+            if (j->state != JobState::Queued || j->holdInQueue || !j->program) continue;
+            if (j->device >= 0 && j->device != static_cast<int>(i)) continue;
+            if (!best || j->priority > best->priority) best = j.get();
+        }
+        if (!best) continue;
+
+        // The pen servo positions are device settings; bring them in line with the job
+        std::string err;
+        if (d.axState.penUpPos != best->cfg.penUpPos && !d.axidraw->setPenUpValue(best->cfg.penUpPos, &err))
+            LOG(WARNING) << "minotaurd: setting pen up on device " << i << ": " << err;
+        if (d.axState.penDownPos != best->cfg.penDownPos && !d.axidraw->setPenDownValue(best->cfg.penDownPos, &err))
+            LOG(WARNING) << "minotaurd: setting pen down on device " << i << ": " << err;
+
+        if (!d.spooler->startProgram(best->program, best->cfg))
+        {
+            setStateLocked(*best, JobState::Failed, "Device " + std::to_string(i) + " could not start");
+            continue;
+        }
+        d.jobId = best->id;
+        best->runningOn = static_cast<int>(i);
+        best->lastStats = d.spooler->stats();
+        setStateLocked(*best, JobState::Running);
+    }
+}
+
+std::string JobServer::handle(const std::string &line, Client *client)
+{
+    json req;
+    try
+    {
+        req = json::parse(line);
+    }
+    catch (const std::exception &ex)
+    {
+        return errorReply(std::string("Bad request: ") + ex.what()).dump();
+    }
+    if (!req.is_object())
+        return errorReply("Bad request: expected an object").dump();
+
+    auto run = [&]() -> json {
+        const std::string cmd = req.value("cmd", std::string{});
+        if (cmd == "submit")
+        {
+            auto job = std::make_unique<Job>();
+            job->device = req.value("device", -1);
+            if (job->device >= static_cast<int>(deviceCount()))
+                return errorReply("No device " + std::to_string(job->device));
+            job->name = req.value("name", std::string{});
+            job->priority = req.value("priority", 0);
+            const bool liftPen = req.value("lift_pen", true);
+            std::optional<int> entity;
+            if (req.contains("entity")) entity = req["entity"].get<int>();
+
+            std::string err;
+            if (req.contains("program_file"))
+            {
+                const std::string path = req["program_file"].get<std::string>();
+                job->cfg = m_options.defaultConfig;
+                std::shared_ptr<PlotProgram> program = PlotProgram::load(path, &err);
+                if (!program) return errorReply(err);
+                job->program = std::move(program);
+                if (job->name.empty()) job->name = path;
+            }
+            else if (req.contains("project") || req.contains("project_file"))
+            {
+                // Parsed here so that a bad project is an error for the client, compiled later
+                auto page = std::make_shared<PageModel>();
+                job->cfg = m_options.defaultConfig;
+                bool ok = false;
+                if (req.contains("project"))
+                {
+                    ok = serialization::projectFromString(*page, job->cfg, req["project"].dump(), &err);
+                }
+                else
+                {
+                    const std::string path = req["project_file"].get<std::string>();
+                    ok = serialization::loadProject(*page, job->cfg, nullptr, path, &err);
+                    if (job->name.empty()) job->name = path;
+                }
+                if (!ok) return errorReply(err);
+                job->compiling = std::async(std::launch::async, compileProject, std::move(page), job->cfg, entity, liftPen);
+            }
+            else
+            {
+                return errorReply("submit needs project, project_file or program_file");
+            }
+
+            std::lock_guard<std::mutex> lk(m_mutex);
+            job->id = m_nextJobId++;
+            const int id = job->id;
+            m_jobs.push_back(std::move(job));
+            setStateLocked(*m_jobs.back(), JobState::Queued);
+            json r = okReply();
+            r["job"] = id;
+            return r;
+        }
+        if (cmd == "jobs")
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            json jobs = json::array();
+            for (const auto &j : m_jobs)
+            {
+                json jj{{"job", j->id},
+                        {"name", j->name},
+                        {"priority", j->priority},
+                        {"state", stateName(j->state)},
+                        {"compiled", j->program != nullptr}};
+                if (j->device >= 0) jj["device"] = j->device;
+                if (j->holdInQueue) jj["held"] = true;
+                if (j->runningOn >= 0) jj["running_on"] = j->runningOn;
+                if (!j->error.empty()) jj["error"] = j->error;
+                if (j->state != JobState::Queued) jj["stats"] = statsToJson(j->lastStats);
+                jobs.push_back(std::move(jj));
+            }
+            json r = okReply();
+            r["jobs"] = std::move(jobs);
+            return r;
+        }
+        if (cmd == "devices")
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            json devices = json::array();
+            for (size_t i = 0; i < m_devices.size(); ++i)
+            {
+                const Device &d = *m_devices[i];
+                json dj{{"device", i}, {"port", d.port}, {"connected", d.serial->isConnected()}};
+                if (d.jobId >= 0) dj["job"] = d.jobId;
+                devices.push_back(std::move(dj));
+            }
+            json r = okReply();
+            r["devices"] = std::move(devices);
+            return r;
+        }
+        if (cmd == "pause" || cmd == "resume" || cmd == "cancel")
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            Job *job = findJobLocked(req.value("job", -1));
+            if (!job) return errorReply("No such job");
+            if (finished(job->state)) return errorReply(std::string("Job is ") + stateName(job->state));
+            Device *d = job->runningOn >= 0 ? m_devices[job->runningOn].get() : nullptr;
+            if (cmd == "pause")
+            {
+                if (job->state == JobState::Queued)
+                {
+                    job->holdInQueue = true;
+                }
+                else if (job->state == JobState::Running)
+                {
+                    d->spooler->pause();
+                    setStateLocked(*job, JobState::Paused);
+                }
+            }
+            else if (cmd == "resume")
+            {
+                if (job->state == JobState::Queued)
+                {
+                    job->holdInQueue = false;
+                }
+                else if (job->state == JobState::Paused)
+                {
+                    d->spooler->resume();
+                    setStateLocked(*job, JobState::Running);
+                }
+            }
+            else
+            {
+                if (d)
+                {
+                    // Only signal here: the spooler drains and stops on its own, and
+                    // tickLocked() sets the final state once it has
+                    job->cancelRequested = true;
+                    d->spooler->requestCancel();
+                }
+                else
+                {
+                    setStateLocked(*job, JobState::Cancelled);
+                }
+            }
+            return okReply();
+        }
+        if (cmd == "watch" || cmd == "unwatch")
+        {
+            if (!client) return errorReply("watch needs a socket connection");
+            client->watching = cmd == "watch";
+            return okReply();
+        }
+        return errorReply("Unknown command: " + cmd);
+    };
+
+    // A field of the wrong type throws out of json::value() / get(); it is the client's error
+    json reply;
+    try
+    {
+        reply = run();
+    }
+    catch (const json::exception &ex)
+    {
+        reply = errorReply(std::string("Bad request: ") + ex.what());
+    }
+
+    // Echo the client's tag so that replies can be matched to requests
+    if (req.contains("tag")) reply["tag"] = req["tag"];
+    return reply.dump();
+}
+
+void JobServer::broadcast(const std::string &line)
+{
+    for (auto &c : m_net->clients)
+        if (c->watching) c->out += line + "\n";
+}
+
+void JobServer::serve()
+{
+    std::vector<PollFd> fds;
+    while (!m_stop)
+    {
+        fds.clear();
+        if (m_net->listenFd != kNoSocket)
+            fds.push_back(PollFd{m_net->listenFd, POLLIN, 0});
+        for (auto &c : m_net->clients)
+            fds.push_back(PollFd{c->fd, static_cast<short>(POLLIN | (c->out.empty() ? 0 : POLLOUT)), 0});
+
+        if (fds.empty())
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        else
+            pollSockets(fds.data(), fds.size(), 50);
+
+        size_t k = 0;
+        if (m_net->listenFd != kNoSocket)
+        {
+            if (fds[k++].revents & POLLIN)
+            {
+                SocketHandle fd;
+                while ((fd = accept(m_net->listenFd, nullptr, nullptr)) != kNoSocket)
+                {
+                    setNonBlocking(fd);
+                    auto c = std::make_unique<Client>();
+                    c->fd = fd;
+                    m_net->clients.push_back(std::move(c));
+                }
+            }
+        }
+
+        // fds only covers the clients that were there before accepting
+        const size_t polled = fds.size() - k;
+        for (size_t i = 0; i < polled; ++i)
+        {
+            Client &c = *m_net->clients[i];
+            const short revents = fds[k + i].revents;
+            if (revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                char buf[65536];
+                for (;;)
+                {
+                    const auto n = recv(c.fd, buf, sizeof(buf), 0);
+                    if (n > 0)
+                    {
+                        c.in.append(buf, static_cast<size_t>(n));
+                        continue;
+                    }
+                    if (n == 0 || !wouldBlock()) c.closed = true;
+                    break;
+                }
+                size_t start = 0, nl;
+                while ((nl = c.in.find('\n', start)) != std::string::npos)
+                {
+                    std::string line = c.in.substr(start, nl - start);
+                    start = nl + 1;
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    if (!line.empty()) c.out += handle(line, &c) + "\n";
+                }
+                c.in.erase(0, start);
+                if (c.in.size() > kMaxLineBytes) c.closed = true;
+            }
+        }
+
+        std::vector<std::string> events;
+        json stats = json::array();
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            tickLocked();
+            events.swap(m_events);
+            const auto now = std::chrono::steady_clock::now();
+            if (now - m_lastStats >= std::chrono::milliseconds(m_options.statsIntervalMs))
+            {
+                m_lastStats = now;
+                for (const auto &j : m_jobs)
+                {
+                    if (j->state == JobState::Running || j->state == JobState::Paused)
+                        stats.push_back(json{{"job", j->id}, {"device", j->runningOn}, {"stats", statsToJson(j->lastStats)}});
+                }
+            }
+        }
+        for (const std::string &ev : events) broadcast(ev);
+        if (!stats.empty()) broadcast(json{{"event", "stats"}, {"jobs", std::move(stats)}}.dump());
+
+        for (auto &c : m_net->clients)
+        {
+            while (!c->closed && !c->out.empty())
+            {
+                const auto n = send(c->fd, c->out.data(), static_cast<int>(std::min(c->out.size(), size_t(1) << 20)), kSendFlags);
+                if (n > 0)
+                {
+                    c->out.erase(0, static_cast<size_t>(n));
+                    continue;
+                }
+                if (!wouldBlock()) c->closed = true;
+                break;
+            }
+            if (c->out.size() > kMaxPendingBytes) c->closed = true;
+        }
+        for (auto it = m_net->clients.begin(); it != m_net->clients.end();)
+        {
+            if ((*it)->closed)
+            {
+                closeSocket((*it)->fd);
+                it = m_net->clients.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
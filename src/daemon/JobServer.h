@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "plotters/AxidrawController.h"
+#include "plotters/PlotProgram.h"
+#include "plotters/PlotSpooler.h"
+#include "plotters/PlotterConfig.h"
+#include "serial/SerialController.h"
+
+// Headless job server behind minotaurd.
+//
+// Owns the plotter connections and a prioritized job queue. Clients talk to it over a
+// local (Unix domain) socket with one JSON object per line; see request() for the
+// commands. Jobs are projects (compiled on a background thread through
+// PlotProgramCache) or already compiled plot programs, and each one runs on the first
+// idle device it may use, highest priority first, FIFO within a priority.
+class JobServer
+{
+public:
+    struct Options
+    {
+        std::string socketPath;
+        // How often watching clients get the stats of running jobs
+        int statsIntervalMs{500};
+        // Motion settings for jobs that do not bring their own (compiled programs)
+        PlotterConfig defaultConfig{};
+    };
+
+    enum class JobState
+    {
+        Queued,
+        Running,
+        Paused,
+        Done,
+        Cancelled,
+        Failed,
+    };
+
+    JobServer();
+    explicit JobServer(Options options);
+    ~JobServer();
+
+    // Connect a plotter on the given port. Returns its device index, or -1.
+    int addDevice(const std::string &port, std::string *errorOut = nullptr);
+    size_t deviceCount() const;
+
+    // Listen on the socket and start serving. Without a socket path only request() works.
+    bool start(std::string *errorOut = nullptr);
+    void stop();
+
+    // Handle one request line the way the socket does and return the reply line (no
+    // newline). Commands, all with "cmd":
+    //   submit   {"project": {...} | "project_file": path | "program_file": path,
+    //             "priority": int, "device": int, "entity": int, "lift_pen": bool, "name": str}
+    //            -> {"ok": true, "job": id}
+    //   jobs     -> {"ok": true, "jobs": [...]}, with stats for running jobs
+    //   devices  -> {"ok": true, "devices": [...]}
+    //   pause | resume | cancel {"job": id}
+    //   watch | unwatch   (socket only) job state events and periodic stats
+    std::string request(const std::string &line);
+
+    JobState jobState(int jobId) const;
+    static const char *stateName(JobState state);
+
+private:
+    struct Device
+    {
+        std::string port;
+        std::unique_ptr<SerialController> serial;
+        AxiDrawState axState;
+        std::unique_ptr<AxiDrawController> axidraw;
+        std::unique_ptr<PlotSpooler> spooler;
+        int jobId{-1};
+    };
+
+    struct Job
+    {
+        int id{0};
+        std::string name;
+        int priority{0};
+        int device{-1}; // required device, -1 for any
+        JobState state{JobState::Queued};
+        bool holdInQueue{false}; // paused before it started
+        bool cancelRequested{false};
+        std::string error;
+        PlotterConfig cfg{};
+        std::shared_ptr<const PlotProgram> program;
+        std::future<std::shared_ptr<const PlotProgram>> compiling;
+        int runningOn{-1};
+        PlotSpooler::Stats lastStats{};
+    };
+
+    struct Client;
+    struct Net;
+
+    // All under m_mutex
+    void tickLocked();
+    void dispatchLocked();
+    void setStateLocked(Job &job, JobState state, const std::string &error = std::string());
+    Job *findJobLocked(int jobId);
+    const Job *findJobLocked(int jobId) const;
+
+    std::string handle(const std::string &line, Client *client);
+    void serve();
+    void broadcast(const std::string &line);
+
+    Options m_options;
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<Device>> m_devices;
+    std::vector<std::unique_ptr<Job>> m_jobs; // in submission order
+    int m_nextJobId{1};
+    std::vector<std::string> m_events; // job state changes waiting for watchers
+
+    std::unique_ptr<Net> m_net;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::chrono::steady_clock::time_point m_lastStats{};
+};
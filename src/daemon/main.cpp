@@ -0,0 +1,145 @@
+// minotaurd: headless plot job server. Owns the plotters and takes jobs over a local socket.
+//
+//   minotaurd [--socket PATH] [--port PORT]... [--auto] [--config PROJECT.json]
+//             [--cache DIR] [--simulate N]
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "Page.h"
+#include "daemon/JobServer.h"
+#include "filters/FilterRegistry.h"
+#include "plotters/EbbSimulator.h"
+#include "plotters/PlotProgramCache.h"
+#include "utils/Serialization.h"
+
+namespace
+{
+
+volatile std::sig_atomic_t g_quit = 0;
+
+void onSignal(int) { g_quit = 1; }
+
+void usage()
+{
+    std::fprintf(stderr,
+                 "usage: minotaurd [options]\n"
+                 "  --socket PATH     socket to listen on (default: minotaurd.sock in the temp directory)\n"
+                 "  --port PORT       plotter serial port, repeat for several plotters\n"
+                 "  --auto            every connected EiBotBoard\n"
+                 "  --config FILE     project whose plotter settings are the defaults\n"
+                 "  --cache DIR       plot program cache directory, empty to disable\n"
+                 "  --simulate N      N simulated plotters (Linux)\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    google::InitGoogleLogging(argv[0]);
+    FilterRegistry::initDefaults();
+
+    JobServer::Options options;
+    std::error_code ec;
+    options.socketPath = (std::filesystem::temp_directory_path(ec) / "minotaurd.sock").string();
+    std::vector<std::string> ports;
+    bool autoPorts = false;
+    int simulated = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--socket" && hasValue)
+            options.socketPath = argv[++i];
+        else if (arg == "--port" && hasValue)
+            ports.push_back(argv[++i]);
+        else if (arg == "--auto")
+            autoPorts = true;
+        else if (arg == "--cache" && hasValue)
+            PlotProgramCache::instance().setDirectory(argv[++i]);
+        else if (arg == "--simulate" && hasValue)
+            simulated = std::atoi(argv[++i]);
+        else if (arg == "--config" && hasValue)
+        {
+            PageModel page;
+            std::string err;
+            if (!serialization::loadProject(page, options.defaultConfig, nullptr, argv[++i], &err))
+            {
+                std::fprintf(stderr, "minotaurd: %s\n", err.c_str());
+                return 1;
+            }
+        }
+        else
+        {
+            usage();
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    if (autoPorts)
+    {
+        SerialController probe;
+        for (const SerialController::PortInfo &p : probe.listPorts())
+        {
+            if (p.vendorId == SerialController::kEBB_VID && p.productId == SerialController::kEBB_PID)
+                ports.push_back(p.path);
+        }
+    }
+
+    // Simulated plotters sit behind ptys so that they go through the same serial path
+    std::vector<std::unique_ptr<EbbSimulator>> sims;
+    std::vector<std::unique_ptr<EbbPtyServer>> simServers;
+#ifdef __linux__
+    for (int i = 0; i < simulated; ++i)
+    {
+        sims.push_back(std::make_unique<EbbSimulator>(EbbSimulator::Options(), VirtualClock(1.0)));
+        simServers.push_back(std::make_unique<EbbPtyServer>(*sims.back()));
+        std::string err;
+        if (!simServers.back()->start(&err))
+        {
+            std::fprintf(stderr, "minotaurd: simulator: %s\n", err.c_str());
+            return 1;
+        }
+        ports.push_back(simServers.back()->devicePath());
+    }
+#else
+    if (simulated > 0)
+        std::fprintf(stderr, "minotaurd: --simulate is only available on Linux\n");
+#endif
+
+    JobServer server(options);
+    for (const std::string &port : ports)
+    {
+        std::string err;
+        if (server.addDevice(port, &err) < 0)
+            std::fprintf(stderr, "minotaurd: %s: %s\n", port.c_str(), err.c_str());
+    }
+    if (server.deviceCount() == 0)
+        std::fprintf(stderr, "minotaurd: no plotters connected, jobs will wait in the queue\n");
+
+    std::string err;
+    if (!server.start(&err))
+    {
+        std::fprintf(stderr, "minotaurd: %s\n", err.c_str());
+        return 1;
+    }
+    std::fprintf(stderr, "minotaurd: %zu plotter(s), listening on %s\n", server.deviceCount(),
+                 options.socketPath.c_str());
+
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    while (!g_quit) std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    server.stop();
+    for (auto &s : simServers) s->stop();
+    return 0;
+}
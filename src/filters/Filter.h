@@ -61,11 +61,24 @@ struct FilterBase
     double lastRunMs() const { return m_lastRunMs.load(); }
     void setLastRunMs(double ms) { m_lastRunMs.store(ms); }
 
+    // Optional one-line report from the last apply() (e.g. an estimate the filter computed),
+    // shown under the filter's stats. Read on the thread that ran apply().
+    virtual std::string runSummary() const { return {}; }
+    const std::string &lastSummary() const { return m_lastSummary; }
+    void setLastSummary(const std::string &s) { m_lastSummary = s; }
+
+    // Cooperative cancellation for background evaluation. Long-running filters poll
+    // cancelled() between work units and return early; a cancelled output is discarded.
+    void setCancelToken(const std::atomic<bool> *token) { m_cancelToken = token; }
+    bool cancelled() const { return m_cancelToken && m_cancelToken->load(std::memory_order_relaxed); }
+
 protected:
+    const std::atomic<bool> *m_cancelToken{nullptr};
     std::atomic<uint64_t> m_version{1};
     std::atomic<double> m_lastRunMs{0.0};
     std::atomic<size_t> m_lastVertexCount{0};
     std::atomic<size_t> m_lastPathCount{0};
+    std::string m_lastSummary;
 };
 
 template <typename T>
@@ -81,6 +94,11 @@ inline void ensure(LayerPtr &p)
         if (!isFloatImageLayer(p))
             p = std::make_shared<FloatImage>();
     }
+    else if constexpr (std::is_same_v<T, Mask>)
+    {
+        if (!isMaskLayer(p))
+            p = std::make_shared<Mask>();
+    }
     else
     {
         if (!isPathSetLayer(p))
@@ -100,6 +118,11 @@ inline T &as(LayerPtr &p)
         assert(isFloatImageLayer(p));
         return *static_cast<FloatImage *>(p.get());
     }
+    else if constexpr (std::is_same_v<T, Mask>)
+    {
+        assert(isMaskLayer(p));
+        return *static_cast<Mask *>(p.get());
+    }
     else
     {
         assert(isPathSetLayer(p));
@@ -119,6 +142,11 @@ inline const T &asConst(const LayerPtr &p)
         assert(isFloatImageLayer(p));
         return *static_cast<const FloatImage *>(p.get());
     }
+    else if constexpr (std::is_same_v<T, Mask>)
+    {
+        assert(isMaskLayer(p));
+        return *static_cast<const Mask *>(p.get());
+    }
     else
     {
         assert(isPathSetLayer(p));
@@ -138,6 +166,8 @@ struct FilterTyped : public FilterBase
             return LayerKind::Bitmap;
         else if constexpr (std::is_same<InT, FloatImage>::value)
             return LayerKind::FloatImage;
+        else if constexpr (std::is_same<InT, Mask>::value)
+            return LayerKind::Mask;
         else
             return LayerKind::PathSet;
     }
@@ -148,16 +178,45 @@ struct FilterTyped : public FilterBase
             return LayerKind::Bitmap;
         else if constexpr (std::is_same<OutT, FloatImage>::value)
             return LayerKind::FloatImage;
+        else if constexpr (std::is_same<OutT, Mask>::value)
+            return LayerKind::Mask;
         else
             return LayerKind::PathSet;
     }
 
     void apply(const LayerPtr &in, LayerPtr &out) const override
     {
-        const InT &src = asConst<InT>(in);
         ensure<OutT>(out);
         OutT &dst = as<OutT>(out);
-        applyTyped(src, dst);
+
+        // Bitmap and Mask feed each other: convert on the way in. Chains built in the UI or
+        // loaded from a project get an explicit Threshold before a Mask filter, so this
+        // only happens when one is disabled or removed.
+        if constexpr (std::is_same<InT, Mask>::value)
+        {
+            if (isBitmapLayer(in))
+            {
+                LOG_FIRST_N(WARNING, 1) << name() << ": bitmap input converted to a mask at pixel < "
+                                        << static_cast<int>(kImplicitInkCut)
+                                        << "; add a Threshold filter to choose the cut";
+                Mask converted;
+                maskFromBitmap(asConst<Bitmap>(in), converted, kImplicitInkCut);
+                applyTyped(converted, dst);
+                return;
+            }
+        }
+        else if constexpr (std::is_same<InT, Bitmap>::value)
+        {
+            if (isMaskLayer(in))
+            {
+                Bitmap converted;
+                bitmapFromMask(asConst<Mask>(in), converted);
+                applyTyped(converted, dst);
+                return;
+            }
+        }
+
+        applyTyped(asConst<InT>(in), dst);
     }
 
     // Implemented by concrete filters
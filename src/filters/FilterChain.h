@@ -5,9 +5,13 @@
 #include <vector>
 #include <cassert>
 #include <chrono>
+#include <atomic>
+#include <mutex>
 
 #include "Types.h"
 #include "Filter.h"
+#include "FilterEvaluator.h"
+#include "FilterRegistry.h"
 
 struct LayerCache
 {
@@ -31,25 +35,32 @@ public:
     {
         if (this != &other)
         {
+            cancelBackground();
             m_filters.clear();
             m_layers.clear();
+            m_enabled.clear();
             m_base = other.m_base;
             m_baseGen = other.m_baseGen;
+            ++m_structureGen;
         }
         return *this;
     }
 
-    // Move defaulted
+    // Move defaulted; the background state travels with the chain
     FilterChain(FilterChain &&) noexcept = default;
     FilterChain &operator=(FilterChain &&) noexcept = default;
 
+    ~FilterChain() { cancelBackground(); }
+
     void clear()
     {
+        cancelBackground();
         m_filters.clear();
         m_layers.clear();
         m_enabled.clear();
         m_base.reset();
         m_baseGen = 0;
+        ++m_structureGen;
     }
 
     void setBase(const LayerPtr &base, uint64_t baseGen)
@@ -67,34 +78,70 @@ public:
         if (m_filters.empty())
         {
             if (m_base)
-                assert(f->inputKind() == m_base->kind());
+                assert(layerKindFeeds(m_base->kind(), f->inputKind()));
         }
         else
         {
             auto prevOut = m_filters.back()->outputKind();
-            assert(prevOut == f->inputKind());
+            assert(layerKindFeeds(prevOut, f->inputKind()));
         }
 
         m_filters.emplace_back(std::move(f));
         m_layers.emplace_back(LayerCache{});
         m_enabled.emplace_back(true);
+        ++m_structureGen;
         return m_filters.size() - 1;
     }
 
     size_t size() const { return m_filters.size(); }
 
+    // Non-blocking: adopts any finished background run, schedules a new one if the chain is
+    // stale, and returns the output of the last completed generation. Until the first run
+    // lands this falls back to the nearest available upstream layer (ultimately the base).
     const LayerPtr &output()
     {
         if (m_filters.empty())
+        {
+            publishOutput();
             return m_base;
-        return evaluate(m_filters.size() - 1);
+        }
+        pollBackground();
+        publishOutput();
+        return displayLayer();
     }
 
-    const LayerPtr &outputLayer() const
+    // Blocking: evaluates the whole chain on the calling thread (tools, headless use)
+    const LayerPtr &outputBlocking()
     {
         if (m_filters.empty())
+        {
+            publishOutput();
             return m_base;
-        return m_layers[m_layers.size() - 1].data;
+        }
+        const LayerPtr &out = evaluate(m_filters.size() - 1);
+        publishOutput();
+        return out;
+    }
+
+    // True while a background run for this chain is queued or executing
+    bool isEvaluating() const
+    {
+        if (!m_async)
+            return false;
+        std::lock_guard<std::mutex> lk(m_async->mutex);
+        return m_async->inFlight;
+    }
+
+    // Output of the last run that finished the whole chain (the base if it has no filters),
+    // as of the owner's last output() or outputBlocking() call. Safe from any thread, e.g.
+    // plot compilation while a background run is in flight. Null until a run has landed:
+    // callers must handle that.
+    LayerPtr outputLayer() const
+    {
+        if (!m_async)
+            return nullptr;
+        std::lock_guard<std::mutex> lk(m_async->mutex);
+        return m_async->published;
     }
 
     void invalidateAll()
@@ -122,6 +169,7 @@ public:
         m_filters.erase(m_filters.begin() + static_cast<std::ptrdiff_t>(index));
         m_layers.erase(m_layers.begin() + static_cast<std::ptrdiff_t>(index));
         m_enabled.erase(m_enabled.begin() + static_cast<std::ptrdiff_t>(index));
+        ++m_structureGen;
         // Invalidate remaining caches; upstream may have changed
         invalidateAll();
         return true;
@@ -147,6 +195,7 @@ public:
         }
 
         m_enabled[index] = enabled;
+        ++m_structureGen;
         invalidateAll();
     }
 
@@ -195,7 +244,7 @@ public:
         if (nextEn < 0) return true; // no downstream consumer
 
         LayerKind nextInput = m_filters[static_cast<size_t>(nextEn)]->inputKind();
-        return upstreamKind == nextInput;
+        return layerKindFeeds(upstreamKind, nextInput);
     }
 
     bool canEnableFilterAtIndex(size_t index) const
@@ -209,13 +258,13 @@ public:
                                      : baseKind();
 
         // This filter must accept upstream kind
-        if (m_filters[index]->inputKind() != upstreamKind)
+        if (!layerKindFeeds(upstreamKind, m_filters[index]->inputKind()))
             return false;
 
         // And its output must feed next enabled filter if exists
         int nextEn = nextEnabledIndex(static_cast<int>(index) + 1);
         if (nextEn < 0) return true;
-        return m_filters[index]->outputKind() == m_filters[static_cast<size_t>(nextEn)]->inputKind();
+        return layerKindFeeds(m_filters[index]->outputKind(), m_filters[static_cast<size_t>(nextEn)]->inputKind());
     }
 
     bool canDisableFilterAtIndex(size_t index) const
@@ -234,12 +283,7 @@ public:
 
         if (!m_enabled[i])
         {
-            // Bypass: forward upstream unchanged
-            cache.data = upstream;
-            cache.upstreamGen = upstreamGen;
-            cache.paramVer = filter.paramVersion();
-            cache.gen = upstreamGen; // propagate generation for downstream
-            cache.valid = true;
+            bypass(cache, upstream, upstreamGen, filter.paramVersion());
             return cache.data;
         }
 
@@ -249,36 +293,284 @@ public:
 
         if (needsRecompute)
         {
-            auto t0 = std::chrono::high_resolution_clock::now();
-            // Avoid aliasing: if our output pointer aliases upstream, reset so we don't mutate upstream in-place
-            if (cache.data == upstream)
-            {
-                cache.data.reset();
-            }
-            filter.apply(upstream, cache.data);
-            auto t1 = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double, std::milli> dt = t1 - t0;
-            filter.setLastRunMs(dt.count());
+            // Never write into a layer someone else may be holding (upstream or the displayed output)
+            cache.data.reset();
+            FilterRunStats stats = runFilter(filter, upstream, cache.data);
+            applyStats(filter, stats);
             cache.upstreamGen = upstreamGen;
             cache.paramVer = filter.paramVersion();
             cache.gen = cache.gen + 1; // advance local generation
             cache.valid = true;
+        }
+        return cache.data;
+    }
+
+private:
+    struct FilterRunStats
+    {
+        bool ran{false};
+        double ms{0.0};
+        bool hasPathStats{false};
+        size_t pathCount{0};
+        size_t vertexCount{0};
+        std::string summary;
+    };
+
+    // Result of one background run, produced on a worker thread and adopted on the owner thread
+    struct BackgroundResult
+    {
+        uint64_t structureGen{0};
+        size_t completed{0}; // number of leading layers that finished before cancellation
+        std::vector<LayerCache> layers;
+        std::vector<FilterRunStats> stats;
+    };
+
+    struct BackgroundState
+    {
+        std::mutex mutex;
+        bool inFlight{false};
+        bool hasResult{false};
+        BackgroundResult result;
+        std::shared_ptr<std::atomic<bool>> cancel;
+        LayerPtr published; // what outputLayer() returns
+    };
+
+    static void bypass(LayerCache &cache, const LayerPtr &upstream, uint64_t upstreamGen, uint64_t paramVer)
+    {
+        // Bypass: forward upstream unchanged
+        cache.data = upstream;
+        cache.upstreamGen = upstreamGen;
+        cache.paramVer = paramVer;
+        cache.gen = upstreamGen; // propagate generation for downstream
+        cache.valid = true;
+    }
+
+    static FilterRunStats runFilter(const FilterBase &filter, const LayerPtr &upstream, LayerPtr &out)
+    {
+        FilterRunStats stats;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        filter.apply(upstream, out);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::milli> dt = t1 - t0;
+        stats.ran = true;
+        stats.ms = dt.count();
+        stats.summary = filter.runSummary();
+
+        if (const PathSet *psp = asPathSetConstPtr(out))
+        {
+            stats.hasPathStats = true;
+            stats.pathCount = psp->size();
+            stats.vertexCount = psp->pointCount();
+            LOG(INFO) << stats.vertexCount << " " << stats.pathCount;
+        }
+        LOG(INFO) << "recomputed " << filter.name();
+        return stats;
+    }
+
+    static void applyStats(FilterBase &filter, const FilterRunStats &stats)
+    {
+        if (!stats.ran)
+            return;
+        filter.setLastRunMs(stats.ms);
+        filter.setLastSummary(stats.summary);
+        if (stats.hasPathStats)
+        {
+            filter.setLastPathCount(stats.pathCount);
+            filter.setLastVertexCount(stats.vertexCount);
+        }
+    }
+
+    // Same staleness rule as evaluate(), without computing anything
+    bool isStale() const
+    {
+        for (size_t i = 0; i < m_filters.size(); ++i)
+        {
+            const LayerCache &cache = m_layers[i];
+            uint64_t upstreamGen = (i == 0) ? m_baseGen : m_layers[i - 1].gen;
+            if (!cache.valid || cache.upstreamGen != upstreamGen || cache.paramVer != m_filters[i]->paramVersion())
+                return true;
+        }
+        return false;
+    }
+
+    // Last layer that has data, walking upstream; the base if nothing has been computed yet
+    const LayerPtr &displayLayer() const
+    {
+        for (size_t i = m_layers.size(); i-- > 0;)
+        {
+            if (m_layers[i].data)
+                return m_layers[i].data;
+        }
+        return m_base;
+    }
 
-            if (cache.data.get()->kind() == LayerKind::PathSet)
+    void publishOutput()
+    {
+        if (!m_async)
+            m_async = std::make_shared<BackgroundState>();
+        LayerPtr out = m_filters.empty() ? m_base : m_layers.back().data;
+        std::lock_guard<std::mutex> lk(m_async->mutex);
+        m_async->published = std::move(out);
+    }
+
+    void cancelBackground()
+    {
+        if (!m_async)
+            return;
+        std::lock_guard<std::mutex> lk(m_async->mutex);
+        if (m_async->cancel)
+            m_async->cancel->store(true);
+    }
+
+    void pollBackground()
+    {
+        if (!m_async)
+            m_async = std::make_shared<BackgroundState>();
+
+        BackgroundResult finished;
+        bool haveFinished = false;
+        {
+            std::lock_guard<std::mutex> lk(m_async->mutex);
+            if (m_async->hasResult)
             {
-                const PathSet *psp = static_cast<const PathSet *>(cache.data.get());
-                filter.setLastPathCount(psp->paths.size());
-                int totalVerts = 0;
-                for (auto path : psp->paths)
+                finished = std::move(m_async->result);
+                m_async->hasResult = false;
+                haveFinished = true;
+            }
+            if (m_async->inFlight)
+            {
+                // A newer parameter version supersedes the running snapshot: ask it to stop at
+                // its next checkpoint and resubmit once it has drained.
+                if (m_async->cancel && snapshotSuperseded())
+                    m_async->cancel->store(true);
+                return;
+            }
+        }
+
+        if (haveFinished && finished.structureGen == m_structureGen)
+        {
+            for (size_t i = 0; i < finished.completed && i < m_layers.size(); ++i)
+            {
+                m_layers[i] = std::move(finished.layers[i]);
+                applyStats(*m_filters[i], finished.stats[i]);
+            }
+        }
+
+        if (isStale())
+            submitBackground();
+    }
+
+    // While a run is in flight we only know which structure it was built for; compare the
+    // live parameter versions against the ones the snapshot captured.
+    bool snapshotSuperseded() const
+    {
+        if (m_inFlightStructureGen != m_structureGen)
+            return true;
+        for (size_t i = 0; i < m_filters.size() && i < m_inFlightParamVers.size(); ++i)
+        {
+            if (m_filters[i]->paramVersion() != m_inFlightParamVers[i])
+                return true;
+        }
+        return false;
+    }
+
+    void submitBackground()
+    {
+        struct Job
+        {
+            LayerPtr base;
+            uint64_t baseGen{0};
+            std::vector<std::unique_ptr<FilterBase>> filters; // parameter snapshots, nullptr when bypassed
+            std::vector<uint64_t> paramVers;
+            std::vector<bool> enabled;
+            BackgroundResult result;
+        };
+
+        auto job = std::make_shared<Job>();
+        job->base = m_base;
+        job->baseGen = m_baseGen;
+        job->enabled = m_enabled;
+        job->result.structureGen = m_structureGen;
+        job->result.layers = m_layers;
+        job->result.stats.resize(m_filters.size());
+
+        auto cancel = std::make_shared<std::atomic<bool>>(false);
+        for (size_t i = 0; i < m_filters.size(); ++i)
+        {
+            // Read the version before copying so a concurrent edit can only make us look older
+            job->paramVers.push_back(m_filters[i]->paramVersion());
+            std::unique_ptr<FilterBase> snapshot;
+            if (m_enabled[i])
+            {
+                snapshot = FilterRegistry::instance().clone(*m_filters[i]);
+                if (!snapshot)
                 {
-                    totalVerts += path.points.size();
+                    // Unregistered filter type: no way to snapshot it, evaluate in place instead
+                    outputBlocking();
+                    return;
                 }
-                filter.setLastVertexCount(totalVerts);
-                LOG(INFO) << totalVerts << " "  <<  psp->paths.size();
+                snapshot->setCancelToken(cancel.get());
             }
-            LOG(INFO) << "recomputed " << filter.name();
+            job->filters.push_back(std::move(snapshot));
         }
-        return cache.data;
+
+        m_inFlightStructureGen = m_structureGen;
+        m_inFlightParamVers = job->paramVers;
+
+        std::shared_ptr<BackgroundState> state = m_async;
+        {
+            std::lock_guard<std::mutex> lk(state->mutex);
+            state->inFlight = true;
+            state->cancel = cancel;
+            state->result.structureGen = m_structureGen;
+        }
+
+        FilterEvaluator::instance().submit([job, state, cancel]() {
+            BackgroundResult &r = job->result;
+            size_t n = job->filters.size();
+            for (size_t i = 0; i < n; ++i)
+            {
+                // Checkpoint between filters
+                if (cancel->load())
+                    break;
+
+                const LayerPtr &upstream = (i == 0) ? job->base : r.layers[i - 1].data;
+                uint64_t upstreamGen = (i == 0) ? job->baseGen : r.layers[i - 1].gen;
+                LayerCache &cache = r.layers[i];
+
+                if (!job->enabled[i])
+                {
+                    bypass(cache, upstream, upstreamGen, job->paramVers[i]);
+                    r.completed = i + 1;
+                    continue;
+                }
+
+                bool needsRecompute = !cache.valid ||
+                                      (cache.upstreamGen != upstreamGen) ||
+                                      (cache.paramVer != job->paramVers[i]);
+                if (needsRecompute)
+                {
+                    LayerPtr out;
+                    FilterRunStats stats = runFilter(*job->filters[i], upstream, out);
+                    // A filter that noticed the cancel may have returned partial output
+                    if (cancel->load())
+                        break;
+                    cache.data = std::move(out);
+                    cache.upstreamGen = upstreamGen;
+                    cache.paramVer = job->paramVers[i];
+                    cache.gen = cache.gen + 1;
+                    cache.valid = true;
+                    r.stats[i] = stats;
+                }
+                r.completed = i + 1;
+            }
+
+            std::lock_guard<std::mutex> lk(state->mutex);
+            state->result = std::move(r);
+            state->hasResult = true;
+            state->inFlight = false;
+            state->cancel.reset();
+        }, cancel);
     }
 
     std::vector<std::unique_ptr<FilterBase>> m_filters;
@@ -286,4 +578,11 @@ public:
     std::vector<bool> m_enabled;
     LayerPtr m_base;
     uint64_t m_baseGen{0};
+
+    // Background evaluation. m_structureGen changes whenever filters are added, removed or
+    // toggled, so results computed against an older layout are dropped instead of adopted.
+    uint64_t m_structureGen{0};
+    uint64_t m_inFlightStructureGen{0};
+    std::vector<uint64_t> m_inFlightParamVers;
+    std::shared_ptr<BackgroundState> m_async{std::make_shared<BackgroundState>()};
 };
@@ -0,0 +1,79 @@
+#include "FilterEvaluator.h"
+
+#include <algorithm>
+
+#include "utils/ThreadPool.h"
+
+FilterEvaluator &FilterEvaluator::instance()
+{
+    static FilterEvaluator g_instance;
+    return g_instance;
+}
+
+FilterEvaluator::FilterEvaluator()
+{
+    // Jobs run parallelFor on the shared pool. Creating the pool first makes it outlive
+    // this evaluator, since statics are destroyed in reverse order of construction.
+    ThreadPool::instance();
+
+    // A couple of threads lets one entity's heavy chain run without starving the others;
+    // data parallelism inside filters is handled separately.
+    unsigned hw = std::thread::hardware_concurrency();
+    unsigned n = std::max(1u, std::min(2u, hw));
+    m_threads.reserve(n);
+    for (unsigned i = 0; i < n; ++i)
+    {
+        m_threads.emplace_back([this]() { workerLoop(); });
+    }
+}
+
+FilterEvaluator::~FilterEvaluator()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_stop = true;
+        m_jobs.clear();
+        // Ask running jobs to stop at their next checkpoint rather than wait them out
+        for (const auto &cancel : m_running)
+            cancel->store(true);
+    }
+    m_cv.notify_all();
+    for (auto &t : m_threads)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void FilterEvaluator::submit(std::function<void()> job, std::shared_ptr<std::atomic<bool>> cancel)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_jobs.push_back({std::move(job), std::move(cancel)});
+    }
+    m_cv.notify_one();
+}
+
+void FilterEvaluator::workerLoop()
+{
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_cv.wait(lk, [this]() { return m_stop || !m_jobs.empty(); });
+            if (m_stop)
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+            if (job.cancel)
+                m_running.push_back(job.cancel);
+        }
+        job.run();
+        if (job.cancel)
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_running.erase(std::find(m_running.begin(), m_running.end(), job.cancel));
+        }
+    }
+}
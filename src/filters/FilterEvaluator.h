@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small process-wide pool of background threads that run FilterChain evaluation
+// jobs so heavy chains never execute on the render thread.
+class FilterEvaluator
+{
+public:
+    static FilterEvaluator &instance();
+
+    ~FilterEvaluator();
+
+    // Queue a job; it runs on one of the evaluator threads in FIFO order. 'cancel' is the
+    // job's cooperative cancel token: shutdown sets it on a running job before joining.
+    void submit(std::function<void()> job, std::shared_ptr<std::atomic<bool>> cancel = nullptr);
+
+    size_t threadCount() const { return m_threads.size(); }
+
+private:
+    FilterEvaluator();
+    FilterEvaluator(const FilterEvaluator &) = delete;
+    FilterEvaluator &operator=(const FilterEvaluator &) = delete;
+
+    void workerLoop();
+
+    struct Job
+    {
+        std::function<void()> run;
+        std::shared_ptr<std::atomic<bool>> cancel;
+    };
+
+    std::vector<std::thread> m_threads;
+    std::deque<Job> m_jobs;
+    std::vector<std::shared_ptr<std::atomic<bool>>> m_running; // cancel tokens of running jobs
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    bool m_stop{false};
+};
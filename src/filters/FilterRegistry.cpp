@@ -28,6 +28,7 @@ namespace {
         case LayerKind::Bitmap: return "Bitmap";
         case LayerKind::PathSet: return "PathSet";
         case LayerKind::FloatImage: return "Float";
+        case LayerKind::Mask: return "Mask";
         }
         return "?";
 	}
@@ -62,12 +63,29 @@ std::vector<FilterInfo> FilterRegistry::byInput(LayerKind kind) const
 	out.reserve(m_filters.size());
 	for (const auto &fi : m_filters)
 	{
-		if (fi.inputKind == kind)
+		if (layerKindFeeds(kind, fi.inputKind))
 			out.push_back(fi);
 	}
 	return out;
 }
 
+std::unique_ptr<FilterBase> FilterRegistry::clone(const FilterBase &src) const
+{
+	for (const auto &info : m_filters)
+	{
+		if (info.name == src.name() && info.inputKind == src.inputKind() && info.outputKind == src.outputKind())
+		{
+			std::unique_ptr<FilterBase> f = info.factory();
+			for (const auto &kv : src.m_parameters)
+			{
+				f->setParameter(kv.first, kv.second.value);
+			}
+			return f;
+		}
+	}
+	return nullptr;
+}
+
 void FilterRegistry::initDefaults()
 {
 	static bool initialized = false;
@@ -99,7 +117,7 @@ void FilterRegistry::initDefaults()
 
 	reg.registerFilter(FilterInfo{
 		"Trace",
-		LayerKind::Bitmap,
+		LayerKind::Mask,
 		LayerKind::PathSet,
 		[]() { return std::make_unique<TraceFilter>(); }
 	});
@@ -113,14 +131,14 @@ void FilterRegistry::initDefaults()
 
 	reg.registerFilter(FilterInfo{
 		"Blobs",
-		LayerKind::Bitmap,
+		LayerKind::Mask,
 		LayerKind::PathSet,
 		[]() { return std::make_unique<TraceBlobsFilter>(); }
 	});
 
 	reg.registerFilter(FilterInfo{
 		"Skeletonize",
-		LayerKind::Bitmap,
+		LayerKind::Mask,
 		LayerKind::PathSet,
 		[]() { return std::make_unique<SkeletonizeFilter>(); }
 	});
@@ -128,7 +146,7 @@ void FilterRegistry::initDefaults()
 	reg.registerFilter(FilterInfo{
 		"Threshold",
 		LayerKind::Bitmap,
-		LayerKind::Bitmap,
+		LayerKind::Mask,
 		[]() { return std::make_unique<ThresholdFilter>(); }
 	});
 
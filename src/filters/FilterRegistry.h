@@ -30,6 +30,10 @@ public:
 	// Get filters that accept a given input kind
 	std::vector<FilterInfo> byInput(LayerKind kind) const;
 
+	// Create a fresh instance of the same filter type carrying a copy of src's parameters.
+	// Returns nullptr if the filter type is not registered.
+	std::unique_ptr<FilterBase> clone(const FilterBase &src) const;
+
 	// One-time initialization of built-in filters
 	static void initDefaults();
 
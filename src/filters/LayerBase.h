@@ -4,9 +4,21 @@ enum class LayerKind
 {
     Bitmap,
     PathSet,
-    FloatImage
+    FloatImage,
+    Mask
 };
 
+// Whether a layer of kind 'produced' can feed a filter whose input is 'consumed'.
+// Bitmap and Mask convert into each other implicitly (see FilterTyped::apply).
+inline bool layerKindFeeds(LayerKind produced, LayerKind consumed)
+{
+    if (produced == consumed)
+        return true;
+    const bool pRaster = produced == LayerKind::Bitmap || produced == LayerKind::Mask;
+    const bool cRaster = consumed == LayerKind::Bitmap || consumed == LayerKind::Mask;
+    return pRaster && cRaster;
+}
+
 struct ILayerData
 {
     virtual ~ILayerData() = default;
@@ -11,8 +11,14 @@ struct BlurFilter : public FilterTyped<Bitmap, Bitmap>
         m_parameters["radius"] = FilterParameter{
             "radius",
             0.0f,
-            10.0f,
+            50.0f,
             2.0f};
+        // Three stacked running-sum boxes instead of the exact kernel: same cost for every radius
+        m_parameters["boxApprox"] = FilterParameter{
+            "Box Approx (0/1)",
+            0.0f,
+            1.0f,
+            0.0f};
     }
 
     const char *name() const override { return "Blur"; }
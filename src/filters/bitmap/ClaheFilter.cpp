@@ -5,15 +5,19 @@
 #include <cstdint>
 #include <vector>
 
+#include "utils/ThreadPool.h"
+
 static inline int clampi_int(int v, int lo, int hi)
 {
     return (v < lo) ? lo : (v > hi ? hi : v);
 }
 
-// Build per-tile LUT (256 entries) with optional clipping and redistribution
+// Build per-tile LUT (256 entries) with optional clipping and redistribution.
+// tilePixels points at the tile's top-left pixel inside an image with the given row stride.
 static void buildClaheLut(const uint8_t *tilePixels,
                           int tileW,
                           int tileH,
+                          int stride,
                           float clipLimitParam,
                           std::array<uint8_t, 256> &outLut)
 {
@@ -31,7 +35,7 @@ static void buildClaheLut(const uint8_t *tilePixels,
     // Histogram
     for (int y = 0; y < tileH; ++y)
     {
-        const uint8_t *row = tilePixels + static_cast<size_t>(y) * static_cast<size_t>(tileW);
+        const uint8_t *row = tilePixels + static_cast<size_t>(y) * static_cast<size_t>(stride);
         for (int x = 0; x < tileW; ++x)
         {
             ++hist[static_cast<size_t>(row[static_cast<size_t>(x)])];
@@ -113,65 +117,61 @@ void ClaheFilter::applyTyped(const Bitmap &in, Bitmap &out) const
     // Build LUTs per tile
     const int numTiles = tilesX * tilesY;
     std::vector<std::array<uint8_t, 256>> luts(static_cast<size_t>(numTiles));
-    for (int ty = 0; ty < tilesY; ++ty)
-    {
+    parallelForTiles(tilesX, tilesY, [&](int tx, int ty) {
         const int y0 = yCoords[static_cast<size_t>(ty)];
         const int y1 = yCoords[static_cast<size_t>(ty + 1)];
         const int th = std::max(0, y1 - y0);
-        for (int tx = 0; tx < tilesX; ++tx)
-        {
-            const int x0 = xCoords[static_cast<size_t>(tx)];
-            const int x1 = xCoords[static_cast<size_t>(tx + 1)];
-            const int tw = std::max(0, x1 - x0);
-
-            const uint8_t *tilePtr = in.pixels.data() + static_cast<size_t>(y0) * static_cast<size_t>(w) + static_cast<size_t>(x0);
-            // Build a contiguous temporary buffer row by row if width != tw; otherwise we can treat row stride
-            // Our builder expects contiguous tile rows; handle per-row inside builder by passing tileW and tileH
-            buildClaheLut(tilePtr, tw, th, clipLimit, luts[static_cast<size_t>(ty * tilesX + tx)]);
-        }
-    }
+        const int x0 = xCoords[static_cast<size_t>(tx)];
+        const int x1 = xCoords[static_cast<size_t>(tx + 1)];
+        const int tw = std::max(0, x1 - x0);
+
+        const uint8_t *tilePtr = in.pixels.data() + static_cast<size_t>(y0) * static_cast<size_t>(w) + static_cast<size_t>(x0);
+        buildClaheLut(tilePtr, tw, th, w, clipLimit, luts[static_cast<size_t>(ty * tilesX + tx)]);
+    });
 
     // Apply with bilinear interpolation between neighboring tile LUTs
-    for (int y = 0; y < h; ++y)
-    {
-        const int pty = clampi_int((y * tilesY) / h, 0, tilesY - 1);
-        const int pty1 = std::min(pty + 1, tilesY - 1);
-        const int y0 = yCoords[static_cast<size_t>(pty)];
-        const int y1 = yCoords[static_cast<size_t>(pty + 1)];
-        const int dy = std::max(1, y1 - y0);
-        const float fy = static_cast<float>(y - y0) / static_cast<float>(dy);
+    parallelForRows(h, w, [&](int yBegin, int yEnd) {
+        for (int y = yBegin; y < yEnd; ++y)
+        {
+            const int pty = clampi_int((y * tilesY) / h, 0, tilesY - 1);
+            const int pty1 = std::min(pty + 1, tilesY - 1);
+            const int y0 = yCoords[static_cast<size_t>(pty)];
+            const int y1 = yCoords[static_cast<size_t>(pty + 1)];
+            const int dy = std::max(1, y1 - y0);
+            const float fy = static_cast<float>(y - y0) / static_cast<float>(dy);
 
-        const uint8_t *srcRow = in.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(w);
-        uint8_t *dstRow = out.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(w);
+            const uint8_t *srcRow = in.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(w);
+            uint8_t *dstRow = out.pixels.data() + static_cast<size_t>(y) * static_cast<size_t>(w);
 
-        for (int x = 0; x < w; ++x)
-        {
-            const int ptx = clampi_int((x * tilesX) / w, 0, tilesX - 1);
-            const int ptx1 = std::min(ptx + 1, tilesX - 1);
-
-            const int x0 = xCoords[static_cast<size_t>(ptx)];
-            const int x1 = xCoords[static_cast<size_t>(ptx + 1)];
-            const int dx = std::max(1, x1 - x0);
-            const float fx = static_cast<float>(x - x0) / static_cast<float>(dx);
-
-            const uint8_t v = srcRow[static_cast<size_t>(x)];
-
-            const std::array<uint8_t, 256> &L00 = luts[static_cast<size_t>(pty * tilesX + ptx)];
-            const std::array<uint8_t, 256> &L10 = luts[static_cast<size_t>(pty * tilesX + ptx1)];
-            const std::array<uint8_t, 256> &L01 = luts[static_cast<size_t>(pty1 * tilesX + ptx)];
-            const std::array<uint8_t, 256> &L11 = luts[static_cast<size_t>(pty1 * tilesX + ptx1)];
-
-            const float v00 = static_cast<float>(L00[static_cast<size_t>(v)]);
-            const float v10 = static_cast<float>(L10[static_cast<size_t>(v)]);
-            const float v01 = static_cast<float>(L01[static_cast<size_t>(v)]);
-            const float v11 = static_cast<float>(L11[static_cast<size_t>(v)]);
-
-            const float v0 = v00 + (v10 - v00) * fx;
-            const float v1 = v01 + (v11 - v01) * fx;
-            const int vo = static_cast<int>(std::lround(v0 + (v1 - v0) * fy));
-            dstRow[static_cast<size_t>(x)] = static_cast<uint8_t>(clampi_int(vo, 0, 255));
+            for (int x = 0; x < w; ++x)
+            {
+                const int ptx = clampi_int((x * tilesX) / w, 0, tilesX - 1);
+                const int ptx1 = std::min(ptx + 1, tilesX - 1);
+
+                const int x0 = xCoords[static_cast<size_t>(ptx)];
+                const int x1 = xCoords[static_cast<size_t>(ptx + 1)];
+                const int dx = std::max(1, x1 - x0);
+                const float fx = static_cast<float>(x - x0) / static_cast<float>(dx);
+
+                const uint8_t v = srcRow[static_cast<size_t>(x)];
+
+                const std::array<uint8_t, 256> &L00 = luts[static_cast<size_t>(pty * tilesX + ptx)];
+                const std::array<uint8_t, 256> &L10 = luts[static_cast<size_t>(pty * tilesX + ptx1)];
+                const std::array<uint8_t, 256> &L01 = luts[static_cast<size_t>(pty1 * tilesX + ptx)];
+                const std::array<uint8_t, 256> &L11 = luts[static_cast<size_t>(pty1 * tilesX + ptx1)];
+
+                const float v00 = static_cast<float>(L00[static_cast<size_t>(v)]);
+                const float v10 = static_cast<float>(L10[static_cast<size_t>(v)]);
+                const float v01 = static_cast<float>(L01[static_cast<size_t>(v)]);
+                const float v11 = static_cast<float>(L11[static_cast<size_t>(v)]);
+
+                const float v0 = v00 + (v10 - v00) * fx;
+                const float v1 = v01 + (v11 - v01) * fx;
+                const int vo = static_cast<int>(std::lround(v0 + (v1 - v0) * fy));
+                dstRow[static_cast<size_t>(x)] = static_cast<uint8_t>(clampi_int(vo, 0, 255));
+            }
         }
-    }
+    });
 }
 
 
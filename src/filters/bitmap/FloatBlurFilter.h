@@ -6,7 +6,9 @@ struct FloatBlurFilter : public FilterTyped<FloatImage, FloatImage>
 {
     FloatBlurFilter()
     {
-        m_parameters["radius"] = FilterParameter{"radius", 0.0f, 20.0f, 2.0f};
+        m_parameters["radius"] = FilterParameter{"radius", 0.0f, 100.0f, 2.0f};
+        // Young / van Vliet recursive Gaussian: same cost for every radius
+        m_parameters["recursive"] = FilterParameter{"Recursive IIR (0/1)", 0.0f, 1.0f, 0.0f};
     }
 
     const char *name() const override { return "Float Blur"; }
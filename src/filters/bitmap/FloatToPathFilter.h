@@ -17,7 +17,7 @@ struct FloatToPathFilter : public FilterTyped<FloatImage, PathSet>
     {
         const size_t w = in.width_px;
         const size_t h = in.height_px;
-        out.paths.clear();
+        out.clear();
         if (w == 0 || h == 0 || in.pixels.empty()) return;
 
         const float px = in.pixel_size_mm;
@@ -71,14 +71,10 @@ struct FloatToPathFilter : public FilterTyped<FloatImage, PathSet>
                         size_t j = idx(static_cast<size_t>(xn), static_cast<size_t>(yn));
                         if (!isMax[j]) continue;
 
-                        Path p;
-                        p.closed = false;
-                        p.points.reserve(2);
-                        p.points.push_back(Vec2((static_cast<float>(x) + 0.5f) * px,
-                                                (static_cast<float>(y) + 0.5f) * px));
-                        p.points.push_back(Vec2((static_cast<float>(xn) + 0.5f) * px,
-                                                (static_cast<float>(yn) + 0.5f) * px));
-                        out.paths.push_back(std::move(p));
+                        out.addSegment(Vec2((static_cast<float>(x) + 0.5f) * px,
+                                            (static_cast<float>(y) + 0.5f) * px),
+                                       Vec2((static_cast<float>(xn) + 0.5f) * px,
+                                            (static_cast<float>(yn) + 0.5f) * px));
                     }
                 }
             }
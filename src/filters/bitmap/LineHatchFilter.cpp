@@ -18,7 +18,7 @@ namespace {
 
 void LineHatchFilter::applyTyped(const Bitmap &in, PathSet &out) const
 {
-    out.paths.clear();
+    out.clear();
     out.color = Color(1.0f, 1.0f, 1.0f, 1.0f);
 
     const int width = static_cast<int>(in.width_px);
@@ -129,13 +129,10 @@ void LineHatchFilter::applyTyped(const Bitmap &in, PathSet &out) const
                 const float y0 = a.y + (b.y - a.y) * t0;
                 const float x1 = a.x + (b.x - a.x) * t1;
                 const float y1 = a.y + (b.y - a.y) * t1;
-                Path seg;
-                seg.closed = false;
-                seg.points.emplace_back(x0 * in.pixel_size_mm, y0 * in.pixel_size_mm);
-                seg.points.emplace_back(x1 * in.pixel_size_mm, y1 * in.pixel_size_mm);
+                out.addSegment(Vec2(x0 * in.pixel_size_mm, y0 * in.pixel_size_mm),
+                               Vec2(x1 * in.pixel_size_mm, y1 * in.pixel_size_mm));
                 totalVertices += 2;
                 ++totalPaths;
-                out.paths.emplace_back(std::move(seg));
                 runStart = -1;
             }
         }
@@ -144,13 +141,10 @@ void LineHatchFilter::applyTyped(const Bitmap &in, PathSet &out) const
             const float t0 = static_cast<float>(runStart) / static_cast<float>(samples - 1);
             const float x0 = a.x + (b.x - a.x) * t0;
             const float y0 = a.y + (b.y - a.y) * t0;
-            Path seg;
-            seg.closed = false;
-            seg.points.emplace_back(x0 * in.pixel_size_mm, y0 * in.pixel_size_mm);
-            seg.points.emplace_back(b.x * in.pixel_size_mm, b.y * in.pixel_size_mm);
+            out.addSegment(Vec2(x0 * in.pixel_size_mm, y0 * in.pixel_size_mm),
+                           Vec2(b.x * in.pixel_size_mm, b.y * in.pixel_size_mm));
             totalVertices += 2;
             ++totalPaths;
-            out.paths.emplace_back(std::move(seg));
         }
     };
 
@@ -6,6 +6,9 @@
 #include <cmath>
 #include <chrono>
 
+#include "utils/ConnectedComponents.h"
+#include "utils/ThreadPool.h"
+
 namespace {
 	struct IVec2 { int x; int y; };
 
@@ -71,25 +74,135 @@ namespace {
 		return d;
 	}
 
+	static inline bool hasBackgroundNeighbor(const std::vector<uint8_t> &img, int x, int y, int w, int h)
+	{
+		for (const auto &d : N8)
+		{
+			int nx = x + d.x, ny = y + d.y;
+			if (nx < 0 || ny < 0 || nx >= w || ny >= h) return true;
+			if (!img[idxOf(nx,ny,w)]) return true;
+		}
+		return false;
+	}
+
+	// Zhang-Suen deletion tables, indexed by the 8-neighbourhood with bit k = N8[k]
+	// (bit 0 = p2 north, clockwise). One table per sub-iteration.
+	struct ThinningLut
+	{
+		uint8_t del[2][256];
+
+		ThinningLut()
+		{
+			for (int m = 0; m < 256; ++m)
+			{
+				int p[9]; p[0] = 1;
+				for (int k = 0; k < 8; ++k) p[k + 1] = (m >> k) & 1;
+				int B = 0; for (int k = 1; k <= 8; ++k) B += p[k];
+				int A = 0; for (int k = 1; k <= 8; ++k) { int k1 = (k % 8) + 1; if (p[k] == 0 && p[k1] == 1) ++A; }
+				const bool base = (B >= 2 && B <= 6 && A == 1);
+				del[0][m] = (base && p[1] * p[3] * p[5] == 0 && p[3] * p[5] * p[7] == 0) ? 1 : 0;
+				del[1][m] = (base && p[1] * p[3] * p[7] == 0 && p[1] * p[5] * p[7] == 0) ? 1 : 0;
+			}
+		}
+	};
+
+	static const ThinningLut &thinningLut()
+	{
+		static const ThinningLut lut;
+		return lut;
+	}
+
+}
+
+// Active-set Zhang-Suen thinning of one component ROI, in place. Each sub-iteration tests
+// only the candidates, against the image as it was before the sub-iteration. The next
+// candidates are the foreground neighbours of the pixels just deleted, exactly as in the
+// filter's original thinning, so skeletons are unchanged. Membership of the next candidate
+// set is tracked with generation stamps, so nothing full-size is cleared between phases.
+void thinActive(std::vector<uint8_t> &img, int w, int h)
+{
+	const ThinningLut &lut = thinningLut();
+
+	// Build initial candidate set: edge foreground pixels
+	std::vector<int> cand; cand.reserve(static_cast<size_t>(w*h/8 + 1));
+	for (int y = 1; y < h - 1; ++y)
+	{
+		for (int x = 1; x < w - 1; ++x)
+		{
+			if (!img[idxOf(x,y,w)]) continue;
+			if (hasBackgroundNeighbor(img, x, y, w, h)) cand.push_back(static_cast<int>(idxOf(x,y,w)));
+		}
+	}
+	if (cand.empty()) return;
+	std::vector<int> del; del.reserve(cand.size());
+	std::vector<int> nextCand; nextCand.reserve(cand.size());
+	std::vector<uint32_t> nextStamp(static_cast<size_t>(w * h), 0);
+	uint32_t stamp = 0;
+
+	// Neighbour offsets in N8 order for the flat ROI
+	int off[8];
+	for (int k = 0; k < 8; ++k) off[k] = N8[k].y * w + N8[k].x;
+
+	auto phaseDelete = [&](int phase) -> bool {
+		const uint8_t *table = lut.del[phase];
+		del.clear();
+		for (int id : cand)
+		{
+			if (!img[static_cast<size_t>(id)]) continue;
+			unsigned m = 0;
+			for (int k = 0; k < 8; ++k) m |= static_cast<unsigned>(img[static_cast<size_t>(id + off[k])] != 0) << k;
+			if (table[m]) del.push_back(id);
+		}
+		if (del.empty()) return false;
+		// Delete and seed next candidates. Every foreground neighbour of a deleted pixel
+		// now has a background neighbour, so no border test is needed.
+		for (int idd : del) img[static_cast<size_t>(idd)] = 0;
+		++stamp;
+		for (int idd : del)
+		{
+			const int y = idd / w; const int x = idd % w;
+			for (const auto &d : N8)
+			{
+				int nx = x + d.x, ny = y + d.y;
+				if (nx <= 0 || ny <= 0 || nx >= w-1 || ny >= h-1) continue;
+				const size_t ni = idxOf(nx,ny,w);
+				if (!img[ni] || nextStamp[ni] == stamp) continue;
+				nextCand.push_back(static_cast<int>(ni));
+				nextStamp[ni] = stamp;
+			}
+		}
+		cand.swap(nextCand);
+		nextCand.clear();
+		return true;
+	};
+
+	int guard = 8 * (w + h); // perimeter-scale safety cap
+	while (guard-- > 0)
+	{
+		bool any = false;
+		any |= phaseDelete(0);
+		any |= phaseDelete(1);
+		if (!any) break;
+		if (cand.empty()) break;
+	}
 }
 
-void SkeletonizeFilter::applyTyped(const Bitmap &in, PathSet &out) const
+void SkeletonizeFilter::applyTyped(const Mask &in, PathSet &out) const
 {
 	using clock = std::chrono::high_resolution_clock;
 	auto t0 = clock::now();
 
-	out.paths.clear();
+	out.clear();
 	out.color = Color(1.0f, 1.0f, 1.0f, 1.0f);
 
 	const int W0 = static_cast<int>(in.width_px);
 	const int H0 = static_cast<int>(in.height_px);
-	if (W0 <= 0 || H0 <= 0 || in.pixels.empty())
+	if (W0 <= 0 || H0 <= 0 || in.empty())
 	{
 		out.computeAABB();
 		return;
 	}
 
-	const uint8_t thresh = static_cast<uint8_t>(std::round(m_parameters.at("threshold").value));
 	const int pruneIters = static_cast<int>(std::round(std::max(0.0f, m_parameters.at("pruneIters").value)));
 	const float tolPx = std::max(0.0f, m_parameters.at("tolerancePx").value);
 	const int down = std::max(1, static_cast<int>(std::round(m_parameters.at("downsample").value)));
@@ -97,125 +210,38 @@ void SkeletonizeFilter::applyTyped(const Bitmap &in, PathSet &out) const
 	const int turdSizePx = static_cast<int>(std::round(std::max(0.0f, m_parameters.at("turdSizePx").value)));
 	const float minSegmentLengthPx = std::max(0.0f, m_parameters.at("minSegmentLengthPx").value);
 
-	// Build binary mask (optionally downsampled with max pooling)
+	// Downsample the ink with max pooling (OR of each down x down block)
 	int W = (W0 + down - 1) / down;
 	int H = (H0 + down - 1) / down;
 	float pixel_mm = in.pixel_size_mm * static_cast<float>(down);
-	std::vector<uint8_t> fg(static_cast<size_t>(W * H), 0);
-	for (int y = 0; y < H; ++y)
+	Mask pooled;
+	const Mask *grid = &in;
+	if (down > 1)
 	{
-		for (int x = 0; x < W; ++x)
+		pooled.pixel_size_mm = pixel_mm;
+		pooled.resize(static_cast<size_t>(W), static_cast<size_t>(H));
+		for (int y0 = 0; y0 < H0; ++y0)
 		{
-			bool any = false;
-			const int x0 = x * down;
-			const int y0 = y * down;
-			for (int yy = y0; yy < std::min(y0 + down, H0) && !any; ++yy)
+			const uint64_t *bits = in.row(static_cast<size_t>(y0));
+			for (size_t i = 0; i < in.wordsPerRow; ++i)
 			{
-				for (int xx = x0; xx < std::min(x0 + down, W0); ++xx)
+				uint64_t word = bits[i];
+				while (word)
 				{
-					if (in.pixels[idxOf(xx, yy, W0)] < thresh) { any = true; break; }
+					const int x0 = static_cast<int>(i * 64) + maskbits::lowestBit(word);
+					word &= word - 1;
+					pooled.set(static_cast<size_t>(x0 / down), static_cast<size_t>(y0 / down), true);
 				}
 			}
-			fg[idxOf(x,y,W)] = any ? 1 : 0;
 		}
+		grid = &pooled;
 	}
 
 	const float epsMm = tolPx * pixel_mm / static_cast<float>(down); // match effective resolution
 	const int turdSizeCells = std::max(0, (down > 0) ? static_cast<int>(std::ceil(static_cast<float>(turdSizePx) / static_cast<float>(down * down))) : turdSizePx);
 	const float minSegmentLengthMm = minSegmentLengthPx * in.pixel_size_mm; // defined in input pixels
 
-	// Connected components on downsampled grid (4-connected)
-	std::vector<uint8_t> visited(static_cast<size_t>(W * H), 0);
-	const IVec2 n4[4] = {{1,0},{-1,0},{0,1},{0,-1}};
-
-	auto hasBackgroundNeighbor = [&](const std::vector<uint8_t> &img, int x, int y, int w, int h) -> bool {
-		for (const auto &d : N8)
-		{
-			int nx = x + d.x, ny = y + d.y;
-			if (nx < 0 || ny < 0 || nx >= w || ny >= h) return true;
-			if (!img[idxOf(nx,ny,w)]) return true;
-		}
-		return false;
-	};
-
-	auto thin_active = [&](std::vector<uint8_t> &img, int w, int h)
-	{
-		// Build initial candidate set: edge foreground pixels
-		std::vector<int> cand; cand.reserve(static_cast<size_t>(w*h/8 + 1));
-		std::vector<uint8_t> inCand(static_cast<size_t>(w * h), 0);
-		for (int y = 1; y < h - 1; ++y)
-		{
-			for (int x = 1; x < w - 1; ++x)
-			{
-				if (!img[idxOf(x,y,w)]) continue;
-				if (hasBackgroundNeighbor(img, x, y, w, h)) { cand.push_back(static_cast<int>(idxOf(x,y,w))); inCand[idxOf(x,y,w)] = 1; }
-			}
-		}
-		if (cand.empty()) return;
-		std::vector<int> del; del.reserve(cand.size());
-		std::vector<int> nextCand; nextCand.reserve(cand.size());
-		std::vector<uint8_t> inNext(static_cast<size_t>(w * h), 0);
-
-		auto phaseDelete = [&](int phase) -> bool {
-			del.clear();
-			for (int id : cand)
-			{
-				const int y = id / w; const int x = id % w;
-				if (!img[idxOf(x,y,w)]) continue;
-				uint8_t p[9]; p[0] = 1; // center is foreground by construction
-				for (int k = 0; k < 8; ++k) p[k+1] = img[idxOf(x + N8[k].x, y + N8[k].y, w)];
-				int B = 0; for (int k = 1; k <= 8; ++k) B += (p[k] != 0);
-				if (B < 2 || B > 6) continue;
-				int A = 0; for (int k = 1; k <= 8; ++k) { int k1 = (k % 8) + 1; if (p[k] == 0 && p[k1] == 1) ++A; }
-				if (A != 1) continue;
-				if (phase == 0)
-				{
-					if (p[1] * p[3] * p[5] != 0) continue;
-					if (p[3] * p[5] * p[7] != 0) continue;
-				}
-				else
-				{
-					if (p[1] * p[3] * p[7] != 0) continue;
-					if (p[1] * p[5] * p[7] != 0) continue;
-				}
-				del.push_back(id);
-			}
-			if (del.empty()) return false;
-			// Delete and seed next candidates
-			for (int idd : del)
-			{
-				const int y = idd / w; const int x = idd % w;
-				img[idxOf(x,y,w)] = 0;
-				for (const auto &d : N8)
-				{
-					int nx = x + d.x, ny = y + d.y;
-					if (nx <= 0 || ny <= 0 || nx >= w-1 || ny >= h-1) continue;
-					if (!img[idxOf(nx,ny,w)]) continue;
-					const size_t ni = idxOf(nx,ny,w);
-					if (!inNext[ni] && hasBackgroundNeighbor(img, nx, ny, w, h))
-					{
-						nextCand.push_back(static_cast<int>(ni));
-						inNext[ni] = 1;
-					}
-				}
-			}
-			cand.swap(nextCand);
-			nextCand.clear(); std::fill(inNext.begin(), inNext.end(), 0);
-			return true;
-		};
-
-		int guard = 8 * (w + h); // perimeter-scale safety cap
-		while (guard-- > 0)
-		{
-			bool any = false;
-			any |= phaseDelete(0);
-			any |= phaseDelete(1);
-			if (!any) break;
-			if (cand.empty()) break;
-		}
-	};
-
-	auto trace_component = [&](const std::vector<uint8_t> &roi, int rx, int ry, int rw, int rh)
+	auto trace_component = [&](const std::vector<uint8_t> &roi, int rx, int ry, int rw, int rh, PathSet &dst)
 	{
 		std::vector<uint8_t> v(static_cast<size_t>(rw * rh), 0);
 		auto nextNeighbor = [&](int x, int y, int px, int py, int &nx, int &ny) -> bool
@@ -283,8 +309,7 @@ void SkeletonizeFilter::applyTyped(const Bitmap &in, PathSet &out) const
 					totalLen += std::sqrt(dx*dx + dy*dy);
 				}
 				if (totalLen < minSegmentLengthMm) return; // drop too-short segments
-				Path p; p.closed = (closed && closeLoops); p.points = std::move(pts);
-				out.paths.push_back(std::move(p));
+				dst.addPath(pts, closed && closeLoops);
 			}
 		};
 
@@ -335,60 +360,49 @@ void SkeletonizeFilter::applyTyped(const Bitmap &in, PathSet &out) const
 		}
 	};
 
-	// Find components and process each in its ROI with active-set thinning and pruning
-	for (int y = 0; y < H; ++y)
-	{
-		for (int x = 0; x < W; ++x)
+	// 4-connected components on the downsampled grid, small ones dropped
+	ComponentLabels cc;
+	labelComponents(*grid, Connectivity::Four, cc, static_cast<size_t>(turdSizeCells));
+	if (cancelled()) return;
+
+	// Components are independent: thin, prune and trace each in its own ROI in parallel,
+	// then concatenate in discovery order so the output matches a sequential run
+	std::vector<PathSet> compPaths(cc.count);
+	parallelForEach(cc.count, 1, [&](size_t ci) {
+		if (cancelled()) return;
+		const ComponentBox &c = cc.boxes[ci];
+		int rw = c.maxX - c.minX + 1; int rh = c.maxY - c.minY + 1;
+		std::vector<uint8_t> roi(static_cast<size_t>(rw * rh), 0);
+		for (size_t k = cc.begin(ci + 1); k < cc.end(ci + 1); ++k)
 		{
-			const size_t ii = idxOf(x,y,W);
-			if (visited[ii] || !fg[ii]) continue;
-			// BFS collect component
-			std::vector<int> q; q.reserve(256);
-			std::vector<int> comp; comp.reserve(256);
-			q.push_back(static_cast<int>(ii)); visited[ii] = 1; comp.push_back(static_cast<int>(ii));
-			int minX = x, minY = y, maxX = x, maxY = y;
-			while (!q.empty())
-			{
-				int p = q.back(); q.pop_back();
-				int py = p / W; int px = p % W;
-				for (const auto &d : n4)
-				{
-					int nx = px + d.x, ny = py + d.y; if (nx < 0 || ny < 0 || nx >= W || ny >= H) continue;
-					size_t ni = idxOf(nx,ny,W); if (visited[ni] || !fg[ni]) continue; visited[ni] = 1; q.push_back(static_cast<int>(ni)); comp.push_back(static_cast<int>(ni));
-					if (nx < minX) minX = nx; if (nx > maxX) maxX = nx; if (ny < minY) minY = ny; if (ny > maxY) maxY = ny;
-				}
-			}
-			int rw = maxX - minX + 1; int rh = maxY - minY + 1; if (rw <= 0 || rh <= 0) continue;
-			if (turdSizeCells > 0 && static_cast<int>(comp.size()) < turdSizeCells) continue;
-			std::vector<uint8_t> roi(static_cast<size_t>(rw * rh), 0);
-			for (int p : comp)
-			{
-				int py = p / W; int px = p % W; roi[idxOf(px - minX, py - minY, rw)] = 1;
-			}
+			int p = cc.pixels[k];
+			int py = p / W; int px = p % W; roi[idxOf(px - c.minX, py - c.minY, rw)] = 1;
+		}
 
-			thin_active(roi, rw, rh);
+		thinActive(roi, rw, rh);
 
-			// Endpoint pruning using active set (repeat few iterations)
-			for (int it = 0; it < pruneIters; ++it)
+		// Endpoint pruning using active set (repeat few iterations)
+		for (int it = 0; it < pruneIters; ++it)
+		{
+			std::vector<int> ends; ends.reserve(128);
+			for (int yy = 1; yy < rh - 1; ++yy)
 			{
-				std::vector<int> ends; ends.reserve(128);
-				for (int yy = 1; yy < rh - 1; ++yy)
+				for (int xx = 1; xx < rw - 1; ++xx)
 				{
-					for (int xx = 1; xx < rw - 1; ++xx)
-					{
-						if (!roi[idxOf(xx,yy,rw)]) continue;
-						if (degreeAt(roi, xx, yy, rw, rh) == 1) ends.push_back(static_cast<int>(idxOf(xx,yy,rw)));
-					}
+					if (!roi[idxOf(xx,yy,rw)]) continue;
+					if (degreeAt(roi, xx, yy, rw, rh) == 1) ends.push_back(static_cast<int>(idxOf(xx,yy,rw)));
 				}
-				if (ends.empty()) break;
-				for (int idd : ends) roi[idd] = 0;
 			}
-
-			trace_component(roi, minX, minY, rw, rh);
+			if (ends.empty()) break;
+			for (int idd : ends) roi[idd] = 0;
 		}
-	}
 
-	out.computeAABB();
-}
+		trace_component(roi, c.minX, c.minY, rw, rh, compPaths[ci]);
+	});
+	if (cancelled()) return;
 
+	for (const PathSet &paths : compPaths)
+		out.append(paths);
 
+	out.computeAABB();
+}
@@ -1,20 +1,16 @@
 #pragma once
 
 #include <atomic>
+#include <cstdint>
+#include <vector>
 
 #include "../Filter.h"
 
-// Skeletonize black pixels and trace the 1px-wide skeleton into polylines
-struct SkeletonizeFilter : public FilterTyped<Bitmap, PathSet>
+// Skeletonize ink pixels and trace the 1px-wide skeleton into polylines
+struct SkeletonizeFilter : public FilterTyped<Mask, PathSet>
 {
 	SkeletonizeFilter()
 	{
-		m_parameters["threshold"] = FilterParameter{
-			"Black Threshold",
-			0.0f,
-			255.0f,
-			128.0f
-		};
 		m_parameters["pruneIters"] = FilterParameter{
 			"Prune Iterations",
 			0.0f,
@@ -56,7 +52,8 @@ struct SkeletonizeFilter : public FilterTyped<Bitmap, PathSet>
 	const char *name() const override { return "Skeletonize"; }
 	uint64_t paramVersion() const override { return m_version.load(); }
 
-	void applyTyped(const Bitmap &in, PathSet &out) const override;
+	void applyTyped(const Mask &in, PathSet &out) const override;
 };
 
-
+// Active-set Zhang-Suen thinning of a w x h 0/1 image in place; the one-pixel frame is left as is
+void thinActive(std::vector<uint8_t> &img, int w, int h);
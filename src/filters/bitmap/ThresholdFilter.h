@@ -3,7 +3,8 @@
 
 #include "../Filter.h"
 
-struct ThresholdFilter : public FilterTyped<Bitmap, Bitmap>
+// Pixels inside [Min, Max] become ink in the output mask
+struct ThresholdFilter : public FilterTyped<Bitmap, Mask>
 {
     ThresholdFilter()
     {
@@ -24,7 +25,15 @@ struct ThresholdFilter : public FilterTyped<Bitmap, Bitmap>
     const char *name() const override { return "Threshold"; }
     uint64_t paramVersion() const override { return m_version.load(); }
 
-    void applyTyped(const Bitmap &in, Bitmap &out) const override;
+    // Ink where pixel < cut (1..256), the rule the tracing filters' own threshold used
+    void setInkBelow(int cut)
+    {
+        cut = cut < 1 ? 1 : (cut > 256 ? 256 : cut);
+        setParameter("min", 0.0f);
+        setParameter("max", static_cast<float>(cut - 1));
+    }
+
+    void applyTyped(const Bitmap &in, Mask &out) const override;
 
 
 };
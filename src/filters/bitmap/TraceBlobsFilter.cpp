@@ -1,15 +1,14 @@
 #include "filters/bitmap/TraceBlobsFilter.h"
 
 #include <vector>
-#include <queue>
 #include <cmath>
 #include <cstdint>
-#include <climits>
-#include <unordered_set>
+#include <cstdlib>
 
-namespace {
-    struct IVec2 { int x; int y; };
+#include "utils/ConnectedComponents.h"
+#include "utils/ThreadPool.h"
 
+namespace {
     // Non-recursive Ramer–Douglas–Peucker on Vec2 in mm space (stack-based to avoid deep recursion)
     static std::vector<Vec2> rdp(const std::vector<Vec2> &pts, float eps)
     {
@@ -67,415 +66,336 @@ namespace {
         }
         return out;
     }
-}
 
-// Algorithm overview
-// 1) Binarize the bitmap (fixed threshold at 128) to a black/white mask
-// 2) 4-connected component labeling via BFS over black pixels to get each blob
-// 3) For each blob, perform Moore-neighborhood boundary tracing to extract the
-//    outer contour as a closed polyline in page mm space. Use an edge-visited
-//    set to avoid multi-lap duplicates and a step cap to avoid hangs.
-// 4) Optionally trace inner contours (holes) by flood-filling background cells
-//    connected to the component bounding box edges (outside), then tracing any
-//    remaining background regions (interior islands) exactly like the outer
-//    contour. Each hole becomes its own closed polyline.
-// 5) Optionally simplify using Ramer–Douglas–Peucker with tolerance in pixels
-//    converted to mm.
-void TraceBlobsFilter::applyTyped(const Bitmap &in, PathSet &out) const
-{
-    out.paths.clear();
-    out.color = Color(1.0f, 1.0f, 1.0f, 1.0f);
+    // 8 neighbours, counterclockwise on screen (y down) starting east: index + 1 turns left
+    const int kDx[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+    const int kDy[8] = {0, -1, -1, -1, 0, 1, 1, 1};
 
-    const int W = static_cast<int>(in.width_px);
-    const int H = static_cast<int>(in.height_px);
-    if (W <= 0 || H <= 0 || in.pixels.empty())
+    struct Contour
     {
-        out.computeAABB();
-        return;
-    }
-
-    const auto idxOf = [W](int x, int y) { return y * W + x; };
-
-    // Binary mask: black = value < 128
-    std::vector<uint8_t> black(static_cast<size_t>(W * H), 0);
-    for (int y = 0; y < H; ++y)
+        bool hole{false};
+        int parent{-1};            // index into the contour list, -1 = frame
+        double area{0.0};          // |shoelace| area of the pixel-centre polygon
+        std::vector<int> px;       // x, y pairs in image pixels
+    };
+
+    // Suzuki & Abe (1985) border following on the ink of a mask. Ink is 8-connected,
+    // background 4-connected. One raster scan over a padded int32 label image finds every
+    // outer border and hole border, each traced exactly once, together with its parent
+    // border; no per-blob buffers or visited-edge sets. The mask is one component's box,
+    // and (ox, oy) place it in the image.
+    struct BorderFollower
     {
-        const int row = y * W;
-        for (int x = 0; x < W; ++x)
-        {
-            const size_t i = static_cast<size_t>(row + x);
-            black[i] = (in.pixels[i] < 128) ? 1 : 0;
-        }
-    }
-
-    std::vector<uint8_t> visited(static_cast<size_t>(W * H), 0);
-    const IVec2 n4[4] = {{1,0},{-1,0},{0,1},{0,-1}};
-    const IVec2 n8[8] = {{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1},{0,-1},{1,-1}};
+        const Mask *mask{nullptr};
+        int W{0}, H{0}, stride{0}, ox{0}, oy{0};
+        std::vector<int32_t> f;              // (W + 2) x (H + 2), 0 = background, 1 = ink
+        std::vector<Contour> contours;       // contour k has label k + 2
 
-    const int turdSize = static_cast<int>(std::round(m_parameters.at("turdSizePx").value));
-    const float tolPx = m_parameters.at("tolerancePx").value;
-    const float epsMm = std::max(0.0f, tolPx) * in.pixel_size_mm;
-    const bool traceHoles = m_parameters.at("traceHoles").value > 0.5f;
+        int32_t &at(int x, int y) { return f[static_cast<size_t>(y + 1) * static_cast<size_t>(stride) + static_cast<size_t>(x + 1)]; }
 
-    for (int y = 0; y < H; ++y)
-    {
-        for (int x = 0; x < W; ++x)
+        void load(const Mask &m, int originX, int originY)
         {
-            const int idx = idxOf(x, y);
-            if (visited[static_cast<size_t>(idx)]) continue;
-            visited[static_cast<size_t>(idx)] = 1;
-            if (!black[static_cast<size_t>(idx)]) continue;
-
-            // BFS to collect component
-            std::vector<int> q;
-            std::vector<int> comp;
-            q.reserve(256);
-            comp.reserve(256);
-            q.push_back(idx);
-            comp.push_back(idx);
-            int minX = x, minY = y, maxX = x, maxY = y;
-            while (!q.empty())
+            mask = &m;
+            W = static_cast<int>(m.width_px);
+            H = static_cast<int>(m.height_px);
+            ox = originX;
+            oy = originY;
+            stride = W + 2;
+            f.assign(static_cast<size_t>(stride) * static_cast<size_t>(H + 2), 0);
+            for (int y = 0; y < H; ++y)
             {
-                int p = q.back(); q.pop_back();
-                const int py = p / W;
-                const int px = p % W;
-                for (const auto &d : n4)
+                const uint64_t *bits = m.row(static_cast<size_t>(y));
+                int32_t *dst = &at(0, y);
+                for (size_t i = 0; i < m.wordsPerRow; ++i)
                 {
-                    const int nx = px + d.x;
-                    const int ny = py + d.y;
-                    if (nx < 0 || ny < 0 || nx >= W || ny >= H) continue;
-                    const int ni = idxOf(nx, ny);
-                    if (visited[static_cast<size_t>(ni)]) continue;
-                    visited[static_cast<size_t>(ni)] = 1;
-                    if (black[static_cast<size_t>(ni)])
+                    uint64_t word = bits[i];
+                    while (word)
                     {
-                        q.push_back(ni);
-                        comp.push_back(ni);
-                        if (nx < minX) minX = nx;
-                        if (nx > maxX) maxX = nx;
-                        if (ny < minY) minY = ny;
-                        if (ny > maxY) maxY = ny;
+                        dst[i * 64 + static_cast<size_t>(maskbits::lowestBit(word))] = 1;
+                        word &= word - 1;
                     }
                 }
             }
+        }
 
-            if (static_cast<int>(comp.size()) < turdSize) continue;
+        static int dirOf(int dx, int dy)
+        {
+            for (int k = 0; k < 8; ++k)
+                if (kDx[k] == dx && kDy[k] == dy) return k;
+            return 0;
+        }
 
-            const int bw = maxX - minX + 1;
-            const int bh = maxY - minY + 1;
-            if (bw <= 0 || bh <= 0) continue;
-            std::vector<uint8_t> inComp(static_cast<size_t>(bw * bh), 0);
-            for (int p : comp)
+        // Follow the border starting at (x, y) whose known background neighbour is (bx, by)
+        void follow(int x, int y, int bx, int by, int32_t nbd, Contour &c)
+        {
+            // 3.1: clockwise from the background neighbour for any non-zero pixel
+            const int d0 = dirOf(bx - x, by - y);
+            int d1 = -1;
+            for (int t = 0; t < 8; ++t)
             {
-                const int py = p / W; const int px = p % W;
-                inComp[static_cast<size_t>((py - minY) * bw + (px - minX))] = 1;
+                const int d = (d0 - t + 8) & 7;
+                if (at(x + kDx[d], y + kDy[d]) != 0) { d1 = d; break; }
             }
-
-            // Find boundary start: top-most then left-most with a background 4-neighbor
-            int startX = -1, startY = -1;
-            for (int p : comp)
+            c.px.push_back(x + ox);
+            c.px.push_back(y + oy);
+            if (d1 < 0)
             {
-                const int py = p / W; const int px = p % W;
-                const int lx = px - minX; const int ly = py - minY;
-                bool boundary = false;
-                for (const auto &d : n4)
-                {
-                    const int nx = lx + d.x; const int ny = ly + d.y;
-                    if (nx < 0 || ny < 0 || nx >= bw || ny >= bh) { boundary = true; break; }
-                    if (!inComp[static_cast<size_t>(ny * bw + nx)]) { boundary = true; break; }
-                }
-                if (boundary)
-                {
-                    if (startY == -1 || py < startY || (py == startY && px < startX))
-                    { startX = px; startY = py; }
-                }
+                at(x, y) = -nbd; // isolated pixel
+                return;
             }
-            if (startX == -1) continue;
 
-            // Moore-neighbor tracing with edge-visited guard to prevent multi-lap duplicates
-            int cx = startX - minX; int cy = startY - minY;
-            int bx = startX - 1; int by = startY;
-            int lbx = bx - minX; int lby = by - minY;
-            const int sx = cx, sy = cy, sbx = lbx, sby = lby;
-
-            auto dirIndex = [&](int px, int py, int qx, int qy) -> int {
-                const int dx = qx - px; const int dy = qy - py;
-                for (int k = 0; k < 8; ++k) if (n8[k].x == dx && n8[k].y == dy) return k;
-                return 0;
-            };
-
-            std::vector<Vec2> path;
-            path.reserve(static_cast<size_t>(bw + bh));
-
-            // Cap tracing steps to a multiple of component size to avoid hangs on huge images
-            const size_t stepCap = comp.size() * 8ull;
-            const int maxSteps = static_cast<int>(std::min<size_t>(static_cast<size_t>(INT_MAX / 2), stepCap));
-            int steps = 0;
-            struct Edge { int x0,y0,x1,y1; };
-            struct EdgeHash { size_t operator()(const Edge &e) const noexcept {
-                // mix ints into size_t
-                uint64_t k0 = (static_cast<uint64_t>(static_cast<uint32_t>(e.x0)) << 32) ^ static_cast<uint32_t>(e.y0);
-                uint64_t k1 = (static_cast<uint64_t>(static_cast<uint32_t>(e.x1)) << 32) ^ static_cast<uint32_t>(e.y1);
-                uint64_t h = k0 * 1469598103934665603ull ^ (k1 + 1099511628211ull);
-                return static_cast<size_t>(h);
-            }};
-            struct EdgeEq { bool operator()(const Edge &a, const Edge &b) const noexcept { return a.x0==b.x0 && a.y0==b.y0 && a.x1==b.x1 && a.y1==b.y1; } };
-            std::unordered_set<Edge, EdgeHash, EdgeEq> visitedEdges;
-            while (steps++ < maxSteps)
+            // 3.2 .. 3.5: counterclockwise walk until we are back on the first edge
+            const int x1 = x + kDx[d1], y1 = y + kDy[d1];
+            int x3 = x, y3 = y;
+            int dPrev = d1; // direction from (x3, y3) to the previously visited pixel
+            double area2 = 0.0;
+            while (true)
             {
-                const int k = dirIndex(cx, cy, lbx, lby);
-                bool found = false;
-                int nx = cx, ny = cy, nbx = lbx, nby = lby;
+                int d4 = -1;
+                bool eastZero = false;
                 for (int t = 1; t <= 8; ++t)
                 {
-                    const int j = (k + t) % 8;
-                    const int qx = cx + n8[j].x; const int qy = cy + n8[j].y;
-                    if (qx < 0 || qy < 0 || qx >= bw || qy >= bh) continue;
-                    if (inComp[static_cast<size_t>(qy * bw + qx)])
-                    {
-                        const int jp = (j + 7) % 8;
-                        nbx = cx + n8[jp].x; nby = cy + n8[jp].y;
-                        nx = qx; ny = qy; found = true; break;
-                    }
+                    const int d = (dPrev + t) & 7;
+                    if (at(x3 + kDx[d], y3 + kDy[d]) != 0) { d4 = d; break; }
+                    if (d == 0) eastZero = true;
                 }
-                if (!found) break;
-
-                // Edge-visited guard: if we're about to traverse an already seen directed edge, stop
-                Edge e{cx, cy, nx, ny};
-                if (visitedEdges.find(e) != visitedEdges.end())
-                    break;
-                visitedEdges.insert(e);
+                const int x4 = x3 + kDx[d4], y4 = y3 + kDy[d4];
 
-                // record current boundary point in mm page-local space at pixel center
-                const float px_mm = (static_cast<float>(minX + cx) + 0.5f) * in.pixel_size_mm;
-                const float py_mm = (static_cast<float>(minY + cy) + 0.5f) * in.pixel_size_mm;
-                if (path.empty() || path.back().x != px_mm || path.back().y != py_mm)
-                    path.emplace_back(px_mm, py_mm);
+                int32_t &v = at(x3, y3);
+                if (eastZero) v = -nbd;
+                else if (v == 1) v = nbd;
 
-                // If next position returns to start cell, we completed a loop
-                if (nx == sx && ny == sy)
+                area2 += static_cast<double>(x3) * y4 - static_cast<double>(x4) * y3;
+                if (x4 == x && y4 == y && x3 == x1 && y3 == y1)
                     break;
-
-                cx = nx; cy = ny; lbx = nbx; lby = nby;
-            }
-
-            // Ensure closed
-            if (path.size() > 1)
-            {
-                const Vec2 &f = path.front();
-                const Vec2 &l = path.back();
-                if (f.x != l.x || f.y != l.y) path.push_back(f);
-            }
-
-            std::vector<Vec2> simplified;
-            if (epsMm > 0.0f && path.size() > 3)
-                simplified = rdp(path, epsMm);
-            else
-                simplified = path;
-
-            if (simplified.size() >= 3)
-            {
-                Path pp;
-                pp.closed = true;
-                pp.points = std::move(simplified);
-                out.paths.push_back(std::move(pp));
+                c.px.push_back(x4 + ox);
+                c.px.push_back(y4 + oy);
+                dPrev = (d4 + 4) & 7;
+                x3 = x4; y3 = y4;
             }
+            c.area = std::abs(area2) * 0.5;
+        }
 
-            // Optional: trace interior holes (enclosed background regions)
-            if (traceHoles)
+        // Only ink pixels with a background 4-neighbour can start a border or be labelled
+        // by one, so the scan visits those, found 64 at a time on the packed mask; every
+        // other ink pixel keeps label 1 and would be skipped anyway.
+        void run()
+        {
+            contours.clear();
+            const size_t wpr = mask->wordsPerRow;
+            int32_t nbd = 1;
+            for (int y = 0; y < H; ++y)
             {
-                // Background mask inside this blob's bounding box
-                std::vector<uint8_t> bg(static_cast<size_t>(bw * bh), 0);
-                for (int yy = 0; yy < bh; ++yy)
+                const uint64_t *row = mask->row(static_cast<size_t>(y));
+                const uint64_t *up = (y > 0) ? mask->row(static_cast<size_t>(y - 1)) : nullptr;
+                const uint64_t *down = (y + 1 < H) ? mask->row(static_cast<size_t>(y + 1)) : nullptr;
+                int32_t lnbd = 1;
+                for (size_t i = 0; i < wpr; ++i)
                 {
-                    for (int xx = 0; xx < bw; ++xx)
+                    uint64_t edge = maskbits::edge4(up, row, down, i, wpr);
+                    while (edge)
                     {
-                        const size_t ii = static_cast<size_t>(yy * bw + xx);
-                        bg[ii] = inComp[ii] ? 0 : 1;
-                    }
-                }
+                        const int x = static_cast<int>(i * 64) + maskbits::lowestBit(edge);
+                        edge &= edge - 1;
+                        const int32_t v = at(x, y);
+
+                        bool start = false, hole = false;
+                        int bx = 0, by = y;
+                        if (v == 1 && at(x - 1, y) == 0) { start = true; bx = x - 1; }
+                        else if (v >= 1 && at(x + 1, y) == 0)
+                        {
+                            start = true; hole = true; bx = x + 1;
+                            if (v > 1) lnbd = v;
+                        }
 
-                // Mark outside-connected background by flood fill from bbox border
-                std::vector<uint8_t> outside(static_cast<size_t>(bw * bh), 0);
-                std::vector<int> stk; stk.reserve(static_cast<size_t>(bw * 2 + bh * 2));
-                auto push_if_bg = [&](int lx, int ly)
-                {
-                    if (lx < 0 || ly < 0 || lx >= bw || ly >= bh) return;
-                    const int ii = ly * bw + lx;
-                    if (bg[static_cast<size_t>(ii)] && !outside[static_cast<size_t>(ii)])
-                    {
-                        outside[static_cast<size_t>(ii)] = 1;
-                        stk.push_back(ii);
-                    }
-                };
-                for (int xx = 0; xx < bw; ++xx) { push_if_bg(xx, 0); push_if_bg(xx, bh - 1); }
-                for (int yy = 0; yy < bh; ++yy) { push_if_bg(0, yy); push_if_bg(bw - 1, yy); }
-                while (!stk.empty())
-                {
-                    int p = stk.back(); stk.pop_back();
-                    const int py = p / bw; const int px = p % bw;
-                    for (const auto &d : n4)
-                    {
-                        const int nx = px + d.x; const int ny = py + d.y;
-                        if (nx < 0 || ny < 0 || nx >= bw || ny >= bh) continue;
-                        const int ni = ny * bw + nx;
-                        if (bg[static_cast<size_t>(ni)] && !outside[static_cast<size_t>(ni)])
+                        if (start)
                         {
-                            outside[static_cast<size_t>(ni)] = 1;
-                            stk.push_back(ni);
+                            ++nbd;
+                            Contour c;
+                            c.hole = hole;
+                            // Parent from the type of the last border crossed on this row
+                            const int lastIdx = lnbd - 2;
+                            const bool lastIsHole = (lastIdx >= 0) ? contours[static_cast<size_t>(lastIdx)].hole : true; // frame acts as a hole
+                            if (hole == lastIsHole)
+                                c.parent = (lastIdx >= 0) ? contours[static_cast<size_t>(lastIdx)].parent : -1;
+                            else
+                                c.parent = lastIdx;
+                            follow(x, y, bx, by, nbd, c);
+                            contours.push_back(std::move(c));
                         }
+
+                        const int32_t now = at(x, y);
+                        if (now != 1) lnbd = std::abs(now);
                     }
                 }
+            }
+        }
 
-                // Interior background = background not connected to outside
-                std::vector<uint8_t> interior(static_cast<size_t>(bw * bh), 0);
-                for (int ii = 0; ii < bw * bh; ++ii)
-                    interior[static_cast<size_t>(ii)] = (bg[static_cast<size_t>(ii)] && !outside[static_cast<size_t>(ii)]) ? 1 : 0;
-
-                // Visit each interior white component and trace its boundary
-                std::vector<uint8_t> visitedHole(static_cast<size_t>(bw * bh), 0);
-                for (int ly = 0; ly < bh; ++ly)
+        // Only the outer border of the first ink pixel in raster order, which for a mask
+        // holding one region is that region's outline
+        void runOuter()
+        {
+            contours.clear();
+            for (int y = 0; y < H; ++y)
+            {
+                const uint64_t *row = mask->row(static_cast<size_t>(y));
+                for (size_t i = 0; i < mask->wordsPerRow; ++i)
                 {
-                    for (int lx = 0; lx < bw; ++lx)
-                    {
-                        const int si = ly * bw + lx;
-                        if (!interior[static_cast<size_t>(si)] || visitedHole[static_cast<size_t>(si)]) continue;
-
-                        // Collect this hole component (4-connected)
-                        std::vector<int> hq; hq.reserve(128);
-                        std::vector<int> holeComp; holeComp.reserve(128);
-                        hq.push_back(si); visitedHole[static_cast<size_t>(si)] = 1;
-                        while (!hq.empty())
-                        {
-                            int p = hq.back(); hq.pop_back();
-                            holeComp.push_back(p);
-                            const int py = p / bw; const int px = p % bw;
-                            for (const auto &d : n4)
-                            {
-                                const int nx = px + d.x; const int ny = py + d.y;
-                                if (nx < 0 || ny < 0 || nx >= bw || ny >= bh) continue;
-                                const int ni = ny * bw + nx;
-                                if (interior[static_cast<size_t>(ni)] && !visitedHole[static_cast<size_t>(ni)])
-                                {
-                                    visitedHole[static_cast<size_t>(ni)] = 1;
-                                    hq.push_back(ni);
-                                }
-                            }
-                        }
-
-                        if (static_cast<int>(holeComp.size()) < turdSize) continue;
+                    if (!row[i]) continue;
+                    const int x = static_cast<int>(i * 64) + maskbits::lowestBit(row[i]);
+                    Contour c;
+                    follow(x, y, x - 1, y, 2, c);
+                    contours.push_back(std::move(c));
+                    return;
+                }
+            }
+        }
+    };
 
-                        // Build mask for this hole component
-                        std::vector<uint8_t> inHole(static_cast<size_t>(bw * bh), 0);
-                        for (int p : holeComp)
-                            inHole[static_cast<size_t>(p)] = 1;
+    // Background pixels enclosed by a hole border, from its polygon area (Pick's theorem).
+    // The border runs over the surrounding ink, so only interior points count: I = A - B/2 + 1.
+    double holePixels(const Contour &c)
+    {
+        const double B = static_cast<double>(c.px.size() / 2);
+        return std::max(0.0, c.area - B * 0.5 + 1.0);
+    }
 
-                        // Find boundary start for hole
-                        int hstartX = -1, hstartY = -1;
-                        for (int p : holeComp)
-                        {
-                            const int py = p / bw; const int px = p % bw;
-                            bool boundary = false;
-                            for (const auto &d : n4)
-                            {
-                                const int nx = px + d.x; const int ny = py + d.y;
-                                if (nx < 0 || ny < 0 || nx >= bw || ny >= bh) { boundary = true; break; }
-                                if (!inHole[static_cast<size_t>(ny * bw + nx)]) { boundary = true; break; }
-                            }
-                            if (boundary)
-                            {
-                                if (hstartY == -1 || py < hstartY || (py == hstartY && px < hstartX))
-                                { hstartX = px; hstartY = py; }
-                            }
-                        }
-                        if (hstartX == -1) continue;
-
-                        // Moore-neighbor tracing around the interior region
-                        int cx2 = hstartX; int cy2 = hstartY;
-                        int bx2 = hstartX - 1; int by2 = hstartY;
-                        const int sx2 = cx2, sy2 = cy2;
-
-                        auto dirIndex2 = [&](int px, int py, int qx, int qy) -> int {
-                            const int dx = qx - px; const int dy = qy - py;
-                            for (int k = 0; k < 8; ++k) if (n8[k].x == dx && n8[k].y == dy) return k;
-                            return 0;
-                        };
-
-                        std::vector<Vec2> hpath; hpath.reserve(static_cast<size_t>(bw + bh));
-                        const size_t stepCap2 = holeComp.size() * 8ull;
-                        const int maxSteps2 = static_cast<int>(std::min<size_t>(static_cast<size_t>(INT_MAX / 2), stepCap2));
-                        int steps2 = 0;
-                        struct Edge { int x0,y0,x1,y1; };
-                        struct EdgeHash { size_t operator()(const Edge &e) const noexcept {
-                            uint64_t k0 = (static_cast<uint64_t>(static_cast<uint32_t>(e.x0)) << 32) ^ static_cast<uint32_t>(e.y0);
-                            uint64_t k1 = (static_cast<uint64_t>(static_cast<uint32_t>(e.x1)) << 32) ^ static_cast<uint32_t>(e.y1);
-                            uint64_t h = k0 * 1469598103934665603ull ^ (k1 + 1099511628211ull);
-                            return static_cast<size_t>(h);
-                        }};
-                        struct EdgeEq { bool operator()(const Edge &a, const Edge &b) const noexcept { return a.x0==b.x0 && a.y0==b.y0 && a.x1==b.x1 && a.y1==b.y1; } };
-                        std::unordered_set<Edge, EdgeHash, EdgeEq> visitedEdges2;
-                        while (steps2++ < maxSteps2)
-                        {
-                            const int k = dirIndex2(cx2, cy2, bx2, by2);
-                            bool found = false;
-                            int nx = cx2, ny = cy2, nbx = bx2, nby = by2;
-                            for (int t = 1; t <= 8; ++t)
-                            {
-                                const int j = (k + t) % 8;
-                                const int qx = cx2 + n8[j].x; const int qy = cy2 + n8[j].y;
-                                if (qx < 0 || qy < 0 || qx >= bw || qy >= bh) continue;
-                                if (inHole[static_cast<size_t>(qy * bw + qx)])
-                                {
-                                    const int jp = (j + 7) % 8;
-                                    nbx = cx2 + n8[jp].x; nby = cy2 + n8[jp].y;
-                                    nx = qx; ny = qy; found = true; break;
-                                }
-                            }
-                            if (!found) break;
-
-                            Edge e{cx2, cy2, nx, ny};
-                            if (visitedEdges2.find(e) != visitedEdges2.end())
-                                break;
-                            visitedEdges2.insert(e);
-
-                            // pixel center in page mm
-                            const float px_mm2 = (static_cast<float>(minX + cx2) + 0.5f) * in.pixel_size_mm;
-                            const float py_mm2 = (static_cast<float>(minY + cy2) + 0.5f) * in.pixel_size_mm;
-                            if (hpath.empty() || hpath.back().x != px_mm2 || hpath.back().y != py_mm2)
-                                hpath.emplace_back(px_mm2, py_mm2);
-
-                            if (nx == sx2 && ny == sy2)
-                                break;
-
-                            cx2 = nx; cy2 = ny; bx2 = nbx; by2 = nby;
-                        }
+    // One region of a labeling as a mask of its bounding box
+    void regionMask(const ComponentLabels &cc, size_t label, Mask &out)
+    {
+        const ComponentBox &b = cc.boxes[label - 1];
+        out.resize(static_cast<size_t>(b.maxX - b.minX + 1), static_cast<size_t>(b.maxY - b.minY + 1));
+        for (size_t k = cc.begin(label); k < cc.end(label); ++k)
+        {
+            const int p = cc.pixels[k];
+            out.set(static_cast<size_t>(p % cc.width - b.minX), static_cast<size_t>(p / cc.width - b.minY), true);
+        }
+    }
+}
 
-                        if (hpath.size() > 1)
-                        {
-                            const Vec2 &f = hpath.front();
-                            const Vec2 &l = hpath.back();
-                            if (f.x != l.x || f.y != l.y) hpath.push_back(f);
-                        }
+// Algorithm overview
+// 1) Label the ink with the shared connected-component labeling, 4-connected by default
+//    and 8-connected with '8-Connected' on; blobs with fewer than 'Min Area' pixels are
+//    dropped there.
+// 2) Trace the components in parallel, each on a mask of its own bounding box, so every
+//    component's paths only depend on its own pixels.
+// 3) 4-connected: follow the blob's outline once from its first pixel. Holes are the
+//    4-connected background regions of the blob's box that do not reach the outside;
+//    each is outlined the same way, around its own background pixels.
+// 4) 8-connected: one Suzuki-Abe raster scan follows the blob's outer border and every
+//    hole border once; hole outlines run along the ink around them.
+// 5) Holes enclosing fewer than 'Min Area' pixels are dropped; the rest are emitted right
+//    after their blob when 'Trace Holes' is on.
+// 6) Optionally simplify using Ramer-Douglas-Peucker with tolerance in pixels
+//    converted to mm.
+void TraceBlobsFilter::applyTyped(const Mask &in, PathSet &out) const
+{
+    out.clear();
+    out.color = Color(1.0f, 1.0f, 1.0f, 1.0f);
 
-                        std::vector<Vec2> hsimplified;
-                        if (epsMm > 0.0f && hpath.size() > 3)
-                            hsimplified = rdp(hpath, epsMm);
-                        else
-                            hsimplified = hpath;
+    const int W = static_cast<int>(in.width_px);
+    const int H = static_cast<int>(in.height_px);
+    if (W <= 0 || H <= 0 || in.empty())
+    {
+        out.computeAABB();
+        return;
+    }
 
-                        if (hsimplified.size() >= 3)
-                        {
-                            Path hp; hp.closed = true; hp.points = std::move(hsimplified);
-                            out.paths.push_back(std::move(hp));
-                        }
-                    }
-                }
+    const double turdSize = std::max(0.0, std::round(static_cast<double>(m_parameters.at("turdSizePx").value)));
+    const float tolPx = m_parameters.at("tolerancePx").value;
+    const float epsMm = std::max(0.0f, tolPx) * in.pixel_size_mm;
+    const bool traceHoles = m_parameters.at("traceHoles").value > 0.5f;
+    const bool eight = m_parameters.at("eightConnected").value > 0.5f;
+    const float pxMm = in.pixel_size_mm;
+
+    ComponentLabels cc;
+    labelComponents(in, eight ? Connectivity::Eight : Connectivity::Four, cc, static_cast<size_t>(turdSize));
+    if (cancelled()) return;
+
+    std::vector<PathSet> blobPaths(cc.count);
+    parallelForEach(cc.count, 16, [&](size_t ci) {
+        if (cancelled()) return;
+        const size_t label = ci + 1;
+        const ComponentBox &box = cc.boxes[ci];
+        PathSet &dst = blobPaths[ci];
+
+        // 'reverse' walks the border the other way round from its first pixel: the
+        // 4-connected outlines go clockwise on screen, as they always have
+        auto emit = [&](const Contour &c, bool reverse) {
+            const size_t n = c.px.size() / 2;
+            std::vector<Vec2> path;
+            path.reserve(n + 1);
+            for (size_t j = 0; j < n; ++j)
+            {
+                const size_t i = 2 * ((reverse && j > 0) ? n - j : j);
+                path.emplace_back((static_cast<float>(c.px[i]) + 0.5f) * pxMm, (static_cast<float>(c.px[i + 1]) + 0.5f) * pxMm);
             }
+            if (path.size() > 1)
+                path.push_back(path.front()); // ensure closed
+
+            std::vector<Vec2> simplified = (epsMm > 0.0f && path.size() > 3) ? rdp(path, epsMm) : std::move(path);
+            if (simplified.size() >= 3)
+                dst.addPath(simplified, true);
+        };
+
+        Mask blob;
+        regionMask(cc, label, blob);
+        BorderFollower bf;
+        bf.load(blob, box.minX, box.minY);
+
+        if (eight)
+        {
+            // The box holds one 8-connected blob, so its first border is the outer one
+            // and its holes are the borders whose parent that is, in raster order
+            bf.run();
+            const std::vector<Contour> &cs = bf.contours;
+            emit(cs[0], false);
+            if (!traceHoles) return;
+            for (size_t k = 1; k < cs.size(); ++k)
+                if (cs[k].hole && cs[k].parent == 0 && holePixels(cs[k]) >= turdSize)
+                    emit(cs[k], false);
+            return;
         }
-    }
 
-    out.computeAABB();
-}
+        bf.runOuter();
+        emit(bf.contours[0], true);
 
+        // A hole needs ink on every side of it
+        const int bw = box.maxX - box.minX + 1;
+        const int bh = box.maxY - box.minY + 1;
+        if (!traceHoles || bw < 3 || bh < 3) return;
 
+        // Background of the blob's box with a one-pixel frame, so everything outside the
+        // blob is a single region: label 1, which holds the frame's first pixel
+        Mask bg;
+        bg.resize(static_cast<size_t>(bw + 2), static_cast<size_t>(bh + 2));
+        for (size_t y = 0; y < bg.height_px; ++y)
+        {
+            uint64_t *r = bg.row(y);
+            for (size_t i = 0; i < bg.wordsPerRow; ++i) r[i] = ~uint64_t(0);
+            r[bg.wordsPerRow - 1] &= bg.tailMask();
+        }
+        for (size_t k = cc.begin(label); k < cc.end(label); ++k)
+        {
+            const int p = cc.pixels[k];
+            bg.set(static_cast<size_t>(p % W - box.minX + 1), static_cast<size_t>(p / W - box.minY + 1), false);
+        }
+        ComponentLabels holes;
+        labelComponents(bg, Connectivity::Four, holes);
+        Mask hole;
+        for (size_t l = 2; l <= holes.count; ++l)
+        {
+            if (holes.areas[l - 1] < turdSize) continue;
+            regionMask(holes, l, hole);
+            bf.load(hole, box.minX - 1 + holes.boxes[l - 1].minX, box.minY - 1 + holes.boxes[l - 1].minY);
+            bf.runOuter();
+            emit(bf.contours[0], true);
+        }
+    });
+    if (cancelled()) return;
 
+    for (const PathSet &paths : blobPaths)
+        out.append(paths);
+
+    out.computeAABB();
+}
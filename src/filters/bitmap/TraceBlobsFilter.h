@@ -4,8 +4,8 @@
 
 #include "../Filter.h"
 
-// Trace connected pixel blobs into closed polylines with optional RDP simplification
-struct TraceBlobsFilter : public FilterTyped<Bitmap, PathSet>
+// Trace connected ink blobs into closed polylines with optional RDP simplification
+struct TraceBlobsFilter : public FilterTyped<Mask, PathSet>
 {
     TraceBlobsFilter()
     {
@@ -28,6 +28,15 @@ struct TraceBlobsFilter : public FilterTyped<Bitmap, PathSet>
             1.0f,
             1.0f
         };
+        // When enabled (>0.5), ink pixels touching at a corner belong to the same blob and
+        // hole outlines run along the ink around each hole. Off keeps 4-connected blobs with
+        // holes outlined around their own background pixels.
+        m_parameters["eightConnected"] = FilterParameter{
+            "8-Connected (0/1)",
+            0.0f,
+            1.0f,
+            0.0f
+        };
     }
 
     const char *name() const override { return "Blobs"; }
@@ -36,8 +45,9 @@ struct TraceBlobsFilter : public FilterTyped<Bitmap, PathSet>
     void setTolerancePx(float t) { if (t < 0.0f) t = 0.0f; setParameter("tolerancePx", t); }
     void setTurdSizePx(float s) { if (s < 0.0f) s = 0.0f; setParameter("turdSizePx", s); }
     void setTraceHoles(bool on) { setParameter("traceHoles", on ? 1.0f : 0.0f); }
+    void setEightConnected(bool on) { setParameter("eightConnected", on ? 1.0f : 0.0f); }
 
-    void applyTyped(const Bitmap &in, PathSet &out) const override;
+    void applyTyped(const Mask &in, PathSet &out) const override;
 };
 
 
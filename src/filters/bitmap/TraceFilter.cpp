@@ -1,42 +1,41 @@
 #include "filters/bitmap/TraceFilter.h"
 
-void TraceFilter::applyTyped(const Bitmap &in, PathSet &out) const
+void TraceFilter::applyTyped(const Mask &in, PathSet &out) const
 {
-    out.paths.clear();
+    out.clear();
     out.color = Color(1.0f, 1.0f, 1.0f, 1.0f);
 
-    if (in.width_px <= 0 || in.height_px <= 0 || in.pixels.empty())
+    if (in.empty())
     {
         out.computeAABB();
         return;
     }
 
-    // Create a polyline per row connecting pixels above threshold
-    const uint8_t threshold = static_cast<uint8_t>(m_parameters.at("threshold").value);
-    for (int y = 0; y < in.height_px; ++y)
+    // Create a polyline per row connecting the clear pixels, 64 at a time
+    const uint64_t tail = in.tailMask();
+    for (size_t y = 0; y < in.height_px; ++y)
     {
-        Path row;
-        row.closed = false;
-        bool anyOn = false;
-        for (int x = 0; x < in.width_px; ++x)
+        const uint64_t *bits = in.row(y);
+        const float py = (static_cast<float>(y) + 0.5f) * in.pixel_size_mm;
+        for (size_t i = 0; i < in.wordsPerRow; ++i)
         {
-            uint8_t v = in.pixels[static_cast<size_t>(y) * static_cast<size_t>(in.width_px) + static_cast<size_t>(x)];
-            if (v >= threshold)
+            uint64_t clear = ~bits[i];
+            if (i + 1 == in.wordsPerRow)
+                clear &= tail;
+            while (clear)
             {
-                anyOn = true;
+                const size_t x = i * 64 + static_cast<size_t>(maskbits::lowestBit(clear));
+                clear &= clear - 1;
                 // Place points in local mm space at pixel centers
-                float px = (static_cast<float>(x) + 0.5f) * in.pixel_size_mm;
-                float py = (static_cast<float>(y) + 0.5f) * in.pixel_size_mm;
-                row.points.emplace_back(px, py);
+                const float px = (static_cast<float>(x) + 0.5f) * in.pixel_size_mm;
+                out.addPoint(Vec2(px, py));
             }
         }
-        if (anyOn && row.points.size() >= 2)
-        {
-            out.paths.push_back(std::move(row));
-        }
+        if (out.openPathSize() >= 2)
+            out.endPath(false);
+        else
+            out.discardPath();
     }
 
     out.computeAABB();
 }
-
-
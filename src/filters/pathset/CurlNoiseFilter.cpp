@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <cmath>
 
+#include "utils/ThreadPool.h"
+
 // Simple hash to produce deterministic pseudo-random gradients from integer lattice coords
 static inline uint32_t hash32(uint32_t x)
 {
@@ -101,9 +103,11 @@ static inline void noiseGrad2(float x, float y, int octaves, float lacunarity, f
 
 void CurlNoiseFilter::applyTyped(const PathSet &in, PathSet &out) const
 {
+    // Displacement keeps the path layout: copy it, then move every point in place
+    out.points = in.points;
+    out.offsets = in.offsets;
+    out.flags = in.flags;
     out.color = in.color;
-    out.paths.clear();
-    out.paths.reserve(in.paths.size());
 
     const float amplitude = std::max(0.0f, m_parameters.at("amplitudeMm").value);
     float scaleMm = std::max(1.0f, m_parameters.at("scaleMm").value);
@@ -119,19 +123,15 @@ void CurlNoiseFilter::applyTyped(const PathSet &in, PathSet &out) const
     if (amplitude <= 0.0f)
     {
         // Bypass quickly
-        out.paths = in.paths;
         out.computeAABB();
         return;
     }
 
-    for (const auto &p : in.paths)
-    {
-        Path q;
-        q.closed = p.closed;
-        q.points.reserve(p.points.size());
-
-        for (const Vec2 &pt : p.points)
+    // Points are independent, so split the flat buffer rather than the paths
+    parallelFor(0, out.points.size(), 1024, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
         {
+            const Vec2 pt = out.points[i];
             // Convert to noise domain by length scale (bigger scale => smoother field)
             const float nx = pt.x / scaleMm;
             const float ny = pt.y / scaleMm;
@@ -143,12 +143,9 @@ void CurlNoiseFilter::applyTyped(const PathSet &in, PathSet &out) const
             // curl(phi) in 2D as a divergence-free field: (dphi/dy, -dphi/dx)
             Vec2 curl(dny, -dnx);
 
-            Vec2 displaced = pt + curl * amplitude;
-            q.points.push_back(displaced);
+            out.points[i] = pt + curl * amplitude;
         }
-
-        out.paths.push_back(std::move(q));
-    }
+    });
 
     out.computeAABB();
 }
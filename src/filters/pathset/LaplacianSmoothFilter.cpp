@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <vector>
 
+#include "utils/ThreadPool.h"
+
 static inline Vec2 lerpVec2(const Vec2 &a, const Vec2 &b, float t)
 {
 	return Vec2(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
@@ -63,24 +65,28 @@ static void laplacianOnce(const Path &in, Path &out, float weight)
 
 void LaplacianSmoothFilter::applyTyped(const PathSet &in, PathSet &out) const
 {
+	// Smoothing keeps every point count, so start from a copy and rewrite paths in place
+	out.points = in.points;
+	out.offsets = in.offsets;
+	out.flags = in.flags;
 	out.color = in.color;
-	out.paths.clear();
-	out.paths.reserve(in.paths.size());
 
 	int iters = static_cast<int>(m_parameters.at("iterations").value + 0.5f);
 	if (iters < 0) iters = 0;
 	if (iters > 50) iters = 50;
 	float weight = std::clamp(m_parameters.at("weight").value, 0.0f, 1.0f);
 
-	for (const Path &p : in.paths)
+	if (iters == 0 || weight <= 0.0f)
 	{
-		if (p.points.size() < 2 || iters == 0 || weight <= 0.0f)
-		{
-			out.paths.push_back(p);
-			continue;
-		}
+		out.computeAABB();
+		return;
+	}
+
+	parallelForEach(in.size(), 64, [&](size_t pi) {
+		if (in.pathSize(pi) < 2)
+			return;
 
-		Path cur = p;
+		Path cur = in.toPath(pi);
 		Path tmp;
 		for (int i = 0; i < iters; ++i)
 		{
@@ -88,8 +94,8 @@ void LaplacianSmoothFilter::applyTyped(const PathSet &in, PathSet &out) const
 			cur.points.swap(tmp.points);
 			cur.closed = tmp.closed;
 		}
-		out.paths.push_back(std::move(cur));
-	}
+		std::copy(cur.points.begin(), cur.points.end(), out.pathPoints(pi).begin());
+	});
 
 	out.computeAABB();
 }
@@ -2,22 +2,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstdio>
+#include <deque>
 #include <limits>
 
-#include "utils/nanoflann.hpp"
-
-// Build endpoint cloud (two endpoints per path)
-struct EndpointCloud
-{
-	std::vector<Vec2> pts;
-	inline size_t kdtree_get_point_count() const { return pts.size(); }
-	inline float kdtree_get_pt(const size_t idx, const size_t dim) const
-	{
-		return dim == 0 ? pts[idx].x : pts[idx].y;
-	}
-	template <class BBOX>
-	bool kdtree_get_bbox(BBOX&) const { return false; }
-};
+#include "utils/KdTree2D.h"
+#include "utils/PathOrdering.h"
 
 static inline float distanceSquared(const Vec2 &a, const Vec2 &b)
 {
@@ -26,338 +16,182 @@ static inline float distanceSquared(const Vec2 &a, const Vec2 &b)
 	return dx * dx + dy * dy;
 }
 
-static inline void reversePath(Path &p)
+// A merged path is a chain of input paths, each used forwards or backwards; points are
+// only copied once the chain is final
+struct ChainPiece
 {
-	std::reverse(p.points.begin(), p.points.end());
-}
+	size_t path;
+	bool reversed;
+};
 
 void OptimizePathsFilter::applyTyped(const PathSet &in, PathSet &out) const
 {
 	out.color = in.color;
-	out.paths.clear();
+	out.clear();
+	setSummary({});
 
 	const bool mergeEnabled = m_parameters.at("mergeEnabled").value > 0.5f;
 	const float mergeDist = std::max(0.0f, m_parameters.at("mergeDistanceMm").value);
 	const bool doReorder = m_parameters.at("reorder").value > 0.5f;
 	const float mergeDist2 = mergeDist * mergeDist;
-	const size_t maxMergePaths = 4000; // safety guard to avoid O(n^2) on huge sets
+	const bool doRefine = m_parameters.at("refine").value > 0.5f;
+	const float refineBudgetMs = std::max(0.0f, m_parameters.at("refineBudgetMs").value);
 
-	// Copy input paths
-	std::vector<Path> working = in.paths;
+	// Paths to reorder: the input itself, or the merged set
+	PathSet merged;
+	const PathSet *workingSet = &in;
 
-	// Merge pass accelerated by KD-trees over endpoints (greedy until convergence)
-	if (mergeEnabled && mergeDist > 0.0f && working.size() > 1)
+	// Merge pass: greedily grow each chain from its nearest free chain end until nothing
+	// lies within the merge distance
+	if (mergeEnabled && mergeDist > 0.0f && in.size() > 1)
 	{
+		const PathSet &working = in;
 		const size_t n = working.size();
 		std::vector<bool> active(n, true);
 
-		// Build KD-trees over initial endpoints (we'll skip inactive paths on queries)
-		EndpointCloud cloudStarts;
-		EndpointCloud cloudEnds;
-		cloudStarts.pts.reserve(n);
-		cloudEnds.pts.reserve(n);
-		std::vector<size_t> startToPath; startToPath.reserve(n);
-		std::vector<size_t> endToPath; endToPath.reserve(n);
+		// Endpoint 2i is the first point of path i, 2i + 1 its last point. The index only
+		// ever holds the two outer endpoints of each open chain; joined ends are removed.
+		std::vector<Vec2> ends(2 * n);
+		std::vector<uint8_t> live(2 * n, 0);
+		std::vector<uint32_t> owner(2 * n, 0);   // chain an outer endpoint belongs to
+		std::vector<uint32_t> frontEnd(n), backEnd(n);
 		for (size_t i = 0; i < n; ++i)
 		{
-			const Path &p = working[i];
+			const PathView p = working[i];
 			if (p.points.empty()) { active[i] = false; continue; }
-			cloudStarts.pts.push_back(p.points.front());
-			startToPath.push_back(i);
-			cloudEnds.pts.push_back(p.points.back());
-			endToPath.push_back(i);
+			ends[2 * i] = p.points.front();
+			ends[2 * i + 1] = p.points.back();
+			frontEnd[i] = static_cast<uint32_t>(2 * i);
+			backEnd[i] = static_cast<uint32_t>(2 * i + 1);
+			owner[2 * i] = owner[2 * i + 1] = static_cast<uint32_t>(i);
+			if (!p.closed)
+				live[2 * i] = live[2 * i + 1] = 1;
 		}
+		KdTree2D tree;
+		tree.build(ends, live);
 
-		using KDTree = nanoflann::KDTreeSingleIndexAdaptor<
-			nanoflann::L2_Simple_Adaptor<float, EndpointCloud>, EndpointCloud, 2>;
-		KDTree indexStarts(2, cloudStarts, {10});
-		KDTree indexEnds(2, cloudEnds, {10});
-		// static adaptor builds at construction
-
-		enum class AttachKind { Append, AppendReverseJ, Prepend, PrependReverseJ };
-
-		auto queryNearest = [&](const Vec2 &q, bool queryStarts, size_t kInit, size_t selfIdx,
-			const std::vector<size_t> &map, KDTree &tree, float &outD2, size_t &outJ) -> bool
+		// Nearest outer endpoint of another chain; the chain's own two ends are skipped
+		std::vector<uint32_t> near;
+		auto nearestOther = [&](const Vec2 &q, uint32_t self, float &outD2) -> uint32_t
 		{
-			const size_t total = queryStarts ? cloudStarts.pts.size() : cloudEnds.pts.size();
-			if (total == 0) return false;
-			float query_pt[2] = { q.x, q.y };
-			size_t k = std::min(kInit, total);
-			while (true)
+			tree.nearestK(q, 3, near);
+			for (uint32_t e : near)
 			{
-				std::vector<size_t> idx(k);
-				std::vector<float> dist(k);
-				nanoflann::KNNResultSet<float> rs(k);
-				rs.init(idx.data(), dist.data());
-				tree.findNeighbors(rs, query_pt, {10});
-				const size_t got = rs.size();
-				for (size_t ii = 0; ii < got; ++ii)
-				{
-					const size_t ep = idx[ii];
-					const size_t pj = map[ep];
-					if (pj == selfIdx) continue;
-					if (!active[pj]) continue;
-					const Path &cand = working[pj];
-					if (cand.closed || cand.points.empty()) continue;
-					outD2 = dist[ii];
-					outJ = pj;
-					return true;
-				}
-				if (k == total) break;
-				k = std::min<size_t>(k * 2, total);
+				if (owner[e] == self) continue;
+				outD2 = distanceSquared(q, ends[e]);
+				return e;
 			}
-			return false;
+			return KdTree2D::npos;
 		};
 
+		std::vector<std::deque<ChainPiece>> chains(n);
 		for (size_t i = 0; i < n; ++i)
 		{
 			if (!active[i]) continue;
-			Path &pi = working[i];
-			if (pi.closed || pi.points.size() == 0) { continue; }
+			std::deque<ChainPiece> &chain = chains[i];
+			chain.push_back(ChainPiece{i, false});
+			if (working.closed(i)) { continue; }
+			if ((i & 1023) == 0 && cancelled()) return;
 
-			bool mergedAny = false;
+			const uint32_t self = static_cast<uint32_t>(i);
 			while (true)
 			{
-				if (pi.points.empty()) break;
-				const Vec2 istart = pi.points.front();
-				const Vec2 iend = pi.points.back();
-
-				float bestD2 = std::numeric_limits<float>::infinity();
-				size_t bestJ = static_cast<size_t>(-1);
-				AttachKind bestKind = AttachKind::Append;
-
-				// iend -> jstart (Append)
-				{
-					float d2; size_t j;
-					if (queryNearest(iend, true, 16, i, startToPath, indexStarts, d2, j) && d2 < bestD2)
-					{ bestD2 = d2; bestJ = j; bestKind = AttachKind::Append; }
-				}
-				// iend -> jend (AppendReverseJ)
-				{
-					float d2; size_t j;
-					if (queryNearest(iend, false, 16, i, endToPath, indexEnds, d2, j) && d2 < bestD2)
-					{ bestD2 = d2; bestJ = j; bestKind = AttachKind::AppendReverseJ; }
-				}
-				// istart -> jend (Prepend)
-				{
-					float d2; size_t j;
-					if (queryNearest(istart, false, 16, i, endToPath, indexEnds, d2, j) && d2 < bestD2)
-					{ bestD2 = d2; bestJ = j; bestKind = AttachKind::Prepend; }
-				}
-				// istart -> jstart (PrependReverseJ)
-				{
-					float d2; size_t j;
-					if (queryNearest(istart, true, 16, i, startToPath, indexStarts, d2, j) && d2 < bestD2)
-					{ bestD2 = d2; bestJ = j; bestKind = AttachKind::PrependReverseJ; }
-				}
-
-				if (bestJ == static_cast<size_t>(-1) || bestD2 > mergeDist2)
+				float backD2 = std::numeric_limits<float>::infinity();
+				float frontD2 = std::numeric_limits<float>::infinity();
+				const uint32_t atBack = nearestOther(ends[backEnd[i]], self, backD2);
+				const uint32_t atFront = nearestOther(ends[frontEnd[i]], self, frontD2);
+
+				const bool append = atBack != KdTree2D::npos && backD2 <= frontD2;
+				const uint32_t hit = append ? atBack : atFront;
+				const float bestD2 = append ? backD2 : frontD2;
+				if (hit == KdTree2D::npos || bestD2 > mergeDist2)
 					break;
 
-				Path &pj = working[bestJ];
-				if (bestKind == AttachKind::Append)
+				// Take the other chain whole, oriented so 'hit' meets our end
+				const uint32_t j = owner[hit];
+				std::deque<ChainPiece> other = std::move(chains[j]);
+				if (other.empty())
+					other.push_back(ChainPiece{j, false});
+				chains[j].clear();
+				const bool hitIsFront = hit == frontEnd[j];
+				const uint32_t farEnd = hitIsFront ? backEnd[j] : frontEnd[j];
+				if (append == !hitIsFront)
 				{
-					if (!pj.points.empty())
-						pi.points.insert(pi.points.end(), pj.points.begin(), pj.points.end());
+					std::reverse(other.begin(), other.end());
+					for (ChainPiece &c : other) c.reversed = !c.reversed;
 				}
-				else if (bestKind == AttachKind::AppendReverseJ)
-				{
-					if (!pj.points.empty())
-					{
-						Path tmp = pj;
-						reversePath(tmp);
-						pi.points.insert(pi.points.end(), tmp.points.begin(), tmp.points.end());
-					}
-				}
-				else if (bestKind == AttachKind::Prepend)
+
+				tree.remove(hit);
+				tree.remove(append ? backEnd[i] : frontEnd[i]);
+				owner[farEnd] = self;
+				if (append)
 				{
-					if (!pj.points.empty())
-					{
-						std::vector<Vec2> merged;
-						merged.reserve(pj.points.size() + pi.points.size());
-						merged.insert(merged.end(), pj.points.begin(), pj.points.end());
-						merged.insert(merged.end(), pi.points.begin(), pi.points.end());
-						pi.points.swap(merged);
-					}
+					chain.insert(chain.end(), other.begin(), other.end());
+					backEnd[i] = farEnd;
 				}
-				else // PrependReverseJ
+				else
 				{
-					if (!pj.points.empty())
-					{
-						Path tmp = pj;
-						reversePath(tmp);
-						std::vector<Vec2> merged;
-						merged.reserve(tmp.points.size() + pi.points.size());
-						merged.insert(merged.end(), tmp.points.begin(), tmp.points.end());
-						merged.insert(merged.end(), pi.points.begin(), pi.points.end());
-						pi.points.swap(merged);
-					}
+					chain.insert(chain.begin(), other.begin(), other.end());
+					frontEnd[i] = farEnd;
 				}
-
-				active[bestJ] = false;
-				mergedAny = true;
+				active[j] = false;
 			}
-			(void)mergedAny;
 		}
 
-		// Compact the working set to only active paths
-		std::vector<Path> compacted;
-		compacted.reserve(n);
+		// Flatten the surviving chains into a compact set
+		merged.reserve(n, working.pointCount());
 		for (size_t i = 0; i < n; ++i)
 		{
-			if (active[i])
-				compacted.push_back(std::move(working[i]));
+			if (!active[i])
+				continue;
+			for (const ChainPiece &c : chains[i])
+			{
+				const PathView p = working[c.path];
+				if (c.reversed)
+					for (size_t k = p.points.size(); k-- > 0;) merged.addPoint(p.points[k]);
+				else
+					for (const Vec2 &v : p.points) merged.addPoint(v);
+			}
+			merged.endPath(working.closed(i));
 		}
-		working.swap(compacted);
+		workingSet = &merged;
 	}
+	const PathSet &working = *workingSet;
 
-	// Reorder pass: nearest-neighbor traversal using a dynamic KD-tree over path endpoints
+	// Reorder pass: greedy nearest-endpoint tour from the bottom-left corner, optionally
+	// refined by local search against the plot time model
 	if (!doReorder)
 	{
-		out.paths = std::move(working);
+		out.points = working.points;
+		out.offsets = working.offsets;
+		out.flags = working.flags;
 		out.computeAABB();
 		return;
 	}
 
 	in.computeAABB();
-	Vec2 ref = in.aabb.min;
-
-	const size_t m = working.size();
-	std::vector<bool> used(m, false);
-	out.paths.reserve(m);
-
-
-
-	// Two endpoint clouds: starts and ends
-	EndpointCloud cloudStarts;
-	EndpointCloud cloudEnds;
-	cloudStarts.pts.reserve(m);
-	cloudEnds.pts.reserve(m);
-	std::vector<size_t> startToPath; startToPath.reserve(m);
-	std::vector<size_t> endToPath; endToPath.reserve(m);
-	for (size_t i = 0; i < m; ++i)
+	const Vec2 home = in.aabb.min;
+	std::vector<PathOrderEntry> order = orderPathsGreedy(working, home, m_cancelToken);
+	if (cancelled()) return;
+
+	// Times use the default plotter settings; the document does not know the device
+	const TravelCostModel model = TravelCostModel::fromConfig(PlotterConfig{});
+	const double greedyS = estimatePlotSeconds(working, order, home, model);
+	char summary[96];
+	if (doRefine)
 	{
-		const Path &p = working[i];
-		if (p.points.empty()) continue;
-		cloudStarts.pts.push_back(p.points.front());
-		startToPath.push_back(i);
-		cloudEnds.pts.push_back(p.points.back());
-		endToPath.push_back(i);
+		refinePathOrder(working, order, home, model, refineBudgetMs, m_cancelToken);
+		if (cancelled()) return;
+		const double refinedS = estimatePlotSeconds(working, order, home, model);
+		std::snprintf(summary, sizeof(summary), "Est. plot time %.1f min -> %.1f min",
+			greedyS / 60.0, refinedS / 60.0);
 	}
-
-	using KDTree = nanoflann::KDTreeSingleIndexAdaptor<
-		nanoflann::L2_Simple_Adaptor<float, EndpointCloud>, EndpointCloud, 2>;
-	KDTree indexStarts(2, cloudStarts, {10});
-	KDTree indexEnds(2, cloudEnds, {10});
-	// static adaptor builds at construction
-	// static adaptor builds at construction; no addPoints needed
-
-	auto pickNearest = [&](const Vec2 &q) -> std::pair<size_t, bool>
+	else
 	{
-		if (cloudStarts.pts.empty() && cloudEnds.pts.empty()) return {static_cast<size_t>(-1), false};
-		float query_pt[2] = { q.x, q.y };
-
-		// progressively widen the search for both trees
-		size_t kS = std::min<size_t>(16, cloudStarts.pts.size());
-		size_t kE = std::min<size_t>(16, cloudEnds.pts.size());
-		while (true)
-		{
-			// current best
-			size_t bestIdx = static_cast<size_t>(-1);
-			bool bestReverse = false;
-			float bestD2 = std::numeric_limits<float>::infinity();
-
-			if (kS > 0)
-			{
-				std::vector<size_t> idxS(kS);
-				std::vector<float> distS(kS);
-				nanoflann::KNNResultSet<float> rsS(kS);
-				rsS.init(idxS.data(), distS.data());
-				indexStarts.findNeighbors(rsS, query_pt, {10});
-				const size_t gotS = rsS.size();
-				for (size_t ii = 0; ii < gotS; ++ii)
-				{
-					const size_t ep = idxS[ii];
-					const size_t pi = startToPath[ep];
-					if (used[pi]) continue;
-					const float d2 = distS[ii];
-					if (d2 < bestD2)
-					{
-						bestD2 = d2;
-						bestIdx = pi;
-						bestReverse = false;
-					}
-				}
-			}
-
-			if (kE > 0)
-			{
-				std::vector<size_t> idxE(kE);
-				std::vector<float> distE(kE);
-				nanoflann::KNNResultSet<float> rsE(kE);
-				rsE.init(idxE.data(), distE.data());
-				indexEnds.findNeighbors(rsE, query_pt, {10});
-				const size_t gotE = rsE.size();
-				for (size_t ii = 0; ii < gotE; ++ii)
-				{
-					const size_t ep = idxE[ii];
-					const size_t pi = endToPath[ep];
-					if (used[pi]) continue;
-					const float d2 = distE[ii];
-					const Path &p = working[pi];
-					const bool canReverse = !p.closed;
-					if (d2 < bestD2)
-					{
-						bestD2 = d2;
-						bestIdx = pi;
-						bestReverse = canReverse;
-					}
-				}
-			}
-
-			if (bestIdx != static_cast<size_t>(-1))
-				return {bestIdx, bestReverse};
-
-			const bool canGrowS = kS < cloudStarts.pts.size();
-			const bool canGrowE = kE < cloudEnds.pts.size();
-			if (!canGrowS && !canGrowE) break;
-			if (canGrowS) kS = std::min<size_t>(kS ? kS * 2 : 16, cloudStarts.pts.size());
-			if (canGrowE) kE = std::min<size_t>(kE ? kE * 2 : 16, cloudEnds.pts.size());
-		}
-
-		return {static_cast<size_t>(-1), false};
-	};
-
-	// Pick first path via KD-tree
-	Vec2 lastPoint = ref;
-	{
-		auto [startIdx, reverseFirst] = pickNearest(ref);
-		if (startIdx == static_cast<size_t>(-1))
-		{
-			out.paths = std::move(working);
-			out.computeAABB();
-			return;
-		}
-		Path first = working[startIdx];
-		used[startIdx] = true;
-		if (reverseFirst)
-			reversePath(first);
-		lastPoint = first.points.empty() ? lastPoint : first.points.back();
-		out.paths.push_back(std::move(first));
+		std::snprintf(summary, sizeof(summary), "Est. plot time %.1f min", greedyS / 60.0);
 	}
-
-	for (size_t picked = 1; picked < m; ++picked)
-	{
-		auto [bestIdx, reverseCandidate] = pickNearest(lastPoint);
-		if (bestIdx == static_cast<size_t>(-1)) break;
-		Path chosen = working[bestIdx];
-		used[bestIdx] = true;
-		if (reverseCandidate)
-			reversePath(chosen);
-		lastPoint = chosen.points.empty() ? lastPoint : chosen.points.back();
-		out.paths.push_back(std::move(chosen));
-	}
-
+	setSummary(summary);
+	applyPathOrder(working, order, out);
 	out.computeAABB();
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
+#include <string>
 #include "../Filter.h"
 
 struct OptimizePathsFilter : public FilterTyped<PathSet, PathSet>
@@ -25,12 +27,42 @@ struct OptimizePathsFilter : public FilterTyped<PathSet, PathSet>
 			1.0f,
 			1.0f
 		};
+		m_parameters["refine"] = FilterParameter{
+			"Refine Order (0/1)",
+			0.0f,
+			1.0f,
+			0.0f
+		};
+		m_parameters["refineBudgetMs"] = FilterParameter{
+			"Refine Budget (ms)",
+			0.0f,
+			10000.0f,
+			1000.0f
+		};
 	}
 
 	const char *name() const override { return "Optimize Paths"; }
 	uint64_t paramVersion() const override { return m_version.load(); }
 
 	void applyTyped(const PathSet &in, PathSet &out) const override;
+
+	// Estimated plot time before and after refinement, when reordering ran
+	std::string runSummary() const override
+	{
+		std::lock_guard<std::mutex> lk(m_summaryMutex);
+		return m_summary;
+	}
+
+private:
+	void setSummary(std::string s) const
+	{
+		std::lock_guard<std::mutex> lk(m_summaryMutex);
+		m_summary = std::move(s);
+	}
+
+	// apply() is const and may run on an evaluator thread while another reads the summary
+	mutable std::mutex m_summaryMutex;
+	mutable std::string m_summary;
 };
 
 
@@ -1,9 +1,12 @@
 #include "filters/pathset/SimplifyFilter.h"
 
 #include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <cmath>
 
+#include "utils/ThreadPool.h"
+
 static inline float perpendicularDistanceToSegment(const Vec2 &p, const Vec2 &a, const Vec2 &b)
 {
     const float vx = b.x - a.x;
@@ -25,7 +28,7 @@ static inline float perpendicularDistanceToSegment(const Vec2 &p, const Vec2 &a,
     return std::sqrt(dx * dx + dy * dy);
 }
 
-static void rdpRecursive(const std::vector<Vec2> &pts, size_t first, size_t last, float eps, std::vector<bool> &keep)
+static void rdpRecursive(Span<const Vec2> pts, size_t first, size_t last, float eps, std::vector<bool> &keep)
 {
     if (last <= first + 1)
         return;
@@ -52,11 +55,11 @@ static void rdpRecursive(const std::vector<Vec2> &pts, size_t first, size_t last
     }
 }
 
-static void rdpSimplifyOpen(const std::vector<Vec2> &inPts, float eps, std::vector<Vec2> &outPts)
+static void rdpSimplifyOpen(Span<const Vec2> inPts, float eps, std::vector<Vec2> &outPts)
 {
     const size_t n = inPts.size();
     if (n == 0) { outPts.clear(); return; }
-    if (n <= 2) { outPts = inPts; return; }
+    if (n <= 2) { outPts.assign(inPts.begin(), inPts.end()); return; }
 
     std::vector<bool> keep(n, false);
     keep[0] = true;
@@ -69,10 +72,10 @@ static void rdpSimplifyOpen(const std::vector<Vec2> &inPts, float eps, std::vect
         if (keep[i]) outPts.push_back(inPts[i]);
 }
 
-static void mergeColinear(const std::vector<Vec2> &inPts, bool closed, float eps, std::vector<Vec2> &outPts)
+static void mergeColinear(Span<const Vec2> inPts, bool closed, float eps, std::vector<Vec2> &outPts)
 {
     const size_t n = inPts.size();
-    if (n <= 2) { outPts = inPts; return; }
+    if (n <= 2) { outPts.assign(inPts.begin(), inPts.end()); return; }
 
     auto at = [&](int i) -> const Vec2& { return inPts[static_cast<size_t>((i + static_cast<int>(n)) % static_cast<int>(n))]; };
 
@@ -109,11 +112,11 @@ static void mergeColinear(const std::vector<Vec2> &inPts, bool closed, float eps
     }
 }
 
-static void rdpSimplifyClosed(const std::vector<Vec2> &inPts, float eps, std::vector<Vec2> &outPts)
+static void rdpSimplifyClosed(Span<const Vec2> inPts, float eps, std::vector<Vec2> &outPts)
 {
     const size_t n = inPts.size();
     if (n == 0) { outPts.clear(); return; }
-    if (n <= 3) { outPts = inPts; return; }
+    if (n <= 3) { outPts.assign(inPts.begin(), inPts.end()); return; }
 
     Vec2 c(0.0f, 0.0f);
     for (const auto &p : inPts) { c.x += p.x; c.y += p.y; }
@@ -140,26 +143,26 @@ static void rdpSimplifyClosed(const std::vector<Vec2> &inPts, float eps, std::ve
     std::vector<Vec2> merged;
     mergeColinear(tmp, true, eps, merged);
     if (merged.size() < 3)
-        outPts = inPts;
+        outPts.assign(inPts.begin(), inPts.end());
     else
         outPts = std::move(merged);
 }
 
-static float computePathLengthMm(const Path &p)
+static float computePathLengthMm(Span<const Vec2> pts, bool closed)
 {
-    const size_t n = p.points.size();
+    const size_t n = pts.size();
     if (n < 2) return 0.0f;
     float len = 0.0f;
     for (size_t i = 1; i < n; ++i)
     {
-        const float dx = p.points[i].x - p.points[i - 1].x;
-        const float dy = p.points[i].y - p.points[i - 1].y;
+        const float dx = pts[i].x - pts[i - 1].x;
+        const float dy = pts[i].y - pts[i - 1].y;
         len += std::sqrt(dx * dx + dy * dy);
     }
-    if (p.closed && n >= 2)
+    if (closed && n >= 2)
     {
-        const float dx = p.points[0].x - p.points[n - 1].x;
-        const float dy = p.points[0].y - p.points[n - 1].y;
+        const float dx = pts[0].x - pts[n - 1].x;
+        const float dy = pts[0].y - pts[n - 1].y;
         len += std::sqrt(dx * dx + dy * dy);
     }
     return len;
@@ -168,47 +171,57 @@ static float computePathLengthMm(const Path &p)
 void SimplifyFilter::applyTyped(const PathSet &in, PathSet &out) const
 {
     out.color = in.color;
-    out.paths.clear();
-    out.paths.reserve(in.paths.size());
+    out.clear();
 
     const float eps = std::max(0.0f, m_parameters.at("toleranceMm").value);
     const float minLen = std::max(1.0f, std::min(10.0f, m_parameters.at("minPathLengthMm").value));
 
-    for (const auto &p : in.paths)
-    {
-        Path sp;
-        sp.closed = p.closed;
-
-        if (!p.closed)
+    // Simplify blocks of paths independently into their own sets, then concatenate in
+    // input order
+    const size_t n = in.size();
+    const size_t block = 256;
+    const size_t blocks = (n + block - 1) / block;
+    std::vector<PathSet> simplifiedBlocks(blocks);
+
+    parallelForEach(blocks, 1, [&](size_t bi) {
+        PathSet &dst = simplifiedBlocks[bi];
+        std::vector<Vec2> simplified;
+        std::vector<Vec2> sp;
+        const size_t end = std::min(n, (bi + 1) * block);
+        for (size_t pi = bi * block; pi < end; ++pi)
         {
-            if (p.points.size() <= 2)
+            const PathView p = in[pi];
+            if (!p.closed)
             {
-                sp = p;
+                if (p.points.size() <= 2)
+                {
+                    sp.assign(p.points.begin(), p.points.end());
+                }
+                else
+                {
+                    rdpSimplifyOpen(p.points, eps, simplified);
+                    mergeColinear(simplified, false, eps, sp);
+                }
             }
             else
             {
-                std::vector<Vec2> simplified;
-                rdpSimplifyOpen(p.points, eps, simplified);
-                mergeColinear(simplified, false, eps, sp.points);
+                rdpSimplifyClosed(p.points, eps, sp);
             }
-        }
-        else
-        {
-            rdpSimplifyClosed(p.points, eps, sp.points);
-            sp.closed = true;
-        }
 
-        if ((!sp.closed && sp.points.size() < 2) || (sp.closed && sp.points.size() < 3))
-        {
-            sp = p;
-        }
+            Span<const Vec2> result = sp;
+            if ((!p.closed && sp.size() < 2) || (p.closed && sp.size() < 3))
+            {
+                result = p.points;
+            }
 
-        // Remove paths shorter than threshold
-        if (computePathLengthMm(sp) >= minLen)
-        {
-            out.paths.push_back(std::move(sp));
+            // Remove paths shorter than threshold
+            if (computePathLengthMm(result, p.closed) >= minLen)
+                dst.addPath(result, p.closed);
         }
-    }
+    });
+
+    for (const PathSet &b : simplifiedBlocks)
+        out.append(b);
 
     out.computeAABB();
 }
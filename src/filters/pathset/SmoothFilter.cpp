@@ -1,7 +1,10 @@
 #include "filters/pathset/SmoothFilter.h"
 
+#include <algorithm>
 #include <vector>
 
+#include "utils/ThreadPool.h"
+
 static inline Vec2 lerp(const Vec2 &a, const Vec2 &b, float t)
 {
     return Vec2(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t);
@@ -55,22 +58,36 @@ static void chaikinOnce(const Path &in, Path &out)
 void SmoothFilter::applyTyped(const PathSet &in, PathSet &out) const
 {
     out.color = in.color;
-    out.paths.clear();
-    out.paths.reserve(in.paths.size());
+    out.clear();
 
     int iters = static_cast<int>(m_parameters.at("iterations").value + 0.5f);
     if (iters < 0) iters = 0;
     if (iters > 50) iters = 50; // hard safety clamp
 
-    for (const Path &p : in.paths)
+    // Each iteration doubles the point count (open paths keep their endpoints, closed
+    // paths cut every corner), so the output layout is known up front and paths can be
+    // written in parallel straight into the shared buffer
+    const size_t n = in.size();
+    out.offsets.resize(n + 1);
+    for (size_t pi = 0; pi < n; ++pi)
     {
+        const size_t len = in.pathSize(pi);
+        const size_t outLen = (len < 2) ? len : (len << iters);
+        out.offsets[pi + 1] = out.offsets[pi] + static_cast<uint32_t>(outLen);
+    }
+    out.flags = in.flags;
+    out.points.resize(out.offsets.back());
+
+    parallelForEach(n, 64, [&](size_t pi) {
+        const PathView p = in[pi];
+        Span<Vec2> dst = out.pathPoints(pi);
         if (p.points.size() < 2 || iters == 0)
         {
-            out.paths.push_back(p);
-            continue;
+            std::copy(p.points.begin(), p.points.end(), dst.begin());
+            return;
         }
 
-        Path cur = p;
+        Path cur = in.toPath(pi);
         Path tmp;
         for (int i = 0; i < iters; ++i)
         {
@@ -78,8 +95,8 @@ void SmoothFilter::applyTyped(const PathSet &in, PathSet &out) const
             cur.points.swap(tmp.points);
             cur.closed = tmp.closed;
         }
-        out.paths.push_back(std::move(cur));
-    }
+        std::copy(cur.points.begin(), cur.points.end(), dst.begin());
+    });
 
     out.computeAABB();
 }
@@ -1,6 +1,10 @@
 #include "plotters/AxidrawController.h"
+#include "plotters/PlotterConfig.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <glog/logging.h>
 
 namespace {
@@ -44,10 +48,14 @@ bool AxiDrawController::stepperMove(int durationMs, int aSteps, int bSteps, std:
         errorOut);
 }
 
-bool AxiDrawController::lowLevelMove(int rateStepsPerSecond, int aSteps, int bSteps, std::string *errorOut) {
-    return sendCmd(
-        "LM," + std::to_string(rateStepsPerSecond) + "," + std::to_string(aSteps) + "," + std::to_string(bSteps),
-        errorOut);
+static std::string lowLevelMoveCmd(uint32_t rate1, int steps1, int32_t accel1, uint32_t rate2, int steps2, int32_t accel2) {
+    return "LM," + std::to_string(rate1) + "," + std::to_string(steps1) + "," + std::to_string(accel1) + "," +
+           std::to_string(rate2) + "," + std::to_string(steps2) + "," + std::to_string(accel2);
+}
+
+bool AxiDrawController::lowLevelMove(uint32_t rate1, int steps1, int32_t accel1, uint32_t rate2, int steps2, int32_t accel2,
+                                     std::string *errorOut) {
+    return sendCmd(lowLevelMoveCmd(rate1, steps1, accel1, rate2, steps2, accel2), errorOut);
 }
 
 bool AxiDrawController::enableMotors(bool enable1, bool enable2, std::string *errorOut) {
@@ -64,27 +72,150 @@ bool AxiDrawController::reset(std::string *errorOut) {
     return sendCmd("R", errorOut);
 }
 
+bool AxiDrawController::emergencyStop(std::string *errorOut) {
+    return sendCmd("ES", errorOut);
+}
+
+void AxiDrawController::batchStepperMove(int durationMs, int aSteps, int bSteps) {
+    m_batch += "SM," + std::to_string(durationMs) + "," + std::to_string(aSteps) + "," + std::to_string(bSteps) + "\r";
+    m_batchEnds.push_back("OK");
+    m_batchCount++;
+}
+
+void AxiDrawController::batchLowLevelMove(uint32_t rate1, int steps1, int32_t accel1, uint32_t rate2, int steps2, int32_t accel2) {
+    m_batch += lowLevelMoveCmd(rate1, steps1, accel1, rate2, steps2, accel2) + "\r";
+    m_batchEnds.push_back("OK");
+    m_batchCount++;
+}
+
+void AxiDrawController::batchPen(bool up, int durationMs) {
+    int dur = (durationMs >= 0) ? durationMs : m_state.upDownMs;
+    m_batch += "SP," + std::to_string(up ? kPenUpState : kPenDownState) + "," + std::to_string(dur) + "\r";
+    m_batchEnds.push_back("OK");
+    m_batchCount++;
+}
+
+bool AxiDrawController::flushBatch(std::string *errorOut) {
+    if (m_batch.empty()) return true;
+    std::string err;
+    std::vector<std::future<SerialController::Reply>> replies;
+    const bool ok = m_serial.write(m_batch, m_batchEnds, replies, &err);
+    for (size_t i = 0; i < replies.size(); ++i) {
+        m_inflight.push_back(Inflight{std::move(replies[i]), m_batchEnds[i] == "QM,"});
+    }
+    m_unacked += static_cast<int>(m_batchCount);
+    m_batch.clear();
+    m_batchEnds.clear();
+    m_batchCount = 0;
+    if (!ok) {
+        if (errorOut) *errorOut = err;
+        LOG(ERROR) << "AxiDraw batch write failed: " << err;
+        return false;
+    }
+    return true;
+}
+
+void AxiDrawController::batchQueryMotion() {
+    m_batch += "QM\r";
+    m_batchEnds.push_back("QM,");
+    m_queriesPending++;
+}
+
+bool AxiDrawController::handleReply(const SerialController::Reply &reply, bool query, std::string *errorOut) {
+    if (query) {
+        if (m_queriesPending > 0) m_queriesPending--;
+    } else if (m_unacked > 0) {
+        m_unacked--;
+    }
+    if (!reply.ok) {
+        if (errorOut) *errorOut = reply.error;
+        LOG(ERROR) << "AxiDraw command failed: " << reply.error;
+        return false;
+    }
+    if (query) {
+        // QM,CommandStatus,Motor1Status,Motor2Status,FIFOStatus
+        const std::string &line = reply.line;
+        int v[4] = {0, 0, 0, 0};
+        size_t pos = 3;
+        for (int i = 0; i < 4; ++i) {
+            v[i] = std::atoi(line.c_str() + pos);
+            const size_t comma = line.find(',', pos);
+            if (comma == std::string::npos) break;
+            pos = comma + 1;
+        }
+        m_status.executing = v[0] != 0;
+        m_status.motor1Moving = v[1] != 0;
+        m_status.motor2Moving = v[2] != 0;
+        m_status.fifoNotEmpty = v[3] != 0;
+        m_statusSeq++;
+    }
+    return true;
+}
+
+bool AxiDrawController::readAcks(int timeoutMs, std::string *errorOut) {
+    auto wait = std::chrono::milliseconds(std::max(0, timeoutMs));
+    while (!m_inflight.empty()) {
+        if (m_inflight.front().reply.wait_for(wait) != std::future_status::ready) return true;
+        Inflight done = std::move(m_inflight.front());
+        m_inflight.pop_front();
+        if (!handleReply(done.reply.get(), done.query, errorOut)) return false;
+        wait = std::chrono::milliseconds(0); // only wait for the first reply; take the rest that are already there
+    }
+    return true;
+}
+
+bool AxiDrawController::queryMotion(MotionStatus &out, int timeoutMs, std::string *errorOut) {
+    const uint32_t seq = m_statusSeq;
+    batchQueryMotion();
+    if (!flushBatch(errorOut)) return false;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(0, timeoutMs));
+    while (m_statusSeq == seq) {
+        if (m_inflight.empty() || m_inflight.front().reply.wait_until(deadline) != std::future_status::ready) {
+            if (errorOut) *errorOut = "No reply to QM";
+            return false;
+        }
+        Inflight done = std::move(m_inflight.front());
+        m_inflight.pop_front();
+        if (!handleReply(done.reply.get(), done.query, errorOut)) return false;
+    }
+    out = m_status;
+    return true;
+}
+
+void AxiDrawController::resetStream() {
+    m_batch.clear();
+    m_batchEnds.clear();
+    m_batchCount = 0;
+    m_inflight.clear();
+    m_unacked = 0;
+    m_queriesPending = 0;
+}
+
 bool AxiDrawController::sendCmd(const std::string &cmd, std::string *errorOut) {
+    // Long enough for the EBB to free a FIFO slot behind a slow move
+    constexpr auto kReplyTimeout = std::chrono::seconds(5);
     if (!m_serial.isConnected()) {
         if (errorOut) *errorOut = "Serial not connected";
         LOG(WARNING) << "AxiDraw send failed (not connected): " << cmd;
         return false;
     }
-    std::string err;
-    bool ok = m_serial.writeLine(cmd, &err);
-    if (!ok) {
-        if (errorOut) *errorOut = err;
-        LOG(ERROR) << "AxiDraw writeLine failed: " << err;
+    std::future<SerialController::Reply> f = m_serial.writeLine(cmd);
+    if (f.wait_for(kReplyTimeout) != std::future_status::ready) {
+        if (errorOut) *errorOut = "No reply to " + cmd;
+        LOG(ERROR) << "AxiDraw: no reply to " << cmd;
+        return false;
+    }
+    const SerialController::Reply r = f.get();
+    if (!r.ok) {
+        if (errorOut) *errorOut = r.error;
+        LOG(ERROR) << "AxiDraw " << cmd << " failed: " << r.error;
         return false;
     }
     return true;
 }
 
 void AxiDrawController::recomputeUpDownMs() {
-    int diff = std::abs(m_state.penUpPos - m_state.penDownPos);
-    // upDownMs = |up-down| * 0.06
-    m_state.upDownMs = static_cast<int>(std::lround(diff * 0.06));
-    if (m_state.upDownMs < 1) m_state.upDownMs = 1;
+    m_state.upDownMs = ::penMoveMs(m_state.penUpPos, m_state.penDownPos);
 }
 
 
@@ -1,14 +1,21 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
+#include <future>
 #include <string>
+#include <vector>
 #include "serial/SerialController.h"
 
 struct AxiDrawState {
     int penUpPos{17548};
     int penDownPos{14058};
-    int upDownMs{100}; // computed as |up-down| * 0.06
+    int upDownMs{100}; // penMoveMs(penUpPos, penDownPos)
 };
 
+// EBB commands over a SerialController. One-off commands wait for the device's reply and
+// fail on an error reply; streamed commands are batched and their replies collected by
+// readAcks().
 class AxiDrawController {
 public:
     explicit AxiDrawController(SerialController &serial, AxiDrawState &state)
@@ -24,17 +31,82 @@ public:
 
     // EBB motion/control commands
     bool stepperMove(int durationMs, int aSteps, int bSteps, std::string *errorOut = nullptr);
-    bool lowLevelMove(int rateStepsPerSecond, int aSteps, int bSteps, std::string *errorOut = nullptr);
+    // LM: per-axis start rate and per-tick acceleration in EBB register units (see
+    // MoveSlice); the move ends once both axes have taken their steps
+    bool lowLevelMove(uint32_t rate1, int steps1, int32_t accel1, uint32_t rate2, int steps2, int32_t accel2,
+                      std::string *errorOut = nullptr);
     bool enableMotors(bool enable1, bool enable2, std::string *errorOut = nullptr);
     bool disengageMotors(std::string *errorOut = nullptr);
     bool reset(std::string *errorOut = nullptr);
+    // Abort the move in progress and drop everything queued on the device
+    bool emergencyStop(std::string *errorOut = nullptr);
+
+    // Pipelined streaming. Commands are appended to a batch and written together by
+    // flushBatch(); the EBB answers each one with "OK" once it has been taken into its
+    // motion FIFO, so unackedCommands() is how many are still waiting in transit.
+    struct MotionStatus {
+        bool executing{false};    // a command is being executed
+        bool motor1Moving{false};
+        bool motor2Moving{false};
+        bool fifoNotEmpty{false}; // motion queued behind the current move
+        bool idle() const { return !executing && !motor1Moving && !motor2Moving && !fifoNotEmpty; }
+    };
+
+    void batchStepperMove(int durationMs, int aSteps, int bSteps);
+    void batchLowLevelMove(uint32_t rate1, int steps1, int32_t accel1, uint32_t rate2, int steps2, int32_t accel2);
+    void batchPen(bool up, int durationMs = -1);
+    size_t batchedCommands() const { return m_batchCount; }
+    bool flushBatch(std::string *errorOut = nullptr);
+
+    // Queue a QM query behind the batched commands. The EBB answers it once everything
+    // before it has entered the FIFO; the reply lands in lastMotionStatus().
+    void batchQueryMotion();
+
+    // Consume replies that are already there or arrive within timeoutMs, in command
+    // order. False on a lost connection or an error reply ("!...") from the device.
+    bool readAcks(int timeoutMs, std::string *errorOut = nullptr);
+    int unackedCommands() const { return m_unacked; }
+    int pendingQueries() const { return m_queriesPending; }
+
+    // Latest QM reply and a counter that advances with every reply
+    const MotionStatus &lastMotionStatus() const { return m_status; }
+    uint32_t motionStatusSeq() const { return m_statusSeq; }
+
+    // Blocking QM query (flushes the batch first)
+    bool queryMotion(MotionStatus &out, int timeoutMs, std::string *errorOut = nullptr);
+
+    // Forget replies and batches of an earlier stream (their replies are still matched
+    // to them by the reader, just not looked at)
+    void resetStream();
+
+    // Servo travel time used for pen moves without an explicit duration
+    int penMoveMs() const { return m_state.upDownMs; }
 
 private:
+    // A streamed command whose reply has not been looked at
+    struct Inflight {
+        std::future<SerialController::Reply> reply;
+        bool query{false}; // QM
+    };
+
+    // Write one command and wait for its reply
     bool sendCmd(const std::string &cmd, std::string *errorOut);
     void recomputeUpDownMs();
 
+    // Handle one streamed reply; false for a device error
+    bool handleReply(const SerialController::Reply &reply, bool query, std::string *errorOut);
+
     SerialController &m_serial;
     AxiDrawState &m_state;
+
+    std::string m_batch;
+    std::vector<std::string> m_batchEnds; // reply end of each batched command
+    size_t m_batchCount{0};
+    std::deque<Inflight> m_inflight;      // oldest first
+    int m_unacked{0};
+    int m_queriesPending{0};
+    MotionStatus m_status{};
+    uint32_t m_statusSeq{0};
 };
 
 
@@ -0,0 +1,469 @@
+#include "plotters/EbbSimulator.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+#ifdef __linux__
+#  include <cerrno>
+#  include <cstring>
+#  include <fcntl.h>
+#  include <poll.h>
+#  include <termios.h>
+#  include <unistd.h>
+#endif
+
+namespace
+{
+constexpr int64_t kUsPerTick = 40;           // 25 kHz step clock
+constexpr long double kLmOne = 2147483648.0L; // LM accumulator overflow, 2^31
+
+// Ticks until an LM axis has taken |steps| steps (the accumulator gains
+// rate + k * accel on tick k), or -1 if its rate runs down first
+int64_t lowLevelTicks(int64_t steps, int64_t rate, int64_t accel, double &peakStepsPerS)
+{
+    peakStepsPerS = 0.0;
+    const int64_t n = std::llabs(steps);
+    if (n == 0)
+        return 0;
+    const long double T = static_cast<long double>(n) * kLmOne;
+    const long double R = static_cast<long double>(rate);
+    const long double A = static_cast<long double>(accel);
+    auto taken = [&](long double k) { return R * k + A * k * (k + 1.0L) / 2.0L; };
+
+    long double k = 0.0L;
+    if (accel == 0)
+    {
+        if (rate <= 0)
+            return -1;
+        k = std::ceil(T / R);
+    }
+    else
+    {
+        // (A/2) k^2 + (R + A/2) k = T
+        const long double a = A / 2.0L, b = R + A / 2.0L;
+        const long double disc = b * b + 4.0L * a * T;
+        if (disc < 0.0L)
+            return -1;
+        k = std::ceil((-b + std::sqrt(disc)) / (2.0L * a));
+        if (k < 1.0L)
+            return -1;
+    }
+    while (k > 1.0L && taken(k - 1.0L) >= T) k -= 1.0L;
+    for (int i = 0; i < 4 && taken(k) < T; ++i) k += 1.0L;
+    if (taken(k) < T || k > 1e10L)
+        return -1;
+
+    const long double peak = std::max(R + A, R + A * k);
+    peakStepsPerS = static_cast<double>(peak / kLmOne * 25000.0L);
+    return static_cast<int64_t>(k);
+}
+} // namespace
+
+VirtualClock::VirtualClock(double wallScale)
+    : m_scale(wallScale), m_wallStart(std::chrono::steady_clock::now())
+{
+}
+
+int64_t VirtualClock::nowUs() const
+{
+    if (isManual())
+        return m_manualUs;
+    const auto wall = std::chrono::steady_clock::now() - m_wallStart;
+    return static_cast<int64_t>(std::chrono::duration<double, std::micro>(wall).count() * m_scale);
+}
+
+void VirtualClock::waitUntilUs(int64_t t)
+{
+    if (isManual())
+    {
+        m_manualUs = std::max(m_manualUs, t);
+        return;
+    }
+    const int64_t now = nowUs();
+    if (t > now)
+        std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>((t - now) / m_scale)));
+}
+
+EbbSimulator::EbbSimulator()
+    : EbbSimulator(Options())
+{
+}
+
+EbbSimulator::EbbSimulator(Options opt, VirtualClock clock)
+    : m_opt(opt), m_clock(clock)
+{
+    m_busyUntilUs = m_clock.nowUs();
+    resetStats();
+}
+
+void EbbSimulator::resetStats()
+{
+    m_stats = Stats{};
+    m_trajectory.clear();
+    m_hadMotion = false;
+    if (m_opt.recordTrajectory)
+    {
+        const float spm = static_cast<float>(m_opt.stepsPerMm);
+        m_trajectory.push_back({m_clock.nowMs(), 0.5f * static_cast<float>(m_pos1 - m_pos2) / spm,
+                                0.5f * static_cast<float>(m_pos1 + m_pos2) / spm, m_penDown});
+    }
+}
+
+std::string EbbSimulator::feed(std::string_view bytes)
+{
+    std::string replies;
+    m_rx.append(bytes.data(), bytes.size());
+    size_t start = 0;
+    for (;;)
+    {
+        const size_t end = m_rx.find_first_of("\r\n", start);
+        if (end == std::string::npos)
+            break;
+        if (end > start)
+            replies += handle(std::string_view(m_rx).substr(start, end - start));
+        start = end + 1;
+    }
+    m_rx.erase(0, start);
+    return replies;
+}
+
+std::string EbbSimulator::handle(std::string_view line)
+{
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) line.remove_suffix(1);
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.front()))) line.remove_prefix(1);
+    if (line.empty())
+        return std::string();
+    m_stats.commands++;
+    m_stats.bytesIn += static_cast<int64_t>(line.size()) + 1;
+
+    // "NAME,arg,arg,..." with integer arguments; names are case-insensitive
+    const size_t comma = line.find(',');
+    std::string name(line.substr(0, comma));
+    for (char &c : name) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+    std::vector<int64_t> args;
+    if (comma != std::string_view::npos)
+    {
+        const std::string rest(line.substr(comma + 1));
+        const char *p = rest.c_str();
+        for (;;)
+        {
+            args.push_back(std::strtoll(p, nullptr, 10));
+            p = std::strchr(p, ',');
+            if (!p) break;
+            ++p;
+        }
+    }
+
+    if (name == "SM")
+        return stepperMove(args);
+    if (name == "LM")
+        return lowLevelMove(args);
+    if (name == "SP")
+    {
+        if (args.empty() || (args[0] != 0 && args[0] != 1))
+            return error("!8 Err: SP needs state 0 or 1");
+        const int64_t ms = args.size() > 1 ? std::max<int64_t>(0, args[1]) : 0;
+        // The servo starts moving when the command runs; its delay only holds up the queue
+        const int64_t start = enqueue(ms * 1000, 0, 0, args[0] == 0);
+        m_servoFrom = servoAt(start);
+        m_servoTo = args[0] == 0 ? 0.0 : 1.0;
+        m_servoStartUs = start;
+        return "OK\r\n";
+    }
+    if (name == "QM")
+    {
+        const int64_t now = m_clock.nowUs();
+        retire(now);
+        const bool running = !m_queue.empty() && m_queue.front().startUs <= now;
+        const bool m1 = running && m_queue.front().steps1 != 0;
+        const bool m2 = running && m_queue.front().steps2 != 0;
+        const bool fifo = waiting(now) > 0;
+        return "QM," + std::to_string((running || fifo) ? 1 : 0) + "," + std::to_string(m1 ? 1 : 0) + "," +
+               std::to_string(m2 ? 1 : 0) + "," + std::to_string(fifo ? 1 : 0) + "\r\n";
+    }
+    if (name == "ES")
+        return emergencyStop();
+    if (name == "R")
+    {
+        m_queue.clear();
+        m_busyUntilUs = m_clock.nowUs();
+        m_pos1 = m_pos2 = 0;
+        m_penDown = false;
+        m_hadMotion = false;
+        m_servoFrom = m_servoTo = 1.0;
+        return "OK\r\n";
+    }
+    if (name == "SC" || name == "EM")
+        return "OK\r\n";
+    if (name == "V")
+        return "EBBv13_and_above EB Firmware Version 3.0.2\r\n";
+    return error("!8 Err: Unknown command '" + name + "'");
+}
+
+std::string EbbSimulator::error(const std::string &msg)
+{
+    m_stats.errors++;
+    return msg + "\r\n";
+}
+
+void EbbSimulator::retire(int64_t nowUs)
+{
+    while (!m_queue.empty() && m_queue.front().endUs <= nowUs) m_queue.pop_front();
+}
+
+int EbbSimulator::waiting(int64_t nowUs) const
+{
+    int n = 0;
+    for (auto it = m_queue.rbegin(); it != m_queue.rend() && it->startUs > nowUs; ++it) ++n;
+    return n;
+}
+
+double EbbSimulator::servoAt(int64_t tUs) const
+{
+    if (m_opt.servoMoveMs <= 0 || tUs <= m_servoStartUs)
+        return m_opt.servoMoveMs <= 0 ? m_servoTo : m_servoFrom;
+    const double moved = static_cast<double>(tUs - m_servoStartUs) / (1000.0 * m_opt.servoMoveMs);
+    if (moved >= std::abs(m_servoTo - m_servoFrom))
+        return m_servoTo;
+    return m_servoFrom + (m_servoTo > m_servoFrom ? moved : -moved);
+}
+
+double EbbSimulator::paperFraction(int64_t fromUs, int64_t toUs, bool penDown) const
+{
+    if (m_opt.servoMoveMs <= 0)
+        return penDown ? 1.0 : 0.0;
+    // The servo moves one way only, so the tip is down for a prefix or suffix of the move
+    const double c = m_opt.contactFraction;
+    const bool downAtFrom = servoAt(fromUs) <= c, downAtTo = servoAt(toUs) <= c;
+    if (downAtFrom == downAtTo || toUs <= fromUs)
+        return downAtFrom ? 1.0 : 0.0;
+    const double crossUs = static_cast<double>(m_servoStartUs) + std::abs(c - m_servoFrom) * 1000.0 * m_opt.servoMoveMs;
+    const double before = std::clamp((crossUs - static_cast<double>(fromUs)) / static_cast<double>(toUs - fromUs), 0.0, 1.0);
+    return downAtFrom ? before : 1.0 - before;
+}
+
+int64_t EbbSimulator::enqueue(int64_t durationUs, int steps1, int steps2, bool penDown)
+{
+    retire(m_clock.nowUs());
+    if (waiting(m_clock.nowUs()) >= m_opt.fifoDepth)
+    {
+        // The parser stalls until the oldest waiting command starts
+        m_stats.fifoFullWaits++;
+        while (waiting(m_clock.nowUs()) >= m_opt.fifoDepth)
+        {
+            const int64_t now = m_clock.nowUs();
+            auto it = std::find_if(m_queue.begin(), m_queue.end(), [&](const Motion &m) { return m.startUs > now; });
+            m_clock.waitUntilUs(it->startUs);
+            retire(m_clock.nowUs());
+        }
+    }
+
+    const int64_t now = m_clock.nowUs();
+    if (m_hadMotion && now > m_busyUntilUs)
+    {
+        m_stats.idleGaps++;
+        m_stats.idleGapMs += static_cast<double>(now - m_busyUntilUs) / 1000.0;
+    }
+    Motion m;
+    m.startUs = std::max(now, m_busyUntilUs);
+    m.endUs = m.startUs + durationUs;
+    m.from1 = m_pos1;
+    m.from2 = m_pos2;
+    m.steps1 = steps1;
+    m.steps2 = steps2;
+    m_queue.push_back(m);
+
+    m_pos1 += steps1;
+    m_pos2 += steps2;
+    m_penDown = penDown;
+    m_busyUntilUs = m.endUs;
+    m_hadMotion = true;
+    m_stats.motionCommands++;
+    m_stats.busyMs += static_cast<double>(durationUs) / 1000.0;
+    if (steps1 != 0 || steps2 != 0)
+    {
+        const double mm = 0.5 * std::hypot(static_cast<double>(steps1 - steps2), static_cast<double>(steps1 + steps2)) /
+                          static_cast<double>(m_opt.stepsPerMm);
+        m_stats.paperMm += mm * paperFraction(m.startUs, m.endUs, penDown);
+    }
+    if (m_opt.recordTrajectory)
+    {
+        const float spm = static_cast<float>(m_opt.stepsPerMm);
+        m_trajectory.push_back({static_cast<double>(m.endUs) / 1000.0, 0.5f * static_cast<float>(m_pos1 - m_pos2) / spm,
+                                0.5f * static_cast<float>(m_pos1 + m_pos2) / spm, penDown});
+    }
+    return m.startUs;
+}
+
+std::string EbbSimulator::stepperMove(const std::vector<int64_t> &args)
+{
+    // SM,duration,steps1,steps2
+    if (args.size() < 3 || args[0] < 1 || args[0] > 16777215)
+        return error("!8 Err: SM needs duration 1-16777215 and two step counts");
+    const double limit = m_opt.maxStepRate * static_cast<double>(args[0]) / 1000.0;
+    if (static_cast<double>(std::llabs(args[1])) > limit || static_cast<double>(std::llabs(args[2])) > limit)
+    {
+        m_stats.rateViolations++;
+        return error("!0 Err: SM step rate too high");
+    }
+    enqueue(args[0] * 1000, static_cast<int>(args[1]), static_cast<int>(args[2]), m_penDown);
+    return "OK\r\n";
+}
+
+std::string EbbSimulator::lowLevelMove(const std::vector<int64_t> &args)
+{
+    // LM,rate1,steps1,accel1,rate2,steps2,accel2[,clear]
+    if (args.size() < 6 || args[0] < 0 || args[3] < 0 || args[0] >= 2147483648LL || args[3] >= 2147483648LL)
+        return error("!8 Err: LM needs rate1,steps1,accel1,rate2,steps2,accel2");
+    double peak1 = 0.0, peak2 = 0.0;
+    const int64_t t1 = lowLevelTicks(args[1], args[0], args[2], peak1);
+    const int64_t t2 = lowLevelTicks(args[4], args[3], args[5], peak2);
+    if (t1 < 0 || t2 < 0)
+    {
+        m_stats.stalls++;
+        return error("!0 Err: LM move never completes");
+    }
+    if (std::max(peak1, peak2) > m_opt.maxStepRate * 1.001)
+    {
+        m_stats.rateViolations++;
+        return error("!0 Err: LM step rate too high");
+    }
+    enqueue(std::max(t1, t2) * kUsPerTick, static_cast<int>(args[1]), static_cast<int>(args[4]), m_penDown);
+    return "OK\r\n";
+}
+
+std::string EbbSimulator::emergencyStop()
+{
+    // Reply: interrupted,fifoSteps1,fifoSteps2,stepsLeft1,stepsLeft2
+    const int64_t now = m_clock.nowUs();
+    retire(now);
+    int interrupted = 0;
+    int64_t left1 = 0, left2 = 0, fifo1 = 0, fifo2 = 0;
+    int64_t at1 = m_pos1, at2 = m_pos2;
+    bool cut = false;
+    for (const Motion &m : m_queue)
+    {
+        if (m.startUs <= now)
+        {
+            // Running: it stops where it is now
+            const double frac = static_cast<double>(now - m.startUs) / static_cast<double>(std::max<int64_t>(1, m.endUs - m.startUs));
+            const int64_t done1 = std::llround(m.steps1 * frac), done2 = std::llround(m.steps2 * frac);
+            at1 = m.from1 + done1;
+            at2 = m.from2 + done2;
+            left1 = m.steps1 - done1;
+            left2 = m.steps2 - done2;
+            interrupted = 1;
+            cut = true;
+        }
+        else
+        {
+            if (!cut)
+            {
+                at1 = m.from1;
+                at2 = m.from2;
+                cut = true;
+            }
+            fifo1 += m.steps1;
+            fifo2 += m.steps2;
+        }
+    }
+    m_queue.clear();
+    m_pos1 = at1;
+    m_pos2 = at2;
+    m_busyUntilUs = now;
+    m_hadMotion = false;
+    if (m_opt.recordTrajectory)
+    {
+        while (m_trajectory.size() > 1 && m_trajectory.back().tMs > static_cast<double>(now) / 1000.0) m_trajectory.pop_back();
+        const float spm = static_cast<float>(m_opt.stepsPerMm);
+        m_trajectory.push_back({static_cast<double>(now) / 1000.0, 0.5f * static_cast<float>(m_pos1 - m_pos2) / spm,
+                                0.5f * static_cast<float>(m_pos1 + m_pos2) / spm, m_penDown});
+    }
+    return std::to_string(interrupted) + "," + std::to_string(fifo1) + "," + std::to_string(fifo2) + "," +
+           std::to_string(left1) + "," + std::to_string(left2) + "\r\nOK\r\n";
+}
+
+void EbbSimulator::runUntilIdle()
+{
+    m_clock.waitUntilUs(m_busyUntilUs);
+    retire(m_clock.nowUs());
+}
+
+#ifdef __linux__
+EbbPtyServer::~EbbPtyServer()
+{
+    stop();
+}
+
+bool EbbPtyServer::start(std::string *errorOut)
+{
+    stop();
+    auto fail = [&](const char *what) {
+        if (errorOut) *errorOut = std::string(what) + " failed: " + std::strerror(errno);
+        stop();
+        return false;
+    };
+    m_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (m_master < 0) return fail("posix_openpt");
+    if (grantpt(m_master) != 0 || unlockpt(m_master) != 0) return fail("grantpt/unlockpt");
+    char name[128];
+    if (ptsname_r(m_master, name, sizeof(name)) != 0) return fail("ptsname_r");
+    m_path = name;
+
+    // Raw from the start, so nothing is echoed or translated before a client sets it up
+    m_slave = ::open(name, O_RDWR | O_NOCTTY);
+    if (m_slave < 0) return fail("open pty slave");
+    termios tio{};
+    if (tcgetattr(m_slave, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(m_slave, TCSANOW, &tio);
+    }
+    fcntl(m_master, F_SETFL, fcntl(m_master, F_GETFL) | O_NONBLOCK);
+
+    m_stop.store(false);
+    m_thread = std::thread([this]() { serve(); });
+    return true;
+}
+
+void EbbPtyServer::stop()
+{
+    m_stop.store(true);
+    if (m_thread.joinable())
+        m_thread.join();
+    if (m_slave >= 0)
+        ::close(m_slave);
+    if (m_master >= 0)
+        ::close(m_master);
+    m_slave = m_master = -1;
+}
+
+void EbbPtyServer::serve()
+{
+    char buf[512];
+    while (!m_stop.load())
+    {
+        pollfd pfd{m_master, POLLIN, 0};
+        if (::poll(&pfd, 1, 20) <= 0)
+            continue;
+        const ssize_t n = ::read(m_master, buf, sizeof(buf));
+        if (n <= 0)
+            continue;
+        const std::string reply = m_sim.feed(std::string_view(buf, static_cast<size_t>(n)));
+        size_t sent = 0;
+        while (sent < reply.size() && !m_stop.load())
+        {
+            const ssize_t w = ::write(m_master, reply.data() + sent, reply.size() - sent);
+            if (w > 0)
+            {
+                sent += static_cast<size_t>(w);
+                continue;
+            }
+            pollfd out{m_master, POLLOUT, 0};
+            ::poll(&out, 1, 20);
+        }
+    }
+}
+#endif
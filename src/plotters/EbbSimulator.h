@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Time source for EbbSimulator. A manual clock (the default) only moves when the
+// simulator or its driver moves it, so hours of plotting simulate in moments. A clock
+// with a wall scale follows the steady clock (1.0 is real time), for serving the
+// simulator to host code that paces itself by the wall clock.
+class VirtualClock
+{
+public:
+    VirtualClock() = default;
+    explicit VirtualClock(double wallScale);
+
+    bool isManual() const { return m_scale <= 0.0; }
+    int64_t nowUs() const;
+    double nowMs() const { return static_cast<double>(nowUs()) / 1000.0; }
+
+    // Manual: jump to t. Scaled: sleep until t. Never moves backwards.
+    void waitUntilUs(int64_t t);
+    void advanceUs(int64_t dt) { waitUntilUs(nowUs() + dt); }
+
+private:
+    double m_scale{0.0};
+    int64_t m_manualUs{0};
+    std::chrono::steady_clock::time_point m_wallStart{};
+};
+
+// Simulated EiBotBoard for tests and benchmarks without an AxiDraw on the bench.
+//
+// Parses the commands the app sends (SC, SP, SM, LM, EM, R, ES, QM, V) and answers them
+// like EBB firmware 3.x. Motion (SM, LM and SP servo moves) goes through a FIFO of
+// fifoDepth commands behind the running one; a motion command that finds it full holds
+// up the parser, and so the reply, until a slot frees. Step rates are checked per axis,
+// LM moves are timed from their rate/accel registers, and the pen position is recorded
+// at the end of every motion command. With servoMoveMs set the pen servo moves over
+// time instead of snapping, and paperMm counts the motion made with the tip touching.
+class EbbSimulator
+{
+public:
+    struct Options
+    {
+        int fifoDepth{3};             // motion commands that may wait behind the running one
+        double maxStepRate{25000.0};  // steps/s per axis
+        int stepsPerMm{80};           // for the trajectory; x = (m1 - m2) / 2, y = (m1 + m2) / 2
+        bool recordTrajectory{true};
+        int servoMoveMs{0};           // full up/down servo move; 0 moves it instantly
+        double contactFraction{0.3};  // the tip touches below this fraction of the move
+    };
+
+    // Where a motion command left the pen, and whether it was down while getting there
+    struct TrajectoryPoint
+    {
+        double tMs{0.0};
+        float xMm{0.0f};
+        float yMm{0.0f};
+        bool penDown{false};
+    };
+
+    struct Stats
+    {
+        int64_t commands{0};
+        int64_t motionCommands{0}; // SM, LM and SP
+        int64_t bytesIn{0};
+        int errors{0};             // commands answered with "!"
+        int rateViolations{0};     // moves rejected for exceeding maxStepRate
+        int stalls{0};             // LM moves that would never finish their steps
+        int fifoFullWaits{0};      // motion commands that waited for a FIFO slot
+        int idleGaps{0};           // motion that arrived after the previous one had finished
+        double idleGapMs{0.0};
+        double busyMs{0.0};        // motion and servo time
+        double paperMm{0.0};       // moved with the pen tip on the paper
+    };
+
+    EbbSimulator();
+    explicit EbbSimulator(Options opt, VirtualClock clock = VirtualClock());
+
+    // One command without its CR; returns the reply lines, each ending in CR LF
+    std::string handle(std::string_view line);
+    // Raw bytes holding any number of CR (or LF) terminated commands
+    std::string feed(std::string_view bytes);
+
+    // When everything queued so far will be done
+    double busyUntilMs() const { return static_cast<double>(m_busyUntilUs) / 1000.0; }
+    void runUntilIdle();
+
+    VirtualClock &clock() { return m_clock; }
+    const Stats &stats() const { return m_stats; }
+    const std::vector<TrajectoryPoint> &trajectory() const { return m_trajectory; }
+
+    // Motor positions (steps) and pen state once the queued motion is done
+    int64_t motor1Position() const { return m_pos1; }
+    int64_t motor2Position() const { return m_pos2; }
+    bool penIsDown() const { return m_penDown; }
+
+    // Clear stats and trajectory, e.g. between jobs; idle time until the next motion
+    // does not count as a gap
+    void resetStats();
+
+private:
+    struct Motion
+    {
+        int64_t startUs{0};
+        int64_t endUs{0};
+        int64_t from1{0};
+        int64_t from2{0};
+        int steps1{0};
+        int steps2{0};
+    };
+
+    std::string error(const std::string &msg);
+    void retire(int64_t nowUs);
+    int waiting(int64_t nowUs) const;
+    int64_t enqueue(int64_t durationUs, int steps1, int steps2, bool penDown); // returns the start
+    double servoAt(int64_t tUs) const;
+    double paperFraction(int64_t fromUs, int64_t toUs, bool penDown) const;
+    std::string stepperMove(const std::vector<int64_t> &args);
+    std::string lowLevelMove(const std::vector<int64_t> &args);
+    std::string emergencyStop();
+
+    Options m_opt;
+    VirtualClock m_clock;
+    Stats m_stats{};
+    std::vector<TrajectoryPoint> m_trajectory;
+    std::deque<Motion> m_queue; // not yet finished; the front may be running
+    std::string m_rx;           // partial command from feed()
+    int64_t m_busyUntilUs{0};
+    int64_t m_pos1{0};
+    int64_t m_pos2{0};
+    bool m_penDown{false};
+    bool m_hadMotion{false};
+    // Servo position (0 down, 1 up) moving from m_servoFrom towards m_servoTo
+    double m_servoFrom{1.0};
+    double m_servoTo{1.0};
+    int64_t m_servoStartUs{0};
+};
+
+#ifdef __linux__
+// Serves a simulator on a pseudo-terminal, so SerialController and AxiDrawController
+// talk to it through the real tty path. The simulator normally gets a scaled clock
+// (VirtualClock(1.0)). Leave the simulator alone until stop().
+class EbbPtyServer
+{
+public:
+    explicit EbbPtyServer(EbbSimulator &sim) : m_sim(sim) {}
+    ~EbbPtyServer();
+
+    bool start(std::string *errorOut = nullptr);
+    void stop();
+
+    // Slave device to connect to, e.g. "/dev/pts/5"
+    const std::string &devicePath() const { return m_path; }
+
+private:
+    void serve();
+
+    EbbSimulator &m_sim;
+    int m_master{-1};
+    int m_slave{-1}; // held open so the pty survives clients coming and going
+    std::string m_path;
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+};
+#endif
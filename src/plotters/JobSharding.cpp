@@ -0,0 +1,235 @@
+#include "plotters/JobSharding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "utils/PathOrdering.h"
+
+namespace
+{
+
+// Rough per-path cost on top of drawing: a lift and lower (as the path ordering models
+// them) and a short travel
+float pathOverheadMs(const PlotterConfig &cfg)
+{
+    return TravelCostModel::fromConfig(cfg).penLiftS * 1000.0f + 100.0f;
+}
+
+// Visits the segments of a path, closing it if needed
+template <typename Fn>
+void forEachSegment(const PathView &path, Fn &&fn)
+{
+    const size_t n = path.points.size();
+    for (size_t k = 0; k + 1 < n; ++k) fn(path.points[k], path.points[k + 1]);
+    if (path.closed && n > 2) fn(path.points[n - 1], path.points[0]);
+}
+
+// Strip edges x[0] < ... < x[devices] that keep the slowest strip as fast as possible.
+// A strip costs its drawing time plus the overhead of every path that touches it, since
+// a path cut at an edge is lifted and lowered again in each strip it crosses.
+std::vector<float> balancedEdges(const PathSet &paths, int devices, float minX, float maxX, const PlotterConfig &cfg)
+{
+    constexpr int kBins = 1024;
+    const float width = std::max(1e-3f, maxX - minX);
+    const float binW = width / kBins;
+    // Prefix sums over bins: drawing time, and paths ending before / starting before a bin
+    std::vector<double> draw(kBins + 1, 0.0);
+    std::vector<int> endsBefore(kBins + 1, 0), startsBefore(kBins + 1, 0);
+    auto bin = [&](float x) { return std::clamp(static_cast<int>((x - minX) / binW), 0, kBins - 1); };
+
+    const double msPerMm = 1000.0 / std::max(1.0f, cfg.drawSpeedMmPerS);
+    int pathCount = 0;
+    for (const PathView &path : paths)
+    {
+        if (path.points.empty()) continue;
+        float lo = path.points[0].x, hi = lo;
+        for (const Vec2 &p : path.points)
+        {
+            lo = std::min(lo, p.x);
+            hi = std::max(hi, p.x);
+        }
+        startsBefore[bin(lo) + 1]++;
+        endsBefore[bin(hi) + 1]++;
+        ++pathCount;
+        forEachSegment(path, [&](const Vec2 &a, const Vec2 &b) {
+            const double ms = std::hypot(b.x - a.x, b.y - a.y) * msPerMm;
+            const int b0 = bin(std::min(a.x, b.x)), b1 = bin(std::max(a.x, b.x));
+            // Spread evenly over the bins the segment crosses
+            for (int i = b0; i <= b1; ++i) draw[i + 1] += ms / (b1 - b0 + 1);
+        });
+    }
+    for (int i = 0; i < kBins; ++i)
+    {
+        draw[i + 1] += draw[i];
+        endsBefore[i + 1] += endsBefore[i];
+        startsBefore[i + 1] += startsBefore[i];
+    }
+
+    const double overhead = pathOverheadMs(cfg);
+    // Bins [i, j)
+    auto stripCost = [&](int i, int j) {
+        const int touching = pathCount - endsBefore[i] - (pathCount - startsBefore[j]);
+        return draw[j] - draw[i] + overhead * touching;
+    };
+    // Greedy strips no slower than limit; the end bin of each but the last
+    auto cut = [&](double limit) {
+        std::vector<int> ends;
+        int i = 0;
+        while (i < kBins)
+        {
+            int j = i + 1;
+            while (j < kBins && stripCost(i, j + 1) <= limit) ++j;
+            ends.push_back(j);
+            i = j;
+        }
+        return ends;
+    };
+
+    double lo = 0.0, hi = stripCost(0, kBins);
+    for (int it = 0; it < 50; ++it)
+    {
+        const double mid = 0.5 * (lo + hi);
+        if (static_cast<int>(cut(mid).size()) <= devices)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    const std::vector<int> ends = cut(hi);
+
+    std::vector<float> edges{minX};
+    for (size_t k = 0; k + 1 < ends.size() && static_cast<int>(edges.size()) < devices; ++k)
+        edges.push_back(minX + binW * static_cast<float>(ends[k]));
+    while (static_cast<int>(edges.size()) < devices) edges.push_back(maxX);
+    edges.push_back(maxX);
+    return edges;
+}
+
+// Appends the parts of path that lie in x0 <= x < x1 (x0 <= x <= x1 for the last strip),
+// shifted left by shift. Strips share their edges, so whatever lies exactly on an edge
+// goes to the strip on its right and is plotted once.
+void clipToStrip(const PathView &path, int entity, float x0, float x1, bool lastStrip, float shift, JobShard &out)
+{
+    auto emit = [&](std::vector<Vec2> &piece) {
+        if (piece.size() >= 2)
+        {
+            for (const Vec2 &p : piece) out.paths.addPoint(Vec2(p.x - shift, p.y));
+            out.paths.endPath(false);
+            out.pathEntity.push_back(entity);
+        }
+        piece.clear();
+    };
+
+    if (path.points.size() == 1)
+    {
+        // Dots go to exactly one strip
+        const float x = path.points[0].x;
+        if (x >= x0 && (x < x1 || lastStrip))
+        {
+            out.paths.addPoint(Vec2(x - shift, path.points[0].y));
+            out.paths.endPath(false);
+            out.pathEntity.push_back(entity);
+        }
+        return;
+    }
+
+    // Paths entirely inside keep their shape (and closedness). A point on x1 counts as
+    // outside, so a path touching x1 goes through the clipper, which leaves any segment
+    // lying on x1 to the next strip.
+    bool inside = true;
+    for (const Vec2 &p : path.points)
+        inside = inside && p.x >= x0 && (p.x < x1 || lastStrip);
+    if (inside)
+    {
+        for (const Vec2 &p : path.points) out.paths.addPoint(Vec2(p.x - shift, p.y));
+        out.paths.endPath(path.closed);
+        out.pathEntity.push_back(entity);
+        return;
+    }
+
+    std::vector<Vec2> piece;
+    forEachSegment(path, [&](const Vec2 &a, const Vec2 &b) {
+        const float dx = b.x - a.x;
+        float t0 = 0.0f, t1 = 1.0f;
+        if (std::abs(dx) < 1e-9f)
+        {
+            if (a.x < x0 || a.x > x1 || (a.x == x1 && !lastStrip))
+            {
+                emit(piece);
+                return;
+            }
+        }
+        else
+        {
+            const float ta = (x0 - a.x) / dx, tb = (x1 - a.x) / dx;
+            t0 = std::max(0.0f, std::min(ta, tb));
+            t1 = std::min(1.0f, std::max(ta, tb));
+            // Only touching an edge leaves nothing to draw
+            if (t0 >= t1)
+            {
+                emit(piece);
+                return;
+            }
+        }
+        const Vec2 p = a + (b - a) * t0;
+        const Vec2 q = a + (b - a) * t1;
+        if (piece.empty() || t0 > 0.0f)
+        {
+            emit(piece);
+            piece.push_back(p);
+        }
+        piece.push_back(q);
+        if (t1 < 1.0f) emit(piece);
+    });
+    emit(piece);
+}
+
+} // namespace
+
+std::vector<JobShard> shardJob(const PathSet &pagePaths, const std::vector<int> &pathEntity, int devices,
+                               ShardMode mode, const PlotterConfig &cfg)
+{
+    devices = std::max(1, devices);
+    std::vector<JobShard> shards(static_cast<size_t>(devices));
+    if (pagePaths.empty())
+        return shards;
+
+    if (mode == ShardMode::Copy || devices == 1)
+    {
+        for (JobShard &s : shards)
+        {
+            s.paths = pagePaths;
+            s.pathEntity = pathEntity;
+        }
+        return shards;
+    }
+
+    float minX = pagePaths.points[0].x, maxX = minX;
+    for (const Vec2 &p : pagePaths.points)
+    {
+        minX = std::min(minX, p.x);
+        maxX = std::max(maxX, p.x);
+    }
+
+    std::vector<float> edges;
+    if (mode == ShardMode::Balanced)
+    {
+        edges = balancedEdges(pagePaths, devices, minX, maxX, cfg);
+    }
+    else
+    {
+        for (int i = 0; i <= devices; ++i) edges.push_back(minX + (maxX - minX) * static_cast<float>(i) / devices);
+    }
+
+    for (int d = 0; d < devices; ++d)
+    {
+        JobShard &s = shards[static_cast<size_t>(d)];
+        s.offsetXMm = edges[d] - minX;
+        for (size_t i = 0; i < pagePaths.size(); ++i)
+        {
+            const int entity = i < pathEntity.size() ? pathEntity[i] : -1;
+            clipToStrip(pagePaths[i], entity, edges[d], edges[d + 1], d == devices - 1, s.offsetXMm, s);
+        }
+    }
+    return shards;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "core/Pathset.h"
+#include "plotters/PlotterConfig.h"
+
+// Splitting one plot job across several plotters.
+//
+// Tiles and Balanced cut the job into vertical strips, clipping paths at the strip
+// edges. Every strip is shifted left so that it starts where the whole job started,
+// i.e. each device plots its strip on its own sheet with the job's original margins.
+
+enum class ShardMode
+{
+    Copy,     // every device plots the whole job (an edition)
+    Tiles,    // strips of equal width
+    Balanced, // strips sized for about the same plot time on every device
+};
+
+struct JobShard
+{
+    PathSet paths;               // page mm, already shifted onto the device's sheet
+    std::vector<int> pathEntity; // entity of each path
+    float offsetXMm{0.0f};       // page x of the strip = sheet x + offsetXMm
+};
+
+// One shard per device. A strip with nothing in it comes back empty.
+std::vector<JobShard> shardJob(const PathSet &pagePaths, const std::vector<int> &pathEntity, int devices,
+                               ShardMode mode, const PlotterConfig &cfg);
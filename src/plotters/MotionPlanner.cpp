@@ -25,261 +25,515 @@ static inline float vInitial_VF_A_Dx_safe(float vf, float accel, float dx) {
     return term > 0.0f ? std::sqrt(term) : 0.0f;
 }
 
-} // namespace
+// S-curve (jerk-limited) speed change by dv: jerk up to 'accel', hold, jerk back to zero,
+// or a pure jerk up / jerk down when dv is too small to reach 'accel'
+static inline float sCurveRampTime(float dv, float accel, float jerk) {
+    dv = std::fabs(dv);
+    if (dv >= accel * accel / jerk) return dv / accel + accel / jerk;
+    return 2.0f * std::sqrt(dv / jerk);
+}
 
-std::vector<MoveSlice> planPath(const PlannerSettings &s,
-                                const std::vector<Vec2> &pointsPageMm,
-                                bool penUp,
-                                const Vec2 &startMm)
+// The ramp is point-symmetric in time, so it covers the average speed times its duration
+static inline float sCurveRampDist(float v0, float v1, float accel, float jerk) {
+    return 0.5f * (v0 + v1) * sCurveRampTime(v1 - v0, accel, jerk);
+}
+
+// Highest speed (<= vCap) that an S-curve ramp starting at v0 reaches within dist. Ramps
+// are reversible, so this is also the highest speed that can brake to v0 within dist.
+static float sCurveReach(float v0, float accel, float jerk, float dist, float vCap) {
+    if (vCap <= v0 || sCurveRampDist(v0, vCap, accel, jerk) <= dist) return vCap;
+    float lo = v0, hi = vCap;
+    for (int k = 0; k < 24; ++k) {
+        const float mid = 0.5f * (lo + hi);
+        if (sCurveRampDist(v0, mid, accel, jerk) <= dist) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+static inline bool useSCurve(const PlannerSettings &s) {
+    return s.sCurve && s.jerkMmPerS3 > 0.0f && !s.lowLevelMoves;
+}
+
+// Samples a jerk-limited profile vi -> peak -> vf over dist as (time, position) pairs:
+// timeSlice apart while accelerating, coarser while cruising. Returns false when vi and
+// vf are too far apart for dist, leaving the caller to use the trapezoid.
+static bool sCurveSamples(float vi, float vf, float speedLimit, float accel, float jerk,
+                          float dist, float timeSlice,
+                          std::vector<std::pair<float, float>> &samples)
 {
-    std::vector<MoveSlice> moves;
-    if (pointsPageMm.size() < 2) return moves;
+    const float vLow = std::max(vi, vf);
+    if (sCurveRampDist(vi, vLow, accel, jerk) + sCurveRampDist(vLow, vf, accel, jerk) > dist * 1.001f)
+        return false;
 
-    // Build trimmed vertices and unit direction vectors
-    const float minDist = s.minSegmentMm;
-    std::vector<Vec2> verts;
-    verts.reserve(pointsPageMm.size());
-    verts.push_back(pointsPageMm.front());
-    for (size_t i = 1; i < pointsPageMm.size(); ++i) {
-        const Vec2 &last = verts.back();
-        const Vec2 &v = pointsPageMm[i];
-        float dx = v.x - last.x;
-        float dy = v.y - last.y;
-        float d = std::hypot(dx, dy);
-        if (d >= minDist) verts.push_back(v);
+    // Peak speed: the limit if there is room to cruise, else the highest that fits
+    float vp = speedLimit;
+    auto rampsDist = [&](float v) { return sCurveRampDist(vi, v, accel, jerk) + sCurveRampDist(v, vf, accel, jerk); };
+    if (rampsDist(speedLimit) > dist) {
+        float lo = vLow, hi = speedLimit;
+        for (int k = 0; k < 24; ++k) {
+            const float mid = 0.5f * (lo + hi);
+            if (rampsDist(mid) <= dist) lo = mid; else hi = mid;
+        }
+        vp = lo;
     }
-    if (verts.size() < 2) return moves;
 
-    const float speedLimit = penUp ? s.speedPenUpMmPerS : s.speedPenDownMmPerS;
-    const float accel = penUp ? s.accelPenUpMmPerS2 : s.accelPenDownMmPerS2;
-    // Junction deviation model: treat s.cornering as jd in mm
-    const float jd = std::max(0.0f, s.cornering);
-    const float vJunctionFloor = (static_cast<float>(s.junctionSpeedFloorPercent) / 100.0f) * speedLimit;
-    const float timeSlice = static_cast<float>(s.timeSliceMs) / 1000.0f;
+    // Phases of constant jerk
+    struct Phase { float t; float j; };
+    std::vector<Phase> phases;
+    auto ramp = [&](float v0, float v1) {
+        const float dv = std::fabs(v1 - v0);
+        if (dv <= 0.0f) return;
+        const float sj = v1 > v0 ? jerk : -jerk;
+        if (dv >= accel * accel / jerk) {
+            phases.push_back({accel / jerk, sj});
+            phases.push_back({dv / accel - accel / jerk, 0.0f});
+            phases.push_back({accel / jerk, -sj});
+        } else {
+            const float t = std::sqrt(dv / jerk);
+            phases.push_back({t, sj});
+            phases.push_back({t, -sj});
+        }
+    };
+    ramp(vi, vp);
+    const size_t cruiseAt = phases.size();
+    const float cruiseDist = dist - rampsDist(vp);
+    if (cruiseDist > 0.0f && vp > 0.0f) phases.push_back({cruiseDist / vp, 0.0f});
+    const size_t cruiseEnd = phases.size();
+    ramp(vp, vf);
 
-    // Segment lengths and unit vectors
-    const size_t segCount = verts.size() - 1;
-    std::vector<float> segLen(segCount);
-    std::vector<Vec2> segDir(segCount);
-    for (size_t i = 0; i < segCount; ++i) {
-        float dx = verts[i + 1].x - verts[i].x;
-        float dy = verts[i + 1].y - verts[i].y;
-        float d = std::hypot(dx, dy);
-        segLen[i] = d;
-        if (d > 0.0f) segDir[i] = Vec2(dx / d, dy / d); else segDir[i] = Vec2(1.0f, 0.0f);
+    double t = 0.0, p = 0.0, v = vi, a = 0.0;
+    for (size_t k = 0; k < phases.size(); ++k) {
+        const Phase &ph = phases[k];
+        if (ph.t <= 0.0f) continue;
+        const bool cruise = k >= cruiseAt && k < cruiseEnd;
+        const float step = cruise ? 20.0f * timeSlice : timeSlice;
+        const int n = std::max(1, static_cast<int>(std::ceil(ph.t / step)));
+        const double dt = static_cast<double>(ph.t) / n;
+        for (int i = 0; i < n; ++i) {
+            p += v * dt + a * dt * dt / 2.0 + ph.j * dt * dt * dt / 6.0;
+            v += a * dt + ph.j * dt * dt / 2.0;
+            a += ph.j * dt;
+            t += dt;
+            samples.emplace_back(static_cast<float>(t), static_cast<float>(p));
+        }
     }
+    return !samples.empty();
+}
 
-    // Precompute junction caps based on junction deviation
-    const size_t N = verts.size();
-    std::vector<float> vJunctionMax(N, speedLimit);
-    for (size_t i = 1; i + 1 < N; ++i) {
-        size_t idxIn = i - 1;
-        size_t idxOut = i;
-        float dot = segDir[idxIn].x * segDir[idxOut].x + segDir[idxIn].y * segDir[idxOut].y;
-        dot = clampf(dot, -1.0f, 1.0f);
-        float sinHalf = std::sqrt(std::max(0.0f, 0.5f * (1.0f - dot)));
-        float vMax = speedLimit;
-        if (sinHalf > 1e-6f && jd > 0.0f) {
-            float R = jd * (1.0f + sinHalf) / (1.0f - sinHalf);
-            vMax = std::sqrt(std::max(0.0f, accel * R));
+// One straight move as up to three LM phases (accelerate, cruise, decelerate)
+static void lowLevelSegment(const PlannerSettings &s,
+                            int a_steps_total, int b_steps_total,
+                            float vi, float vf, float speedLimit, float accel,
+                            std::vector<MoveSlice> &moves)
+{
+    const float spm = static_cast<float>(s.stepsPerMm);
+    const float dx = 0.5f * static_cast<float>(a_steps_total + b_steps_total) / spm;
+    const float dy = 0.5f * static_cast<float>(a_steps_total - b_steps_total) / spm;
+    const float len = std::hypot(dx, dy);
+    if (len <= 0.0f) return;
+
+    // Keep the busier motor within maxStepRatePerAxis
+    const float stepsPerMmBusy = static_cast<float>(std::max(std::abs(a_steps_total), std::abs(b_steps_total))) / len;
+    const float vCap = std::min(speedLimit, static_cast<float>(s.maxStepRatePerAxis) / std::max(1e-6f, stepsPerMmBusy));
+    vi = std::min(vi, vCap);
+    vf = std::min(vf, vCap);
+    accel = std::max(1e-3f, accel);
+
+    struct Phase { float dist; float v0; float v1; };
+    Phase phases[3];
+    int count = 0;
+    const float dAcc = (vCap * vCap - vi * vi) / (2.0f * accel);
+    const float dDec = (vCap * vCap - vf * vf) / (2.0f * accel);
+    if (dAcc + dDec <= len) {
+        phases[count++] = {dAcc, vi, vCap};
+        phases[count++] = {len - dAcc - dDec, vCap, vCap};
+        phases[count++] = {dDec, vCap, vf};
+    } else {
+        const float vp = std::sqrt(0.5f * (2.0f * accel * len + vi * vi + vf * vf));
+        if (vp <= std::max(vi, vf)) {
+            // Junction speeds that the segment cannot honour at this accel: one ramp
+            phases[count++] = {len, vi, vf};
+        } else {
+            const float d1 = clampf((vp * vp - vi * vi) / (2.0f * accel), 0.0f, len);
+            phases[count++] = {d1, vi, vp};
+            phases[count++] = {len - d1, vp, vf};
         }
-        // Apply optional floor
-        vMax = std::max(vMax, vJunctionFloor);
-        vJunctionMax[i] = clampf(vMax, 0.0f, speedLimit);
     }
 
-    // Forward pass (pure kinematics + junction caps)
-    std::vector<float> vAtVertex(N, 0.0f);
-    vAtVertex[0] = 0.0f;
-    for (size_t i = 1; i < N; ++i) {
-        float vFromAccel = std::sqrt(std::max(0.0f, vAtVertex[i - 1] * vAtVertex[i - 1] + 2.0f * accel * segLen[i - 1]));
-        float cap = (i < N - 1) ? std::min(speedLimit, vJunctionMax[i]) : 0.0f;
-        vAtVertex[i] = std::min(vFromAccel, cap);
+    int doneA = 0, doneB = 0;
+    float along = 0.0f;
+    double ticksDone = 0.0;
+    int msDone = 0;
+    for (int k = 0; k < count; ++k) {
+        const Phase &ph = phases[k];
+        if (ph.dist <= 0.0f) continue;
+        along += ph.dist;
+        const float frac = (k == count - 1) ? 1.0f : std::min(1.0f, along / len);
+        const int destA = roundToInt(frac * static_cast<float>(a_steps_total));
+        const int destB = roundToInt(frac * static_cast<float>(b_steps_total));
+        const int sA = destA - doneA;
+        const int sB = destB - doneB;
+        if (sA == 0 && sB == 0) continue;
+        doneA = destA;
+        doneB = destB;
+
+        const float vSum = std::max(1e-6f, ph.v0 + ph.v1);
+        const double seconds = 2.0 * ph.dist / vSum;
+        const int ticks = std::max(1, static_cast<int>(std::lround(seconds * kLmTickHz)));
+        ticksDone += ticks;
+        const int msNow = static_cast<int>(std::lround(ticksDone * 1000.0 / kLmTickHz));
+
+        MoveSlice m;
+        m.lowLevel = true;
+        // Map native B to controller axis: axis2 = -B
+        m.aSteps = sA;
+        m.bSteps = -sB;
+        m.dtMs = std::max(1, msNow - msDone);
+        msDone = msNow;
+        const LowLevelAxis ra = lowLevelAxis(sA, ticks, ph.v0, ph.v1);
+        const LowLevelAxis rb = lowLevelAxis(sB, ticks, ph.v0, ph.v1);
+        m.rateA = ra.rate;
+        m.accelA = ra.accel;
+        m.rateB = rb.rate;
+        m.accelB = rb.accel;
+        moves.push_back(m);
     }
+}
 
-    // Backward pass
-    for (size_t i = N - 1; i > 0; --i) {
-        float vFromDecel = std::sqrt(std::max(0.0f, vAtVertex[i] * vAtVertex[i] + 2.0f * accel * segLen[i - 1]));
-        float cap = (i - 1 > 0) ? std::min(speedLimit, vJunctionMax[i - 1]) : 0.0f;
-        vAtVertex[i - 1] = std::min(vAtVertex[i - 1], std::min(vFromDecel, cap));
+// Time-slices one straight move of a_steps_total / b_steps_total native CoreXY steps,
+// entered at vi and left at vf (mm/s), within speedLimit and accel.
+static void sliceSegment(const PlannerSettings &s,
+                         int a_steps_total, int b_steps_total,
+                         float vi, float vf, float speedLimit, float accel,
+                         std::vector<MoveSlice> &moves)
+{
+    if (s.lowLevelMoves) {
+        lowLevelSegment(s, a_steps_total, b_steps_total, vi, vf, speedLimit, accel, moves);
+        return;
     }
+    const float timeSlice = static_cast<float>(s.timeSliceMs) / 1000.0f;
 
-    // Emit slices per segment
-    Vec2 current = startMm;
-    int prevA = 0, prevB = 0;
-    int cumA = 0, cumB = 0;
-    int cumT = 0;
-
-    for (size_t i = 0; i < segCount; ++i) {
-        const Vec2 target = verts[i + 1];
-        const float vi = clampf(vAtVertex[i], 0.0f, speedLimit);
-        const float vf = clampf(vAtVertex[i + 1], 0.0f, speedLimit);
-
-        // Segment vector
-        float dx = target.x - current.x;
-        float dy = target.y - current.y;
-        float segLenIn = std::hypot(dx, dy);
-        if (segLenIn <= 0.0f) continue;
-
-        // Map to CoreXY native distances (mm)
-        float a_mm = dx + dy; // A axis (dx+dy)
-        float b_mm = dx - dy; // B axis (dx-dy)
-        // Steps per axis
-        int a_steps_total = roundToInt(s.stepsPerMm * a_mm);
-        int b_steps_total = roundToInt(s.stepsPerMm * b_mm);
-        if (std::abs(a_steps_total) < 1 && std::abs(b_steps_total) < 1) {
-            current = target;
-            continue;
-        }
+    // Rounded mm accomplished by those steps
+    float a_mm_round = static_cast<float>(a_steps_total) / static_cast<float>(s.stepsPerMm);
+    float b_mm_round = static_cast<float>(b_steps_total) / static_cast<float>(s.stepsPerMm);
+    float dx_round = 0.5f * (a_mm_round + b_mm_round);
+    float dy_round = 0.5f * (a_mm_round - b_mm_round);
+    float segLenRound = std::hypot(dx_round, dy_round);
 
-        // Rounded mm accomplished by those steps
-        float a_mm_round = static_cast<float>(a_steps_total) / static_cast<float>(s.stepsPerMm);
-        float b_mm_round = static_cast<float>(b_steps_total) / static_cast<float>(s.stepsPerMm);
-        float dx_round = 0.5f * (a_mm_round + b_mm_round);
-        float dy_round = 0.5f * (a_mm_round - b_mm_round);
-        
-        float segLenRound = std::hypot(dx_round, dy_round);
-        if (segLenRound <= 0.0f) segLenRound = segLenIn;
-
-        // Trapezoidal/triangular time slicing
-        float tAccelMax = (speedLimit - vi) / std::max(1e-6f, accel);
-        float tDecelMax = (speedLimit - vf) / std::max(1e-6f, accel);
-        float accelDistMax = vi * tAccelMax + 0.5f * accel * tAccelMax * tAccelMax;
-        float decelDistMax = vf * tDecelMax + 0.5f * accel * tDecelMax * tDecelMax;
-        float timeElapsed = 0.0f;
-        float pos = 0.0f;
-        float vel = vi;
-
-        std::vector<int> durationArray;
-        std::vector<float> distArray;
-
-        auto pushSlice = [&](float t, float p) {
-            durationArray.push_back(std::max(1, roundToInt(t * 1000.0f)));
-            distArray.push_back(p);
-        };
+    // Trapezoidal/triangular time slicing
+    float tAccelMax = (speedLimit - vi) / std::max(1e-6f, accel);
+    float tDecelMax = (speedLimit - vf) / std::max(1e-6f, accel);
+    float accelDistMax = vi * tAccelMax + 0.5f * accel * tAccelMax * tAccelMax;
+    float decelDistMax = vf * tDecelMax + 0.5f * accel * tDecelMax * tDecelMax;
+    float timeElapsed = 0.0f;
+    float pos = 0.0f;
+    float vel = vi;
 
-        if ((segLenRound > (accelDistMax + decelDistMax + timeSlice * speedLimit))) {
-            // Accel phase
-            int intervalsUp = static_cast<int>(std::floor(tAccelMax / timeSlice));
-            if (intervalsUp > 0) {
-                float timePer = tAccelMax / static_cast<float>(intervalsUp);
-                float velStep = (speedLimit - vi) / (static_cast<float>(intervalsUp) + 1.0f);
-                for (int k = 0; k < intervalsUp; ++k) {
-                    vel += velStep;
-                    timeElapsed += timePer;
-                    pos += vel * timePer;
-                    pushSlice(timeElapsed, pos);
-                }
-            }
-            // Cruise phase
-            float coastDist = segLenRound - (accelDistMax + decelDistMax);
-            if (coastDist > (timeSlice * speedLimit)) {
-                vel = speedLimit;
-                float ct = coastDist / vel;
-                float cruiseInterval = 20.0f * timeSlice;
-                while (ct > cruiseInterval) {
-                    ct -= cruiseInterval;
-                    timeElapsed += cruiseInterval;
-                    pos += vel * cruiseInterval;
-                    pushSlice(timeElapsed, pos);
-                }
-                timeElapsed += ct;
-                pos += vel * ct;
+    std::vector<int> durationArray;
+    std::vector<float> distArray;
+
+    auto pushSlice = [&](float t, float p) {
+        durationArray.push_back(std::max(1, roundToInt(t * 1000.0f)));
+        distArray.push_back(p);
+    };
+
+    std::vector<std::pair<float, float>> samples;
+    if (useSCurve(s) && sCurveSamples(vi, vf, speedLimit, accel, s.jerkMmPerS3, segLenRound, timeSlice, samples)) {
+        // Jerk-limited profile
+        for (const auto &sm : samples) pushSlice(sm.first, sm.second);
+        pos = samples.back().second;
+    } else if ((segLenRound > (accelDistMax + decelDistMax + timeSlice * speedLimit))) {
+        // Accel phase
+        int intervalsUp = static_cast<int>(std::floor(tAccelMax / timeSlice));
+        if (intervalsUp > 0) {
+            float timePer = tAccelMax / static_cast<float>(intervalsUp);
+            float velStep = (speedLimit - vi) / (static_cast<float>(intervalsUp) + 1.0f);
+            for (int k = 0; k < intervalsUp; ++k) {
+                vel += velStep;
+                timeElapsed += timePer;
+                pos += vel * timePer;
                 pushSlice(timeElapsed, pos);
             }
-            // Decel phase
-            int intervalsDown = static_cast<int>(std::floor(tDecelMax / timeSlice));
-            if (intervalsDown > 0) {
-                float timePer = tDecelMax / static_cast<float>(intervalsDown);
-                float velStep = (speedLimit - vf) / (static_cast<float>(intervalsDown) + 1.0f);
-                for (int k = 0; k < intervalsDown; ++k) {
-                    vel -= velStep;
-                    timeElapsed += timePer;
-                    pos += vel * timePer;
-                    pushSlice(timeElapsed, pos);
-                }
+        }
+        // Cruise phase
+        float coastDist = segLenRound - (accelDistMax + decelDistMax);
+        if (coastDist > (timeSlice * speedLimit)) {
+            vel = speedLimit;
+            float ct = coastDist / vel;
+            float cruiseInterval = 20.0f * timeSlice;
+            while (ct > cruiseInterval) {
+                ct -= cruiseInterval;
+                timeElapsed += cruiseInterval;
+                pos += vel * cruiseInterval;
+                pushSlice(timeElapsed, pos);
             }
-        } else {
-            // Triangle/linear fallback
-            float accelLocal = accel;
-            // analytical minimal profile ensuring vf at end
-            float ta = accelLocal > 0 ? (std::sqrt(std::max(0.0f, 2 * vi * vi + 2 * vf * vf + 4 * accelLocal * segLenRound)) - 2 * vi) / (2 * accelLocal) : 0.0f;
-            float vmax = vi + accelLocal * ta;
-            int intervalsUp = static_cast<int>(std::floor(ta / timeSlice));
-            if (intervalsUp > 0) {
-                float timePer = ta / static_cast<float>(intervalsUp);
-                float velStep = (vmax - vi) / (static_cast<float>(intervalsUp) + 1.0f);
-                for (int k = 0; k < intervalsUp; ++k) {
-                    vel += velStep;
-                    timeElapsed += timePer;
-                    pos += vel * timePer;
-                    pushSlice(timeElapsed, pos);
-                }
+            timeElapsed += ct;
+            pos += vel * ct;
+            pushSlice(timeElapsed, pos);
+        }
+        // Decel phase
+        int intervalsDown = static_cast<int>(std::floor(tDecelMax / timeSlice));
+        if (intervalsDown > 0) {
+            float timePer = tDecelMax / static_cast<float>(intervalsDown);
+            float velStep = (speedLimit - vf) / (static_cast<float>(intervalsDown) + 1.0f);
+            for (int k = 0; k < intervalsDown; ++k) {
+                vel -= velStep;
+                timeElapsed += timePer;
+                pos += vel * timePer;
+                pushSlice(timeElapsed, pos);
             }
-            float td = accelLocal > 0 ? ta - (vf - vi) / accelLocal : 0.0f;
-            int intervalsDown = static_cast<int>(std::floor(td / timeSlice));
-            if (intervalsDown > 0) {
-                float timePer = td / static_cast<float>(intervalsDown);
-                float velStep = (vmax - vf) / (static_cast<float>(intervalsDown) + 1.0f);
-                for (int k = 0; k < intervalsDown; ++k) {
-                    vel -= velStep;
-                    timeElapsed += timePer;
-                    pos += vel * timePer;
-                    pushSlice(timeElapsed, pos);
-                }
+        }
+    } else {
+        // Triangle/linear fallback
+        float accelLocal = accel;
+        // analytical minimal profile ensuring vf at end
+        float ta = accelLocal > 0 ? (std::sqrt(std::max(0.0f, 2 * vi * vi + 2 * vf * vf + 4 * accelLocal * segLenRound)) - 2 * vi) / (2 * accelLocal) : 0.0f;
+        float vmax = vi + accelLocal * ta;
+        int intervalsUp = static_cast<int>(std::floor(ta / timeSlice));
+        if (intervalsUp > 0) {
+            float timePer = ta / static_cast<float>(intervalsUp);
+            float velStep = (vmax - vi) / (static_cast<float>(intervalsUp) + 1.0f);
+            for (int k = 0; k < intervalsUp; ++k) {
+                vel += velStep;
+                timeElapsed += timePer;
+                pos += vel * timePer;
+                pushSlice(timeElapsed, pos);
             }
-            if (durationArray.empty()) {
-                // constant fallback
-                float v = std::max(vi, std::max(vf, speedLimit * 0.1f));
-                float t = segLenRound / std::max(1e-6f, v);
-                timeElapsed = t;
-                pos = segLenRound;
+        }
+        float td = accelLocal > 0 ? ta - (vf - vi) / accelLocal : 0.0f;
+        int intervalsDown = static_cast<int>(std::floor(td / timeSlice));
+        if (intervalsDown > 0) {
+            float timePer = td / static_cast<float>(intervalsDown);
+            float velStep = (vmax - vf) / (static_cast<float>(intervalsDown) + 1.0f);
+            for (int k = 0; k < intervalsDown; ++k) {
+                vel -= velStep;
+                timeElapsed += timePer;
+                pos += vel * timePer;
                 pushSlice(timeElapsed, pos);
             }
         }
+        if (durationArray.empty()) {
+            // constant fallback
+            float v = std::max(vi, std::max(vf, speedLimit * 0.1f));
+            float t = segLenRound / std::max(1e-6f, v);
+            timeElapsed = t;
+            pos = segLenRound;
+            pushSlice(timeElapsed, pos);
+        }
+    }
 
-        // Map to per-slice steps and dtMs
-        int prev1 = 0, prev2 = 0;
-        int prevT = 0;
-        for (size_t si = 0; si < distArray.size(); ++si) {
-            float frac = pos > 0.0f ? distArray[si] / pos : 1.0f;
-            int dest1 = roundToInt(frac * static_cast<float>(a_steps_total));
-            int dest2 = roundToInt(frac * static_cast<float>(b_steps_total));
-            int sA = dest1 - prev1;
-            int sB = dest2 - prev2;
-            int dt = durationArray[si] - prevT;
-            if (dt < 1) dt = 1;
-
-            // Overspeed guard (maxStepRatePerAxis in steps/second)
-            auto stepsAllowed = [&](int dtMs) {
-                return static_cast<int>(std::floor(static_cast<float>(s.maxStepRatePerAxis) * (static_cast<float>(dtMs) / 1000.0f)));
-            };
-            int maxSteps = stepsAllowed(dt);
-            while ((std::abs(sA) > maxSteps) || (std::abs(sB) > maxSteps)) {
-                dt += 1;
-                maxSteps = stepsAllowed(dt);
-            }
+    // Map to per-slice steps and dtMs
+    int prev1 = 0, prev2 = 0;
+    int prevT = 0;
+    for (size_t si = 0; si < distArray.size(); ++si) {
+        float frac = pos > 0.0f ? distArray[si] / pos : 1.0f;
+        int dest1 = roundToInt(frac * static_cast<float>(a_steps_total));
+        int dest2 = roundToInt(frac * static_cast<float>(b_steps_total));
+        int sA = dest1 - prev1;
+        int sB = dest2 - prev2;
+        int dt = durationArray[si] - prevT;
+        if (dt < 1) dt = 1;
 
-            prev1 = dest1;
-            prev2 = dest2;
-            prevT = durationArray[si];
-
-            if (sA != 0 || sB != 0) {
-                // Map native B to controller axis: axis2 = -B
-                int axis1 = sA;
-                int axis2 = -sB;
-                cumA += axis1;
-                cumB += axis2;
-                cumT += dt;
-                moves.push_back(MoveSlice{axis1, axis2, dt});
-            }
+        // Overspeed guard (maxStepRatePerAxis in steps/second)
+        auto stepsAllowed = [&](int dtMs) {
+            return static_cast<int>(std::floor(static_cast<float>(s.maxStepRatePerAxis) * (static_cast<float>(dtMs) / 1000.0f)));
+        };
+        int maxSteps = stepsAllowed(dt);
+        while ((std::abs(sA) > maxSteps) || (std::abs(sB) > maxSteps)) {
+            dt += 1;
+            maxSteps = stepsAllowed(dt);
+        }
+
+        prev1 = dest1;
+        prev2 = dest2;
+        prevT = durationArray[si];
+
+        if (sA != 0 || sB != 0) {
+            // Map native B to controller axis: axis2 = -B
+            moves.push_back(MoveSlice{sA, -sB, dt});
         }
+    }
+}
+
+} // namespace
+
+LowLevelAxis lowLevelAxis(int steps, int ticks, float v0, float v1)
+{
+    LowLevelAxis r;
+    if (steps == 0 || ticks <= 0) return r;
+    // Tick k (1..N) adds rate_k = R0 + k * A to a 31-bit accumulator and steps on each
+    // overflow, so N ticks take (N * R0 + A * N (N + 1) / 2) / 2^31 steps. Solve for the
+    // speed shape v0 : v1 and (|steps| + 1/2) steps.
+    const double kOne = 2147483648.0; // 2^31
+    const double N = static_cast<double>(ticks);
+    const double target = (std::abs(static_cast<double>(steps)) + 0.5) * kOne;
+    const double tri = N * (N + 1.0) / 2.0;
+    double w0 = std::max(0.0f, v0), w1 = std::max(0.0f, v1);
+    if (w0 + w1 <= 0.0) w0 = w1 = 1.0;
+    const double scale = target / (N * w0 + (w1 - w0) * (N + 1.0) / 2.0);
+    double accel = std::round(scale * (w1 - w0) / N);
+    double rate = std::round((target - accel * tri) / N);
+    if (rate < 0.0) rate = 0.0;
+    // The rate must not go negative before the last tick
+    if (rate + accel * N < 0.0) accel = std::ceil(-rate / N);
+    const double kMaxRate = kOne - 1.0;
+    r.rate = static_cast<uint32_t>(std::min(rate, kMaxRate));
+    r.accel = static_cast<int32_t>(std::clamp(accel, -2147483648.0, 2147483647.0));
+    return r;
+}
 
-        current = target;
+void MotionStream::reset(const Vec2 &posMm)
+{
+    m_verts.assign(1, posMm);
+    m_segs.clear();
+    m_caps.assign(1, 0.0f);
+    m_vStart = 0.0f;
+    m_hasTail = false;
+    m_stepA = roundToInt(static_cast<float>(m_settings.stepsPerMm) * (posMm.x + posMm.y));
+    m_stepB = roundToInt(static_cast<float>(m_settings.stepsPerMm) * (posMm.x - posMm.y));
+}
+
+void MotionStream::add(Span<const Vec2> pointsPageMm, bool penUp)
+{
+    const float minDist = m_settings.minSegmentMm;
+    for (const Vec2 &p : pointsPageMm) {
+        const Vec2 &last = m_verts.back();
+        const float d = std::hypot(p.x - last.x, p.y - last.y);
+        if (d <= 0.0f) continue;
+        if (d >= minDist) {
+            pushVertex(p, penUp);
+            m_hasTail = false;
+        } else {
+            m_tail = p;
+            m_tailPenUp = penUp;
+            m_hasTail = true;
+        }
     }
+}
 
-    (void)prevA; (void)prevB; (void)cumA; (void)cumB; (void)cumT;
-    return moves;
+void MotionStream::pushVertex(const Vec2 &p, bool penUp)
+{
+    const PlannerSettings &s = m_settings;
+    const Vec2 from = m_verts.back();
+    Segment seg;
+    const float dx = p.x - from.x;
+    const float dy = p.y - from.y;
+    seg.len = std::hypot(dx, dy);
+    seg.dir = seg.len > 0.0f ? Vec2(dx / seg.len, dy / seg.len) : Vec2(1.0f, 0.0f);
+    seg.speed = penUp ? s.speedPenUpMmPerS : s.speedPenDownMmPerS;
+    seg.accel = penUp ? s.accelPenUpMmPerS2 : s.accelPenDownMmPerS2;
+
+    // The old end becomes a junction: cap its speed by junction deviation (s.cornering
+    // as jd in mm) under the tighter limits of the two segments
+    if (!m_segs.empty()) {
+        const Segment &in = m_segs.back();
+        const float speedLimit = std::min(in.speed, seg.speed);
+        const float accel = std::min(in.accel, seg.accel);
+        const float jd = std::max(0.0f, s.cornering);
+        float dot = in.dir.x * seg.dir.x + in.dir.y * seg.dir.y;
+        dot = clampf(dot, -1.0f, 1.0f);
+        float sinHalf = std::sqrt(std::max(0.0f, 0.5f * (1.0f - dot)));
+        float vMax = speedLimit;
+        if (sinHalf > 1e-6f && jd > 0.0f) {
+            float R = jd * (1.0f + sinHalf) / (1.0f - sinHalf);
+            vMax = std::sqrt(std::max(0.0f, accel * R));
+        }
+        // Apply optional floor
+        vMax = std::max(vMax, (static_cast<float>(s.junctionSpeedFloorPercent) / 100.0f) * speedLimit);
+        m_caps.back() = clampf(vMax, 0.0f, speedLimit);
+    }
+
+    m_segs.push_back(seg);
+    m_verts.push_back(p);
+    m_caps.push_back(0.0f);
+}
+
+void MotionStream::flushReady(std::vector<MoveSlice> &out)
+{
+    if (m_segs.empty()) return;
+    const PlannerSettings &s = m_settings;
+    const float vMax = std::max(s.speedPenDownMmPerS, s.speedPenUpMmPerS);
+    const float aMin = std::min(s.accelPenDownMmPerS2, s.accelPenUpMmPerS2);
+    if (aMin <= 0.0f) return;
+    const float brake = useSCurve(s) ? sCurveRampDist(vMax, 0.0f, aMin, s.jerkMmPerS3)
+                                     : vMax * vMax / (2.0f * aMin);
+
+    // Vertices at least a full braking distance before the end are settled
+    float dist = 0.0f;
+    for (size_t i = m_segs.size(); i-- > 0;) {
+        dist += m_segs[i].len;
+        if (dist >= brake) {
+            emit(i, false, out);
+            return;
+        }
+    }
 }
 
+void MotionStream::finish(std::vector<MoveSlice> &out)
+{
+    if (m_hasTail) {
+        // Go all the way to the last point, even if it was too close to keep as a vertex
+        pushVertex(m_tail, m_tailPenUp);
+        m_hasTail = false;
+    }
+    emit(m_segs.size(), true, out);
+}
+
+void MotionStream::emit(size_t count, bool toRest, std::vector<MoveSlice> &out)
+{
+    const size_t N = m_verts.size();
+    if (count == 0 || N < 2) return;
+
+    // Forward pass (kinematics + junction caps), assuming a stop at the end of the window
+    std::vector<float> v(N, 0.0f);
+    v[0] = m_vStart;
+    const bool sCurve = useSCurve(m_settings);
+    const float jerk = m_settings.jerkMmPerS3;
+    auto reach = [&](float v0, const Segment &sg) {
+        return sCurve ? sCurveReach(v0, sg.accel, jerk, sg.len, sg.speed) : vFinal_Vi_A_Dx(v0, sg.accel, sg.len);
+    };
+    for (size_t i = 1; i < N; ++i) {
+        const Segment &sg = m_segs[i - 1];
+        float vFromAccel = reach(v[i - 1], sg);
+        float cap = (i < N - 1) ? m_caps[i] : 0.0f;
+        v[i] = std::min(vFromAccel, cap);
+    }
+    // Backward pass; v[0] is already committed
+    for (size_t i = N - 1; i > 1; --i) {
+        const Segment &sg = m_segs[i - 1];
+        v[i - 1] = std::min(v[i - 1], reach(v[i], sg));
+    }
+
+    const float spm = static_cast<float>(m_settings.stepsPerMm);
+    for (size_t i = 0; i < count; ++i) {
+        const Vec2 &target = m_verts[i + 1];
+        const int a = roundToInt(spm * (target.x + target.y));
+        const int b = roundToInt(spm * (target.x - target.y));
+        if (a == m_stepA && b == m_stepB) continue;
+        const Segment &sg = m_segs[i];
+        sliceSegment(m_settings, a - m_stepA, b - m_stepB,
+                     clampf(v[i], 0.0f, sg.speed), clampf(v[i + 1], 0.0f, sg.speed),
+                     sg.speed, sg.accel, out);
+        m_stepA = a;
+        m_stepB = b;
+    }
 
+    m_vStart = toRest ? 0.0f : v[count];
+    m_verts.erase(m_verts.begin(), m_verts.begin() + count);
+    m_segs.erase(m_segs.begin(), m_segs.begin() + count);
+    m_caps.erase(m_caps.begin(), m_caps.begin() + count);
+}
+
+std::vector<MoveSlice> planPath(const PlannerSettings &s,
+                                Span<const Vec2> pointsPageMm,
+                                bool penUp,
+                                const Vec2 &startMm)
+{
+    std::vector<MoveSlice> moves;
+    if (pointsPageMm.size() < 2) return moves;
+    MotionStream stream(s);
+    stream.reset(startMm);
+    stream.add(pointsPageMm, penUp);
+    stream.finish(moves);
+    return moves;
+}
@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "core/Vec2.h"
+#include "core/Span.h"
 
 struct PlannerSettings {
     // Kinematic limits (mm units)
@@ -17,19 +18,109 @@ struct PlannerSettings {
     int maxStepRatePerAxis{8000}; // steps/second
     float minSegmentMm{0.05f};
     int stepsPerMm{80};
+    // Jerk-limited (7-segment S-curve) speed changes instead of trapezoids
+    bool sCurve{false};
+    float jerkMmPerS3{20000.0f};
+    // Emit one EBB low-level move (LM) per accel/cruise/decel phase instead of SM time
+    // slices. LM accelerates linearly, so S-curve settings are ignored in this mode.
+    bool lowLevelMoves{false};
 };
 
 struct MoveSlice {
     int aSteps{0};
     int bSteps{0};
     int dtMs{1};
+    // Low-level move (LM) instead of SM: per-axis rate and acceleration registers at the
+    // EBB's 25 kHz step clock. dtMs is then the duration rounded to ms, for timing.
+    bool lowLevel{false};
+    uint32_t rateA{0};
+    uint32_t rateB{0};
+    int32_t accelA{0};
+    int32_t accelB{0};
 };
 
-// Plans time-sliced CoreXY motor step deltas (A,B) to traverse the given points.
-// pointsPageMm must have at least 2 vertices.
+// EBB LM register scales: a rate register of 1 is 25000 / 2^31 steps/s, and the
+// acceleration register is added to the rate once per 25 kHz tick.
+constexpr double kLmTickHz = 25000.0;
+constexpr double kLmRatePerStepsPerS = 85899.34592;                          // 2^31 / 25000
+constexpr double kLmAccelPerStepsPerS2 = kLmRatePerStepsPerS / kLmTickHz;     // 2^31 / 25000^2
+
+struct LowLevelAxis {
+    uint32_t rate{0};
+    int32_t accel{0};
+};
+
+// Registers that make one axis take exactly |steps| steps within 'ticks' ticks while its
+// speed changes linearly in the ratio v0 : v1 (any units). The last step lands half a
+// step before the end, so a phase that ends at rest still completes.
+LowLevelAxis lowLevelAxis(int steps, int ticks, float v0, float v1);
+
+// Plans time-sliced CoreXY motor step deltas (A,B) to traverse the given points,
+// starting and ending at rest. pointsPageMm must have at least 2 vertices.
 std::vector<MoveSlice> planPath(const PlannerSettings &s,
-                                const std::vector<Vec2> &pointsPageMm,
+                                Span<const Vec2> pointsPageMm,
                                 bool penUp,
                                 const Vec2 &startMm);
 
+// Streaming planner with lookahead across polylines.
+//
+// Polylines are added one after another and continue from where the previous one ended;
+// the carriage only has to stop where finish() is called (e.g. before a pen up or down).
+// Junction speeds between consecutive polylines follow the same cornering rule as inside
+// one, and each segment keeps the speed and acceleration limits of the polyline it came
+// from (pen-up or pen-down). Slices are handed out as soon as no later input can change
+// them: a vertex farther than the worst-case braking distance from the end of what has
+// been added is final.
+//
+// Positions are tracked in whole motor steps, so rounding does not drift over a job.
+class MotionStream {
+public:
+    MotionStream() = default;
+    explicit MotionStream(const PlannerSettings &s) : m_settings(s) {}
+
+    // Limits for segments added from now on
+    void setSettings(const PlannerSettings &s) { m_settings = s; }
+
+    // Forget everything and stand still at posMm
+    void reset(const Vec2 &posMm);
+
+    // Where the carriage ends up after everything added so far
+    const Vec2 &position() const { return m_hasTail ? m_tail : m_verts.back(); }
+
+    // True when nothing is waiting to be planned
+    bool idle() const { return m_segs.empty() && !m_hasTail; }
+
+    // Continue from position() through the points (a leading point equal to position() is
+    // skipped). Points closer than minSegmentMm to the previous one are merged.
+    void add(Span<const Vec2> pointsPageMm, bool penUp);
+
+    // Append slices that are final
+    void flushReady(std::vector<MoveSlice> &out);
+
+    // Come to rest at position() and append all remaining slices
+    void finish(std::vector<MoveSlice> &out);
+
+private:
+    struct Segment {
+        float len{0.0f};
+        Vec2 dir;
+        float speed{0.0f};
+        float accel{0.0f};
+    };
+
+    void pushVertex(const Vec2 &p, bool penUp);
+    void emit(size_t count, bool toRest, std::vector<MoveSlice> &out);
+
+    PlannerSettings m_settings;
+    std::vector<Vec2> m_verts{Vec2(0.0f, 0.0f)}; // m_verts[0] is where the next slice starts
+    std::vector<Segment> m_segs;                // m_segs[i] runs m_verts[i] -> m_verts[i + 1]
+    std::vector<float> m_caps{0.0f};            // cornering speed cap per vertex
+    float m_vStart{0.0f};                       // speed at m_verts[0]
+    Vec2 m_tail;                                // last point if merged away, kept for finish()
+    bool m_hasTail{false};
+    bool m_tailPenUp{false};
+    int m_stepA{0};                             // committed position in native A/B steps
+    int m_stepB{0};
+};
+
 
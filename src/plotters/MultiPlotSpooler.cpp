@@ -0,0 +1,138 @@
+#include "plotters/MultiPlotSpooler.h"
+
+#include <algorithm>
+#include <glog/logging.h>
+
+#include "plotters/PlotProgramCache.h"
+
+MultiPlotSpooler::MultiPlotSpooler(const std::vector<Device> &devices)
+{
+    for (const Device &d : devices)
+    {
+        if (d.serial && d.axidraw)
+            m_spoolers.push_back(std::make_unique<PlotSpooler>(*d.serial, *d.axidraw));
+    }
+}
+
+MultiPlotSpooler::~MultiPlotSpooler()
+{
+    cancel();
+}
+
+bool MultiPlotSpooler::startJob(const PageModel &page, const PlotterConfig &cfg, ShardMode mode, bool liftPen,
+                                std::string *errorOut)
+{
+    PathSet pagePaths;
+    std::vector<int> pathEntity;
+    PlotProgramCache::gatherPaths(page, std::nullopt, pagePaths, pathEntity);
+    return startPaths(pagePaths, pathEntity, cfg, mode, liftPen, errorOut);
+}
+
+bool MultiPlotSpooler::startPaths(const PathSet &pagePaths, const std::vector<int> &pathEntity,
+                                  const PlotterConfig &cfg, ShardMode mode, bool liftPen, std::string *errorOut)
+{
+    if (isRunning())
+    {
+        if (errorOut) *errorOut = "A job is already running";
+        return false;
+    }
+    if (m_spoolers.empty() || pagePaths.empty())
+    {
+        if (errorOut) *errorOut = m_spoolers.empty() ? "No devices" : "Nothing to plot";
+        return false;
+    }
+
+    // Compile every shard before starting any device, so they all start together.
+    // Copies share one cached program.
+    const std::vector<JobShard> shards = shardJob(pagePaths, pathEntity, static_cast<int>(m_spoolers.size()), mode, cfg);
+    const PlotCompileOptions opt = PlotSpooler::compileOptions(liftPen);
+    std::vector<std::shared_ptr<const PlotProgram>> programs;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        std::shared_ptr<const PlotProgram> prog;
+        if (!shards[i].paths.empty())
+            prog = PlotProgramCache::instance().get(shards[i].paths, shards[i].pathEntity, cfg, opt);
+        if (prog)
+        {
+            LOG(INFO) << "MultiPlotSpooler: device " << i << " gets " << shards[i].paths.size() << " paths, "
+                      << prog->totals().totalMs / 1000.0 << " s";
+        }
+        programs.push_back(std::move(prog));
+    }
+    return startPrograms(programs, cfg, errorOut);
+}
+
+bool MultiPlotSpooler::startPrograms(const std::vector<std::shared_ptr<const PlotProgram>> &programs,
+                                     const PlotterConfig &cfg, std::string *errorOut)
+{
+    if (isRunning())
+    {
+        if (errorOut) *errorOut = "A job is already running";
+        return false;
+    }
+    int started = 0;
+    for (size_t i = 0; i < m_spoolers.size() && i < programs.size(); ++i)
+    {
+        if (!programs[i]) continue;
+        if (!m_spoolers[i]->startProgram(programs[i], cfg))
+        {
+            // All or nothing: stop the devices already going
+            cancel();
+            if (errorOut) *errorOut = "Device " + std::to_string(i) + " could not start";
+            return false;
+        }
+        ++started;
+    }
+    if (started == 0)
+    {
+        if (errorOut) *errorOut = "Nothing to plot";
+        return false;
+    }
+    return true;
+}
+
+void MultiPlotSpooler::pause()
+{
+    for (auto &s : m_spoolers) s->pause();
+}
+
+void MultiPlotSpooler::resume()
+{
+    for (auto &s : m_spoolers) s->resume();
+}
+
+void MultiPlotSpooler::cancel()
+{
+    for (auto &s : m_spoolers) s->cancel();
+}
+
+bool MultiPlotSpooler::isRunning() const
+{
+    return std::any_of(m_spoolers.begin(), m_spoolers.end(), [](const auto &s) { return s->isRunning(); });
+}
+
+MultiPlotSpooler::Stats MultiPlotSpooler::stats() const
+{
+    Stats out;
+    PlotSpooler::Stats &t = out.total;
+    for (const auto &s : m_spoolers)
+    {
+        const PlotSpooler::Stats d = s->stats();
+        out.devices.push_back(d);
+        if (s->isRunning()) out.devicesRunning++;
+        t.commandsQueued += d.commandsQueued;
+        t.commandsSent += d.commandsSent;
+        t.plannedPenDownMm += d.plannedPenDownMm;
+        t.donePenDownMm += d.donePenDownMm;
+        t.queuedMs += d.queuedMs;
+        t.plannedMs += d.plannedMs;
+        t.doneMs += d.doneMs;
+        t.penOverlapMs += d.penOverlapMs;
+        t.underruns += d.underruns;
+        t.underrunMs += d.underrunMs;
+        t.elapsedMs = std::max(t.elapsedMs, d.elapsedMs);
+        t.etaMs = std::max(t.etaMs, d.etaMs);
+    }
+    t.percentComplete = t.plannedMs > 0 ? std::min(1.0f, static_cast<float>(t.doneMs) / static_cast<float>(t.plannedMs)) : 0.0f;
+    return out;
+}
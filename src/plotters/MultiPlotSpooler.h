@@ -0,0 +1,56 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Page.h"
+#include "plotters/JobSharding.h"
+#include "plotters/PlotSpooler.h"
+
+// Streams one job to several AxiDraws at once.
+//
+// The job is split with shardJob() and every device gets its own PlotSpooler, so each
+// one plans and streams on its own threads. The controllers stay owned by the caller.
+class MultiPlotSpooler
+{
+public:
+    struct Device
+    {
+        SerialController *serial{nullptr};
+        AxiDrawController *axidraw{nullptr};
+    };
+
+    // Counts, lengths and plannedMs/doneMs are summed over devices; elapsedMs and etaMs
+    // are those of the slowest device
+    struct Stats
+    {
+        PlotSpooler::Stats total;
+        std::vector<PlotSpooler::Stats> devices;
+        int devicesRunning{0};
+    };
+
+    explicit MultiPlotSpooler(const std::vector<Device> &devices);
+    ~MultiPlotSpooler();
+
+    size_t deviceCount() const { return m_spoolers.size(); }
+
+    bool startJob(const PageModel &page, const PlotterConfig &cfg, ShardMode mode, bool liftPen = true,
+                  std::string *errorOut = nullptr);
+    // Same for paths already in page space, with the entity of each path
+    bool startPaths(const PathSet &pagePaths, const std::vector<int> &pathEntity, const PlotterConfig &cfg,
+                    ShardMode mode, bool liftPen = true, std::string *errorOut = nullptr);
+    // One compiled program per device; a null program leaves that device idle
+    bool startPrograms(const std::vector<std::shared_ptr<const PlotProgram>> &programs, const PlotterConfig &cfg,
+                       std::string *errorOut = nullptr);
+
+    void pause();
+    void resume();
+    void cancel();
+
+    bool isRunning() const;
+    Stats stats() const;
+
+private:
+    std::vector<std::unique_ptr<PlotSpooler>> m_spoolers;
+};
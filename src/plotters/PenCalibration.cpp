@@ -0,0 +1,66 @@
+#include "plotters/PenCalibration.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "utils/PathOrdering.h"
+
+namespace
+{
+
+int servoMs(const PlotterConfig &cfg)
+{
+    return static_cast<int>(std::lround(TravelCostModel::fromConfig(cfg).penMoveS * 1000.0f));
+}
+
+float rowFraction(int row, int rows)
+{
+    return rows > 1 ? static_cast<float>(std::clamp(row, 0, rows - 1)) / static_cast<float>(rows - 1) : 0.0f;
+}
+
+} // namespace
+
+PlotterConfig penOverlapRowConfig(const PlotterConfig &cfg, int row, int rows)
+{
+    PlotterConfig out = cfg;
+    const float f = rowFraction(row, rows);
+    const int ms = servoMs(cfg);
+    out.penOverlap = f > 0.0f;
+    out.penLiftClearMs = static_cast<int>(std::lround(ms * (1.0f - f)));
+    out.penDropLeadMs = static_cast<int>(std::lround(ms * f));
+    return out;
+}
+
+void applyPenOverlapCalibration(PlotterConfig &cfg, int cleanLiftRow, int cleanDropRow, int rows)
+{
+    cfg.penLiftClearMs = penOverlapRowConfig(cfg, cleanLiftRow, rows).penLiftClearMs;
+    cfg.penDropLeadMs = penOverlapRowConfig(cfg, cleanDropRow, rows).penDropLeadMs;
+    cfg.penOverlap = true;
+}
+
+std::shared_ptr<PlotProgram> compilePenOverlapCard(const PlotterConfig &cfg, const PenOverlapCard &card,
+                                                   const PlotCompileOptions &opt)
+{
+    // Rows are compiled on their own, in order, each with its own overlap
+    PlotCompileOptions rowOpt = opt;
+    rowOpt.liftPen = true;
+    rowOpt.refineBudgetMs = 0.0;
+    std::vector<std::shared_ptr<const PlotProgram>> rows;
+    for (int r = 0; r < card.rows; ++r)
+    {
+        PathSet ps;
+        const float y = card.origin.y + card.rowPitchMm * static_cast<float>(r);
+        for (int t = 0; t < card.ticks; ++t)
+        {
+            const float x = card.origin.x + card.pitchMm * static_cast<float>(t);
+            ps.addPath(std::vector<Vec2>{Vec2(x, y), Vec2(x, y + card.tickMm)});
+        }
+        const std::vector<int> entity(ps.size(), r);
+        auto row = PlotProgram::compile(ps, entity, penOverlapRowConfig(cfg, r, card.rows), rowOpt);
+        if (!row)
+            return nullptr;
+        rows.push_back(std::move(row));
+    }
+    return PlotProgram::concatenate(rows);
+}
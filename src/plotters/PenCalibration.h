@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include "core/Vec2.h"
+#include "plotters/PlotProgram.h"
+#include "plotters/PlotterConfig.h"
+
+// Test card for the pen overlap settings (PlotterConfig::penOverlap).
+//
+// Each row is a line of short vertical ticks with a long travel between them, and hides
+// more of the servo move than the row above: row r of n hides f = r / (n - 1) of it, so
+// lifts wait (1 - f) of the move before travelling and drops start f of it before the
+// travel ends. Row 0 does not overlap at all. Where a lift is too early the tick drags
+// a tail towards the next one; where a drop is too early a streak runs into the next
+// tick. The last clean row for each gives that pen's settings.
+
+struct PenOverlapCard
+{
+    int rows{8};
+    int ticks{6};
+    float tickMm{6.0f};       // tick length
+    float pitchMm{25.0f};     // between ticks, long enough to hide a whole servo move
+    float rowPitchMm{12.0f};
+    Vec2 origin{20.0f, 20.0f}; // top left of the first tick, page mm
+};
+
+// 'cfg' with the overlap of the given row
+PlotterConfig penOverlapRowConfig(const PlotterConfig &cfg, int row, int rows);
+
+// Sets penLiftClearMs and penDropLeadMs from the last row without lift tails and the
+// last row without drop streaks, and turns the overlap on
+void applyPenOverlapCalibration(PlotterConfig &cfg, int cleanLiftRow, int cleanDropRow, int rows);
+
+// The whole card as one job, rows in order; the paths of row r belong to entity r
+std::shared_ptr<PlotProgram> compilePenOverlapCard(const PlotterConfig &cfg, const PenOverlapCard &card = {},
+                                                   const PlotCompileOptions &opt = {});
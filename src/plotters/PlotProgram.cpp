@@ -0,0 +1,776 @@
+#include "plotters/PlotProgram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include "utils/PathOrdering.h"
+#include "utils/ThreadPool.h"
+
+namespace
+{
+
+constexpr char kMagic[4] = {'M', 'T', 'P', 'G'};
+constexpr uint32_t kVersion = 3; // 2: pen commands may carry a delay; 3: draw paths after the stream
+constexpr uint32_t kNoPath = std::numeric_limits<uint32_t>::max();
+constexpr uint64_t kNoOffset = std::numeric_limits<uint64_t>::max();
+
+struct FileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t geometryHash;
+    uint64_t configHash;
+    uint64_t streamBytes;
+    uint32_t pathCount;
+    uint32_t entityCount;
+    PlotProgram::Totals totals;
+};
+static_assert(sizeof(PlotProgram::Totals) == 32, "Totals is stored as is");
+static_assert(sizeof(PlotProgram::PathEntry) == 24, "PathEntry is stored as is");
+static_assert(sizeof(PlotProgram::EntityStats) == 32, "EntityStats is stored as is");
+static_assert(sizeof(FileHeader) == 72, "FileHeader is stored as is");
+
+// Followed by pointCount points, then pathCount + 1 offsets and pathCount flags (none if
+// pathCount is 0)
+struct DrawPathsHeader
+{
+    uint32_t pathCount;
+    uint32_t pointCount;
+    int32_t stepsPerMm;
+    uint32_t liftPen;
+};
+static_assert(sizeof(DrawPathsHeader) == 16, "DrawPathsHeader is stored as is");
+static_assert(sizeof(Vec2) == 8, "Vec2 is stored as is");
+
+inline void putVarint(std::vector<uint8_t> &out, uint32_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint32_t &v)
+{
+    v = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        if (p >= end) return false;
+        const uint8_t b = *p++;
+        v |= static_cast<uint32_t>(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint32_t zigzag(int32_t v) { return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+inline int32_t unzigzag(uint32_t v) { return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+void encodeMove(std::vector<uint8_t> &out, const MoveSlice &m)
+{
+    const uint8_t op = m.lowLevel ? 3 : 0;
+    if (m.dtMs > 0 && m.dtMs < 64)
+    {
+        out.push_back(static_cast<uint8_t>(op | (m.dtMs << 2)));
+    }
+    else
+    {
+        out.push_back(op);
+        putVarint(out, static_cast<uint32_t>(std::max(0, m.dtMs)));
+    }
+    putVarint(out, zigzag(m.aSteps));
+    putVarint(out, zigzag(m.bSteps));
+    if (m.lowLevel)
+    {
+        putVarint(out, m.rateA);
+        putVarint(out, zigzag(m.accelA));
+        putVarint(out, m.rateB);
+        putVarint(out, zigzag(m.accelB));
+    }
+}
+
+void encodePen(std::vector<uint8_t> &out, bool down, int64_t delayMs, int64_t servoMs)
+{
+    const uint8_t op = down ? 2 : 1;
+    if (delayMs == servoMs)
+    {
+        out.push_back(op);
+        return;
+    }
+    out.push_back(op | 4);
+    putVarint(out, static_cast<uint32_t>(delayMs));
+}
+
+inline float sliceMm(const MoveSlice &m, int stepsPerMm)
+{
+    // Inverse of the planner's A = spm * (x + y), B = spm * (x - y)
+    const float dx = 0.5f * static_cast<float>(m.aSteps + m.bSteps);
+    const float dy = 0.5f * static_cast<float>(m.aSteps - m.bSteps);
+    return std::hypot(dx, dy) / static_cast<float>(stepsPerMm);
+}
+
+// One stretch of motion from rest to rest, made of polylines owned by paths
+struct Piece
+{
+    Span<const Vec2> points;
+    bool penUp{false};
+    uint32_t path{kNoPath}; // index into the ordered paths, or kNoPath for the return home
+};
+
+struct Run
+{
+    Vec2 start;
+    std::vector<Piece> pieces;
+    bool keepSliceStarts{false}; // a pen down may be slipped in before its end
+};
+
+struct PieceOut
+{
+    uint64_t firstByte{kNoOffset};
+    int64_t firstMs{0};
+    int64_t ms{0};
+    float mm{0.0f};
+};
+
+struct RunOut
+{
+    std::vector<uint8_t> bytes;
+    std::vector<PieceOut> pieces;
+    std::vector<std::pair<uint32_t, int64_t>> sliceStarts; // byte offset, ms; if kept
+    uint32_t commands{0};
+    int64_t ms{0};
+};
+
+// Either a run of motion or a pen command owned by a path
+struct Step
+{
+    enum class Kind { Motion, PenUp, PenDown } kind{Kind::Motion};
+    uint32_t index{0}; // run for Motion, owning path (or kNoPath) for pen commands
+};
+
+void planRun(const Run &run, const PlannerSettings &s, RunOut &out)
+{
+    MotionStream motion(s);
+    motion.reset(run.start);
+    std::vector<MoveSlice> slices;
+    // Distance along the run at the end of each piece, to attribute slices to pieces
+    std::vector<float> pieceEnd(run.pieces.size());
+    float along = 0.0f;
+    Vec2 at = run.start;
+    for (size_t i = 0; i < run.pieces.size(); ++i)
+    {
+        const Piece &pc = run.pieces[i];
+        for (const Vec2 &p : pc.points)
+        {
+            along += std::hypot(p.x - at.x, p.y - at.y);
+            at = p;
+        }
+        pieceEnd[i] = along;
+        motion.add(pc.points, pc.penUp);
+        motion.flushReady(slices);
+    }
+    motion.finish(slices);
+
+    // Slices come out in travel order; each belongs to the piece its midpoint falls in
+    out.pieces.assign(run.pieces.size(), PieceOut{});
+    out.bytes.reserve(slices.size() * 4);
+    size_t piece = 0;
+    float done = 0.0f;
+    for (const MoveSlice &m : slices)
+    {
+        const float mm = sliceMm(m, s.stepsPerMm);
+        while (piece + 1 < pieceEnd.size() && done + 0.5f * mm > pieceEnd[piece]) ++piece;
+        done += mm;
+        PieceOut &po = out.pieces[piece];
+        if (po.firstByte == kNoOffset)
+        {
+            po.firstByte = out.bytes.size();
+            po.firstMs = out.ms;
+        }
+        po.ms += m.dtMs;
+        po.mm += mm;
+        if (run.keepSliceStarts)
+            out.sliceStarts.emplace_back(static_cast<uint32_t>(out.bytes.size()), out.ms);
+        encodeMove(out.bytes, m);
+        out.ms += m.dtMs;
+        out.commands++;
+    }
+}
+
+} // namespace
+
+PlannerSettings plannerSettingsFromConfig(const PlotterConfig &cfg, int stepsPerMm)
+{
+    PlannerSettings s;
+    s.speedPenDownMmPerS = cfg.drawSpeedMmPerS;
+    s.speedPenUpMmPerS = cfg.travelSpeedMmPerS;
+    s.accelPenDownMmPerS2 = cfg.accelDrawMmPerS2;
+    s.accelPenUpMmPerS2 = cfg.accelTravelMmPerS2;
+    s.cornering = cfg.cornering;
+    s.junctionSpeedFloorPercent = cfg.junctionSpeedFloorPercent;
+    s.timeSliceMs = cfg.timeSliceMs;
+    s.maxStepRatePerAxis = cfg.maxStepRatePerAxis;
+    s.minSegmentMm = cfg.minSegmentMm;
+    s.sCurve = cfg.sCurve;
+    s.jerkMmPerS3 = cfg.jerkMmPerS3;
+    s.lowLevelMoves = cfg.lowLevelMoves;
+    s.stepsPerMm = stepsPerMm;
+    return s;
+}
+
+bool PlotProgram::Reader::next(Command &out)
+{
+    if (m_pos >= m_end)
+        return false;
+    const uint8_t tag = *m_pos++;
+    switch (tag & 3)
+    {
+    case 1:
+    case 2:
+    {
+        out.op = (tag & 3) == 1 ? Op::PenUp : Op::PenDown;
+        out.penMs = -1;
+        uint32_t delay = 0;
+        if (tag >> 2)
+        {
+            if (!getVarint(m_pos, m_end, delay)) return false;
+            out.penMs = static_cast<int>(delay);
+        }
+        return true;
+    }
+    default:
+    {
+        uint32_t dt = tag >> 2, a = 0, b = 0;
+        if (dt == 0 && !getVarint(m_pos, m_end, dt)) return false;
+        if (!getVarint(m_pos, m_end, a) || !getVarint(m_pos, m_end, b)) return false;
+        out.op = Op::Move;
+        out.move = MoveSlice{};
+        out.move.dtMs = static_cast<int>(dt);
+        out.move.aSteps = unzigzag(a);
+        out.move.bSteps = unzigzag(b);
+        if ((tag & 3) == 3)
+        {
+            uint32_t ra = 0, aa = 0, rb = 0, ab = 0;
+            if (!getVarint(m_pos, m_end, ra) || !getVarint(m_pos, m_end, aa) ||
+                !getVarint(m_pos, m_end, rb) || !getVarint(m_pos, m_end, ab))
+                return false;
+            out.move.lowLevel = true;
+            out.move.rateA = ra;
+            out.move.accelA = unzigzag(aa);
+            out.move.rateB = rb;
+            out.move.accelB = unzigzag(ab);
+        }
+        return true;
+    }
+    }
+}
+
+std::shared_ptr<PlotProgram> PlotProgram::compile(const PathSet &pagePaths, const std::vector<int> &pathEntity,
+                                                  const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                                  const std::atomic<bool> *cancel)
+{
+    const Vec2 home(0.0f, 0.0f);
+    if (pagePaths.empty())
+        return nullptr;
+
+    // Same ordering as an interactive job: greedy, then a short travel-time local search
+    std::vector<PathOrderEntry> order = orderPathsGreedy(pagePaths, home, cancel);
+    refinePathOrder(pagePaths, order, home, TravelCostModel::fromConfig(cfg), opt.refineBudgetMs, cancel);
+    if (cancel && cancel->load())
+        return nullptr;
+    PathSet paths;
+    applyPathOrder(pagePaths, order, paths);
+    std::vector<int> entity(order.size(), -1);
+    for (size_t i = 0; i < order.size(); ++i)
+        if (order[i].index < pathEntity.size()) entity[i] = pathEntity[order[i].index];
+    return plan(std::move(paths), entity, home, cfg, opt, cancel);
+}
+
+std::shared_ptr<PlotProgram> PlotProgram::plan(PathSet paths, const std::vector<int> &pathEntity, const Vec2 &from,
+                                               const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                               const std::atomic<bool> *cancel)
+{
+    const Vec2 home(0.0f, 0.0f);
+    if (paths.empty())
+        return nullptr;
+
+    // Split the job into runs that start and end at rest. With the pen lifted between
+    // strokes every travel and every chain of touching strokes is its own run; without
+    // lifting the carriage never stops, so the whole job is one run.
+    std::vector<Run> runs;
+    std::vector<Step> steps;
+    const float joinMm = 1.0f / static_cast<float>(opt.stepsPerMm);
+    auto openRun = [&](const Vec2 &start) {
+        runs.push_back(Run{start, {}});
+        steps.push_back(Step{Step::Kind::Motion, static_cast<uint32_t>(runs.size() - 1)});
+    };
+    auto pen = [&](bool down, uint32_t owner) {
+        steps.push_back(Step{down ? Step::Kind::PenDown : Step::Kind::PenUp, owner});
+    };
+
+    Vec2 pos = from;
+    bool penDown = false;
+    uint32_t lastPath = kNoPath;
+    if (opt.liftPen)
+        pen(false, kNoPath);
+    else
+        openRun(from);
+    for (uint32_t i = 0; i < paths.size(); ++i)
+    {
+        const PathView path = paths[i];
+        if (path.points.empty())
+            continue;
+        const Span<const Vec2> first(&path.points.front(), 1);
+        if (opt.liftPen)
+        {
+            const Vec2 &start = path.points.front();
+            const bool continues = penDown && std::hypot(pos.x - start.x, pos.y - start.y) < joinMm;
+            if (!continues)
+            {
+                if (penDown)
+                    pen(false, lastPath);
+                openRun(pos);
+                runs.back().pieces.push_back(Piece{first, true, i});
+                pen(true, i);
+                penDown = true;
+                openRun(start);
+            }
+        }
+        else
+        {
+            runs.back().pieces.push_back(Piece{first, true, i});
+        }
+        runs.back().pieces.push_back(Piece{path.points, false, i});
+        pos = path.points.back();
+        lastPath = i;
+    }
+    if (opt.liftPen)
+    {
+        if (penDown)
+            pen(false, lastPath);
+        openRun(pos);
+    }
+    runs.back().pieces.push_back(Piece{Span<const Vec2>(&home, 1), true, kNoPath});
+
+    // With pen overlap a pen down goes out during the travel before it
+    const bool overlap = cfg.penOverlap && opt.liftPen;
+    if (overlap)
+    {
+        for (size_t k = 1; k < steps.size(); ++k)
+        {
+            if (steps[k].kind == Step::Kind::PenDown && steps[k - 1].kind == Step::Kind::Motion)
+                runs[steps[k - 1].index].keepSliceStarts = true;
+        }
+    }
+
+    // Plan all runs in parallel
+    const PlannerSettings settings = plannerSettingsFromConfig(cfg, opt.stepsPerMm);
+    std::vector<RunOut> outs(runs.size());
+    parallelForEach(runs.size(), 1, [&](size_t r) {
+        if (cancel && cancel->load()) return;
+        planRun(runs[r], settings, outs[r]);
+    });
+    if (cancel && cancel->load())
+        return nullptr;
+
+    // Stitch the runs and pen commands together, filling in the index and statistics
+    auto prog = std::make_shared<PlotProgram>();
+    const int64_t penMs = static_cast<int64_t>(std::lround(TravelCostModel::fromConfig(cfg).penMoveS * 1000.0f));
+    size_t streamBytes = steps.size() * 3;
+    for (const RunOut &o : outs) streamBytes += o.bytes.size();
+    prog->m_bytes.reserve(streamBytes);
+    prog->m_paths.resize(paths.size());
+    for (uint32_t i = 0; i < paths.size(); ++i)
+    {
+        prog->m_paths[i].offset = kNoOffset;
+        prog->m_paths[i].entityId = i < pathEntity.size() ? pathEntity[i] : -1;
+    }
+
+    std::map<int, EntityStats> entities;
+    Totals &tot = prog->m_totals;
+    tot.penMoveMs = static_cast<uint32_t>(penMs);
+    auto claim = [&](uint32_t path, uint64_t offset, int64_t ms) -> EntityStats * {
+        if (path == kNoPath) return nullptr;
+        PathEntry &pe = prog->m_paths[path];
+        if (pe.offset == kNoOffset)
+        {
+            pe.offset = offset;
+            pe.startMs = ms;
+        }
+        EntityStats &es = entities[pe.entityId];
+        es.entityId = pe.entityId;
+        return &es;
+    };
+
+    // Pen overlap: the pen down before a run of motion is issued at the first slice
+    // boundary at most leadMs before the travel ends, and a dwell after the travel
+    // covers the rest of the servo move. The pen up before the travel only waits until
+    // the tip has cleared the paper, or longer if the servo would still be rising when
+    // the pen down goes out.
+    const int64_t clearMs = std::clamp<int64_t>(cfg.penLiftClearMs, 0, penMs);
+    const int64_t leadMs = std::clamp<int64_t>(cfg.penDropLeadMs, 0, penMs);
+    struct Drop
+    {
+        uint32_t byte{0};
+        int64_t leadMs{-1}; // -1: no pen down inside this run
+    };
+    std::vector<Drop> drops(runs.size());
+    for (size_t r = 0; r < runs.size(); ++r)
+    {
+        if (!runs[r].keepSliceStarts) continue;
+        const RunOut &o = outs[r];
+        drops[r] = Drop{static_cast<uint32_t>(o.bytes.size()), 0};
+        for (const auto &ss : o.sliceStarts)
+        {
+            if (o.ms - ss.second <= leadMs)
+            {
+                drops[r] = Drop{ss.first, o.ms - ss.second};
+                break;
+            }
+        }
+    }
+
+    std::vector<uint8_t> penBytes;
+    for (size_t k = 0; k < steps.size(); ++k)
+    {
+        const Step &st = steps[k];
+        if (st.kind != Step::Kind::Motion)
+        {
+            const bool down = st.kind == Step::Kind::PenDown;
+            if (down && k > 0 && steps[k - 1].kind == Step::Kind::Motion && drops[steps[k - 1].index].leadMs >= 0)
+                continue; // already issued inside the travel
+            int64_t delayMs = penMs;
+            if (overlap && !down && k + 1 < steps.size() && steps[k + 1].kind == Step::Kind::Motion)
+            {
+                const Drop &d = drops[steps[k + 1].index];
+                const int64_t travelMs = outs[steps[k + 1].index].ms - std::max<int64_t>(0, d.leadMs);
+                delayMs = std::clamp(penMs - travelMs, clearMs, penMs);
+            }
+            if (EntityStats *es = claim(st.index, prog->m_bytes.size(), tot.totalMs))
+            {
+                es->totalMs += delayMs;
+                if (down) es->lifts++;
+            }
+            encodePen(prog->m_bytes, down, delayMs, penMs);
+            tot.totalMs += delayMs;
+            tot.penOverlapMs += static_cast<uint32_t>(penMs - delayMs);
+            tot.commands++;
+            if (down) tot.lifts++;
+            continue;
+        }
+        const Run &run = runs[st.index];
+        const RunOut &o = outs[st.index];
+        const Drop &drop = drops[st.index];
+        penBytes.clear();
+        if (drop.leadMs >= 0)
+            encodePen(penBytes, true, 0, penMs);
+        const uint64_t base = prog->m_bytes.size();
+        for (size_t p = 0; p < run.pieces.size(); ++p)
+        {
+            const Piece &pc = run.pieces[p];
+            const PieceOut &po = o.pieces[p];
+            (pc.penUp ? tot.penUpMm : tot.penDownMm) += po.mm;
+            if (po.firstByte == kNoOffset) continue;
+            const uint64_t shift = drop.leadMs >= 0 && po.firstByte > drop.byte ? penBytes.size() : 0;
+            if (EntityStats *es = claim(pc.path, base + po.firstByte + shift, tot.totalMs + po.firstMs))
+            {
+                es->totalMs += po.ms;
+                (pc.penUp ? es->penUpMm : es->penDownMm) += po.mm;
+            }
+        }
+        if (drop.leadMs < 0)
+        {
+            prog->m_bytes.insert(prog->m_bytes.end(), o.bytes.begin(), o.bytes.end());
+            tot.totalMs += o.ms;
+            tot.commands += o.commands;
+            continue;
+        }
+
+        // Travel, pen down, the end of the travel, then whatever the servo still needs
+        const Step &penStep = steps[k + 1];
+        prog->m_bytes.insert(prog->m_bytes.end(), o.bytes.begin(), o.bytes.begin() + drop.byte);
+        EntityStats *es = claim(penStep.index, prog->m_bytes.size(), tot.totalMs + o.ms - drop.leadMs);
+        prog->m_bytes.insert(prog->m_bytes.end(), penBytes.begin(), penBytes.end());
+        prog->m_bytes.insert(prog->m_bytes.end(), o.bytes.begin() + drop.byte, o.bytes.end());
+        const int64_t dwellMs = penMs - drop.leadMs;
+        if (dwellMs > 0)
+        {
+            MoveSlice dwell;
+            dwell.dtMs = static_cast<int>(dwellMs);
+            encodeMove(prog->m_bytes, dwell);
+            tot.commands++;
+        }
+        if (es)
+        {
+            es->totalMs += dwellMs;
+            es->lifts++;
+        }
+        tot.totalMs += o.ms + dwellMs;
+        tot.penOverlapMs += static_cast<uint32_t>(drop.leadMs);
+        tot.commands += o.commands + 1;
+        tot.lifts++;
+    }
+
+    // Paths without commands of their own point at whatever comes next
+    uint64_t nextOffset = prog->m_bytes.size();
+    int64_t nextMs = tot.totalMs;
+    for (size_t i = paths.size(); i-- > 0;)
+    {
+        PathEntry &pe = prog->m_paths[i];
+        if (pe.offset == kNoOffset)
+        {
+            pe.offset = nextOffset;
+            pe.startMs = nextMs;
+        }
+        nextOffset = pe.offset;
+        nextMs = pe.startMs;
+        EntityStats &es = entities[pe.entityId];
+        es.entityId = pe.entityId;
+        es.paths++;
+    }
+
+    prog->m_entities.reserve(entities.size());
+    for (const auto &kv : entities) prog->m_entities.push_back(kv.second);
+    prog->m_stream = prog->m_bytes.data();
+    prog->m_streamSize = prog->m_bytes.size();
+    prog->m_drawPaths = std::move(paths);
+    prog->m_options = opt;
+    return prog;
+}
+
+std::shared_ptr<PlotProgram> PlotProgram::concatenate(const std::vector<std::shared_ptr<const PlotProgram>> &parts)
+{
+    auto prog = std::make_shared<PlotProgram>();
+    std::map<int, EntityStats> entities;
+    Totals &tot = prog->m_totals;
+    bool first = true;
+    bool drawPaths = true; // every part has its draw paths
+    for (const auto &part : parts)
+    {
+        if (!part) continue;
+        const Totals &t = part->totals();
+        if (first)
+        {
+            tot.penMoveMs = t.penMoveMs;
+            prog->m_options = part->m_options;
+        }
+        first = false;
+        drawPaths = drawPaths && part->m_drawPaths.size() == part->paths().size();
+        if (drawPaths)
+        {
+            for (size_t i = 0; i < part->m_drawPaths.size(); ++i)
+                prog->m_drawPaths.addPath(part->m_drawPaths[i]);
+        }
+        const uint64_t base = prog->m_bytes.size();
+        for (PathEntry pe : part->paths())
+        {
+            pe.offset += base;
+            pe.startMs += tot.totalMs;
+            prog->m_paths.push_back(pe);
+        }
+        for (const EntityStats &e : part->entities())
+        {
+            EntityStats &es = entities[e.entityId];
+            es.entityId = e.entityId;
+            es.paths += e.paths;
+            es.totalMs += e.totalMs;
+            es.penDownMm += e.penDownMm;
+            es.penUpMm += e.penUpMm;
+            es.lifts += e.lifts;
+        }
+        const Span<const uint8_t> bytes = part->stream();
+        prog->m_bytes.insert(prog->m_bytes.end(), bytes.begin(), bytes.end());
+        tot.totalMs += t.totalMs;
+        tot.penDownMm += t.penDownMm;
+        tot.penUpMm += t.penUpMm;
+        tot.lifts += t.lifts;
+        tot.commands += t.commands;
+        tot.penOverlapMs += t.penOverlapMs;
+    }
+    if (first)
+        return nullptr;
+    if (!drawPaths)
+        prog->m_drawPaths.clear();
+    prog->m_entities.reserve(entities.size());
+    for (const auto &kv : entities) prog->m_entities.push_back(kv.second);
+    prog->m_stream = prog->m_bytes.data();
+    prog->m_streamSize = prog->m_bytes.size();
+    return prog;
+}
+
+size_t PlotProgram::restPathAt(uint64_t offset) const
+{
+    if (!m_options.liftPen || m_drawPaths.size() != m_paths.size())
+        return m_paths.size();
+    // The same test compile uses to chain touching strokes without lifting the pen
+    const float joinMm = 1.0f / static_cast<float>(m_options.stepsPerMm);
+    Vec2 pos;
+    bool penDown = false;
+    for (size_t i = 0; i < m_drawPaths.size(); ++i)
+    {
+        const PathView path = m_drawPaths[i];
+        if (path.points.empty())
+            continue;
+        const Vec2 &start = path.points.front();
+        const bool continues = penDown && std::hypot(pos.x - start.x, pos.y - start.y) < joinMm;
+        if (!continues && m_paths[i].offset >= offset)
+            return i;
+        penDown = true;
+        pos = path.points.back();
+    }
+    return m_paths.size();
+}
+
+std::shared_ptr<PlotProgram> PlotProgram::replanFrom(size_t first, const PlotterConfig &cfg,
+                                                     const std::atomic<bool> *cancel) const
+{
+    if (m_drawPaths.size() != m_paths.size() || first >= m_paths.size())
+        return nullptr;
+    Vec2 from(0.0f, 0.0f);
+    for (size_t i = first; i-- > 0;)
+    {
+        if (m_drawPaths.pathSize(i) > 0)
+        {
+            from = m_drawPaths[i].points.back();
+            break;
+        }
+    }
+    PathSet rest;
+    std::vector<int> entity;
+    rest.reserve(m_paths.size() - first, m_drawPaths.pointCount() - m_drawPaths.offsets[first]);
+    entity.reserve(m_paths.size() - first);
+    for (size_t i = first; i < m_paths.size(); ++i)
+    {
+        rest.addPath(m_drawPaths[i]);
+        entity.push_back(m_paths[i].entityId);
+    }
+    return plan(std::move(rest), entity, from, cfg, m_options, cancel);
+}
+
+bool PlotProgram::save(const std::string &filePath, std::string *errorOut) const
+{
+    std::ofstream f(filePath, std::ios::binary | std::ios::trunc);
+    if (!f)
+    {
+        if (errorOut) *errorOut = "Cannot write " + filePath;
+        return false;
+    }
+    FileHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.geometryHash = geometryHash;
+    h.configHash = configHash;
+    h.streamBytes = m_streamSize;
+    h.pathCount = static_cast<uint32_t>(m_paths.size());
+    h.entityCount = static_cast<uint32_t>(m_entities.size());
+    h.totals = m_totals;
+    f.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char *>(m_paths.data()), static_cast<std::streamsize>(m_paths.size() * sizeof(PathEntry)));
+    f.write(reinterpret_cast<const char *>(m_entities.data()), static_cast<std::streamsize>(m_entities.size() * sizeof(EntityStats)));
+    f.write(reinterpret_cast<const char *>(m_stream), static_cast<std::streamsize>(m_streamSize));
+    DrawPathsHeader d{};
+    if (m_drawPaths.size() == m_paths.size())
+    {
+        d.pathCount = static_cast<uint32_t>(m_drawPaths.size());
+        d.pointCount = static_cast<uint32_t>(m_drawPaths.pointCount());
+    }
+    d.stepsPerMm = m_options.stepsPerMm;
+    d.liftPen = m_options.liftPen ? 1 : 0;
+    f.write(reinterpret_cast<const char *>(&d), sizeof(d));
+    if (d.pathCount > 0)
+    {
+        f.write(reinterpret_cast<const char *>(m_drawPaths.points.data()), static_cast<std::streamsize>(d.pointCount * sizeof(Vec2)));
+        f.write(reinterpret_cast<const char *>(m_drawPaths.offsets.data()), static_cast<std::streamsize>((d.pathCount + 1) * sizeof(uint32_t)));
+        f.write(reinterpret_cast<const char *>(m_drawPaths.flags.data()), static_cast<std::streamsize>(d.pathCount));
+    }
+    if (!f)
+    {
+        if (errorOut) *errorOut = "Write failed: " + filePath;
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<PlotProgram> PlotProgram::load(const std::string &filePath, std::string *errorOut)
+{
+    auto prog = std::make_shared<PlotProgram>();
+    if (!prog->m_file.open(filePath, errorOut))
+        return nullptr;
+    const uint8_t *base = prog->m_file.data();
+    const size_t size = prog->m_file.size();
+
+    FileHeader h{};
+    if (size < sizeof(h))
+    {
+        if (errorOut) *errorOut = "Truncated plot program: " + filePath;
+        return nullptr;
+    }
+    std::memcpy(&h, base, sizeof(h));
+    const uint64_t tables = uint64_t(h.pathCount) * sizeof(PathEntry) + uint64_t(h.entityCount) * sizeof(EntityStats);
+    const uint64_t streamEnd = sizeof(h) + tables + h.streamBytes;
+    DrawPathsHeader d{};
+    uint64_t drawBytes = 0;
+    if (h.version >= 3 && streamEnd + sizeof(d) <= size)
+    {
+        std::memcpy(&d, base + streamEnd, sizeof(d));
+        drawBytes = sizeof(d);
+        if (d.pathCount > 0)
+            drawBytes += uint64_t(d.pointCount) * sizeof(Vec2) + (uint64_t(d.pathCount) + 1) * sizeof(uint32_t) + d.pathCount;
+    }
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version < 1 || h.version > kVersion ||
+        (h.version >= 3 && drawBytes == 0) || (d.pathCount > 0 && d.pathCount != h.pathCount) ||
+        streamEnd + drawBytes != size)
+    {
+        if (errorOut) *errorOut = "Not a compatible plot program: " + filePath;
+        return nullptr;
+    }
+
+    // The tables are small; copy them out so alignment of the mapping does not matter
+    const uint8_t *p = base + sizeof(h);
+    prog->m_paths.resize(h.pathCount);
+    std::memcpy(prog->m_paths.data(), p, h.pathCount * sizeof(PathEntry));
+    p += h.pathCount * sizeof(PathEntry);
+    prog->m_entities.resize(h.entityCount);
+    std::memcpy(prog->m_entities.data(), p, h.entityCount * sizeof(EntityStats));
+    p += h.entityCount * sizeof(EntityStats);
+
+    // Draw paths, checked so a damaged file cannot index past its points
+    const uint8_t *q = base + streamEnd + sizeof(d);
+    if (h.version >= 3)
+    {
+        prog->m_options.liftPen = d.liftPen != 0;
+        prog->m_options.stepsPerMm = d.stepsPerMm;
+    }
+    if (d.pathCount > 0)
+    {
+        PathSet &dp = prog->m_drawPaths;
+        dp.points.resize(d.pointCount);
+        std::memcpy(dp.points.data(), q, d.pointCount * sizeof(Vec2));
+        q += d.pointCount * sizeof(Vec2);
+        dp.offsets.resize(d.pathCount + 1);
+        std::memcpy(dp.offsets.data(), q, (d.pathCount + 1) * sizeof(uint32_t));
+        q += (d.pathCount + 1) * sizeof(uint32_t);
+        dp.flags.assign(q, q + d.pathCount);
+        const bool valid = dp.offsets.front() == 0 && dp.offsets.back() == d.pointCount &&
+                           std::is_sorted(dp.offsets.begin(), dp.offsets.end());
+        if (!valid || d.stepsPerMm <= 0)
+        {
+            if (errorOut) *errorOut = "Not a compatible plot program: " + filePath;
+            return nullptr;
+        }
+    }
+
+    prog->m_totals = h.totals;
+    prog->geometryHash = h.geometryHash;
+    prog->configHash = h.configHash;
+    prog->m_stream = p;
+    prog->m_streamSize = static_cast<size_t>(h.streamBytes);
+    return prog;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/Pathset.h"
+#include "core/Span.h"
+#include "plotters/MotionPlanner.h"
+#include "plotters/PlotterConfig.h"
+#include "utils/MappedFile.h"
+
+// A whole plot job, planned ahead of time.
+//
+// The job is ordered and planned once into a stream of commands (time-sliced stepper
+// moves and pen up/down) that PlotSpooler replays as is. Alongside the stream it keeps
+// the exact duration, an index from each path to the first command that works on it,
+// and per-entity totals.
+//
+// Stream encoding: every command starts with a tag byte whose low two bits are the
+// opcode (0 move, 1 pen up, 2 pen down, 3 low-level move). For a move the upper six bits
+// hold the slice duration in ms, or 0 when a varint duration follows; then come the A and
+// B steps as zigzag varints. A low-level move adds rate A, accel A, rate B, accel B
+// (rates as varints, accels zigzag). A pen command with upper bits set is followed by a
+// varint delay in ms (see PlotterConfig::penOverlap); without them it waits for the
+// whole servo move. Commands do not depend on earlier ones, so decoding may start at any
+// indexed offset. A typical slice takes 3-5 bytes.
+//
+// The program also keeps its paths in drawing order, so the rest of a running job can be
+// planned again with other motion settings (see replanFrom).
+//
+// The file form is a fixed header, the path index, the entity table, the stream, then the
+// drawing-order paths, all little-endian. Loaded programs map the file and decode the
+// stream in place.
+
+struct PlotCompileOptions
+{
+    bool liftPen{true};
+    int stepsPerMm{80};
+    double refineBudgetMs{300.0}; // travel-order local search on top of greedy
+};
+
+class PlotProgram
+{
+public:
+    enum class Op : uint8_t { Move = 0, PenUp = 1, PenDown = 2 };
+
+    struct Command
+    {
+        Op op{Op::Move};
+        MoveSlice move; // Op::Move only, SM slice or LM phase
+        int penMs{-1};  // pen commands: delay before the next command, -1 for the servo move
+    };
+
+    // Paths in drawing order. A path that produced no command of its own (all of its
+    // points merged away) points at the next command.
+    struct PathEntry
+    {
+        uint64_t offset{0}; // byte offset of the first command of this path
+        int64_t startMs{0}; // job time at that command
+        int32_t entityId{-1};
+        uint32_t reserved{0};
+    };
+
+    struct EntityStats
+    {
+        int32_t entityId{-1};
+        uint32_t paths{0};
+        int64_t totalMs{0};   // travel to, pen moves for, and drawing of its paths
+        float penDownMm{0.0f};
+        float penUpMm{0.0f};
+        uint32_t lifts{0};
+        uint32_t reserved{0};
+    };
+
+    struct Totals
+    {
+        int64_t totalMs{0}; // slices plus pen delays
+        float penDownMm{0.0f};
+        float penUpMm{0.0f};
+        uint32_t lifts{0};
+        uint32_t commands{0};
+        uint32_t penMoveMs{0}; // servo time per pen up or down
+        uint32_t penOverlapMs{0}; // servo time hidden under travel, not in totalMs
+    };
+
+    // Sequential decoder over [begin, end)
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *begin, const uint8_t *pos, const uint8_t *end) : m_pos(pos), m_begin(begin), m_end(end) {}
+
+        // False at the end of the stream or on malformed data
+        bool next(Command &out);
+        bool atEnd() const { return m_pos >= m_end; }
+        size_t offset() const { return static_cast<size_t>(m_pos - m_begin); }
+
+    private:
+        const uint8_t *m_pos;
+        const uint8_t *m_begin;
+        const uint8_t *m_end;
+    };
+
+    // Order (greedy + refine) and plan 'pagePaths' (page mm) starting and ending at the
+    // origin. pathEntity[i] is the entity path i belongs to. Runs between pen changes are
+    // planned in parallel. Returns null if there is nothing to plot or on cancel.
+    static std::shared_ptr<PlotProgram> compile(const PathSet &pagePaths, const std::vector<int> &pathEntity,
+                                                const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                                const std::atomic<bool> *cancel = nullptr);
+
+    // Programs that start and end at the origin (as compiled ones do), one after the
+    // other. Pen timing comes from the first; the cache key is left empty.
+    static std::shared_ptr<PlotProgram> concatenate(const std::vector<std::shared_ptr<const PlotProgram>> &parts);
+
+    // First path at or after stream offset 'offset' whose commands start with the
+    // carriage at rest and the pen up, or paths().size() if there is none. Only jobs that
+    // lift the pen stop between paths, and only programs with draw paths know where.
+    size_t restPathAt(uint64_t offset) const;
+
+    // The rest of the job from path 'first' (a rest path) on, planned again with cfg. It
+    // starts with a pen up where path first - 1 ends and returns to the origin, so its
+    // stream can take over from this one at paths()[first].offset. Null if there is
+    // nothing left to plot, the program has no draw paths, or on cancel.
+    std::shared_ptr<PlotProgram> replanFrom(size_t first, const PlotterConfig &cfg,
+                                            const std::atomic<bool> *cancel = nullptr) const;
+
+    bool save(const std::string &filePath, std::string *errorOut = nullptr) const;
+    static std::shared_ptr<PlotProgram> load(const std::string &filePath, std::string *errorOut = nullptr);
+
+    const Totals &totals() const { return m_totals; }
+    const std::vector<PathEntry> &paths() const { return m_paths; }
+    const std::vector<EntityStats> &entities() const { return m_entities; }
+    // Paths in drawing order as drawn, one per paths() entry; empty for programs saved
+    // before they were stored
+    const PathSet &drawPaths() const { return m_drawPaths; }
+
+    Span<const uint8_t> stream() const { return Span<const uint8_t>(m_stream, m_streamSize); }
+    Reader reader(size_t offset = 0) const
+    {
+        const size_t o = offset < m_streamSize ? offset : m_streamSize;
+        return Reader(m_stream, m_stream + o, m_stream + m_streamSize);
+    }
+
+    // Cache key, stored in the file header (see PlotProgramCache)
+    uint64_t geometryHash{0};
+    uint64_t configHash{0};
+
+private:
+    // Plan paths already in drawing order, from 'from' back to the origin
+    static std::shared_ptr<PlotProgram> plan(PathSet paths, const std::vector<int> &pathEntity, const Vec2 &from,
+                                             const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                             const std::atomic<bool> *cancel);
+
+    Totals m_totals{};
+    std::vector<PathEntry> m_paths;
+    std::vector<EntityStats> m_entities;
+    PathSet m_drawPaths;
+    PlotCompileOptions m_options{}; // liftPen and stepsPerMm, for replanning
+
+    // Either m_bytes (compiled) or m_file (loaded) backs the stream
+    std::vector<uint8_t> m_bytes;
+    MappedFile m_file;
+    const uint8_t *m_stream{nullptr};
+    size_t m_streamSize{0};
+};
+
+// Planner limits for a plotter configuration
+PlannerSettings plannerSettingsFromConfig(const PlotterConfig &cfg, int stepsPerMm);
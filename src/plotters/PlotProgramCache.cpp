@@ -0,0 +1,315 @@
+#include "plotters/PlotProgramCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glog/logging.h>
+
+namespace
+{
+
+// FNV-1a, 64 bit
+struct Hasher
+{
+    uint64_t h{1469598103934665603ull};
+
+    void bytes(const void *data, size_t n)
+    {
+        const uint8_t *p = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < n; ++i)
+        {
+            h ^= p[i];
+            h *= 1099511628211ull;
+        }
+    }
+    template <typename T>
+    void value(const T &v) { bytes(&v, sizeof(v)); }
+};
+
+uint64_t geometryHash(const PathSet &paths, const std::vector<int> &entity)
+{
+    Hasher h;
+    h.value(paths.points.size());
+    h.bytes(paths.points.data(), paths.points.size() * sizeof(Vec2));
+    h.bytes(paths.offsets.data(), paths.offsets.size() * sizeof(paths.offsets[0]));
+    h.bytes(paths.flags.data(), paths.flags.size());
+    h.bytes(entity.data(), entity.size() * sizeof(int));
+    return h.h;
+}
+
+// Temporary name next to path, unique across threads and processes writing the same program
+std::string tempPathFor(const std::string &path)
+{
+    static std::atomic<uint32_t> counter{0};
+    static const uint32_t processSalt = std::random_device{}();
+    const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    char suffix[64];
+    std::snprintf(suffix, sizeof(suffix), ".%08x-%04zx-%u.tmp", processSalt, thread & 0xFFFF,
+                  counter.fetch_add(1));
+    return path + suffix;
+}
+
+} // namespace
+
+PlotProgramCache &PlotProgramCache::instance()
+{
+    static PlotProgramCache cache;
+    return cache;
+}
+
+void PlotProgramCache::gatherPaths(const PageModel &page, std::optional<int> onlyEntityId, PathSet &out,
+                                   std::vector<int> &entityOut)
+{
+    for (const auto &kv : page.entities)
+    {
+        const Entity &e = kv.second;
+        if (onlyEntityId.has_value() && kv.first != *onlyEntityId)
+            continue;
+        const PathSet *ps = nullptr;
+        LayerPtr chainOut; // keeps a chain's output alive while it is read
+        if (e.type() == EntityType::PathSet)
+        {
+            ps = e.pathset();
+        }
+        else
+        {
+            // Last completed background generation; null until the chain has run once
+            chainOut = e.filterChain.outputLayer();
+            ps = asPathSetConstPtr(chainOut);
+        }
+        if (!ps) continue;
+
+        for (const PathView &path : *ps)
+        {
+            if (path.points.size() < 1) continue;
+            for (const Vec2 &p : path.points)
+                out.addPoint(e.localToPage * p);
+            out.endPath(path.closed);
+            entityOut.push_back(kv.first);
+        }
+    }
+}
+
+PlotProgramCache::PlotProgramCache()
+{
+    std::error_code ec;
+    const std::filesystem::path tmp = std::filesystem::temp_directory_path(ec);
+    if (!ec)
+        m_dir = (tmp / "minotaur_programs").string();
+}
+
+void PlotProgramCache::setDirectory(const std::string &dir)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_dir = dir;
+}
+
+void PlotProgramCache::setDiskLimit(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_diskLimit = bytes;
+}
+
+void PlotProgramCache::trimDirectory(const std::string &dir, uint64_t limitBytes, const std::string &keep)
+{
+    namespace fs = std::filesystem;
+    // Temporary files this old belong to a writer that died
+    constexpr auto kStaleTemp = std::chrono::hours(1);
+    struct Stored
+    {
+        fs::path path;
+        fs::file_time_type used;
+        uint64_t bytes;
+    };
+    std::vector<Stored> stored;
+    uint64_t total = 0;
+    std::error_code ec;
+    const fs::file_time_type now = fs::file_time_type::clock::now();
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        const fs::path &p = it->path();
+        std::error_code fec;
+        const fs::file_time_type used = fs::last_write_time(p, fec);
+        if (fec) continue;
+        if (p.extension() == ".tmp")
+        {
+            if (now - used > kStaleTemp) fs::remove(p, fec);
+            continue;
+        }
+        if (p.extension() != ".mtpg") continue;
+        const uint64_t bytes = fs::file_size(p, fec);
+        if (fec) continue;
+        total += bytes;
+        stored.push_back(Stored{p, used, bytes});
+    }
+    if (total <= limitBytes) return;
+
+    std::sort(stored.begin(), stored.end(), [](const Stored &a, const Stored &b) { return a.used < b.used; });
+    for (const Stored &s : stored)
+    {
+        if (total <= limitBytes) break;
+        if (s.path == keep) continue;
+        std::error_code rec;
+        // A program still mapped elsewhere stays readable until it is unmapped (POSIX);
+        // on Windows the removal fails and is retried on the next trim
+        if (fs::remove(s.path, rec)) total -= s.bytes;
+    }
+}
+
+void PlotProgramCache::clear()
+{
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_entries.clear();
+}
+
+uint64_t PlotProgramCache::configHash(const PlotterConfig &cfg, const PlotCompileOptions &opt)
+{
+    // Everything that changes the order or the slices; hashed field by field to skip padding
+    Hasher h;
+    h.value(cfg.penUpPos);
+    h.value(cfg.penDownPos);
+    h.value(cfg.drawSpeedMmPerS);
+    h.value(cfg.travelSpeedMmPerS);
+    h.value(cfg.accelDrawMmPerS2);
+    h.value(cfg.accelTravelMmPerS2);
+    h.value(cfg.cornering);
+    h.value(cfg.junctionSpeedFloorPercent);
+    h.value(cfg.timeSliceMs);
+    h.value(cfg.maxStepRatePerAxis);
+    h.value(cfg.minSegmentMm);
+    h.value(cfg.sCurve);
+    h.value(cfg.jerkMmPerS3);
+    h.value(cfg.lowLevelMoves);
+    h.value(cfg.penOverlap);
+    h.value(cfg.penLiftClearMs);
+    h.value(cfg.penDropLeadMs);
+    h.value(opt.liftPen);
+    h.value(opt.stepsPerMm);
+    h.value(opt.refineBudgetMs);
+    return h.h;
+}
+
+std::shared_ptr<const PlotProgram> PlotProgramCache::get(const PageModel &page, const PlotterConfig &cfg,
+                                                         const PlotCompileOptions &opt, std::optional<int> onlyEntityId,
+                                                         std::string *errorOut)
+{
+    PathSet pagePaths;
+    std::vector<int> pathEntity;
+    gatherPaths(page, onlyEntityId, pagePaths, pathEntity);
+    return get(pagePaths, pathEntity, cfg, opt, errorOut);
+}
+
+std::shared_ptr<const PlotProgram> PlotProgramCache::get(const PathSet &pagePaths, const std::vector<int> &pathEntity,
+                                                         const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                                         std::string *errorOut)
+{
+    if (pagePaths.empty())
+    {
+        if (errorOut) *errorOut = "Nothing to plot";
+        return nullptr;
+    }
+    const uint64_t gh = geometryHash(pagePaths, pathEntity);
+    const uint64_t ch = configHash(cfg, opt);
+
+    std::string dir, filePath;
+    uint64_t diskLimit = 0;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it)
+        {
+            if (it->geometryHash == gh && it->configHash == ch)
+            {
+                m_entries.splice(m_entries.begin(), m_entries, it);
+                return m_entries.front().program;
+            }
+        }
+        if (!m_dir.empty())
+        {
+            char name[48];
+            std::snprintf(name, sizeof(name), "%016llx-%016llx.mtpg", static_cast<unsigned long long>(gh),
+                          static_cast<unsigned long long>(ch));
+            dir = m_dir;
+            filePath = (std::filesystem::path(dir) / name).string();
+            diskLimit = m_diskLimit;
+        }
+    }
+
+    std::shared_ptr<PlotProgram> prog;
+    std::error_code ec;
+    if (!filePath.empty() && std::filesystem::exists(filePath, ec))
+    {
+        std::string err;
+        prog = PlotProgram::load(filePath, &err);
+        if (prog && (prog->geometryHash != gh || prog->configHash != ch))
+        {
+            prog.reset();
+            err = "hash mismatch";
+        }
+        if (prog)
+            std::filesystem::last_write_time(filePath, std::filesystem::file_time_type::clock::now(), ec); // for LRU trimming
+        else
+            LOG(WARNING) << "Ignoring cached plot program " << filePath << ": " << err;
+    }
+
+    if (!prog)
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        prog = PlotProgram::compile(pagePaths, pathEntity, cfg, opt);
+        if (!prog)
+        {
+            if (errorOut) *errorOut = "Nothing to plot";
+            return nullptr;
+        }
+        prog->geometryHash = gh;
+        prog->configHash = ch;
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        LOG(INFO) << "Compiled plot program: " << prog->paths().size() << " paths, " << prog->totals().commands
+                  << " commands, " << prog->stream().size() << " bytes, " << prog->totals().totalMs / 1000.0
+                  << " s plot time in " << ms << " ms";
+        for (const PlotProgram::EntityStats &es : prog->entities())
+        {
+            LOG(INFO) << "  entity " << es.entityId << ": " << es.paths << " paths, " << es.totalMs / 1000.0 << " s, "
+                      << es.penDownMm << " mm down, " << es.penUpMm << " mm up, " << es.lifts << " lifts";
+        }
+
+        if (!filePath.empty())
+        {
+            // Write under a temporary name so a reader never maps a partial file
+            std::string err;
+            const std::string tmpPath = tempPathFor(filePath);
+            std::filesystem::create_directories(dir, ec);
+            if (prog->save(tmpPath, &err))
+            {
+                std::filesystem::rename(tmpPath, filePath, ec);
+                if (ec)
+                {
+                    LOG(WARNING) << "Cannot store plot program: " << ec.message();
+                    std::filesystem::remove(tmpPath, ec);
+                }
+                else
+                {
+                    trimDirectory(dir, diskLimit, filePath);
+                }
+            }
+            else
+            {
+                LOG(WARNING) << "Cannot store plot program: " << err;
+                std::filesystem::remove(tmpPath, ec);
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lk(m_mutex);
+    m_entries.push_front(Entry{gh, ch, prog});
+    if (m_entries.size() > kMaxEntries)
+        m_entries.pop_back();
+    return m_entries.front().program;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Page.h"
+#include "plotters/PlotProgram.h"
+#include "plotters/PlotterConfig.h"
+
+// Compiled plot programs keyed by a hash of the page geometry (in page space, so moving
+// an entity is a new key) and of the PlotterConfig fields that shape the motion.
+// A few recent programs stay in memory; every compiled program is also written to the
+// cache directory and mapped back from there on a later hit, e.g. after a restart. The
+// directory is kept under a size limit by deleting the least recently used programs.
+class PlotProgramCache
+{
+public:
+    static PlotProgramCache &instance();
+
+    // The program for the page (or a single entity of it), compiling it on a miss.
+    // Null when there is nothing to plot.
+    std::shared_ptr<const PlotProgram> get(const PageModel &page, const PlotterConfig &cfg,
+                                           const PlotCompileOptions &opt, std::optional<int> onlyEntityId = std::nullopt,
+                                           std::string *errorOut = nullptr);
+    // Same for paths already in page space, with the entity of each path
+    std::shared_ptr<const PlotProgram> get(const PathSet &pagePaths, const std::vector<int> &pathEntity,
+                                           const PlotterConfig &cfg, const PlotCompileOptions &opt,
+                                           std::string *errorOut = nullptr);
+
+    // All paths of the page (or one entity) in page space, and the entity of each
+    static void gatherPaths(const PageModel &page, std::optional<int> onlyEntityId, PathSet &out,
+                            std::vector<int> &entityOut);
+
+    // Empty disables the on-disk cache
+    void setDirectory(const std::string &dir);
+    // Total size of the programs kept on disk
+    void setDiskLimit(uint64_t bytes);
+    void clear();
+
+    static uint64_t configHash(const PlotterConfig &cfg, const PlotCompileOptions &opt);
+
+private:
+    PlotProgramCache();
+
+    struct Entry
+    {
+        uint64_t geometryHash{0};
+        uint64_t configHash{0};
+        std::shared_ptr<const PlotProgram> program;
+    };
+
+    // Delete the least recently used programs in dir until they fit in limitBytes; keep
+    // is the one just written
+    static void trimDirectory(const std::string &dir, uint64_t limitBytes, const std::string &keep);
+
+    static constexpr size_t kMaxEntries = 4;
+    static constexpr uint64_t kDefaultDiskLimit = 512ull << 20;
+
+    std::mutex m_mutex;
+    std::list<Entry> m_entries; // most recently used first
+    std::string m_dir;
+    uint64_t m_diskLimit{kDefaultDiskLimit};
+};
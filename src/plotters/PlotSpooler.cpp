@@ -6,75 +6,15 @@
 
 #include <glog/logging.h>
 
+#include "plotters/PlotProgramCache.h"
+
 using Clock = std::chrono::steady_clock;
 using Ms = std::chrono::milliseconds;
 
-static inline float hypot2f(float dx, float dy)
-{
-    return std::sqrt(dx * dx + dy * dy);
-}
-
-static inline float dist2(const Vec2 &a, const Vec2 &b)
-{
-    const float dx = a.x - b.x;
-    const float dy = a.y - b.y;
-    return dx * dx + dy * dy;
-}
-
-static inline void reversePathPoints(std::vector<Vec2> &pts)
+PlotSpooler::StreamClock PlotSpooler::steadyClock()
 {
-    std::reverse(pts.begin(), pts.end());
-}
-
-// Reorder a set of page-space paths by greedy nearest neighbor, allowing flips for open paths
-static std::vector<Path> reorderPathsNearest(const std::vector<Path> &in, const Vec2 &start)
-{
-    const size_t n = in.size();
-    std::vector<bool> used(n, false);
-    std::vector<Path> out;
-    out.reserve(n);
-
-    Vec2 last = start;
-
-    for (size_t k = 0; k < n; ++k)
-    {
-        size_t bestIdx = static_cast<size_t>(-1);
-        bool bestFlip = false;
-        float bestD2 = std::numeric_limits<float>::infinity();
-
-        for (size_t i = 0; i < n; ++i)
-        {
-            if (used[i]) continue;
-            const Path &p = in[i];
-            if (p.points.empty()) continue;
-
-            float dStart = dist2(last, p.points.front());
-            float dEnd = dist2(last, p.points.back());
-            float cand = dStart;
-            bool candFlip = false;
-            if (!p.closed && dEnd < dStart) { cand = dEnd; candFlip = true; }
-
-            if (cand < bestD2)
-            {
-                bestD2 = cand;
-                bestIdx = i;
-                bestFlip = candFlip;
-            }
-        }
-
-        if (bestIdx == static_cast<size_t>(-1))
-            break;
-
-        Path chosen = in[bestIdx];
-        used[bestIdx] = true;
-        if (bestFlip)
-            reversePathPoints(chosen.points);
-        if (!chosen.points.empty())
-            last = chosen.points.back();
-        out.push_back(std::move(chosen));
-    }
-
-    return out;
+    return StreamClock{[]() { return Clock::now(); },
+                       [](Clock::time_point t) { std::this_thread::sleep_until(t); }};
 }
 
 PlotSpooler::~PlotSpooler()
@@ -87,6 +27,15 @@ PlotSpooler::~PlotSpooler()
     }
 }
 
+PlotCompileOptions PlotSpooler::compileOptions(bool liftPen)
+{
+    PlotCompileOptions opt;
+    opt.liftPen = liftPen;
+    opt.stepsPerMm = kStepsPerMm;
+    opt.refineBudgetMs = kRefineBudgetMs;
+    return opt;
+}
+
 bool PlotSpooler::startJob(const PageModel &page, const PlotterConfig &cfg, bool liftPen)
 {
     if (m_running.load())
@@ -94,54 +43,38 @@ bool PlotSpooler::startJob(const PageModel &page, const PlotterConfig &cfg, bool
         LOG(WARNING) << "PlotSpooler already running";
         return false;
     }
-    if (!m_serial.isConnected())
-    {
-        LOG(WARNING) << "Serial not connected; cannot start plot job";
-        return false;
-    }
-
-    {
-        std::lock_guard<std::mutex> lk(m_mutex);
-        m_stats = Stats{};
-        m_queuedMs = 0;
-        m_job = JobState{};
-        std::queue<Cmd> empty;
-        std::swap(m_queue, empty);
-    }
-
-    m_cfg = cfg;
-    m_onlyEntityId.reset();
 
-    if (!prepareJob(page, liftPen))
+    const PlotCompileOptions opt = compileOptions(liftPen);
+    std::string err;
+    std::shared_ptr<const PlotProgram> program = PlotProgramCache::instance().get(page, cfg, opt, std::nullopt, &err);
+    if (!program)
     {
-        LOG(WARNING) << "PlotSpooler: nothing to plot";
+        LOG(WARNING) << "PlotSpooler: " << err;
         return false;
     }
+    return startProgram(std::move(program), cfg);
+}
 
+bool PlotSpooler::startJobSingle(const PageModel &page, int entityId, const PlotterConfig &cfg, bool liftPen)
+{
+    if (m_running.load())
     {
-        std::lock_guard<std::mutex> lk(m_mutex);
-        // Prime the queue to a reasonable high-water mark
-        refillQueueLocked(/*highWaterMs=*/1200, /*lowWaterMs=*/300);
+        LOG(WARNING) << "PlotSpooler already running";
+        return false;
     }
 
-    m_startTime = Clock::now();
-
-    // Join any previous finished worker to avoid std::terminate on reassignment
-    if (m_worker.joinable())
+    const PlotCompileOptions opt = compileOptions(liftPen);
+    std::string err;
+    std::shared_ptr<const PlotProgram> program = PlotProgramCache::instance().get(page, cfg, opt, entityId, &err);
+    if (!program)
     {
-        m_worker.join();
+        LOG(WARNING) << "PlotSpooler: " << err << " for entity " << entityId;
+        return false;
     }
-
-    m_cancel.store(false);
-    m_paused.store(false);
-    m_running.store(true);
-
-    m_worker = std::thread([this]()
-                           { run(); });
-    return true;
+    return startProgram(std::move(program), cfg);
 }
 
-bool PlotSpooler::startJobSingle(const PageModel &page, int entityId, const PlotterConfig &cfg, bool liftPen)
+bool PlotSpooler::startProgram(std::shared_ptr<const PlotProgram> program, const PlotterConfig &cfg)
 {
     if (m_running.load())
     {
@@ -153,43 +86,74 @@ bool PlotSpooler::startJobSingle(const PageModel &page, int entityId, const Plot
         LOG(WARNING) << "Serial not connected; cannot start plot job";
         return false;
     }
-
+    if (!program || program->stream().empty())
     {
-        std::lock_guard<std::mutex> lk(m_mutex);
-        m_stats = Stats{};
-        m_queuedMs = 0;
-        m_job = JobState{};
-        std::queue<Cmd> empty;
-        std::swap(m_queue, empty);
+        LOG(WARNING) << "PlotSpooler: nothing to plot";
+        return false;
     }
 
-    m_cfg = cfg;
-    m_onlyEntityId = entityId;
-
-    if (!prepareJob(page, liftPen))
+    // Join any previous finished worker before touching the ring
+    if (m_worker.joinable())
     {
-        LOG(WARNING) << "PlotSpooler: nothing to plot for entity " << entityId;
-        return false;
+        m_worker.join();
     }
 
     {
         std::lock_guard<std::mutex> lk(m_mutex);
+        resetForJobLocked();
+        m_cfg = cfg;
+        m_job.program = std::move(program);
+        m_job.endOffset = m_job.program->stream().size();
+        {
+            std::lock_guard<std::mutex> slk(m_statsMutex);
+            m_stats.plannedPenDownMm = m_job.program->totals().penDownMm;
+            m_stats.plannedMs = static_cast<int>(m_job.program->totals().totalMs);
+            m_stats.penOverlapMs = static_cast<int>(m_job.program->totals().penOverlapMs);
+        }
         // Prime the queue to a reasonable high-water mark
-        refillQueueLocked(/*highWaterMs=*/1200, /*lowWaterMs=*/300);
+        refillQueueLocked(kHighWaterMs, kLowWaterMs);
     }
 
-    m_startTime = Clock::now();
-    if (m_worker.joinable())
+    launchThreads();
+    return true;
+}
+
+void PlotSpooler::resetForJobLocked()
+{
     {
-        m_worker.join();
+        std::lock_guard<std::mutex> slk(m_statsMutex);
+        m_stats = Stats{};
     }
+    m_queuedMs.store(0);
+    m_commandsQueued.store(0);
+    m_job = JobState{};
+    m_ring.clear();
+}
+
+void PlotSpooler::launchThreads()
+{
+    m_startTime = m_clock.now();
 
     m_cancel.store(false);
     m_paused.store(false);
+    m_stopProducer.store(false);
+    m_producerDone.store(false);
     m_running.store(true);
 
+    m_producer = std::thread([this]() { produce(); });
     m_worker = std::thread([this]() { run(); });
-    return true;
+}
+
+PlotSpooler::Stats PlotSpooler::stats() const
+{
+    Stats s;
+    {
+        std::lock_guard<std::mutex> lk(m_statsMutex);
+        s = m_stats;
+    }
+    s.commandsQueued = m_commandsQueued.load();
+    s.queuedMs = m_queuedMs.load();
+    return s;
 }
 
 void PlotSpooler::pause()
@@ -207,316 +171,457 @@ void PlotSpooler::resume()
 
 void PlotSpooler::cancel()
 {
-    m_cancel.store(true);
-    m_cv.notify_all();
+    requestCancel();
     if (m_worker.joinable())
     {
         m_worker.join();
     }
 }
 
-void PlotSpooler::updateConfig(const PlotterConfig &cfg)
+void PlotSpooler::requestCancel()
 {
-    std::lock_guard<std::mutex> lk(m_mutex);
-    m_cfg = cfg;
+    m_cancel.store(true);
+    m_cv.notify_all();
+    m_producerCv.notify_all();
 }
 
-void PlotSpooler::mmDeltaToCoreXYSteps(float dxMm, float dyMm, int &aOut, int &bOut)
+void PlotSpooler::updateConfig(const PlotterConfig &cfg)
 {
-    const int dxSteps = roundToInt(dxMm * static_cast<float>(kStepsPerMm));
-    const int dySteps = roundToInt(dyMm * static_cast<float>(kStepsPerMm));
-    const int a = dxSteps + dySteps;
-    const int b = -dxSteps + dySteps;
-    aOut = a;
-    bOut = b;
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_cfg = cfg;
+        m_job.configChanged = m_job.program != nullptr;
+    }
+    m_producerCv.notify_all();
 }
 
-int PlotSpooler::computeDurationMsForAB(int aSteps, int bSteps, bool plotting) const
+bool PlotSpooler::pushCmd(const Cmd &c)
 {
-    const int distanceSteps = std::max(std::abs(aSteps), std::abs(bSteps));
-    const int pctInt = plotting ? m_cfg.drawSpeedPercent : m_cfg.travelSpeedPercent;
-    const float pct = static_cast<float>(std::clamp(pctInt, 1, 500)) / 100.0f;
-    const float stepsPerSecond = std::max(1.0f, pct * static_cast<float>(kMaxStepsPerSecond));
-    const float ms = 1000.0f * (static_cast<float>(distanceSteps) / stepsPerSecond);
-    const int dur = std::max(1, roundToInt(ms));
-    return dur;
+    // Count queued time before publishing so the streamer never subtracts it first
+    const int dt = c.kind == CmdKind::StepperMove ? std::max(1, c.durationMs) : 0;
+    m_queuedMs.fetch_add(dt);
+    if (!m_ring.tryPush(c))
+    {
+        m_queuedMs.fetch_sub(dt);
+        return false;
+    }
+    m_commandsQueued.fetch_add(1);
+    return true;
 }
 
-void PlotSpooler::pushPenUp()
+void PlotSpooler::refillQueueLocked(int highWaterMs, int lowWaterMs)
 {
-    Cmd c;
-    c.kind = CmdKind::PenUp;
-    m_queue.push(c);
-    m_stats.commandsQueued++;
+    // Hysteresis: nothing until the streamer has drained below the low-water mark, then
+    // a whole batch up to the high-water mark, so a wake-up plans more than a command
+    if (!m_job.program || m_queuedMs.load() >= lowWaterMs)
+        return;
+
+    PlotProgram::Reader reader = m_job.program->reader(m_job.readOffset);
+    PlotProgram::Command pc;
+    while (m_queuedMs.load() < highWaterMs && reader.offset() < m_job.endOffset)
+    {
+        if (!reader.next(pc))
+        {
+            LOG(ERROR) << "PlotSpooler: corrupt plot program at byte " << m_job.readOffset;
+            m_job.readOffset = m_job.endOffset = m_job.program->stream().size();
+            break;
+        }
+        Cmd c;
+        if (pc.op == PlotProgram::Op::Move)
+        {
+            c.kind = CmdKind::StepperMove;
+            c.durationMs = pc.move.dtMs;
+            c.aSteps = pc.move.aSteps;
+            c.bSteps = pc.move.bSteps;
+            c.lowLevel = pc.move.lowLevel;
+            c.rateA = pc.move.rateA;
+            c.rateB = pc.move.rateB;
+            c.accelA = pc.move.accelA;
+            c.accelB = pc.move.accelB;
+        }
+        else
+        {
+            c.kind = pc.op == PlotProgram::Op::PenDown ? CmdKind::PenDown : CmdKind::PenUp;
+            c.durationMs = pc.penMs;
+        }
+        if (!pushCmd(c))
+            break; // ring full; the command is decoded again next time
+        m_job.readOffset = reader.offset();
+    }
 }
 
-void PlotSpooler::pushPenDown()
+void PlotSpooler::replanLocked()
 {
-    Cmd c;
-    c.kind = CmdKind::PenDown;
-    m_queue.push(c);
-    m_stats.commandsQueued++;
+    if (m_job.replan.valid())
+    {
+        // The old program plays up to the cut, then the new one takes over from there
+        if (m_job.replan.wait_for(Ms(0)) != std::future_status::ready || m_job.readOffset < m_job.endOffset)
+            return;
+        std::shared_ptr<const PlotProgram> next = m_job.replan.get();
+        if (next && !m_job.configChanged)
+        {
+            m_job.startMs += m_job.program->paths()[m_job.replanPath].startMs;
+            m_job.program = std::move(next);
+            m_job.readOffset = 0;
+            m_job.endOffset = m_job.program->stream().size();
+            std::lock_guard<std::mutex> slk(m_statsMutex);
+            m_stats.plannedMs = static_cast<int>(m_job.startMs + m_job.program->totals().totalMs);
+            m_stats.etaMs = std::max(0, m_stats.plannedMs - m_stats.doneMs);
+            return;
+        }
+        // Nothing to switch to, or the settings changed again while planning and the
+        // newest ones are planned below
+        m_job.endOffset = m_job.program->stream().size();
+    }
+    if (!m_job.configChanged || !m_job.program)
+        return;
+    m_job.configChanged = false;
+    const size_t first = m_job.program->restPathAt(m_job.readOffset);
+    if (first >= m_job.program->paths().size())
+        return; // no rest point left; the job finishes with its settings
+    m_job.replanPath = first;
+    m_job.endOffset = m_job.program->paths()[first].offset;
+    // Off this thread so the queue keeps filling up to the cut meanwhile
+    m_job.replan = std::async(std::launch::async, [program = m_job.program, first, cfg = m_cfg, stop = &m_stopProducer]() {
+        return program->replanFrom(first, cfg, stop);
+    });
 }
 
-void PlotSpooler::pushSM(int durationMs, int aSteps, int bSteps)
+bool PlotSpooler::jobDoneLocked() const
 {
-    Cmd c;
-    c.kind = CmdKind::StepperMove;
-    c.durationMs = durationMs;
-    c.aSteps = aSteps;
-    c.bSteps = bSteps;
-    m_queue.push(c);
-    m_stats.commandsQueued++;
-    m_stats.queuedMs += std::max(1, durationMs);
-    m_queuedMs += std::max(1, durationMs);
+    return !m_job.program || (m_job.readOffset >= m_job.program->stream().size() && !m_job.replan.valid());
 }
 
-bool PlotSpooler::buildQueue(const PageModel &page, bool liftPen)
+void PlotSpooler::produce()
 {
-    // Collect all transformed paths
-    int totalSegments = 0;
-    float totalDrawn = 0.0f;
-
-    // Ensure pen up initially if requested
-    if (liftPen)
+    while (!m_cancel.load() && !m_stopProducer.load())
     {
-        pushPenUp();
+        bool done = false;
+        bool atCut = false;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            replanLocked();
+            refillQueueLocked(kHighWaterMs, kLowWaterMs);
+            done = jobDoneLocked();
+            atCut = m_job.replan.valid() && m_job.readOffset >= m_job.endOffset;
+        }
+        if (done)
+            break;
+
+        // Sleep until the streamer drains below the low-water mark; the timeout
+        // covers a notification that lands between the check and the wait. Queued up
+        // to the cut, only the replan can make progress, so just poll for it.
+        std::unique_lock<std::mutex> lk(m_producerMutex);
+        m_producerCv.wait_for(lk, Ms(atCut ? 2 : 10), [&]()
+                              { return m_cancel.load() || m_stopProducer.load() ||
+                                       (!atCut && m_queuedMs.load() < kLowWaterMs && !m_ring.full()); });
     }
+    m_producerDone.store(true, std::memory_order_release);
+}
 
-    Vec2 currentPosMm = Vec2(0.0f, 0.0f);
+PlotSpooler::Next PlotSpooler::nextCmd(Cmd &cmd)
+{
+    if (m_ring.tryPop(cmd))
+        return Next::Got;
+    // Everything pushed before the producer finished is visible once it reports done
+    if (m_producerDone.load(std::memory_order_acquire))
+        return m_ring.tryPop(cmd) ? Next::Got : Next::Done;
+    m_producerCv.notify_one();
+    return Next::Starved;
+}
 
-    for (const auto &kv : page.entities)
+void PlotSpooler::noteStarved(bool starved)
+{
+    if (starved == m_starving)
+        return;
+    m_starving = starved;
+    std::lock_guard<std::mutex> lk(m_statsMutex);
+    if (starved)
     {
-        const Entity &e = kv.second;
-        if (m_onlyEntityId.has_value() && kv.first != *m_onlyEntityId)
-            continue;
-        if (e.type() != EntityType::PathSet)
-            continue;
-        const PathSet *ps = e.pathset();
-        if (!ps)
-            continue;
+        m_starveStart = m_clock.now();
+        m_stats.underruns++;
+    }
+    else
+    {
+        m_stats.underrunMs += static_cast<int>(std::chrono::duration_cast<Ms>(m_clock.now() - m_starveStart).count());
+    }
+}
 
-        for (const Path &path : ps->paths)
+void PlotSpooler::noteSent(const Cmd &cmd, bool penDownActive, int penMoveMs)
+{
+    if (cmd.kind == CmdKind::StepperMove)
+    {
+        // Release queued time and wake the producer once below the low-water mark
+        const int dt = std::max(1, cmd.durationMs);
+        if (m_queuedMs.fetch_sub(dt) - dt < kLowWaterMs)
         {
-            if (path.points.size() < 1)
-                continue;
-
-            // Transform first point to page space
-            Vec2 p0 = e.localToPage * path.points[0];
-
-            // Travel move to start (pen up)
-            int a = 0, b = 0;
-            mmDeltaToCoreXYSteps(p0.x - currentPosMm.x, p0.y - currentPosMm.y, a, b);
-            const int durTravel = computeDurationMsForAB(a, b, /*plotting=*/false);
-            pushSM(durTravel, a, b);
-            currentPosMm = p0;
-            totalSegments++;
-
-            if (liftPen)
-            {
-                pushPenDown();
-            }
+            m_producerCv.notify_one();
+        }
 
-            // Draw segments
-            for (size_t i = 1; i < path.points.size(); ++i)
-            {
-                Vec2 p = e.localToPage * path.points[i];
-                const float dx = p.x - currentPosMm.x;
-                const float dy = p.y - currentPosMm.y;
-                mmDeltaToCoreXYSteps(dx, dy, a, b);
-                const int durPlot = computeDurationMsForAB(a, b, /*plotting=*/true);
-                pushSM(durPlot, a, b);
-                currentPosMm = p;
-                totalSegments++;
-                totalDrawn += hypot2f(dx, dy);
-            }
+        std::lock_guard<std::mutex> lk(m_statsMutex);
+        m_stats.commandsSent++;
+        m_stats.doneMs += dt;
+        // Convert CoreXY steps to mm for progress if pen is down
+        if (penDownActive)
+        {
+            const float a = static_cast<float>(cmd.aSteps);
+            const float b = static_cast<float>(cmd.bSteps);
+            const float dxSteps = 0.5f * (a - b);
+            const float dySteps = 0.5f * (a + b);
+            const float dxMm = dxSteps / static_cast<float>(kStepsPerMm);
+            const float dyMm = dySteps / static_cast<float>(kStepsPerMm);
+            m_stats.donePenDownMm += std::hypot(dxMm, dyMm);
+        }
 
-            if (liftPen)
-            {
-                pushPenUp();
-            }
+        // Update time; progress and ETA follow the compiled job's exact timeline
+        auto now = m_clock.now();
+        m_stats.elapsedMs = static_cast<int>(std::chrono::duration_cast<Ms>(now - m_startTime).count());
+        float frac = 0.0f;
+        if (m_stats.plannedMs > 0)
+        {
+            frac = static_cast<float>(m_stats.doneMs) / static_cast<float>(m_stats.plannedMs);
+            if (frac > 1.0f) frac = 1.0f;
         }
+        m_stats.percentComplete = frac;
+        m_stats.etaMs = std::max(0, m_stats.plannedMs - m_stats.doneMs);
     }
-
-    // Return to origin after all moves (non-plotting)
-    if (totalSegments > 0)
+    else
     {
-        int a = 0, b = 0;
-        mmDeltaToCoreXYSteps(-currentPosMm.x, -currentPosMm.y, a, b);
-        const int durBack = computeDurationMsForAB(a, b, /*plotting=*/false);
-        pushSM(durBack, a, b);
-        totalSegments++;
+        std::lock_guard<std::mutex> lk(m_statsMutex);
+        m_stats.commandsSent++;
+        m_stats.doneMs += cmd.durationMs >= 0 ? cmd.durationMs : penMoveMs;
     }
-
-    m_stats.plannedPenDownMm = totalDrawn;
-    return totalSegments > 0;
-}
-
-bool PlotSpooler::buildQueuePlanned(const PageModel &page, bool liftPen)
-{
-    // Deprecated in favor of short-queue refill strategy. Keeping for reference.
-    // Build nothing here to avoid filling long queues.
-    (void)page;
-    (void)liftPen;
-    return false;
 }
 
-bool PlotSpooler::prepareJob(const PageModel &page, bool liftPen)
+bool PlotSpooler::streamHostTimed(std::string &err)
 {
-    // Transform to page space and reorder paths, compute total pen-down mm
-    std::vector<Path> pagePaths;
-    Vec2 currentPosMm = Vec2(0.0f, 0.0f);
-    float totalDrawn = 0.0f;
+    const int penMoveMs = static_cast<int>(m_job.program->totals().penMoveMs);
+    bool penDownActive = false;
+    bool streaming = false; // first command written
+    // When the device finishes the moves written so far. Each write now waits for its
+    // ack, so sleeping against this absolute schedule keeps those waits from adding up.
+    Clock::time_point moveEnd = m_clock.now();
 
-    for (const auto &kv : page.entities)
+    while (!m_cancel.load())
     {
-        const Entity &e = kv.second;
-        if (m_onlyEntityId.has_value() && kv.first != *m_onlyEntityId)
-            continue;
-        const PathSet *ps = nullptr;
-        if (e.type() == EntityType::PathSet)
+        // Pause handling
+        if (m_paused.load())
         {
-            ps = e.pathset();
+            std::unique_lock<std::mutex> lk(m_pauseMutex);
+            m_cv.wait(lk, [&]()
+                      { return !m_paused.load() || m_cancel.load(); });
+            if (m_cancel.load())
+                break;
         }
-        else if (e.filterChain.outputLayer()->kind() == LayerKind::PathSet)
+
+        Cmd cmd;
+        const Next next = nextCmd(cmd);
+        if (next == Next::Done)
+            break; // nothing more to do
+        if (next == Next::Starved)
         {
-            const auto &output = e.filterChain.outputLayer();
-            ps = asPathSetConstPtr(output);
+            // Underrun: the device is idle while planning catches up. Planning is host
+            // work, so this waits on the host's clock.
+            noteStarved(streaming);
+            std::this_thread::sleep_for(Ms(1));
+            continue;
         }
-        if (!ps) continue;
+        noteStarved(false);
 
-        for (const Path &path : ps->paths)
+        bool ok = true;
+        switch (cmd.kind)
         {
-            if (path.points.size() < 1) continue;
-            Path pspace;
-            pspace.closed = path.closed;
-            pspace.points.reserve(path.points.size());
-            for (const Vec2 &p : path.points)
-                pspace.points.push_back(e.localToPage * p);
-            // Accumulate length
-            for (size_t i = 1; i < pspace.points.size(); ++i)
-            {
-                float dx = pspace.points[i].x - pspace.points[i - 1].x;
-                float dy = pspace.points[i].y - pspace.points[i - 1].y;
-                totalDrawn += std::hypot(dx, dy);
-            }
-            pagePaths.push_back(std::move(pspace));
+        case CmdKind::PenUp:
+            ok = m_axidraw.penUp(cmd.durationMs, &err);
+            penDownActive = false;
+            break;
+        case CmdKind::PenDown:
+            ok = m_axidraw.penDown(cmd.durationMs, &err);
+            penDownActive = true;
+            break;
+        case CmdKind::StepperMove:
+            if (cmd.lowLevel)
+                ok = m_axidraw.lowLevelMove(cmd.rateA, cmd.aSteps, cmd.accelA, cmd.rateB, cmd.bSteps, cmd.accelB, &err);
+            else
+                ok = m_axidraw.stepperMove(cmd.durationMs, cmd.aSteps, cmd.bSteps, &err);
+            break;
+        }
+        if (!ok)
+            return false;
+        streaming = true;
+        noteSent(cmd, penDownActive, penMoveMs);
+
+        // Sleep until the SM slice is done. The EBB holds the next command back for a pen
+        // command's delay itself, so the next write simply waits in its queue. Being a
+        // little late is made up on the next slice; after a pause, an underrun or a pen
+        // move the schedule restarts from now.
+        if (cmd.kind == CmdKind::StepperMove)
+        {
+            constexpr Ms kMaxLate(20);
+            const Clock::time_point now = m_clock.now();
+            if (now - moveEnd > kMaxLate)
+                moveEnd = now;
+            moveEnd += Ms(std::max(1, cmd.durationMs));
+            m_clock.sleepUntil(moveEnd);
         }
     }
-
-    if (pagePaths.empty())
-        return false;
-
-    m_job = JobState{};
-    m_job.liftPen = liftPen;
-    m_job.currentPosMm = Vec2(0.0f, 0.0f);
-    m_job.orderedPaths = reorderPathsNearest(pagePaths, currentPosMm);
-    m_job.prepared = true;
-
-    m_stats.plannedPenDownMm = totalDrawn;
-    m_stats.donePenDownMm = 0.0f;
-    m_stats.queuedMs = 0;
-    m_queuedMs = 0;
     return true;
 }
 
-void PlotSpooler::refillQueueLocked(int highWaterMs, int lowWaterMs)
+bool PlotSpooler::streamDeviceFifo(int deviceBufferMs, std::string &err)
 {
-    (void)lowWaterMs; // currently unused; kept for future logic
-    if (!m_job.prepared)
-        return;
-
-    // Recompute planner settings from current config to reflect live updates
-    PlannerSettings s;
-    s.speedPenDownMmPerS = m_cfg.drawSpeedMmPerS;
-    s.speedPenUpMmPerS = m_cfg.travelSpeedMmPerS;
-    s.accelPenDownMmPerS2 = m_cfg.accelDrawMmPerS2;
-    s.accelPenUpMmPerS2 = m_cfg.accelTravelMmPerS2;
-    s.cornering = m_cfg.cornering;
-    s.junctionSpeedFloorPercent = m_cfg.junctionSpeedFloorPercent;
-    s.timeSliceMs = m_cfg.timeSliceMs;
-    s.maxStepRatePerAxis = m_cfg.maxStepRatePerAxis;
-    s.minSegmentMm = m_cfg.minSegmentMm;
-    s.stepsPerMm = kStepsPerMm;
+    // Commands in transit; the EBB acknowledges each as it takes it into its FIFO, so
+    // this bounds what sits in USB buffers without ever blocking on a write
+    constexpr int kMaxUnacked = 12;
+    constexpr int kMaxBatch = 6;        // commands per serial write
+    constexpr int kQueryEveryMs = 250;  // QM cadence for checking the timing model
+    const int targetMs = std::clamp(deviceBufferMs, 20, 5000);
+    const int penMs = m_axidraw.penMoveMs();
+
+    // Host-side model of the device: when it will finish everything written so far
+    Clock::time_point busyUntil = m_clock.now();
+    auto aheadMs = [&]() {
+        return std::max<int>(0, static_cast<int>(std::chrono::duration_cast<Ms>(busyUntil - m_clock.now()).count()));
+    };
+    auto sleepMs = [&](int ms) { m_clock.sleepUntil(m_clock.now() + Ms(ms)); };
+    Clock::time_point nextQuery = m_clock.now() + Ms(kQueryEveryMs);
+    uint32_t querySeq = m_axidraw.motionStatusSeq();
+    int msSinceQuery = 0; // motion written after the outstanding QM
+    bool penDownActive = false;
+    bool done = false;
+    bool streaming = false;
 
-    // Ensure initial pen-up once if requested
-    if (m_job.liftPen && !m_job.sentInitialPenUp)
+    while (!m_cancel.load())
     {
-        pushPenUp();
-        m_job.sentInitialPenUp = true;
-    }
+        if (m_paused.load())
+        {
+            // The device finishes what it already holds, then everything waits
+            if (!m_axidraw.flushBatch(&err))
+                return false;
+            std::unique_lock<std::mutex> lk(m_pauseMutex);
+            m_cv.wait(lk, [&]()
+                      { return !m_paused.load() || m_cancel.load(); });
+            if (m_cancel.load())
+                break;
+            busyUntil = std::max(busyUntil, m_clock.now());
+        }
 
-    while (m_queuedMs < highWaterMs)
-    {
-        // If all paths processed, return home once
-        if (m_job.pathIndex >= m_job.orderedPaths.size())
+        // Top the device up to the target depth
+        bool starved = false;
+        while (!done && aheadMs() < targetMs && static_cast<int>(m_axidraw.batchedCommands()) < kMaxBatch &&
+               m_axidraw.unackedCommands() + static_cast<int>(m_axidraw.batchedCommands()) < kMaxUnacked)
         {
-            if (!m_job.returnedHome)
+            Cmd cmd;
+            const Next next = nextCmd(cmd);
+            if (next != Next::Got)
             {
-                std::vector<Vec2> backPts{ m_job.currentPosMm, Vec2(0.0f, 0.0f) };
-                auto backMoves = planPath(s, backPts, /*penUp=*/true, m_job.currentPosMm);
-                for (const auto &mv : backMoves)
-                {
-                    pushSM(mv.dtMs, mv.aSteps, mv.bSteps);
-                }
-                m_job.currentPosMm = Vec2(0.0f, 0.0f);
-                m_job.returnedHome = true;
+                done = next == Next::Done;
+                starved = next == Next::Starved;
+                break;
+            }
+            int dt = cmd.durationMs >= 0 ? cmd.durationMs : penMs;
+            switch (cmd.kind)
+            {
+            case CmdKind::PenUp:
+                m_axidraw.batchPen(true, cmd.durationMs);
+                penDownActive = false;
+                break;
+            case CmdKind::PenDown:
+                m_axidraw.batchPen(false, cmd.durationMs);
+                penDownActive = true;
+                break;
+            case CmdKind::StepperMove:
+                if (cmd.lowLevel)
+                    m_axidraw.batchLowLevelMove(cmd.rateA, cmd.aSteps, cmd.accelA, cmd.rateB, cmd.bSteps, cmd.accelB);
+                else
+                    m_axidraw.batchStepperMove(cmd.durationMs, cmd.aSteps, cmd.bSteps);
+                dt = std::max(1, cmd.durationMs);
+                break;
             }
-            break; // nothing more to enqueue
+            busyUntil = std::max(busyUntil, m_clock.now()) + Ms(dt);
+            msSinceQuery += dt;
+            streaming = true;
+            noteSent(cmd, penDownActive, penMs);
+        }
+        if (!done && m_clock.now() >= nextQuery && m_axidraw.pendingQueries() == 0)
+        {
+            m_axidraw.batchQueryMotion();
+            querySeq = m_axidraw.motionStatusSeq();
+            msSinceQuery = 0;
+            nextQuery = m_clock.now() + Ms(kQueryEveryMs);
         }
+        if (!m_axidraw.flushBatch(&err))
+            return false;
 
-        Path &path = m_job.orderedPaths[m_job.pathIndex];
-        if (path.points.empty())
+        // Underrun: the device has run out of motion while the job is not finished
+        noteStarved(streaming && starved && aheadMs() == 0);
+        if (done)
+            break;
+
+        // Collect acknowledgements; otherwise wait until it is time to top up again.
+        // Starved, the wait is for the planning thread and so on the host's clock.
+        const int waitMs = starved ? 1 : std::clamp(aheadMs() - targetMs / 2, 1, 20);
+        if (m_axidraw.unackedCommands() > 0 || m_axidraw.pendingQueries() > 0)
         {
-            m_job.pathIndex++;
-            continue;
+            if (!m_axidraw.readAcks(waitMs, &err))
+                return false;
+        }
+        else if (starved)
+        {
+            std::this_thread::sleep_for(Ms(waitMs));
+        }
+        else
+        {
+            sleepMs(waitMs);
         }
 
-        // If not currently drawing, travel to start and (optionally) pen down, then plan draw moves
-        if (!m_job.drawingPhase)
+        // The QM reply describes the device once everything before it was queued. Idle
+        // there means it ran dry: count it and pull the model back to the device's clock.
+        if (m_axidraw.motionStatusSeq() != querySeq && m_axidraw.pendingQueries() == 0)
         {
-            if (dist2(m_job.currentPosMm, path.points.front()) > 0.0f)
+            querySeq = m_axidraw.motionStatusSeq();
+            if (m_axidraw.lastMotionStatus().idle())
             {
-                std::vector<Vec2> travelPts{ m_job.currentPosMm, path.points.front() };
-                auto travelMoves = planPath(s, travelPts, /*penUp=*/true, m_job.currentPosMm);
-                for (const auto &mv : travelMoves)
+                if (!m_starving)
                 {
-                    pushSM(mv.dtMs, mv.aSteps, mv.bSteps);
+                    std::lock_guard<std::mutex> lk(m_statsMutex);
+                    m_stats.underruns++;
                 }
-                m_job.currentPosMm = path.points.front();
+                busyUntil = std::min(busyUntil, m_clock.now() + Ms(msSinceQuery));
             }
-            if (m_job.liftPen)
-                pushPenDown();
-
-            m_job.activeMoves = planPath(s, path.points, /*penUp=*/false, m_job.currentPosMm);
-            m_job.moveIndex = 0;
-            m_job.drawingPhase = true;
         }
+    }
 
-        // Add draw moves up to high-water mark
-        while (m_job.moveIndex < m_job.activeMoves.size() && m_queuedMs < highWaterMs)
-        {
-            const auto &mv = m_job.activeMoves[m_job.moveIndex++];
-            pushSM(mv.dtMs, mv.aSteps, mv.bSteps);
-        }
+    if (m_cancel.load())
+    {
+        (void)m_axidraw.flushBatch(nullptr);
+        (void)m_axidraw.emergencyStop(nullptr);
+        return true;
+    }
 
-        // If finished current path, pen up, advance to next
-        if (m_job.moveIndex >= m_job.activeMoves.size())
+    // Wait for the device to drain before the final pen up / motors off
+    const Clock::time_point deadline = busyUntil + Ms(5000);
+    while (!m_cancel.load() && m_clock.now() < deadline)
+    {
+        if (m_axidraw.unackedCommands() > 0)
         {
-            if (m_job.liftPen)
-                pushPenUp();
-            m_job.currentPosMm = path.points.back();
-            m_job.drawingPhase = false;
-            m_job.activeMoves.clear();
-            m_job.moveIndex = 0;
-            m_job.pathIndex++;
+            if (!m_axidraw.readAcks(std::clamp(aheadMs(), 1, 50), &err))
+                return false;
+            continue;
         }
-        else
+        if (aheadMs() > 0)
         {
-            // Reached high water, exit to let worker drain
-            break;
+            sleepMs(std::min(aheadMs(), 50));
+            continue;
         }
+        AxiDrawController::MotionStatus st;
+        if (!m_axidraw.queryMotion(st, 500, &err))
+            return false;
+        if (st.idle())
+            break;
+        sleepMs(10);
     }
+    return true;
 }
 
 void PlotSpooler::run()
@@ -536,117 +641,39 @@ void PlotSpooler::run()
         LOG(WARNING) << "Failed to enable motors: " << err;
     }
 
-    bool penDownActive = false;
-    const int kLowWaterMs = 300;
-    const int kHighWaterMs = 1200;
-
-    while (!m_cancel.load())
+    bool fifoStreaming = false;
+    int deviceBufferMs = 0;
     {
-        // Pause handling
-        if (m_paused.load())
-        {
-            std::unique_lock<std::mutex> lk(m_mutex);
-            m_cv.wait(lk, [&]()
-                      { return !m_paused.load() || m_cancel.load(); });
-            if (m_cancel.load())
-                break;
-        }
-
-        Cmd cmd;
-        {
-            std::lock_guard<std::mutex> lk(m_mutex);
-            if (m_queue.empty())
-            {
-                // Try to refill when empty
-                refillQueueLocked(kHighWaterMs, kLowWaterMs);
-                if (m_queue.empty())
-                {
-                    // Nothing more to do
-                    break;
-                }
-            }
-            cmd = m_queue.front();
-            m_queue.pop();
-        }
-
-        bool ok = true;
-        switch (cmd.kind)
-        {
-        case CmdKind::PenUp:
-            ok = m_axidraw.penUp(-1, &err);
-            penDownActive = false;
-            break;
-        case CmdKind::PenDown:
-            ok = m_axidraw.penDown(-1, &err);
-            penDownActive = true;
-            break;
-        case CmdKind::StepperMove:
-            ok = m_axidraw.stepperMove(cmd.durationMs, cmd.aSteps, cmd.bSteps, &err);
-            break;
-        }
-
-        if (!ok)
+        std::lock_guard<std::mutex> lk(m_mutex);
+        fifoStreaming = m_cfg.fifoStreaming;
+        deviceBufferMs = m_cfg.deviceBufferMs;
+    }
+    if (fifoStreaming)
+    {
+        // The device must answer queries for FIFO pacing; older setups fall back to sleeping
+        m_axidraw.resetStream();
+        AxiDrawController::MotionStatus st;
+        if (!m_axidraw.queryMotion(st, 500, &err))
         {
-            LOG(ERROR) << "Command failed: " << err;
-            break;
+            LOG(WARNING) << "No QM reply (" << err << "); using host-timed streaming";
+            fifoStreaming = false;
         }
+    }
+    m_starving = false;
 
-        m_stats.commandsSent++;
-
-        // Sleep exact dtMs for SM slices; brief delay for pen toggles
-        if (cmd.kind == CmdKind::StepperMove)
-        {
-            // Convert CoreXY steps to mm for progress if pen is down
-            if (penDownActive)
-            {
-                const float a = static_cast<float>(cmd.aSteps);
-                const float b = static_cast<float>(cmd.bSteps);
-                const float dxSteps = 0.5f * (a - b);
-                const float dySteps = 0.5f * (a + b);
-                const float dxMm = dxSteps / static_cast<float>(kStepsPerMm);
-                const float dyMm = dySteps / static_cast<float>(kStepsPerMm);
-                m_stats.donePenDownMm += std::hypot(dxMm, dyMm);
-            }
-
-            // Decrease queued time and top up if needed
-            {
-                std::lock_guard<std::mutex> lk(m_mutex);
-                const int dt = std::max(1, cmd.durationMs);
-                m_queuedMs = std::max(0, m_queuedMs - dt);
-                m_stats.queuedMs = std::max(0, m_stats.queuedMs - dt);
-                // Update time and ETA
-                auto now = Clock::now();
-                m_stats.elapsedMs = static_cast<int>(std::chrono::duration_cast<Ms>(now - m_startTime).count());
-                float frac = 0.0f;
-                if (m_stats.plannedPenDownMm > 0.0f)
-                {
-                    frac = m_stats.donePenDownMm / m_stats.plannedPenDownMm;
-                    if (frac < 0.0f) frac = 0.0f;
-                    if (frac > 1.0f) frac = 1.0f;
-                }
-                m_stats.percentComplete = frac;
-                if (frac > 0.0f)
-                {
-                    const float totalMs = static_cast<float>(m_stats.elapsedMs) / frac;
-                    int eta = static_cast<int>(std::max(0.0f, totalMs - static_cast<float>(m_stats.elapsedMs)));
-                    m_stats.etaMs = eta;
-                }
-                else
-                {
-                    m_stats.etaMs = 0;
-                }
-                if (m_queuedMs < kLowWaterMs)
-                {
-                    refillQueueLocked(kHighWaterMs, kLowWaterMs);
-                }
-            }
+    const bool ok = fifoStreaming ? streamDeviceFifo(deviceBufferMs, err) : streamHostTimed(err);
+    if (!ok)
+    {
+        LOG(ERROR) << "Command failed: " << err;
+    }
+    noteStarved(false);
 
-            std::this_thread::sleep_for(Ms(std::max(1, cmd.durationMs)));
-        }
-        else
-        {
-            std::this_thread::sleep_for(Ms(5));
-        }
+    // Stop planning before the job state goes away
+    m_stopProducer.store(true);
+    m_producerCv.notify_all();
+    if (m_producer.joinable())
+    {
+        m_producer.join();
     }
 
     // Best-effort pen up and motors off at end (unless cancelled early)
@@ -656,6 +683,17 @@ void PlotSpooler::run()
     }
     (void)m_axidraw.enableMotors(false, false, nullptr);
 
+    {
+        std::lock_guard<std::mutex> lk(m_statsMutex);
+        const double wallS = std::chrono::duration<double>(m_clock.now() - m_startTime).count();
+        LOG(INFO) << "PlotSpooler: " << (fifoStreaming ? "FIFO" : "host-timed") << " streaming took " << wallS
+                  << " s for " << m_stats.plannedMs / 1000.0 << " s planned";
+        if (m_stats.underruns > 0)
+        {
+            LOG(WARNING) << "PlotSpooler: " << m_stats.underruns << " underruns, " << m_stats.underrunMs << " ms starved";
+        }
+    }
+
     m_running.store(false);
     LOG(INFO) << "PlotSpooler worker finished";
 }
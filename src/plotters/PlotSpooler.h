@@ -4,20 +4,28 @@
 #include <condition_variable>
 #include <cstdint>
 #include <chrono>
+#include <functional>
+#include <future>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
-#include <optional>
 
 #include "Page.h"
 #include "core/Vec2.h"
 #include "plotters/AxidrawController.h"
 #include "plotters/PlotterConfig.h"
-#include "plotters/MotionPlanner.h"
+#include "plotters/PlotProgram.h"
 #include "serial/SerialController.h"
+#include "utils/SpscRing.h"
 
 // Streams page geometry to AxiDraw using simple SM moves and pen commands.
+//
+// A job is compiled into a PlotProgram up front (or taken from PlotProgramCache)
+// and replayed. Two threads per job: a producer decodes the program into a
+// lock-free SPSC ring, and the streaming thread only pops and writes commands to
+// the serial port. New motion settings mid-job (updateConfig) are applied by planning
+// the rest of the job again in the background and switching to it at the next point
+// where the carriage is at rest with the pen up.
 class PlotSpooler {
 public:
     struct Stats {
@@ -31,97 +39,152 @@ public:
         int queuedMs{0};
         // Elapsed time since job start (ms)
         int elapsedMs{0};
+        // Exact plot time of the compiled job and how much of it has been sent (ms)
+        int plannedMs{0};
+        int doneMs{0};
+        // Pen servo time the job hides under travel (pen overlap), not in plannedMs
+        int penOverlapMs{0};
         // Percent completion [0..1]
         float percentComplete{0.0f};
         // Estimated time remaining (ms)
         int etaMs{0};
+        // Times the streaming thread found the ring empty mid-job, and how long it waited
+        int underruns{0};
+        int underrunMs{0};
     };
 
+    // Time of the streaming thread: pacing, underrun timing and elapsedMs. The default is
+    // the steady clock; tests run the real streamer on simulated time (an EbbSimulator's
+    // VirtualClock). Waits for the planning thread stay on the host's clock.
+    struct StreamClock {
+        std::function<std::chrono::steady_clock::time_point()> now;
+        std::function<void(std::chrono::steady_clock::time_point)> sleepUntil;
+    };
+    static StreamClock steadyClock();
+
     PlotSpooler(SerialController &serial, AxiDrawController &axidraw)
         : m_serial(serial), m_axidraw(axidraw) {}
     ~PlotSpooler();
 
+    // Not while a job is running
+    void setStreamClock(StreamClock clock) { m_clock = std::move(clock); }
+
     bool startJob(const PageModel &page, const PlotterConfig &cfg, bool liftPen = true);
     bool startJobSingle(const PageModel &page, int entityId, const PlotterConfig &cfg, bool liftPen = true);
+    // Replay an already compiled program
+    bool startProgram(std::shared_ptr<const PlotProgram> program, const PlotterConfig &cfg);
+    // Options the start functions compile jobs with
+    static PlotCompileOptions compileOptions(bool liftPen);
     void pause();
     void resume();
+    // Stop the job and wait for the threads to exit
     void cancel();
+    // Stop the job without waiting; isRunning() turns false once the threads have exited
+    void requestCancel();
 
-    // Update motion parameters for future queued chunks while a job is running
+    // Motion and pen settings for the rest of the running job (and the next one). Jobs
+    // that never lift the pen, and programs without draw paths, keep their settings.
     void updateConfig(const PlotterConfig &cfg);
 
     bool isRunning() const { return m_running.load(); }
     bool isPaused() const { return m_paused.load(); }
-    Stats stats() const { return m_stats; }
+    Stats stats() const;
 
 private:
-    // Short-queue job preparation and refilling
-    struct JobState {
-        std::vector<Path> orderedPaths;   // page-space, reordered
-        size_t pathIndex{0};              // current path
-        std::vector<MoveSlice> activeMoves; // planned move slices for current phase
-        size_t moveIndex{0};              // index into activeMoves
-        bool drawingPhase{false};         // false: need travel; true: drawing
-        bool prepared{false};
-        bool sentInitialPenUp{false};
-        bool returnedHome{false};
-        Vec2 currentPosMm{0.0f, 0.0f};
-        bool liftPen{true};
-    };
-
     enum class CmdKind { PenUp, PenDown, StepperMove };
     struct Cmd {
         CmdKind kind{CmdKind::StepperMove};
-        // For SM: duration ms and motor A/B steps (CoreXY mapped)
+        // For SM: duration ms and motor A/B steps (CoreXY mapped). For pen commands the
+        // delay before the next command, -1 for the full servo move.
         int durationMs{0};
         int aSteps{0};
         int bSteps{0};
+        // Sent as LM with these rate/accel registers instead (durationMs is then the estimate)
+        bool lowLevel{false};
+        uint32_t rateA{0};
+        uint32_t rateB{0};
+        int32_t accelA{0};
+        int32_t accelB{0};
+    };
+
+    // Replay position in the compiled program
+    struct JobState {
+        std::shared_ptr<const PlotProgram> program;
+        size_t readOffset{0};             // next command to queue
+        size_t endOffset{0};              // queue up to here; the cut point while replanning
+        int64_t startMs{0};               // job time at the start of program
+        bool configChanged{false};        // m_cfg differs from what program was planned with
+        size_t replanPath{0};             // path of program the replan takes over at
+        std::future<std::shared_ptr<PlotProgram>> replan;
     };
 
     // Constants
     static constexpr int kStepsPerMm = 80; // 2032 steps/in
-    static constexpr int kMaxStepsPerSecond = 5000; // conservative streaming speed
+    // Local search on top of greedy ordering. The greedy pass itself is not bounded by this:
+    // on one core it takes about 0.9 s for a million grid-like paths and 1.2-1.4 s for a
+    // million random segments, where the pen keeps landing in drained regions and each
+    // nearest query has to search outward. That misses the sub-second target for large
+    // random pages.
+    static constexpr double kRefineBudgetMs = 300.0;
+    static constexpr size_t kRingCapacity = 8192;   // commands between producer and streamer
+    static constexpr int kLowWaterMs = 300;          // producer wakes below this much queued motion
+    static constexpr int kHighWaterMs = 1200;        // ...and plans up to this much
 
     SerialController &m_serial;
     AxiDrawController &m_axidraw;
     PlotterConfig m_cfg{};
+    StreamClock m_clock{steadyClock()};
 
-    std::thread m_worker{};
+    std::thread m_worker{};   // streaming thread
+    std::thread m_producer{}; // planning thread
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_paused{false};
     std::atomic<bool> m_cancel{false};
+    std::atomic<bool> m_stopProducer{false};
+    std::atomic<bool> m_producerDone{false};
 
+    // Guards m_cfg and m_job; held by the producer while planning, never by the streamer
     mutable std::mutex m_mutex;
+    std::mutex m_pauseMutex;
     std::condition_variable m_cv;
-    std::queue<Cmd> m_queue;
+    std::mutex m_producerMutex;
+    std::condition_variable m_producerCv;
+    SpscRing<Cmd> m_ring{kRingCapacity};
 
+    mutable std::mutex m_statsMutex;
     Stats m_stats{};
-    int m_queuedMs{0};
+    std::atomic<int> m_queuedMs{0};
+    std::atomic<int> m_commandsQueued{0};
     JobState m_job{};
     std::chrono::steady_clock::time_point m_startTime{};
-    std::optional<int> m_onlyEntityId{};
-
-    static inline int roundToInt(float v) { return static_cast<int>(v >= 0.0f ? v + 0.5f : v - 0.5f); }
-
-    // Build command queue from page paths
-    bool buildQueue(const PageModel &page, bool liftPen);
-    bool buildQueuePlanned(const PageModel &page, bool liftPen);
-
+    bool m_starving{false}; // streaming thread only
+    std::chrono::steady_clock::time_point m_starveStart{};
 
-    bool prepareJob(const PageModel &page, bool liftPen);
     void refillQueueLocked(int highWaterMs, int lowWaterMs);
-
-    // Push helpers
-    void pushPenUp();
-    void pushPenDown();
-    void pushSM(int durationMs, int aSteps, int bSteps);
-
-    // Geometry helpers
-    static inline void mmDeltaToCoreXYSteps(float dxMm, float dyMm, int &aOut, int &bOut);
-    int computeDurationMsForAB(int aSteps, int bSteps, bool plotting) const;
-
-    // Worker loop
+    // Start replanning after a config change, or switch to the replanned program once
+    // everything up to the cut point is queued
+    void replanLocked();
+    bool jobDoneLocked() const;
+    void resetForJobLocked();
+    void launchThreads();
+
+    // False when the ring is full
+    bool pushCmd(const Cmd &c);
+
+    // Producer loop: plans into the ring until the job is fully queued
+    void produce();
+    // Streaming thread: pops from the ring and writes to the device
     void run();
+
+    // Streaming-thread helpers
+    enum class Next { Got, Starved, Done };
+    Next nextCmd(Cmd &cmd);
+    void noteStarved(bool starved);
+    void noteSent(const Cmd &cmd, bool penDownActive, int penMoveMs);
+    // One command per write, host sleeps for each slice
+    bool streamHostTimed(std::string &err);
+    // Pipelined writes that keep deviceBufferMs of motion queued on the EBB
+    bool streamDeviceFifo(int deviceBufferMs, std::string &err);
 };
 
 
@@ -17,5 +17,30 @@ struct PlotterConfig {
     int timeSliceMs{50};
     int maxStepRatePerAxis{5296}; // steps/second per axis
     float minSegmentMm{0.5099999904632568f};
+    // Jerk-limited S-curve profiles (smoother lines at higher speeds)
+    bool sCurve{false};
+    float jerkMmPerS3{20000.0f};
+    // Send one LM (low-level move) per accel/cruise/decel phase instead of SM time slices;
+    // far fewer commands, the EBB ramps the step rate itself. Overrides S-curve.
+    bool lowLevelMoves{false};
+    // Streaming: keep the EBB's motion FIFO topped up (paced by device acknowledgements
+    // and QM queries) instead of sleeping for every slice on the host
+    bool fifoStreaming{true};
+    int deviceBufferMs{250}; // motion kept queued ahead of the device
+    // Hide pen servo moves under travel: start travelling once the tip has cleared the
+    // paper, and start lowering it before the travel ends. Both times depend on the pen
+    // and holder; find them with the pen overlap test card (PenCalibration.h).
+    bool penOverlap{false};
+    int penLiftClearMs{70};  // from the start of a lift until the tip is off the paper
+    int penDropLeadMs{120};  // a drop started this long before travel ends lands after it
     // Future: auto-connect on launch, device VID/PID allowlist, etc.
 };
+
+// Servo time of one pen move between the two positions: |up - down| * 0.06 ms, rounded,
+// at least 1 ms. The delay the EBB is given for SP, and what planning assumes.
+inline int penMoveMs(int penUpPos, int penDownPos)
+{
+    const int diff = penUpPos > penDownPos ? penUpPos - penDownPos : penDownPos - penUpPos;
+    const int ms = (diff * 6 + 50) / 100;
+    return ms < 1 ? 1 : ms;
+}
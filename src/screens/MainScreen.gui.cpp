@@ -6,6 +6,8 @@
 #include <ctime>
 #include "filters/FilterChain.h"
 #include "filters/FilterRegistry.h"
+#include "filters/bitmap/ThresholdFilter.h"
+#include "plotters/PenCalibration.h"
 #include "filters/Types.h"
 #include "core/Theme.h"
 
@@ -172,8 +174,11 @@ void MainScreen::onGui()
                 }
             }
 
-            // Pen position sliders
+            // Pen position sliders. A running job replans its rest with the new settings.
             ImGui::Separator();
+            auto updateRunningJob = [this]() {
+                if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter);
+            };
             int up = m_axState.penUpPos;
             int down = m_axState.penDownPos;
             if (ImGui::SliderInt("Pen Up Position", &up, 8000, 20000))
@@ -185,6 +190,7 @@ void MainScreen::onGui()
                     std::string e;
                     m_ax->setPenUpValue(up, &e);
                 }
+                updateRunningJob();
             }
             if (ImGui::SliderInt("Pen Down Position", &down, 8000, 20000))
             {
@@ -195,6 +201,7 @@ void MainScreen::onGui()
                     std::string e;
                     m_ax->setPenDownValue(down, &e);
                 }
+                updateRunningJob();
             }
 
             // Speed sliders
@@ -204,12 +211,12 @@ void MainScreen::onGui()
             if (ImGui::SliderInt("Drawing Speed (%)", &drawPct, 10, 300))
             {
                 m_plotter.drawSpeedPercent = drawPct;
-                if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter);
+                updateRunningJob();
             }
             if (ImGui::SliderInt("Travel Speed (%)", &travelPct, 10, 300))
             {
                 m_plotter.travelSpeedPercent = travelPct;
-                if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter);
+                updateRunningJob();
             }
 
             if (ImGui::CollapsingHeader("Advanced Motion", ImGuiTreeNodeFlags_DefaultOpen))
@@ -223,25 +230,70 @@ void MainScreen::onGui()
                 int sliceMs = m_plotter.timeSliceMs;
                 int maxRate = m_plotter.maxStepRatePerAxis;
                 float minSeg = m_plotter.minSegmentMm;
+                bool sCurve = m_plotter.sCurve;
+                float jerk = m_plotter.jerkMmPerS3;
+                bool lowLevelMoves = m_plotter.lowLevelMoves;
+                bool fifoStreaming = m_plotter.fifoStreaming;
+                int deviceBufferMs = m_plotter.deviceBufferMs;
 
                 if (ImGui::SliderFloat("Draw Speed (mm/s)", &drawSpeed, 5.0f, 200.0f, "%.1f"))
-                { m_plotter.drawSpeedMmPerS = drawSpeed; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.drawSpeedMmPerS = drawSpeed; updateRunningJob(); }
                 if (ImGui::SliderFloat("Travel Speed (mm/s)", &travelSpeed, 5.0f, 300.0f, "%.1f"))
-                { m_plotter.travelSpeedMmPerS = travelSpeed; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.travelSpeedMmPerS = travelSpeed; updateRunningJob(); }
                 if (ImGui::SliderFloat("Draw Accel (mm/s^2)", &accelDraw, 50.0f, 5000.0f, "%.0f"))
-                { m_plotter.accelDrawMmPerS2 = accelDraw; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.accelDrawMmPerS2 = accelDraw; updateRunningJob(); }
                 if (ImGui::SliderFloat("Travel Accel (mm/s^2)", &accelTravel, 50.0f, 8000.0f, "%.0f"))
-                { m_plotter.accelTravelMmPerS2 = accelTravel; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.accelTravelMmPerS2 = accelTravel; updateRunningJob(); }
                 if (ImGui::SliderFloat("Cornering (jd, mm)", &cornering, 0.00f, 2.00f, "%.2f"))
-                { m_plotter.cornering = cornering; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.cornering = cornering; updateRunningJob(); }
                 if (ImGui::SliderInt("Junction Speed Floor (%)", &junctionFloor, 0, 100))
-                { m_plotter.junctionSpeedFloorPercent = junctionFloor; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.junctionSpeedFloorPercent = junctionFloor; updateRunningJob(); }
                 if (ImGui::SliderInt("Time Slice (ms)", &sliceMs, 2, 100))
-                { m_plotter.timeSliceMs = sliceMs; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.timeSliceMs = sliceMs; updateRunningJob(); }
                 if (ImGui::SliderInt("Max Step Rate (steps/s)", &maxRate, 1000, 30000))
-                { m_plotter.maxStepRatePerAxis = maxRate; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.maxStepRatePerAxis = maxRate; updateRunningJob(); }
                 if (ImGui::SliderFloat("Min Segment (mm)", &minSeg, 0.01f, 1.0f, "%.2f"))
-                { m_plotter.minSegmentMm = minSeg; if (m_spooler && m_spooler->isRunning()) m_spooler->updateConfig(m_plotter); }
+                { m_plotter.minSegmentMm = minSeg; updateRunningJob(); }
+                if (ImGui::Checkbox("S-Curve (jerk limited)", &sCurve))
+                { m_plotter.sCurve = sCurve; updateRunningJob(); }
+                if (sCurve && ImGui::SliderFloat("Jerk (mm/s^3)", &jerk, 1000.0f, 200000.0f, "%.0f"))
+                { m_plotter.jerkMmPerS3 = jerk; updateRunningJob(); }
+                if (ImGui::Checkbox("Low-level moves (LM)", &lowLevelMoves))
+                { m_plotter.lowLevelMoves = lowLevelMoves; updateRunningJob(); }
+                if (ImGui::Checkbox("Device FIFO streaming", &fifoStreaming))
+                { m_plotter.fifoStreaming = fifoStreaming; }
+                if (fifoStreaming && ImGui::SliderInt("Device Buffer (ms)", &deviceBufferMs, 50, 1000))
+                { m_plotter.deviceBufferMs = deviceBufferMs; }
+            }
+
+            if (ImGui::CollapsingHeader("Pen Overlap"))
+            {
+                bool penOverlap = m_plotter.penOverlap;
+                int liftClearMs = m_plotter.penLiftClearMs;
+                int dropLeadMs = m_plotter.penDropLeadMs;
+                const PenOverlapCard card;
+                if (ImGui::Checkbox("Overlap pen moves with travel", &penOverlap))
+                { m_plotter.penOverlap = penOverlap; updateRunningJob(); }
+                if (ImGui::SliderInt("Lift Clear (ms)", &liftClearMs, 0, 500))
+                { m_plotter.penLiftClearMs = liftClearMs; updateRunningJob(); }
+                if (ImGui::SliderInt("Drop Lead (ms)", &dropLeadMs, 0, 500))
+                { m_plotter.penDropLeadMs = dropLeadMs; updateRunningJob(); }
+
+                if (ImGui::Button("Plot Test Card") && m_ax && !(m_spooler && m_spooler->isRunning()))
+                {
+                    if (!m_spooler)
+                    {
+                        m_spooler = std::make_unique<PlotSpooler>(m_serial, *m_ax);
+                    }
+                    if (auto program = compilePenOverlapCard(m_plotter, card, PlotSpooler::compileOptions(true)))
+                        (void)m_spooler->startProgram(program, m_plotter);
+                }
+                ImGui::SliderInt("Last clean row, lifts", &m_penCardLiftRow, 0, card.rows - 1);
+                ImGui::SliderInt("Last clean row, drops", &m_penCardDropRow, 0, card.rows - 1);
+                if (ImGui::Button("Use Test Card Rows"))
+                {
+                    applyPenOverlapCalibration(m_plotter, m_penCardLiftRow, m_penCardDropRow, card.rows);
+                }
             }
 
             ImGui::Separator();
@@ -277,6 +329,11 @@ void MainScreen::onGui()
                 int eMin = elapsedSec / 60, eSec = elapsedSec % 60;
                 int rMin = etaSec / 60, rSec = etaSec % 60;
                 ImGui::Text("Elapsed: %02d:%02d   ETA: %02d:%02d   %.0f%%", eMin, eSec, rMin, rSec, frac * 100.0f);
+                ImGui::Text("Buffered: %d ms   Underruns: %d (%d ms)", s.queuedMs, s.underruns, s.underrunMs);
+                if (s.penOverlapMs > 0)
+                {
+                    ImGui::Text("Pen overlap saves: %d s", s.penOverlapMs / 1000);
+                }
                 if (!m_spooler->isPaused())
                 {
                     ImGui::SameLine();
@@ -312,7 +369,13 @@ void MainScreen::onGui()
             ImGui::Text("Selected Entity: %d", selectedId);
             // ImGui::Text("Payload Version: %llu", static_cast<unsigned long long>(e.payloadVersion));
             auto kindToString = [](LayerKind k) {
-                return (k == LayerKind::Bitmap) ? "Bitmap" : (k == LayerKind::PathSet ? "PathSet" : "Float");
+                switch (k)
+                {
+                case LayerKind::Bitmap: return "Bitmap";
+                case LayerKind::PathSet: return "PathSet";
+                case LayerKind::Mask: return "Mask";
+                default: return "Float";
+                }
             };
             ImGui::Text("Base Kind: %s", kindToString(e.filterChain.baseKind()));
             // ImGui::Text("Base Gen: %llu", static_cast<unsigned long long>(e.filterChain.baseGen()));
@@ -320,6 +383,11 @@ void MainScreen::onGui()
 
             size_t n = e.filterChain.filterCount();
             ImGui::Text("Filters: %llu", static_cast<unsigned long long>(n));
+            if (e.filterChain.isEvaluating())
+            {
+                ImGui::SameLine();
+                ImGui::TextDisabled("(evaluating...)");
+            }
 
             // Add filter buttons based on the next input kind
             LayerKind nextIn = (n == 0)
@@ -365,6 +433,13 @@ void MainScreen::onGui()
                     if (ImGui::Button(label.c_str()))
                     {
                         auto f = info.factory();
+                        // A Mask filter behind a bitmap gets its Threshold made explicit
+                        if (f->inputKind() == LayerKind::Mask && nextIn == LayerKind::Bitmap)
+                        {
+                            auto threshold = std::make_unique<ThresholdFilter>();
+                            threshold->setInkBelow(kImplicitInkCut);
+                            e.filterChain.addFilter(std::move(threshold));
+                        }
                         e.filterChain.addFilter(std::move(f));
                     }
 
@@ -392,8 +467,8 @@ void MainScreen::onGui()
                     return c;
                 };
 
-                const bool inBitmap = (f->inputKind() == LayerKind::Bitmap);
-                const bool outBitmap = (f->outputKind() == LayerKind::Bitmap);
+                const bool inBitmap = (f->inputKind() == LayerKind::Bitmap || f->inputKind() == LayerKind::Mask);
+                const bool outBitmap = (f->outputKind() == LayerKind::Bitmap || f->outputKind() == LayerKind::Mask);
                 Color cin = inBitmap ? theme::BitmapColor : theme::PathsetColor;
                 Color cout = outBitmap ? theme::BitmapColor : theme::PathsetColor;
 
@@ -480,6 +555,8 @@ void MainScreen::onGui()
                             f->lastVertexCount(),
                             f->lastPathCount());
                         ImGui::TextUnformatted(ioinfo.c_str());
+                        if (!f->lastSummary().empty())
+                            ImGui::TextUnformatted(f->lastSummary().c_str());
                     }
 
                     else if (f->outputKind() == LayerKind::Bitmap)
@@ -497,6 +574,21 @@ void MainScreen::onGui()
                         ImGui::TextUnformatted(ioinfo.c_str());
                     }
 
+                    else if (f->outputKind() == LayerKind::Mask)
+                    {
+                        const LayerCache *lcPtr = e.filterChain.layerCacheAt(i);
+                        size_t w = 0, h = 0, ink = 0;
+                        if (lcPtr && lcPtr->data)
+                        {
+                            if (const Mask *mp = asMaskConstPtr(lcPtr->data)) { w = mp->width_px; h = mp->height_px; ink = mp->countSet(); }
+                        }
+                        std::string ioinfo = fmt::format(
+                            "Output {:.3f} ms, {}x{} (mask)  {} ink px",
+                            f->lastRunMs(),
+                            w, h, ink);
+                        ImGui::TextUnformatted(ioinfo.c_str());
+                    }
+
                     else if (f->outputKind() == LayerKind::FloatImage)
                     {
                         const LayerCache *lcPtr = e.filterChain.layerCacheAt(i);
@@ -38,4 +38,7 @@ private:
     std::unique_ptr<PlotSpooler> m_spooler{};
     PlotterConfig m_plotter{};
     char m_portBuf[64] = "";
+    // Pen overlap test card: last clean rows for lifts and drops
+    int m_penCardLiftRow{0};
+    int m_penCardDropRow{0};
 };
@@ -1,5 +1,6 @@
 #include "serial/SerialController.h"
 
+#include <algorithm>
 #include <glog/logging.h>
 #include <vector>
 
@@ -10,6 +11,16 @@
 #  include <devguid.h>
 #  include <initguid.h>
 #  pragma comment(lib, "setupapi.lib")
+#else
+#  include <cerrno>
+#  include <chrono>
+#  include <cstring>
+#  include <dirent.h>
+#  include <fcntl.h>
+#  include <fstream>
+#  include <poll.h>
+#  include <termios.h>
+#  include <unistd.h>
 #endif
 
 namespace {
@@ -53,9 +64,10 @@ bool setCommParams(HANDLE h, int baud, std::string *err) {
     }
 
     COMMTIMEOUTS timeouts{};
-    timeouts.ReadIntervalTimeout = 50;           // ms
-    timeouts.ReadTotalTimeoutConstant = 200;     // ms
-    timeouts.ReadTotalTimeoutMultiplier = 10;    // per byte
+    // Reads return as soon as anything has arrived, or after 50 ms with nothing
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 50;      // ms
     timeouts.WriteTotalTimeoutConstant = 1000;   // ms (raise to tolerate device latency)
     timeouts.WriteTotalTimeoutMultiplier = 5;    // per byte
     if (!SetCommTimeouts(h, &timeouts)) {
@@ -77,6 +89,82 @@ bool setCommParams(HANDLE h, int baud, std::string *err) {
     PurgeComm(h, PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
     return true;
 }
+
+std::string winErrorMessage(const char *what, DWORD code) {
+    char *msg = nullptr;
+    FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+                   nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&msg, 0, nullptr);
+    std::string s = std::string(what) + " failed (code " + std::to_string(code) + ")" + (msg ? std::string(": ") + msg : std::string());
+    if (msg) LocalFree(msg);
+    return s;
+}
+
+// Blocking write on a handle opened for overlapped I/O (the reader thread reads it concurrently)
+bool writeOverlapped(HANDLE h, const char *data, DWORD n, DWORD &written) {
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    written = 0;
+    BOOL ok = WriteFile(h, data, n, nullptr, &ov);
+    if (ok || GetLastError() == ERROR_IO_PENDING) ok = GetOverlappedResult(h, &ov, &written, TRUE);
+    const DWORD code = GetLastError();
+    CloseHandle(ov.hEvent);
+    SetLastError(code);
+    return ok && written == n;
+}
+#else
+std::string errnoMessage(const char *what) {
+    const int code = errno;
+    return std::string(what) + " failed (errno " + std::to_string(code) + "): " + std::strerror(code);
+}
+
+speed_t baudToSpeed(int baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 230400: return B230400;
+    default: return B115200; // USB CDC devices such as the EBB ignore the rate anyway
+    }
+}
+
+bool setCommParams(int fd, int baud, std::string *err) {
+    termios tio{};
+    if (tcgetattr(fd, &tio) != 0) {
+        if (err) *err = errnoMessage("tcgetattr");
+        return false;
+    }
+    // Raw 8N1, no flow control, no modem control lines
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, baudToSpeed(baud));
+    cfsetospeed(&tio, baudToSpeed(baud));
+    if (tcsetattr(fd, TCSANOW, &tio) != 0) {
+        if (err) *err = errnoMessage("tcsetattr");
+        return false;
+    }
+    // Clear any stale data
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+// Milliseconds left until deadline, at least 0
+int msUntil(std::chrono::steady_clock::time_point deadline) {
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    return left.count() > 0 ? static_cast<int>(left.count()) : 0;
+}
+
+std::string readSysfsLine(const std::string &path) {
+    std::ifstream f(path);
+    std::string s;
+    std::getline(f, s);
+    for (char &c : s) c = static_cast<char>(::toupper(static_cast<unsigned char>(c)));
+    return s;
+}
 #endif
 } // namespace
 
@@ -96,7 +184,7 @@ bool SerialController::connect(const std::string &portPath, int baud, std::strin
         0,
         nullptr,
         OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
         nullptr);
 
     if (h == INVALID_HANDLE_VALUE) {
@@ -129,77 +217,281 @@ bool SerialController::connect(const std::string &portPath, int baud, std::strin
     m_state.portPath = portPath;
     m_state.baudRate = baud;
     m_state.lastError.clear();
+    startReader();
     LOG(INFO) << "Serial connected: " << portPath << " @" << baud;
     return true;
 #else
-    (void)portPath; (void)baud; (void)errorOut;
-    m_state.isConnected = false;
-    m_state.lastError = "Serial not supported on this platform";
-    if (errorOut) *errorOut = m_state.lastError;
-    return false;
+    const int fd = ::open(portPath.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    std::string err;
+    if (fd < 0) {
+        err = "Failed to open port: " + errnoMessage("open");
+    } else if (!setCommParams(fd, baud, &err)) {
+        ::close(fd);
+    }
+    if (!err.empty()) {
+        m_state.isConnected = false;
+        m_state.portPath.clear();
+        m_state.baudRate = baud;
+        m_state.lastError = err;
+        if (errorOut) *errorOut = m_state.lastError;
+        return false;
+    }
+
+    m_fd = fd;
+    m_state.isConnected = true;
+    m_state.portPath = portPath;
+    m_state.baudRate = baud;
+    m_state.lastError.clear();
+    startReader();
+    LOG(INFO) << "Serial connected: " << portPath << " @" << baud;
+    return true;
 #endif
 }
 
+void SerialController::connectLoopback(LoopbackDevice device, const std::string &name) {
+    disconnect();
+    m_loopback = std::move(device);
+    m_state.isConnected = true;
+    m_state.portPath = name;
+    m_state.lastError.clear();
+    LOG(INFO) << "Serial connected: " << name << " (in-process)";
+}
+
 void SerialController::disconnect() {
+    stopReader();
+    m_loopback = nullptr;
 #ifdef _WIN32
     if (m_state.isConnected && m_handle && m_handle != INVALID_HANDLE_VALUE) {
         CloseHandle(reinterpret_cast<HANDLE>(m_handle));
     }
+    m_handle = INVALID_HANDLE_VALUE;
+#else
+    if (m_fd >= 0) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
 #endif
+    failPending("Port disconnected");
+    m_rx.clear();
+    m_lost.store(false);
     m_state.isConnected = false;
     m_state.portPath.clear();
 }
 
-bool SerialController::writeLine(std::string_view asciiNoCR, std::string *errorOut) {
-    if (!m_state.isConnected) {
-        if (errorOut) *errorOut = "Port not connected";
-        m_state.lastError = "Port not connected";
-        return false;
-    }
-
-#ifdef _WIN32
+std::future<SerialController::Reply> SerialController::writeLine(std::string_view asciiNoCR, std::string_view replyEnd) {
     std::string withCR;
     withCR.reserve(asciiNoCR.size() + 1);
     withCR.append(asciiNoCR.begin(), asciiNoCR.end());
     withCR.push_back('\r');
+    std::vector<std::future<Reply>> replies;
+    (void)write(withCR, {std::string(replyEnd)}, replies);
+    return std::move(replies.front());
+}
 
+bool SerialController::write(std::string_view bytes, const std::vector<std::string> &replyEnds,
+                             std::vector<std::future<Reply>> &repliesOut, std::string *errorOut) {
+    std::lock_guard<std::mutex> wlk(m_writeMutex);
+    std::string err;
+    if (!isConnected()) {
+        std::lock_guard<std::mutex> lk(m_pendingMutex);
+        err = m_lost.load() ? m_lostError : std::string("Port not connected");
+    }
+    {
+        // Registered before the bytes go out, so that no reply can arrive first
+        std::lock_guard<std::mutex> lk(m_pendingMutex);
+        for (const std::string &end : replyEnds) {
+            Pending p;
+            p.replyEnd = end;
+            repliesOut.push_back(p.reply.get_future());
+            m_pending.push_back(std::move(p));
+        }
+    }
+    if (err.empty() && writeBytes(bytes, &err)) return true;
+
+    // Part of it may have gone out; replies can no longer be told apart
+    if (errorOut) *errorOut = err;
+    failPending(err);
+    return false;
+}
+
+bool SerialController::writeBytes(std::string_view bytes, std::string *errorOut) {
+    if (m_loopback) {
+        // Under m_writeMutex, so replies are matched in write order here as well
+        const std::string reply = m_loopback(bytes);
+        onBytes(reply.data(), reply.size());
+        return true;
+    }
+#ifdef _WIN32
+    HANDLE h = reinterpret_cast<HANDLE>(m_handle);
     DWORD bytesWritten = 0;
-    BOOL ok = WriteFile(reinterpret_cast<HANDLE>(m_handle), withCR.data(), static_cast<DWORD>(withCR.size()), &bytesWritten, nullptr);
-    if (!ok || bytesWritten != withCR.size()) {
-        DWORD code = GetLastError();
-        char *msg = nullptr;
-        FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-                       nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&msg, 0, nullptr);
-        std::string firstErr = std::string("WriteFile failed (code ") + std::to_string(code) + ")" + (msg ? std::string(": ") + msg : std::string());
-        if (msg) LocalFree(msg);
+    if (!writeOverlapped(h, bytes.data(), static_cast<DWORD>(bytes.size()), bytesWritten)) {
+        const std::string firstErr = winErrorMessage("WriteFile", GetLastError());
 
-        // Best-effort recovery: clear errors/queues and retry once
+        // Best-effort recovery: clear errors and the transmit queue and retry once. The
+        // receive side belongs to the reader thread and is left alone.
         DWORD commErrors = 0;
         COMSTAT commStat{};
-        ClearCommError(reinterpret_cast<HANDLE>(m_handle), &commErrors, &commStat);
-        PurgeComm(reinterpret_cast<HANDLE>(m_handle), PURGE_TXABORT | PURGE_RXABORT | PURGE_TXCLEAR | PURGE_RXCLEAR);
+        ClearCommError(h, &commErrors, &commStat);
+        PurgeComm(h, PURGE_TXABORT | PURGE_TXCLEAR);
         Sleep(50);
 
-        bytesWritten = 0;
-        ok = WriteFile(reinterpret_cast<HANDLE>(m_handle), withCR.data(), static_cast<DWORD>(withCR.size()), &bytesWritten, nullptr);
-        if (!ok || bytesWritten != withCR.size()) {
-            code = GetLastError();
-            msg = nullptr;
-            FormatMessageA(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-                           nullptr, code, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), (LPSTR)&msg, 0, nullptr);
-            m_state.lastError = firstErr + std::string("; retry failed (code ") + std::to_string(code) + ")" + (msg ? std::string(": ") + msg : std::string());
-            if (errorOut) *errorOut = m_state.lastError + std::string("; wrote ") + std::to_string(bytesWritten) + "/" + std::to_string(withCR.size()) + " bytes";
-            if (msg) LocalFree(msg);
+        if (!writeOverlapped(h, bytes.data(), static_cast<DWORD>(bytes.size()), bytesWritten)) {
+            m_state.lastError = firstErr + "; retry " + winErrorMessage("WriteFile", GetLastError());
+            if (errorOut) *errorOut = m_state.lastError + std::string("; wrote ") + std::to_string(bytesWritten) + "/" + std::to_string(bytes.size()) + " bytes";
             return false;
         }
     }
     return true;
 #else
-    (void)asciiNoCR; (void)errorOut;
-    m_state.lastError = "Serial not supported on this platform";
-    if (errorOut) *errorOut = m_state.lastError;
-    return false;
+    // The tty is non-blocking: write what the driver takes, wait for room, repeat
+    constexpr int kWriteTimeoutMs = 1000;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(kWriteTimeoutMs);
+    size_t written = 0;
+    while (written < bytes.size()) {
+        const ssize_t n = ::write(m_fd, bytes.data() + written, bytes.size() - written);
+        if (n > 0) {
+            written += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            m_state.lastError = errnoMessage("write");
+            break;
+        }
+        pollfd pfd{m_fd, POLLOUT, 0};
+        const int left = msUntil(deadline);
+        if (left == 0 || (::poll(&pfd, 1, left) < 0 && errno != EINTR)) {
+            m_state.lastError = left == 0 ? std::string("write timed out") : errnoMessage("poll");
+            break;
+        }
+    }
+    if (written < bytes.size()) {
+        if (errorOut) *errorOut = m_state.lastError + std::string("; wrote ") + std::to_string(written) + "/" + std::to_string(bytes.size()) + " bytes";
+        return false;
+    }
+    return true;
+#endif
+}
+
+void SerialController::startReader() {
+    m_stopReader.store(false);
+    m_lost.store(false);
+    m_rx.clear();
+    m_reader = std::thread([this]() { readLoop(); });
+}
+
+void SerialController::stopReader() {
+    if (!m_reader.joinable()) return;
+    m_stopReader.store(true);
+#ifdef _WIN32
+    CancelIoEx(reinterpret_cast<HANDLE>(m_handle), nullptr); // wake a pending read
+#endif
+    m_reader.join();
+}
+
+void SerialController::readLoop() {
+    // Reads wait at most this long, so that stopReader() is noticed
+    constexpr int kPollMs = 50;
+    std::string error;
+#ifdef _WIN32
+    HANDLE h = reinterpret_cast<HANDLE>(m_handle);
+    OVERLAPPED ov{};
+    ov.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    char buf[256];
+    while (!m_stopReader.load()) {
+        ResetEvent(ov.hEvent);
+        DWORD got = 0;
+        // Completes when bytes arrive or after the 50 ms read timeout (see setCommParams)
+        BOOL ok = ReadFile(h, buf, sizeof(buf), nullptr, &ov);
+        if (ok || GetLastError() == ERROR_IO_PENDING) ok = GetOverlappedResult(h, &ov, &got, TRUE);
+        if (!ok) {
+            const DWORD code = GetLastError();
+            if (code == ERROR_OPERATION_ABORTED) continue; // stopReader() or a purge
+            error = winErrorMessage("ReadFile", code);
+            break;
+        }
+        if (got > 0) onBytes(buf, got);
+    }
+    CloseHandle(ov.hEvent);
+    (void)kPollMs;
+#else
+    char buf[256];
+    while (!m_stopReader.load()) {
+        pollfd pfd{m_fd, POLLIN, 0};
+        const int ready = ::poll(&pfd, 1, kPollMs);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            error = errnoMessage("poll");
+            break;
+        }
+        if (ready == 0) continue;
+        // Take everything there is, then look at a hangup
+        ssize_t got = 0;
+        while ((got = ::read(m_fd, buf, sizeof(buf))) > 0) onBytes(buf, static_cast<size_t>(got));
+        if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            error = errnoMessage("read");
+            break;
+        }
+        if (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) {
+            error = "Device disconnected";
+            break;
+        }
+    }
 #endif
+    if (!error.empty()) {
+        LOG(ERROR) << "Serial reader stopped: " << error;
+        {
+            std::lock_guard<std::mutex> lk(m_pendingMutex);
+            m_lostError = error;
+        }
+        m_lost.store(true);
+        failPending(error);
+    }
+}
+
+void SerialController::onBytes(const char *data, size_t n) {
+    // CR and LF both end a line; empty lines are skipped
+    m_rx.append(data, n);
+    size_t start = 0;
+    for (;;) {
+        const size_t end = m_rx.find_first_of("\r\n", start);
+        if (end == std::string::npos) break;
+        if (end > start) onLine(m_rx.substr(start, end - start));
+        start = end + 1;
+    }
+    m_rx.erase(0, start);
+}
+
+void SerialController::onLine(const std::string &line) {
+    std::lock_guard<std::mutex> lk(m_pendingMutex);
+    if (m_pending.empty()) {
+        LOG(WARNING) << "Serial: reply with no command waiting: " << line;
+        return;
+    }
+    Pending &p = m_pending.front();
+    const bool isError = line[0] == '!';
+    if (!isError && line.rfind(p.replyEnd, 0) != 0) {
+        p.data.push_back(line);
+        return;
+    }
+    Reply r;
+    r.ok = !isError;
+    r.line = line;
+    r.data = std::move(p.data);
+    if (isError) r.error = "Device error: " + line;
+    p.reply.set_value(std::move(r));
+    m_pending.pop_front();
+}
+
+void SerialController::failPending(const std::string &error) {
+    std::lock_guard<std::mutex> lk(m_pendingMutex);
+    for (Pending &p : m_pending) {
+        Reply r;
+        r.error = error;
+        r.data = std::move(p.data);
+        p.reply.set_value(std::move(r));
+    }
+    m_pending.clear();
 }
 
 std::string SerialController::normalizeWindowsComPath(const std::string &portPath) const {
@@ -278,8 +570,50 @@ std::vector<SerialController::PortInfo> SerialController::listPorts(std::string
 
     SetupDiDestroyDeviceInfoList(hDevInfo);
     return result;
+#elif defined(__linux__)
+    // USB serial devices show up as /sys/class/tty/<name>/device -> the USB interface,
+    // whose parent directory holds the idVendor/idProduct of the device
+    DIR *dir = opendir("/sys/class/tty");
+    if (!dir) {
+        if (errorOut) *errorOut = "Cannot read /sys/class/tty";
+        return result;
+    }
+    while (dirent *e = readdir(dir)) {
+        const std::string name = e->d_name;
+        if (name.rfind("ttyACM", 0) != 0 && name.rfind("ttyUSB", 0) != 0) continue;
+        const std::string dev = "/sys/class/tty/" + name + "/device";
+        PortInfo info;
+        info.path = "/dev/" + name;
+        // ttyACM: device is the interface; ttyUSB: one level further down
+        for (const char *up : {"/..", "/../.."}) {
+            info.vendorId = readSysfsLine(dev + up + "/idVendor");
+            info.productId = readSysfsLine(dev + up + "/idProduct");
+            if (!info.vendorId.empty()) {
+                info.friendlyName = readSysfsLine(dev + up + "/product");
+                break;
+            }
+        }
+        if (info.friendlyName.empty()) info.friendlyName = name;
+        result.push_back(std::move(info));
+    }
+    closedir(dir);
+    return result;
 #else
-    if (errorOut) *errorOut = "Not supported";
+    // No VID/PID without IOKit; list the usual USB modem nodes by name
+    DIR *dir = opendir("/dev");
+    if (!dir) {
+        if (errorOut) *errorOut = "Cannot read /dev";
+        return result;
+    }
+    while (dirent *e = readdir(dir)) {
+        const std::string name = e->d_name;
+        if (name.rfind("cu.usbmodem", 0) != 0 && name.rfind("cu.usbserial", 0) != 0) continue;
+        PortInfo info;
+        info.path = "/dev/" + name;
+        info.friendlyName = name;
+        result.push_back(std::move(info));
+    }
+    closedir(dir);
     return result;
 #endif
 }
@@ -290,15 +624,16 @@ bool SerialController::autoConnect(std::string *chosenPortOut, int baud, std::st
 
 bool SerialController::autoConnectByVidPid(const std::string &vendorIdUpper, const std::string &productIdUpper,
                                            std::string *chosenPortOut, int baud, std::string *errorOut) {
-#ifdef _WIN32
     std::string err;
     auto ports = listPorts(&err);
     if (!err.empty() && ports.empty()) {
         if (errorOut) *errorOut = err;
         return false;
     }
+    // Where the OS reports no IDs at all (macOS), take the first USB modem port
+    const bool haveIds = std::any_of(ports.begin(), ports.end(), [](const PortInfo &p) { return !p.vendorId.empty(); });
     for (const auto &p : ports) {
-        if (!p.vendorId.empty() && !p.productId.empty() && p.vendorId == vendorIdUpper && p.productId == productIdUpper) {
+        if (!haveIds || (!p.vendorId.empty() && !p.productId.empty() && p.vendorId == vendorIdUpper && p.productId == productIdUpper)) {
             std::string cErr;
             if (connect(p.path, baud, &cErr)) {
                 if (chosenPortOut) *chosenPortOut = p.path;
@@ -311,11 +646,6 @@ bool SerialController::autoConnectByVidPid(const std::string &vendorIdUpper, con
     }
     if (errorOut) *errorOut = "No matching device found";
     return false;
-#else
-    (void)vendorIdUpper; (void)productIdUpper; (void)chosenPortOut; (void)baud;
-    if (errorOut) *errorOut = "Not supported";
-    return false;
-#endif
 }
 
 
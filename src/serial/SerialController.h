@@ -1,23 +1,42 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
-// Windows-only minimal serial controller for COM ports.
-// Provides connect/disconnect and simple line-based write (appends CR).
+// Minimal serial controller for COM ports (Windows) and tty devices (Linux/macOS, termios).
+// Provides connect/disconnect and command writes whose replies come back as futures.
+//
+// While connected a reader thread owns all reads. The device answers commands in the
+// order it got them, so every write registers one pending reply per command and the
+// reader hands each reply line to the oldest pending command: lines before its end
+// line are data, the end line (or an error line starting with '!') completes it.
 class SerialController {
 public:
     static constexpr const char* kEBB_VID = "04D8"; // Microchip VID used by EiBotBoard
     static constexpr const char* kEBB_PID = "FD92"; // EiBotBoard PID
 
     struct PortInfo {
-        std::string path;          // e.g., "COM3"
+        std::string path;          // e.g., "COM3" or "/dev/ttyACM0"
         std::string vendorId;      // e.g., "04D8" (uppercase hex, no 0x)
         std::string productId;     // e.g., "FD92"
         std::string friendlyName;  // e.g., device label
     };
 
+    // Reply to one command
+    struct Reply {
+        bool ok{false};                // ended with the expected line
+        std::string line;              // the line that ended it, e.g. "OK" or "QM,0,0,0,0"
+        std::vector<std::string> data; // lines before it (e.g. the step counts from ES)
+        std::string error;             // device error line or I/O failure when !ok
+    };
+
     struct SerialState {
         bool isConnected{false};
         std::string portPath{};
@@ -28,21 +47,35 @@ public:
     SerialController() = default;
     ~SerialController();
 
-    // Connect to a COM port (e.g., "COM3"). Returns true on success.
+    // Connect to a COM port (e.g., "COM3") or tty device (e.g., "/dev/ttyACM0"). Returns true on success.
     bool connect(const std::string &portPath, int baud = 115200, std::string *errorOut = nullptr);
 
+    // In-process device instead of a port, e.g. a simulator: every write is handed to
+    // 'device', and the bytes it returns are read back as its replies before the write
+    // returns. No reader thread.
+    using LoopbackDevice = std::function<std::string(std::string_view)>;
+    void connectLoopback(LoopbackDevice device, const std::string &name = "loopback");
+
     // Disconnect if connected.
     void disconnect();
 
-    // Returns true if the port is open.
-    bool isConnected() const { return m_state.isConnected; }
+    // Returns true if the port is open and the device has not gone away.
+    bool isConnected() const { return m_state.isConnected && !m_lost.load(); }
+
+    // Write an ASCII command, appending a carriage return ("\r"). The future completes
+    // with the reply ending in a line that starts with replyEnd ("OK" for most EBB
+    // commands, "QM," for QM), or with the error if the device or the port failed.
+    std::future<Reply> writeLine(std::string_view asciiNoCR, std::string_view replyEnd = "OK");
 
-    // Write an ASCII line, automatically appending a carriage return ("\r").
-    bool writeLine(std::string_view asciiNoCR, std::string *errorOut = nullptr);
+    // Several CR-terminated commands in one transfer, with the reply end of each in
+    // order. repliesOut gets one future per command, even when the write fails.
+    bool write(std::string_view bytes, const std::vector<std::string> &replyEnds,
+               std::vector<std::future<Reply>> &repliesOut, std::string *errorOut = nullptr);
 
     const SerialState &state() const { return m_state; }
 
-    // Enumerate COM ports with vendor/product IDs (Windows). Returns empty on failure.
+    // Enumerate serial ports with vendor/product IDs (IDs only where the OS reports them:
+    // Windows, Linux sysfs). Returns empty on failure.
     std::vector<PortInfo> listPorts(std::string *errorOut = nullptr) const;
 
     // Auto-connect to the first matching EBB (VID/PID defaults), returns true on success.
@@ -53,12 +86,38 @@ public:
                              std::string *chosenPortOut = nullptr, int baud = 115200, std::string *errorOut = nullptr);
 
 private:
+    struct Pending {
+        std::string replyEnd;
+        std::vector<std::string> data;
+        std::promise<Reply> reply;
+    };
+
     std::string normalizeWindowsComPath(const std::string &portPath) const;
+    bool writeBytes(std::string_view bytes, std::string *errorOut);
+
+    // Reader thread: split incoming bytes into lines and complete pending replies
+    void startReader();
+    void stopReader();
+    void readLoop();
+    void onBytes(const char *data, size_t n);
+    void onLine(const std::string &line);
+    void failPending(const std::string &error);
 
     SerialState m_state{};
+    std::mutex m_writeMutex;         // keeps pending replies in the order bytes go out
+    std::mutex m_pendingMutex;
+    std::deque<Pending> m_pending;   // oldest first
+    std::string m_rx;                // reader thread (loopback: writer) only: bytes of an unfinished line
+    std::thread m_reader;
+    std::atomic<bool> m_stopReader{false};
+    std::atomic<bool> m_lost{false}; // read failure or hangup; writes fail from then on
+    std::string m_lostError;         // under m_pendingMutex
+    LoopbackDevice m_loopback;       // set instead of a port by connectLoopback()
 
 #ifdef _WIN32
-    void *m_handle{reinterpret_cast<void *>(-1)}; // HANDLE without including windows.h in header
+    void *m_handle{reinterpret_cast<void *>(-1)}; // HANDLE without including windows.h in header; overlapped I/O
+#else
+    int m_fd{-1}; // non-blocking tty; reads and writes wait in poll()
 #endif
 };
 
@@ -0,0 +1,212 @@
+#include "ConnectedComponents.h"
+
+#include <algorithm>
+
+#include "utils/ThreadPool.h"
+
+namespace
+{
+    // Each stripe allocates provisional labels from its own range, sized by the stripe's ink
+    // count, so stripes never coordinate and labels grow in raster order. Roots are always
+    // the smallest label of their set, which makes the final numbering follow raster order
+    // and lets the flattening pass run front to back.
+    struct UnionFind
+    {
+        std::vector<int32_t> parent;
+
+        int32_t find(int32_t a)
+        {
+            while (parent[static_cast<size_t>(a)] != a)
+            {
+                const int32_t g = parent[static_cast<size_t>(parent[static_cast<size_t>(a)])];
+                parent[static_cast<size_t>(a)] = g; // path halving
+                a = g;
+            }
+            return a;
+        }
+
+        int32_t unite(int32_t a, int32_t b)
+        {
+            a = find(a);
+            b = find(b);
+            if (a == b) return a;
+            if (a < b) { parent[static_cast<size_t>(b)] = a; return a; }
+            parent[static_cast<size_t>(a)] = b;
+            return b;
+        }
+    };
+
+    // Join pixel (x, y) with its already-scanned neighbours in row y and, if 'withAbove',
+    // in row y - 1. Returns the label to store (0 if no neighbour is labeled).
+    inline int32_t joinNeighbours(const std::vector<int32_t> &labels, UnionFind &uf, int W, int x, int y,
+                                  bool eight, bool withAbove)
+    {
+        const size_t i = static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x);
+        int32_t l = 0;
+        auto take = [&](int32_t n) {
+            if (n == 0) return;
+            l = (l == 0) ? uf.find(n) : uf.unite(l, n);
+        };
+        if (x > 0) take(labels[i - 1]);
+        if (withAbove)
+        {
+            const size_t up = i - static_cast<size_t>(W);
+            take(labels[up]);
+            if (eight)
+            {
+                if (x > 0) take(labels[up - 1]);
+                if (x + 1 < W) take(labels[up + 1]);
+            }
+        }
+        return l;
+    }
+}
+
+void labelComponents(const Mask &mask, Connectivity conn, ComponentLabels &out, size_t minArea)
+{
+    const int W = static_cast<int>(mask.width_px);
+    const int H = static_cast<int>(mask.height_px);
+    const size_t N = static_cast<size_t>(W) * static_cast<size_t>(H);
+    out.width = W;
+    out.height = H;
+    out.count = 0;
+    out.labels.assign(N, 0);
+    out.boxes.clear();
+    out.areas.clear();
+    out.offsets.assign(1, 0);
+    out.pixels.clear();
+    if (N == 0 || mask.empty())
+        return;
+
+    const bool eight = (conn == Connectivity::Eight);
+    std::vector<int32_t> &labels = out.labels;
+
+    auto forEachInk = [&](int y, auto &&fn) {
+        const uint64_t *bits = mask.row(static_cast<size_t>(y));
+        for (size_t w = 0; w < mask.wordsPerRow; ++w)
+        {
+            uint64_t word = bits[w];
+            while (word)
+            {
+                fn(static_cast<int>(w * 64) + maskbits::lowestBit(word));
+                word &= word - 1;
+            }
+        }
+    };
+
+    const size_t want = ThreadPool::instance().concurrency() * 4;
+    const int stripeRows = std::max(32, static_cast<int>((static_cast<size_t>(H) + want - 1) / want));
+    const size_t stripes = static_cast<size_t>((H + stripeRows - 1) / stripeRows);
+
+    // Label ranges: a stripe creates at most one label per ink pixel
+    std::vector<size_t> base(stripes + 1, 0);
+    parallelForEach(stripes, 1, [&](size_t s) {
+        const size_t w0 = static_cast<size_t>(s) * static_cast<size_t>(stripeRows) * mask.wordsPerRow;
+        const size_t w1 = std::min(static_cast<size_t>(H), (s + 1) * static_cast<size_t>(stripeRows)) * mask.wordsPerRow;
+        size_t ink = 0;
+        for (size_t w = w0; w < w1; ++w) ink += static_cast<size_t>(maskbits::popcount(mask.words[w]));
+        base[s + 1] = ink;
+    });
+    for (size_t s = 0; s < stripes; ++s) base[s + 1] += base[s];
+    const size_t maxLabels = base[stripes];
+
+    UnionFind uf;
+    uf.parent.assign(maxLabels + 1, 0);
+
+    // Pass 1: stripes in parallel. A stripe only touches its own pixels' labels and the
+    // parent entries of labels it created, so stripes never race.
+    parallelForEach(stripes, 1, [&](size_t s) {
+        const int y0 = static_cast<int>(s) * stripeRows;
+        const int y1 = std::min(H, y0 + stripeRows);
+        int32_t next = static_cast<int32_t>(base[s]);
+        for (int y = y0; y < y1; ++y)
+        {
+            forEachInk(y, [&](int x) {
+                const size_t i = static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x);
+                int32_t l = joinNeighbours(labels, uf, W, x, y, eight, y > y0);
+                if (l == 0)
+                {
+                    l = ++next;
+                    uf.parent[static_cast<size_t>(l)] = l;
+                }
+                labels[i] = l;
+            });
+        }
+    });
+
+    // Seam merge: join the first row of every stripe with the row above it
+    for (size_t s = 1; s < stripes; ++s)
+    {
+        const int y = static_cast<int>(s) * stripeRows;
+        forEachInk(y, [&](int x) {
+            const size_t i = static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x);
+            const size_t up = i - static_cast<size_t>(W);
+            const int32_t l = labels[i];
+            if (labels[up]) uf.unite(l, labels[up]);
+            if (eight)
+            {
+                if (x > 0 && labels[up - 1]) uf.unite(l, labels[up - 1]);
+                if (x + 1 < W && labels[up + 1]) uf.unite(l, labels[up + 1]);
+            }
+        });
+    }
+
+    // Flatten front to back: every parent is smaller than its child, so it is already final.
+    // Final ids are stored negated to tell them apart from provisional parents.
+    int32_t count = 0;
+    for (size_t l = 1; l <= maxLabels; ++l)
+    {
+        const int32_t p = uf.parent[l];
+        if (p == 0) continue;
+        uf.parent[l] = (static_cast<size_t>(p) == l) ? -(++count) : uf.parent[static_cast<size_t>(p)];
+    }
+
+    // Pass 2: final labels, then areas and boxes
+    parallelForRows(H, W, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+            forEachInk(y, [&](int x) {
+                int32_t &l = labels[static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x)];
+                l = -uf.parent[static_cast<size_t>(l)];
+            });
+    });
+    std::vector<int32_t>().swap(uf.parent);
+
+    std::vector<uint32_t> areas(static_cast<size_t>(count), 0);
+    std::vector<ComponentBox> boxes(static_cast<size_t>(count), ComponentBox{W, H, -1, -1});
+    for (int y = 0; y < H; ++y)
+    {
+        forEachInk(y, [&](int x) {
+            const size_t c = static_cast<size_t>(labels[static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x)] - 1);
+            ++areas[c];
+            ComponentBox &b = boxes[c];
+            b.minX = std::min(b.minX, x); b.maxX = std::max(b.maxX, x);
+            b.minY = std::min(b.minY, y); b.maxY = std::max(b.maxY, y);
+        });
+    }
+
+    // Drop small components and renumber the survivors
+    std::vector<int32_t> remap(static_cast<size_t>(count) + 1, 0);
+    for (size_t c = 0; c < static_cast<size_t>(count); ++c)
+    {
+        if (areas[c] < minArea) continue;
+        remap[c + 1] = static_cast<int32_t>(++out.count);
+        out.areas.push_back(areas[c]);
+        out.boxes.push_back(boxes[c]);
+    }
+
+    // CSR pixel lists
+    out.offsets.resize(out.count + 1);
+    for (size_t c = 0; c < out.count; ++c)
+        out.offsets[c + 1] = out.offsets[c] + out.areas[c];
+    out.pixels.resize(out.offsets[out.count]);
+    std::vector<uint32_t> cursor(out.offsets.begin(), out.offsets.end() - 1);
+    for (int y = 0; y < H; ++y)
+    {
+        forEachInk(y, [&](int x) {
+            const size_t i = static_cast<size_t>(y) * static_cast<size_t>(W) + static_cast<size_t>(x);
+            const int32_t l = remap[static_cast<size_t>(labels[i])];
+            labels[i] = l;
+            if (l) out.pixels[cursor[static_cast<size_t>(l - 1)]++] = static_cast<int32_t>(i);
+        });
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "core/Mask.h"
+
+// Connected-component labeling of the ink in a Mask.
+//
+// Two-pass union-find: horizontal stripes are labeled in parallel, the stripe seams are
+// merged, and one flattening pass turns provisional labels into final ones. Labels are
+// numbered 1..count in raster order of each component's first pixel, so results do not
+// depend on the stripe layout.
+
+enum class Connectivity
+{
+    Four = 4,
+    Eight = 8
+};
+
+struct ComponentBox
+{
+    int minX{0};
+    int minY{0};
+    int maxX{0};
+    int maxY{0};
+};
+
+struct ComponentLabels
+{
+    int width{0};
+    int height{0};
+    size_t count{0};
+
+    // Per pixel, row-major: 0 = background or dropped, otherwise the component label
+    std::vector<int32_t> labels;
+
+    // Per component, indexed by label - 1
+    std::vector<ComponentBox> boxes;
+    std::vector<uint32_t> areas;
+
+    // Pixel lists in CSR form: component label l owns pixels[offsets[l - 1] .. offsets[l]),
+    // each entry y * width + x, in raster order
+    std::vector<uint32_t> offsets;
+    std::vector<int32_t> pixels;
+
+    size_t begin(size_t label) const { return offsets[label - 1]; }
+    size_t end(size_t label) const { return offsets[label]; }
+};
+
+// Label 'mask'. Components with fewer than minArea pixels are dropped (their pixels get
+// label 0 and they do not appear in the per-component arrays).
+void labelComponents(const Mask &mask, Connectivity conn, ComponentLabels &out, size_t minArea = 0);
@@ -0,0 +1,179 @@
+#include "DistanceTransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "utils/ThreadPool.h"
+
+namespace
+{
+    // Row distance sentinel: no pixel of the wanted class in this row
+    constexpr float kNoSite = std::numeric_limits<float>::infinity();
+
+    // Columns gathered per task so the column pass reads and writes whole cache lines
+    constexpr int kColumnBlock = 16;
+
+    // Lower envelope of the parabolas (q - p)^2 + f(p) for the sites p with finite f, then
+    // d(q) = min_p (q - p)^2 + f(p) written for the q where want[q] is set.
+    struct Envelope
+    {
+        std::vector<int> v;
+        std::vector<double> z;
+        std::vector<double> f;
+
+        explicit Envelope(int n) : v(static_cast<size_t>(n)), z(static_cast<size_t>(n) + 1), f(static_cast<size_t>(n)) {}
+
+        // f must be filled for [0, n); negative entries are "no site"
+        void solve(int n, const uint8_t *want, uint8_t wantValue, double *d)
+        {
+            int k = -1;
+            for (int q = 0; q < n; ++q)
+            {
+                const double fq = f[static_cast<size_t>(q)];
+                if (fq < 0.0)
+                    continue;
+                const double hq = fq + static_cast<double>(q) * q;
+                while (k >= 0)
+                {
+                    const int p = v[static_cast<size_t>(k)];
+                    const double hp = f[static_cast<size_t>(p)] + static_cast<double>(p) * p;
+                    const double s = (hq - hp) / (2.0 * (q - p));
+                    if (s > z[static_cast<size_t>(k)])
+                    {
+                        ++k;
+                        v[static_cast<size_t>(k)] = q;
+                        z[static_cast<size_t>(k)] = s;
+                        break;
+                    }
+                    --k;
+                }
+                if (k < 0)
+                {
+                    k = 0;
+                    v[0] = q;
+                    z[0] = -std::numeric_limits<double>::infinity();
+                }
+                z[static_cast<size_t>(k) + 1] = std::numeric_limits<double>::infinity();
+            }
+            if (k < 0)
+                return; // no sites in this column for this class: keep the caller's value
+
+            int j = 0;
+            for (int q = 0; q < n; ++q)
+            {
+                if (want[q] != wantValue)
+                    continue;
+                while (z[static_cast<size_t>(j) + 1] < q)
+                    ++j;
+                const int p = v[static_cast<size_t>(j)];
+                const double dq = static_cast<double>(q - p);
+                d[q] = dq * dq + f[static_cast<size_t>(p)];
+            }
+        }
+    };
+}
+
+bool signedDistanceTransform(const uint8_t *inside, int width, int height, float *out)
+{
+    if (width <= 0 || height <= 0)
+        return false;
+    const size_t W = static_cast<size_t>(width);
+    const size_t N = W * static_cast<size_t>(height);
+
+    bool hasIn = false, hasOut = false;
+    for (size_t i = 0; i < N && !(hasIn && hasOut); ++i)
+        (inside[i] ? hasIn : hasOut) = true;
+    if (!hasIn || !hasOut)
+    {
+        std::fill(out, out + N, 0.0f);
+        return false;
+    }
+
+    // Row pass: distance along the row to the nearest pixel of the opposite class
+    parallelForRows(height, width, [&](int y0, int y1) {
+        for (int y = y0; y < y1; ++y)
+        {
+            const uint8_t *m = inside + static_cast<size_t>(y) * W;
+            float *o = out + static_cast<size_t>(y) * W;
+            int lastIn = -1, lastOut = -1;
+            for (int x = 0; x < width; ++x)
+            {
+                if (m[x]) lastIn = x; else lastOut = x;
+                const int last = m[x] ? lastOut : lastIn;
+                o[x] = (last < 0) ? kNoSite : static_cast<float>(x - last);
+            }
+            lastIn = lastOut = -1;
+            for (int x = width - 1; x >= 0; --x)
+            {
+                if (m[x]) lastIn = x; else lastOut = x;
+                const int next = m[x] ? lastOut : lastIn;
+                if (next >= 0)
+                    o[x] = std::min(o[x], static_cast<float>(next - x));
+            }
+        }
+    });
+
+    // Column pass over blocks of columns. For the inside pixels we need the row profile of the
+    // outside class: it is the stored value at inside pixels and 0 at outside ones (and the
+    // mirror image for the outside pixels), so both envelopes come from the one buffer.
+    const size_t blocks = (W + kColumnBlock - 1) / kColumnBlock;
+    parallelFor(0, blocks, 1, [&](size_t b0, size_t b1) {
+        const int h = height;
+        const size_t H = static_cast<size_t>(h);
+        Envelope env(h);
+        std::vector<float> g(H * kColumnBlock);
+        std::vector<uint8_t> m(H * kColumnBlock);
+        std::vector<double> d(H);
+
+        for (size_t b = b0; b < b1; ++b)
+        {
+            const size_t x0 = b * kColumnBlock;
+            const size_t bw = std::min<size_t>(kColumnBlock, W - x0);
+
+            for (size_t y = 0; y < H; ++y)
+                for (size_t c = 0; c < bw; ++c)
+                {
+                    g[c * H + y] = out[y * W + x0 + c];
+                    m[c * H + y] = inside[y * W + x0 + c] ? 1 : 0;
+                }
+
+            for (size_t c = 0; c < bw; ++c)
+            {
+                const float *gc = &g[c * H];
+                const uint8_t *mc = &m[c * H];
+                std::fill(d.begin(), d.end(), std::numeric_limits<double>::infinity());
+
+                // Inside pixels: sites are outside pixels (f = 0) and inside pixels that see an
+                // outside pixel somewhere along their row (f = row distance squared)
+                for (size_t y = 0; y < H; ++y)
+                {
+                    const float r = mc[y] ? gc[y] : 0.0f;
+                    env.f[y] = (r == kNoSite) ? -1.0 : static_cast<double>(r) * r;
+                }
+                env.solve(h, mc, 1, d.data());
+
+                // Outside pixels, mirrored
+                for (size_t y = 0; y < H; ++y)
+                {
+                    const float r = mc[y] ? 0.0f : gc[y];
+                    env.f[y] = (r == kNoSite) ? -1.0 : static_cast<double>(r) * r;
+                }
+                env.solve(h, mc, 0, d.data());
+
+                float *gw = &g[c * H];
+                for (size_t y = 0; y < H; ++y)
+                {
+                    const float dist = static_cast<float>(std::sqrt(d[y]));
+                    gw[y] = mc[y] ? -dist : dist;
+                }
+            }
+
+            for (size_t y = 0; y < H; ++y)
+                for (size_t c = 0; c < bw; ++c)
+                    out[y * W + x0 + c] = g[c * H + y];
+        }
+    });
+    return true;
+}
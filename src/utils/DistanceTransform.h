@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+// Exact Euclidean distance transform (Felzenszwalb & Huttenlocher), separable and linear time.
+//
+// Signed field in pixels: for an inside pixel the distance to the nearest outside pixel centre,
+// negated; for an outside pixel the distance to the nearest inside pixel centre. If the image
+// holds only one class the field is all zero. inside[i] != 0 marks inside pixels.
+//
+// Both signs come out of one pass: the row pass stores, per pixel, the row distance to the
+// opposite class in 'out' itself, and the column pass rebuilds both row profiles from it.
+// Returns false (and leaves 'out' zeroed) when only one class is present.
+bool signedDistanceTransform(const uint8_t *inside, int width, int height, float *out);
@@ -1,173 +1,335 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <limits>
 #include <utility>
-#include <functional>
+#include <vector>
 #include "core/Vec2.h"
 
-// Simple 2D KD-Tree supporting insert, remove-by-key, and nearest neighbor.
-// Keys are user-provided unique ints associated with each point.
+// Array-backed 2D point tree over a fixed point set, with removal and nearest neighbor.
+//
+// build() sorts the points along a Z-order (Morton) curve with a radix sort. A node owns a
+// run of the sorted points and splits it where the highest differing bit of the codes
+// changes, i.e. at the middle of its grid cell along alternating axes (at the middle of
+// the run once the codes are equal), down to runs of at most kLeafSize points. Every
+// node keeps the bounding box of its points and how many of them are live, so removal is
+// a walk up one path and searches skip subtrees that are empty or farther than the best
+// hit so far. Points are stored as flat coordinate arrays in curve order, so the build
+// is a few linear passes and leaf scans read contiguous memory.
+//
+// Once removals leave the tree a quarter full it is rebuilt over the survivors (amortized
+// O(1) per removal: they are still in curve order, so no sort is needed), which keeps
+// queries fast while a greedy traversal drains the set.
+//
+// Point ids are indices into the vector passed to build().
 class KdTree2D
 {
 public:
-	KdTree2D() : m_root(nullptr) {}
+	static constexpr uint32_t npos = 0xffffffffu;
 
-	~KdTree2D() { clear(); }
+	// Index every point
+	void build(const std::vector<Vec2> &pts)
+	{
+		build(pts, std::vector<uint8_t>(pts.size(), 1));
+	}
+
+	// Index the points with live[id] != 0
+	void build(const std::vector<Vec2> &pts, const std::vector<uint8_t> &live)
+	{
+		m_pts = pts;
+		m_posOf.assign(pts.size(), npos);
+		std::vector<uint32_t> ids;
+		ids.reserve(pts.size());
+		for (size_t i = 0; i < pts.size(); ++i)
+			if (live[i]) ids.push_back(static_cast<uint32_t>(i));
+		sortAlongCurve(ids);
+		index(ids);
+	}
 
 	void clear()
 	{
-		clearRec(m_root);
-		m_root = nullptr;
+		m_pts.clear();
+		m_posOf.clear();
+		m_code.clear();
+		m_x.clear();
+		m_y.clear();
+		m_id.clear();
+		m_leafOf.clear();
+		m_nodes.clear();
+		m_live = 0;
 	}
 
-	void insert(const Vec2 &p, int key)
+	// Remove a live point. Returns false if it was not in the tree.
+	bool remove(uint32_t id)
 	{
-		m_root = insertRec(m_root, p, key, 0);
+		if (!contains(id)) return false;
+		const uint32_t slot = m_posOf[id];
+		m_posOf[id] = npos;
+		m_id[slot] = npos;
+		--m_live;
+		for (uint32_t node = m_leafOf[slot]; node != npos; node = m_nodes[node].parent)
+			--m_nodes[node].count;
+		if (m_id.size() > 64 && m_live * 4 < m_id.size())
+			rebuild();
+		return true;
 	}
 
-	bool remove(int key)
+	bool contains(uint32_t id) const { return id < m_posOf.size() && m_posOf[id] != npos; }
+	size_t size() const { return m_live; }
+	bool empty() const { return m_live == 0; }
+	const Vec2 &point(uint32_t id) const { return m_pts[id]; }
+
+	// Nearest live point to q (ties go to the lowest id), or npos if empty.
+	// d2Out receives the squared distance.
+	uint32_t nearest(const Vec2 &q, float *d2Out = nullptr) const
 	{
-		bool removed = false;
-		m_root = removeRec(m_root, key, removed);
-		return removed;
+		Best best;
+		if (m_live > 0)
+			nearestRec(0, q, best);
+		if (d2Out) *d2Out = best.d2;
+		return best.id;
 	}
 
-	// Returns pair<key, dist2>; if tree empty, returns <-1, inf>
-	std::pair<int, float> nearest(const Vec2 &q) const
+	// Up to k nearest live points to q, sorted by distance
+	void nearestK(const Vec2 &q, size_t k, std::vector<uint32_t> &out) const
 	{
-		int bestKey = -1;
-		float bestD2 = std::numeric_limits<float>::infinity();
-		nearestRec(m_root, q, bestKey, bestD2);
-		return {bestKey, bestD2};
+		out.clear();
+		if (k == 0 || m_live == 0) return;
+		std::vector<std::pair<float, uint32_t>> heap; // max-heap on (distance, id)
+		heap.reserve(k + 1);
+		nearestKRec(0, q, k, heap);
+		std::sort_heap(heap.begin(), heap.end());
+		for (const auto &h : heap) out.push_back(h.second);
 	}
 
 private:
+	static constexpr uint32_t kLeafSize = 16;
+
+	// Node 0 is the root and a node's left child follows it; a leaf has no children
 	struct Node
 	{
-		Vec2 pt;
-		int key;
-		int axis; // 0:x, 1:y
-		Node *left{nullptr};
-		Node *right{nullptr};
-		Node(const Vec2 &p, int k, int a) : pt(p), key(k), axis(a) {}
+		float minX, minY, maxX, maxY;
+		uint32_t count; // live points
+		uint32_t right; // npos for a leaf
+		uint32_t parent;
+		uint32_t lo, hi; // slots
 	};
 
-	Node *m_root;
+	struct Best
+	{
+		float d2{std::numeric_limits<float>::infinity()};
+		uint32_t id{npos};
+	};
+
+	std::vector<Vec2> m_pts;
+	std::vector<uint32_t> m_posOf; // per id: slot, npos when absent
+	// Slots in curve order; a removed slot keeps its coordinates and gets id npos
+	std::vector<uint32_t> m_code;
+	std::vector<float> m_x, m_y;
+	std::vector<uint32_t> m_id;
+	std::vector<uint32_t> m_leafOf; // per slot
+	std::vector<Node> m_nodes;
+	size_t m_live{0};
 
-	static inline float dist2(const Vec2 &a, const Vec2 &b)
+	static inline float boxDist2(const Node &b, const Vec2 &q)
 	{
-		const float dx = a.x - b.x;
-		const float dy = a.y - b.y;
+		const float dx = std::max(std::max(b.minX - q.x, q.x - b.maxX), 0.0f);
+		const float dy = std::max(std::max(b.minY - q.y, q.y - b.maxY), 0.0f);
 		return dx * dx + dy * dy;
 	}
 
-	void clearRec(Node *n)
+	// Spreads the low 16 bits of v to the even bits
+	static inline uint32_t spreadBits(uint32_t v)
 	{
-		if (!n) return;
-		clearRec(n->left);
-		clearRec(n->right);
-		delete n;
+		v &= 0xffffu;
+		v = (v | (v << 8)) & 0x00ff00ffu;
+		v = (v | (v << 4)) & 0x0f0f0f0fu;
+		v = (v | (v << 2)) & 0x33333333u;
+		v = (v | (v << 1)) & 0x55555555u;
+		return v;
 	}
 
-	Node *insertRec(Node *n, const Vec2 &p, int key, int axis)
+	// Orders ids by the Morton code of their point on a 2^16 grid over the points' bounds,
+	// leaving the codes in m_code
+	void sortAlongCurve(std::vector<uint32_t> &ids)
 	{
-		if (!n) return new Node(p, key, axis);
-
-		const bool goLeft = (axis == 0) ? (p.x < n->pt.x) : (p.y < n->pt.y);
-		if (goLeft)
-			n->left = insertRec(n->left, p, key, 1 - axis);
-		else
-			n->right = insertRec(n->right, p, key, 1 - axis);
-		return n;
+		const size_t n = ids.size();
+		m_code.assign(n, 0);
+		if (n < 2) return;
+		float minX = std::numeric_limits<float>::infinity(), minY = minX;
+		float maxX = -minX, maxY = -minX;
+		for (uint32_t id : ids)
+		{
+			const Vec2 &p = m_pts[id];
+			minX = std::min(minX, p.x); maxX = std::max(maxX, p.x);
+			minY = std::min(minY, p.y); maxY = std::max(maxY, p.y);
+		}
+		// One scale for both axes keeps the grid cells square
+		const float extent = std::max(maxX - minX, maxY - minY);
+		const float scale = extent > 0.0f ? 65535.0f / extent : 0.0f;
+		std::vector<std::pair<uint32_t, uint32_t>> keyed(n), tmp(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const Vec2 &p = m_pts[ids[i]];
+			const uint32_t gx = static_cast<uint32_t>((p.x - minX) * scale);
+			const uint32_t gy = static_cast<uint32_t>((p.y - minY) * scale);
+			keyed[i] = {spreadBits(gx) | (spreadBits(gy) << 1), ids[i]};
+		}
+		// LSD radix sort, 8 bits per pass; stable, so equal codes keep id order
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			size_t bucket[257] = {};
+			for (const auto &k : keyed) ++bucket[((k.first >> shift) & 0xffu) + 1];
+			for (int b = 0; b < 256; ++b) bucket[b + 1] += bucket[b];
+			for (const auto &k : keyed) tmp[bucket[(k.first >> shift) & 0xffu]++] = k;
+			keyed.swap(tmp);
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			m_code[i] = keyed[i].first;
+			ids[i] = keyed[i].second;
+		}
 	}
 
-	Node *findMin(Node *n, int axis, int depthAxis) const
+	void rebuild()
 	{
-		if (!n) return nullptr;
-
-		if (depthAxis == axis)
+		std::vector<uint32_t> ids;
+		ids.reserve(m_live);
+		size_t kept = 0;
+		for (size_t s = 0; s < m_id.size(); ++s)
 		{
-			if (!n->left) return n;
-			return findMin(n->left, axis, 1 - depthAxis);
+			if (m_id[s] == npos) continue;
+			ids.push_back(m_id[s]);
+			m_code[kept++] = m_code[s];
 		}
+		m_code.resize(kept);
+		index(ids);
+	}
 
-		Node *lmin = findMin(n->left, axis, 1 - depthAxis);
-		Node *rmin = findMin(n->right, axis, 1 - depthAxis);
-		Node *minNode = n;
-		if (lmin && ((axis == 0 ? lmin->pt.x < minNode->pt.x : lmin->pt.y < minNode->pt.y))) minNode = lmin;
-		if (rmin && ((axis == 0 ? rmin->pt.x < minNode->pt.x : rmin->pt.y < minNode->pt.y))) minNode = rmin;
-		return minNode;
+	// Lays out ids (in curve order, codes in m_code) and builds the nodes over them
+	void index(const std::vector<uint32_t> &ids)
+	{
+		const size_t n = ids.size();
+		m_live = n;
+		m_id = ids;
+		m_x.resize(n);
+		m_y.resize(n);
+		for (size_t s = 0; s < n; ++s)
+		{
+			const Vec2 &p = m_pts[ids[s]];
+			m_x[s] = p.x;
+			m_y[s] = p.y;
+			m_posOf[ids[s]] = static_cast<uint32_t>(s);
+		}
+		m_leafOf.assign(n, npos);
+		m_nodes.clear();
+		m_nodes.reserve(n / 2 + 1);
+		if (n > 0)
+			buildRec(0, static_cast<uint32_t>(n), npos);
 	}
 
-	Node *removeRec(Node *n, int key, bool &removed)
+	// Where run [lo, hi) splits: the first slot with the highest differing code bit set
+	uint32_t splitOf(uint32_t lo, uint32_t hi) const
 	{
-		if (!n) return nullptr;
+		const uint32_t a = m_code[lo], b = m_code[hi - 1];
+		if (a == b) return lo + (hi - lo) / 2;
+		uint32_t bit = 31;
+		while (!((a ^ b) >> bit)) --bit;
+		const auto it = std::partition_point(m_code.begin() + lo, m_code.begin() + hi,
+			[bit](uint32_t c) { return !((c >> bit) & 1u); });
+		return static_cast<uint32_t>(it - m_code.begin());
+	}
 
-		if (key == n->key)
+	uint32_t buildRec(uint32_t lo, uint32_t hi, uint32_t parent)
+	{
+		const uint32_t self = static_cast<uint32_t>(m_nodes.size());
+		const float inf = std::numeric_limits<float>::infinity();
+		m_nodes.push_back(Node{inf, inf, -inf, -inf, hi - lo, npos, parent, lo, hi});
+		if (hi - lo <= kLeafSize)
 		{
-			removed = true;
-			if (n->right)
-			{
-				Node *m = findMin(n->right, n->axis, 1 - n->axis);
-				n->pt = m->pt;
-				n->key = m->key;
-				n->right = removeRec(n->right, m->key, removed /*ignored*/);
-				return n;
-			}
-			else if (n->left)
+			Node &m = m_nodes[self];
+			for (uint32_t s = lo; s < hi; ++s)
 			{
-				Node *m = findMin(n->left, n->axis, 1 - n->axis);
-				n->pt = m->pt;
-				n->key = m->key;
-				n->left = removeRec(n->left, m->key, removed /*ignored*/);
-				return n;
-			}
-			else
-			{
-				delete n;
-				return nullptr;
+				m.minX = std::min(m.minX, m_x[s]); m.maxX = std::max(m.maxX, m_x[s]);
+				m.minY = std::min(m.minY, m_y[s]); m.maxY = std::max(m.maxY, m_y[s]);
+				m_leafOf[s] = self;
 			}
+			return self;
 		}
-		else
-		{
-			// Because we do not store the key's point here, removal must search both sides.
-			n->left = removeRec(n->left, key, removed);
-			if (!removed) n->right = removeRec(n->right, key, removed);
-			return n;
-		}
+		const uint32_t split = splitOf(lo, hi);
+		buildRec(lo, split, self);
+		const uint32_t right = buildRec(split, hi, self);
+		const Node &l = m_nodes[self + 1], &r = m_nodes[right];
+		Node &m = m_nodes[self];
+		m.right = right;
+		m.minX = std::min(l.minX, r.minX); m.minY = std::min(l.minY, r.minY);
+		m.maxX = std::max(l.maxX, r.maxX); m.maxY = std::max(l.maxY, r.maxY);
+		return self;
 	}
 
-	void nearestRec(Node *n, const Vec2 &q, int &bestKey, float &bestD2) const
+	void nearestRec(uint32_t node, const Vec2 &q, Best &best) const
 	{
-		if (!n) return;
-
-		const float d2 = dist2(q, n->pt);
-		if (d2 < bestD2)
+		const Node &m = m_nodes[node];
+		if (m.right == npos)
 		{
-			bestD2 = d2;
-			bestKey = n->key;
+			for (uint32_t s = m.lo; s < m.hi; ++s)
+			{
+				const uint32_t id = m_id[s];
+				if (id == npos) continue;
+				const float dx = m_x[s] - q.x, dy = m_y[s] - q.y;
+				const float d2 = dx * dx + dy * dy;
+				if (d2 < best.d2 || (d2 == best.d2 && id < best.id)) { best.d2 = d2; best.id = id; }
+			}
+			return;
 		}
+		// Nearer child first; ties need the farther one too, for the lowest id
+		const uint32_t l = node + 1, r = m.right;
+		const float inf = std::numeric_limits<float>::infinity();
+		const float dl = m_nodes[l].count ? boxDist2(m_nodes[l], q) : inf;
+		const float dr = m_nodes[r].count ? boxDist2(m_nodes[r], q) : inf;
+		const uint32_t a = dl <= dr ? l : r, b = dl <= dr ? r : l;
+		const float da = std::min(dl, dr), db = std::max(dl, dr);
+		if (da <= best.d2) nearestRec(a, q, best);
+		if (db <= best.d2) nearestRec(b, q, best);
+	}
 
-		Node *first = nullptr;
-		Node *second = nullptr;
-		float diff = 0.0f;
-		if (n->axis == 0)
+	void nearestKRec(uint32_t node, const Vec2 &q, size_t k, std::vector<std::pair<float, uint32_t>> &heap) const
+	{
+		const Node &m = m_nodes[node];
+		if (m.count == 0) return;
+		if (heap.size() == k && boxDist2(m, q) > heap.front().first) return;
+		if (m.right != npos)
 		{
-			diff = q.x - n->pt.x;
-			if (diff < 0.0f) { first = n->left; second = n->right; }
-			else { first = n->right; second = n->left; }
+			const uint32_t l = node + 1, r = m.right;
+			if (boxDist2(m_nodes[l], q) <= boxDist2(m_nodes[r], q))
+			{
+				nearestKRec(l, q, k, heap);
+				nearestKRec(r, q, k, heap);
+			}
+			else
+			{
+				nearestKRec(r, q, k, heap);
+				nearestKRec(l, q, k, heap);
+			}
+			return;
 		}
-		else
+		for (uint32_t s = m.lo; s < m.hi; ++s)
 		{
-			diff = q.y - n->pt.y;
-			if (diff < 0.0f) { first = n->left; second = n->right; }
-			else { first = n->right; second = n->left; }
+			if (m_id[s] == npos) continue;
+			const float dx = m_x[s] - q.x, dy = m_y[s] - q.y;
+			const std::pair<float, uint32_t> cand(dx * dx + dy * dy, m_id[s]);
+			if (heap.size() < k)
+			{
+				heap.push_back(cand);
+				std::push_heap(heap.begin(), heap.end());
+			}
+			else if (cand < heap.front())
+			{
+				std::pop_heap(heap.begin(), heap.end());
+				heap.back() = cand;
+				std::push_heap(heap.begin(), heap.end());
+			}
 		}
-
-		nearestRec(first, q, bestKey, bestD2);
-		if (diff * diff < bestD2)
-			nearestRec(second, q, bestKey, bestD2);
 	}
 };
-
-
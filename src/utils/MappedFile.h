@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Read-only memory mapping of a whole file. The view stays valid until close() or
+// destruction; the object is move-only.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&o) noexcept { *this = std::move(o); }
+    MappedFile &operator=(MappedFile &&o) noexcept;
+
+    bool open(const std::string &path, std::string *errorOut = nullptr);
+    void close();
+
+    bool isOpen() const { return m_data != nullptr; }
+    const uint8_t *data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    const uint8_t *m_data{nullptr};
+    size_t m_size{0};
+#ifdef _WIN32
+    void *m_file{reinterpret_cast<void *>(-1)}; // HANDLE without including windows.h in header
+    void *m_mapping{nullptr};
+#else
+    int m_fd{-1};
+#endif
+};
@@ -0,0 +1,503 @@
+#include "PathOrdering.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#include "utils/KdTree2D.h"
+
+static inline float distance(const Vec2 &a, const Vec2 &b)
+{
+    const float dx = a.x - b.x, dy = a.y - b.y;
+    return std::sqrt(dx * dx + dy * dy);
+}
+
+// Number of distinct vertices around a closed loop (the repeated closing point excluded)
+static inline size_t cycleLength(const PathView &p)
+{
+    const size_t n = p.points.size();
+    const bool repeated = n > 1 && p.points.front().x == p.points.back().x &&
+                          p.points.front().y == p.points.back().y;
+    return repeated ? n - 1 : n;
+}
+
+static inline Vec2 entryPoint(const PathSet &paths, const PathOrderEntry &o)
+{
+    const PathView p = paths[o.index];
+    if (p.closed)
+        return p.points[o.start];
+    return o.reversed ? p.points.back() : p.points.front();
+}
+
+static inline Vec2 exitPoint(const PathSet &paths, const PathOrderEntry &o)
+{
+    const PathView p = paths[o.index];
+    // A closed loop always ends where it started (see applyPathOrder)
+    if (p.closed)
+        return p.points[o.start];
+    return o.reversed ? p.points.front() : p.points.back();
+}
+
+std::vector<PathOrderEntry> orderPathsGreedy(const PathSet &paths, const Vec2 &start,
+                                             const std::atomic<bool> *cancel)
+{
+    // Point 2i is the first point of path i and 2i + 1 its last; closed loops instead put
+    // every cycle vertex at loopBase[i] + k
+    const size_t n = paths.size();
+    std::vector<Vec2> pts(2 * n);
+    std::vector<uint8_t> live(2 * n, 0);
+    std::vector<uint32_t> loopBase(n, 0);
+    std::vector<uint32_t> loopOf; // path of each loop vertex, indexed from 2n
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        const PathView p = paths[i];
+        if (p.points.empty())
+            continue;
+        ++count;
+        if (p.closed)
+        {
+            loopBase[i] = static_cast<uint32_t>(pts.size());
+            const size_t c = cycleLength(p);
+            for (size_t k = 0; k < c; ++k)
+            {
+                pts.push_back(p.points[k]);
+                live.push_back(1);
+                loopOf.push_back(static_cast<uint32_t>(i));
+            }
+            continue;
+        }
+        pts[2 * i] = p.points.front();
+        pts[2 * i + 1] = p.points.back();
+        live[2 * i] = 1;
+        live[2 * i + 1] = p.points.size() > 1 ? 1 : 0;
+    }
+
+    KdTree2D tree;
+    tree.build(pts, live);
+
+    std::vector<PathOrderEntry> order;
+    order.reserve(count);
+    Vec2 pen = start;
+    while (!tree.empty())
+    {
+        if ((order.size() & 1023) == 0 && cancel && cancel->load(std::memory_order_relaxed))
+            break;
+        const uint32_t e = tree.nearest(pen);
+        PathOrderEntry o{0, false};
+        if (e >= 2 * n)
+        {
+            o.index = loopOf[e - 2 * n];
+            o.start = e - loopBase[o.index];
+            const size_t c = cycleLength(paths[o.index]);
+            for (size_t k = 0; k < c; ++k)
+                tree.remove(loopBase[o.index] + static_cast<uint32_t>(k));
+        }
+        else
+        {
+            o.index = e / 2;
+            o.reversed = (e & 1u) != 0;
+            tree.remove(2 * o.index);
+            tree.remove(2 * o.index + 1);
+        }
+        order.push_back(o);
+        pen = exitPoint(paths, o);
+    }
+    return order;
+}
+
+void applyPathOrder(const PathSet &in, const std::vector<PathOrderEntry> &order, PathSet &out)
+{
+    out.clear();
+    out.reserve(order.size(), in.pointCount());
+    for (const PathOrderEntry &o : order)
+    {
+        const PathView p = in[o.index];
+        if (p.closed && p.points.size() > 1)
+        {
+            // Rotate the cycle and end it back at the start. The plotter draws no implicit
+            // closing segment, so a plain loop gets the point explicitly too, wherever it
+            // is entered.
+            const size_t c = cycleLength(p);
+            for (size_t k = 0; k < c; ++k)
+                out.addPoint(p.points[(o.start + k) % c]);
+            out.addPoint(p.points[o.start]);
+            out.endPath(true);
+        }
+        else if (o.reversed)
+            out.addPathReversed(p);
+        else
+            out.addPath(p);
+    }
+}
+
+void pickLoopEntries(const PathSet &paths, std::vector<PathOrderEntry> &order, const Vec2 &home)
+{
+    constexpr size_t kScanLimit = 64; // smaller loops are scanned directly
+    KdTree2D tree;
+    std::vector<Vec2> cycle;
+    Vec2 pen = home;
+    for (PathOrderEntry &o : order)
+    {
+        const PathView p = paths[o.index];
+        if (p.closed && !p.points.empty())
+        {
+            const size_t c = cycleLength(p);
+            if (c <= kScanLimit)
+            {
+                float best = std::numeric_limits<float>::infinity();
+                for (size_t k = 0; k < c; ++k)
+                {
+                    const float d = distance(pen, p.points[k]);
+                    if (d < best) { best = d; o.start = static_cast<uint32_t>(k); }
+                }
+            }
+            else
+            {
+                cycle.assign(p.points.begin(), p.points.begin() + c);
+                tree.build(cycle);
+                o.start = tree.nearest(pen);
+            }
+        }
+        pen = exitPoint(paths, o);
+    }
+}
+
+TravelCostModel TravelCostModel::fromConfig(const PlotterConfig &cfg)
+{
+    TravelCostModel m;
+    m.travelSpeedMmPerS = cfg.travelSpeedMmPerS;
+    m.travelAccelMmPerS2 = cfg.accelTravelMmPerS2;
+    m.drawSpeedMmPerS = cfg.drawSpeedMmPerS;
+    m.drawAccelMmPerS2 = cfg.accelDrawMmPerS2;
+    const float moveMs = static_cast<float>(penMoveMs(cfg.penUpPos, cfg.penDownPos));
+    m.penMoveS = moveMs / 1000.0f;
+    m.penLiftS = 2.0f * m.penMoveS;
+    if (cfg.penOverlap)
+    {
+        // What is left when the travel is long enough to hide the rest (see PlotProgram)
+        const float clearMs = std::clamp(static_cast<float>(cfg.penLiftClearMs), 0.0f, moveMs);
+        const float leadMs = std::clamp(static_cast<float>(cfg.penDropLeadMs), 0.0f, moveMs);
+        m.penLiftS = (clearMs + moveMs - leadMs) / 1000.0f;
+    }
+    return m;
+}
+
+float TravelCostModel::moveTime(float distMm, float speed, float accel)
+{
+    if (distMm <= 0.0f || speed <= 0.0f)
+        return 0.0f;
+    if (accel <= 0.0f)
+        return distMm / speed;
+    // Accelerating to full speed and back down takes v^2 / a of distance
+    if (distMm >= speed * speed / accel)
+        return distMm / speed + speed / accel;
+    return 2.0f * std::sqrt(distMm / accel);
+}
+
+double estimatePlotSeconds(const PathSet &paths, const std::vector<PathOrderEntry> &order,
+                           const Vec2 &home, const TravelCostModel &model)
+{
+    double total = 0.0;
+    Vec2 pen = home;
+    for (const PathOrderEntry &o : order)
+    {
+        const PathView p = paths[o.index];
+        if (p.points.empty())
+            continue;
+        total += model.travelTime(distance(pen, entryPoint(paths, o)));
+        float len = 0.0f;
+        for (size_t k = 1; k < p.points.size(); ++k)
+            len += distance(p.points[k - 1], p.points[k]);
+        if (p.closed && cycleLength(p) == p.points.size())
+            len += distance(p.points.back(), p.points.front()); // closed by applyPathOrder
+        total += TravelCostModel::moveTime(len, model.drawSpeedMmPerS, model.drawAccelMmPerS2);
+        total += model.penLiftS;
+        pen = exitPoint(paths, o);
+    }
+    total += model.travelTime(distance(pen, home));
+    return total;
+}
+
+namespace
+{
+// Local search state. Positions run 0..m-1; position -1 (before the first path) and
+// position m (after the last) both stand for 'home', so every path has a predecessor
+// and a successor and the return trip is part of the cost.
+class OrderRefiner
+{
+public:
+    OrderRefiner(const PathSet &paths, std::vector<PathOrderEntry> &order, const Vec2 &home,
+                 const TravelCostModel &model)
+        : m_paths(paths), m_order(order), m_home(home), m_model(model),
+          m_m(static_cast<int>(order.size()))
+    {
+        m_pos.assign(paths.size(), -1);
+        for (int k = 0; k < m_m; ++k)
+            m_pos[m_order[k].index] = k;
+
+        std::vector<Vec2> ends(2 * paths.size());
+        std::vector<uint8_t> live(2 * paths.size(), 0);
+        for (const PathOrderEntry &o : m_order)
+        {
+            ends[2 * o.index] = entryPoint(paths, o);
+            ends[2 * o.index + 1] = exitPoint(paths, o);
+            live[2 * o.index] = live[2 * o.index + 1] = 1;
+        }
+        m_tree.build(ends, live);
+        m_neighbors.assign(paths.size() * kNeighbors, KdTree2D::npos);
+        m_hasNeighbors.assign(paths.size(), 0);
+    }
+
+    void run(double budgetMs, const std::atomic<bool> *cancel)
+    {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point deadline =
+            Clock::now() + std::chrono::microseconds(static_cast<int64_t>(budgetMs * 1000.0));
+
+        // Work list of paths whose surroundings changed, starting with all of them in order
+        std::vector<uint32_t> work;
+        std::vector<uint8_t> queued(m_paths.size(), 0);
+        work.reserve(m_m);
+        for (int k = m_m; k-- > 0;)
+        {
+            work.push_back(m_order[k].index);
+            queued[m_order[k].index] = 1;
+        }
+        m_touched.clear();
+
+        size_t iter = 0;
+        while (!work.empty())
+        {
+            if ((++iter & 63) == 0)
+            {
+                if (Clock::now() >= deadline)
+                    break;
+                if (cancel && cancel->load(std::memory_order_relaxed))
+                    break;
+            }
+            const uint32_t p = work.back();
+            work.pop_back();
+            queued[p] = 0;
+            if (!improve(p))
+                continue;
+            for (uint32_t t : m_touched)
+            {
+                if (!queued[t])
+                {
+                    queued[t] = 1;
+                    work.push_back(t);
+                }
+            }
+            m_touched.clear();
+        }
+    }
+
+private:
+    static constexpr int kNeighbors = 8;
+    static constexpr int kMaxSegment = 3;         // Or-opt moves 1..3 consecutive paths
+    static constexpr int kMaxReverse = 50000;     // longest 2-opt reversal, bounds a move's cost
+    static constexpr float kMinGainS = 1e-5f;
+
+    enum class MoveKind { None, Reverse, Move };
+
+    struct Move
+    {
+        MoveKind kind{MoveKind::None};
+        float delta{0.0f};
+        int a{0}, b{0};   // Reverse: positions [a, b]. Move: segment [a, a + len)
+        int len{0};
+        int after{0};     // Move: insert after this position (-1 = at the front)
+        bool flip{false};
+    };
+
+    Vec2 entryAt(int k) const { return k >= m_m ? m_home : entryPoint(m_paths, m_order[k]); }
+    Vec2 exitAt(int k) const { return k < 0 ? m_home : exitPoint(m_paths, m_order[k]); }
+    float cost(const Vec2 &a, const Vec2 &b) const { return m_model.travelTime(distance(a, b)); }
+
+    // Up to kNeighbors other paths with an endpoint near either endpoint of path i
+    const uint32_t *neighbors(uint32_t i)
+    {
+        uint32_t *out = m_neighbors.data() + static_cast<size_t>(i) * kNeighbors;
+        if (m_hasNeighbors[i])
+            return out;
+        m_hasNeighbors[i] = 1;
+
+        std::vector<std::pair<float, uint32_t>> cand;
+        for (uint32_t side = 0; side < 2; ++side)
+        {
+            const Vec2 q = m_tree.point(2 * i + side);
+            m_tree.nearestK(q, kNeighbors + 2, m_scratch);
+            for (uint32_t e : m_scratch)
+            {
+                if (e / 2 == i) continue;
+                const Vec2 d = m_tree.point(e) - q;
+                cand.emplace_back(d.x * d.x + d.y * d.y, e / 2);
+            }
+        }
+        std::sort(cand.begin(), cand.end());
+        int n = 0;
+        for (const auto &c : cand)
+        {
+            if (n == kNeighbors) break;
+            if (std::find(out, out + n, c.second) != out + n) continue;
+            out[n++] = c.second;
+        }
+        return out;
+    }
+
+    void consider(Move &best, const Move &m) const
+    {
+        if (m.delta < best.delta)
+            best = m;
+    }
+
+    // Reverse positions [a, b]: the edges into a and out of b are replaced
+    float reverseDelta(int a, int b) const
+    {
+        const Vec2 before = exitAt(a - 1), after = entryAt(b + 1);
+        return cost(before, exitAt(b)) + cost(entryAt(a), after)
+             - cost(before, entryAt(a)) - cost(exitAt(b), after);
+    }
+
+    bool improve(uint32_t p)
+    {
+        const int i = m_pos[p];
+        Move best;
+        best.delta = -kMinGainS;
+
+        const uint32_t *nb = neighbors(p);
+        for (int n = 0; n < kNeighbors && nb[n] != KdTree2D::npos; ++n)
+        {
+            const int j = m_pos[nb[n]];
+            if (j < 0) continue;
+
+            // 2-opt: join p's entry to q's entry, or p's exit to q's exit
+            {
+                const int a = j > i ? i : j + 1;
+                const int b = j > i ? j - 1 : i;
+                if (b - a < kMaxReverse)
+                {
+                    Move m;
+                    m.kind = MoveKind::Reverse;
+                    m.a = a;
+                    m.b = b;
+                    m.delta = reverseDelta(a, b);
+                    consider(best, m);
+                }
+            }
+
+            // Or-opt: move the segment starting at p next to q, either way round
+            for (int len = 1; len <= kMaxSegment && i + len <= m_m; ++len)
+            {
+                const int last = i + len - 1;
+                if (j >= i - 1 && j <= i + len)
+                    continue;
+                const Vec2 segIn = entryAt(i), segOut = exitAt(last);
+                const float removeGain = cost(exitAt(i - 1), segIn) + cost(segOut, entryAt(last + 1))
+                                       - cost(exitAt(i - 1), entryAt(last + 1));
+                for (int t : {j, j - 1}) // insert after q, or before it
+                {
+                    const Vec2 prev = exitAt(t), next = entryAt(t + 1);
+                    const float gap = cost(prev, next);
+                    Move m;
+                    m.kind = MoveKind::Move;
+                    m.a = i;
+                    m.len = len;
+                    m.after = t;
+                    m.delta = cost(prev, segIn) + cost(segOut, next) - gap - removeGain;
+                    consider(best, m);
+                    m.flip = true;
+                    m.delta = cost(prev, segOut) + cost(segIn, next) - gap - removeGain;
+                    consider(best, m);
+                }
+            }
+        }
+
+        if (best.kind == MoveKind::None)
+            return false;
+        apply(best);
+        return true;
+    }
+
+    void touch(int k)
+    {
+        if (k >= 0 && k < m_m)
+            m_touched.push_back(m_order[k].index);
+    }
+
+    // Reverse positions [a, b] and the direction of the open paths among them. A closed
+    // loop is entered and left at the same vertex, so it costs the same either way round
+    // and keeps its flag.
+    void flipRange(int a, int b)
+    {
+        std::reverse(m_order.begin() + a, m_order.begin() + b + 1);
+        for (int k = a; k <= b; ++k)
+            if (!m_paths.closed(m_order[k].index))
+                m_order[k].reversed = !m_order[k].reversed;
+    }
+
+    void apply(const Move &mv)
+    {
+        int lo = 0, hi = 0;
+        if (mv.kind == MoveKind::Reverse)
+        {
+            touch(mv.a - 1); touch(mv.a); touch(mv.b); touch(mv.b + 1);
+            flipRange(mv.a, mv.b);
+            lo = mv.a;
+            hi = mv.b;
+        }
+        else
+        {
+            const int i = mv.a, last = mv.a + mv.len - 1;
+            touch(i - 1); touch(last + 1); touch(mv.after); touch(mv.after + 1);
+            for (int k = i; k <= last; ++k) touch(k);
+            int start;
+            if (mv.after < i)
+            {
+                std::rotate(m_order.begin() + mv.after + 1, m_order.begin() + i, m_order.begin() + last + 1);
+                start = mv.after + 1;
+                lo = start;
+                hi = last;
+            }
+            else
+            {
+                std::rotate(m_order.begin() + i, m_order.begin() + last + 1, m_order.begin() + mv.after + 1);
+                start = mv.after - mv.len + 1;
+                lo = i;
+                hi = mv.after;
+            }
+            if (mv.flip)
+                flipRange(start, start + mv.len - 1);
+        }
+        for (int k = lo; k <= hi; ++k)
+            m_pos[m_order[k].index] = k;
+    }
+
+    const PathSet &m_paths;
+    std::vector<PathOrderEntry> &m_order;
+    const Vec2 m_home;
+    const TravelCostModel &m_model;
+    const int m_m;
+
+    std::vector<int> m_pos;                 // position of each path in m_order, -1 if absent
+    KdTree2D m_tree;                        // endpoint 2i / 2i + 1 of path i
+    std::vector<uint32_t> m_neighbors;      // kNeighbors per path, npos padded
+    std::vector<uint8_t> m_hasNeighbors;
+    std::vector<uint32_t> m_scratch;
+    std::vector<uint32_t> m_touched;
+};
+}
+
+void refinePathOrder(const PathSet &paths, std::vector<PathOrderEntry> &order, const Vec2 &home,
+                     const TravelCostModel &model, double budgetMs, const std::atomic<bool> *cancel)
+{
+    if (order.size() < 2 || budgetMs <= 0.0)
+        return;
+    {
+        OrderRefiner refiner(paths, order, home, model);
+        refiner.run(budgetMs, cancel);
+    }
+    pickLoopEntries(paths, order, home);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "core/Pathset.h"
+#include "plotters/PlotterConfig.h"
+
+// Pen-up travel ordering for plotting.
+//
+// The result is a permutation of the input paths (index, whether to draw the path
+// backwards, and where to start a closed loop); paths themselves are never copied until
+// applyPathOrder().
+//
+// A closed loop may be entered at any vertex of its cycle. Its points are a cycle, with
+// or without the first point repeated at the end; started at vertex s it is drawn
+// s, s + 1, ... around to s again. The plotter draws no implicit closing segment, so a
+// plain loop gains its closing point whatever vertex it is entered at, and is always
+// drawn in full. Closed loops are never reversed.
+
+struct PathOrderEntry
+{
+    uint32_t index;
+    bool reversed;
+    uint32_t start{0}; // closed loops: vertex the pen enters at
+};
+
+// Greedy nearest-neighbour tour from 'start': repeatedly draw the path whose entry point
+// is closest to the current pen position. Open paths may be entered from either end,
+// closed loops at any vertex. Empty paths are left out. Entry points are kept in a
+// KdTree2D, so a tour costs O(n log n) in the number of candidate points rather than
+// O(n^2). If 'cancel' becomes true the partial order built so far is returned.
+std::vector<PathOrderEntry> orderPathsGreedy(const PathSet &paths, const Vec2 &start,
+                                             const std::atomic<bool> *cancel = nullptr);
+
+// Write the paths of 'in' to 'out' in the given order, direction and loop start
+void applyPathOrder(const PathSet &in, const std::vector<PathOrderEntry> &order, PathSet &out);
+
+// Plot time model for comparing orders. Moves are timed like the motion planner's
+// trapezoid profile (accelerate, cruise, decelerate); a pen-down path is treated as one
+// straight move of its length, which ignores cornering but is the same for any order.
+struct TravelCostModel
+{
+    float travelSpeedMmPerS{120.0f};
+    float travelAccelMmPerS2{1000.0f};
+    float drawSpeedMmPerS{40.0f};
+    float drawAccelMmPerS2{1000.0f};
+    float penLiftS{0.2f}; // one pen up plus one pen down, less what overlaps travel
+    float penMoveS{0.1f}; // one servo move
+
+    static TravelCostModel fromConfig(const PlotterConfig &cfg);
+
+    // Seconds for a pen-up move of the given length
+    float travelTime(float distMm) const { return moveTime(distMm, travelSpeedMmPerS, travelAccelMmPerS2); }
+
+    static float moveTime(float distMm, float speed, float accel);
+};
+
+// Estimated seconds to plot 'order' starting and ending at 'home': pen-up travel,
+// one pen lift per path, and drawing.
+double estimatePlotSeconds(const PathSet &paths, const std::vector<PathOrderEntry> &order,
+                           const Vec2 &home, const TravelCostModel &model);
+
+// Local search over an existing order (e.g. from orderPathsGreedy): 2-opt segment
+// reversals and Or-opt moves of 1-3 paths, each optionally flipped, tried against the
+// nearest paths of every endpoint. A move is kept when it shortens the modelled travel
+// time, including the return to 'home'. Closed paths are never flipped. Stops when no
+// move improves, after budgetMs of wall time, or on cancel; 'order' is always valid.
+// Finally every closed loop is re-entered at its vertex nearest the pen (see
+// pickLoopEntries), since moves change what precedes it.
+void refinePathOrder(const PathSet &paths, std::vector<PathOrderEntry> &order, const Vec2 &home,
+                     const TravelCostModel &model, double budgetMs,
+                     const std::atomic<bool> *cancel = nullptr);
+
+// Start every closed loop in 'order' at the cycle vertex nearest the pen position left by
+// the path before it. Large loops get a KdTree2D over their own vertices, so contours with
+// tens of thousands of points cost O(log n) each.
+void pickLoopEntries(const PathSet &paths, std::vector<PathOrderEntry> &order, const Vec2 &home);
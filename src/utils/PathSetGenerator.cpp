@@ -17,7 +17,7 @@ PathSet Circle(Vec2 center_mm, float radius_mm, int segments, Color col) {
         float y = center_mm.y + radius_mm * sinf(ang);
         path.points.push_back(Vec2{x, y});
     }
-    ps.paths.push_back(std::move(path));
+    ps.addPath(path);
     return ps;
 }
 
@@ -30,7 +30,7 @@ PathSet Square(Vec2 center_mm, float side_mm, Color col) {
     path.points.push_back(center_mm + Vec2{ h, -h});
     path.points.push_back(center_mm + Vec2{ h,  h});
     path.points.push_back(center_mm + Vec2{-h,  h});
-    ps.paths.push_back(std::move(path));
+    ps.addPath(path);
     return ps;
 }
 
@@ -49,7 +49,7 @@ PathSet Star(Vec2 center_mm, float outer_radius_mm, float inner_radius_mm, int p
         float y = center_mm.y + rad * sinf(ang);
         path.points.push_back(Vec2{x, y});
     }
-    ps.paths.push_back(std::move(path));
+    ps.addPath(path);
     return ps;
 }
 
@@ -57,7 +57,7 @@ PathSet Text(const std::string &text, Vec2 origin_mm, float height_mm, float let
     PathSet ps{};
     ps.color = col;
     auto paths = VectorFont::textToPaths(text, origin_mm.x, origin_mm.y, height_mm, letter_spacing_units);
-    ps.paths = std::move(paths);
+    ps.assign(paths);
     return ps;
 }
 
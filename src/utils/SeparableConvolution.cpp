@@ -0,0 +1,641 @@
+#include "SeparableConvolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "utils/ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #define CONV_HAS_SSE2 1
+  #if defined(_MSC_VER)
+    #include <intrin.h>
+  #endif
+  #include <emmintrin.h> // SSE2
+  #include <immintrin.h> // AVX2 (only called after a runtime check)
+  #if defined(__GNUC__) || defined(__clang__)
+    #define CONV_TARGET_AVX2 __attribute__((target("avx2")))
+  #else
+    #define CONV_TARGET_AVX2
+  #endif
+#endif
+
+namespace
+{
+    // Slack after each padded row so vector loads past the last tap stay in bounds
+    constexpr int kRowSlack = 32;
+    // Column strip widths for the vertical pass; (2r+1) strip rows stay cache resident
+    constexpr int kStripU8 = 1024;
+    constexpr int kStripF32 = 256;
+
+    inline int clampi(int v, int lo, int hi)
+    {
+        return (v < lo) ? lo : (v > hi ? hi : v);
+    }
+
+#if defined(CONV_HAS_SSE2)
+    bool detectAvx2()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    bool hasAvx2()
+    {
+        static const bool s_avx2 = detectAvx2();
+        return s_avx2;
+    }
+#endif
+
+    // Copy a row with clamp-to-edge padding of r on both sides plus vector slack
+    template <typename T>
+    inline void padRow(const T *src, int w, int r, T *pad)
+    {
+        for (int i = 0; i < r; ++i)
+            pad[i] = src[0];
+        std::memcpy(pad + r, src, static_cast<size_t>(w) * sizeof(T));
+        for (int i = 0; i < r + kRowSlack; ++i)
+            pad[r + w + i] = src[w - 1];
+    }
+
+    // Two adjacent Q12 taps packed as (lo, hi) 16-bit halves for pmaddwd; odd tap counts
+    // get a trailing zero weight
+    std::vector<int32_t> makeTapPairs(const std::vector<int16_t> &k)
+    {
+        std::vector<int32_t> pairs((k.size() + 1) / 2);
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            uint32_t lo = static_cast<uint16_t>(k[2 * i]);
+            uint32_t hi = (2 * i + 1 < k.size()) ? static_cast<uint16_t>(k[2 * i + 1]) : 0u;
+            pairs[i] = static_cast<int32_t>(lo | (hi << 16));
+        }
+        return pairs;
+    }
+
+    inline uint8_t roundQ12(int sum)
+    {
+        return static_cast<uint8_t>(clampi((sum + 2048) >> 12, 0, 255));
+    }
+
+    // ---------------------------------------------------------------------------------
+    // 8-bit rows. FR > 0 fixes the radius at compile time so the tap loop unrolls.
+    // 'pad' is a padded source row (horizontal) and rows[t] are source rows (vertical);
+    // both compute dst[x] = sum_t k[t] * src_t[x] for x in [x0, x1).
+    // ---------------------------------------------------------------------------------
+
+    template <int FR>
+    void rowU8Scalar(const uint8_t *const *rows, int stride, uint8_t *dst, int x0, int x1, const int16_t *k, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        for (int x = x0; x < x1; ++x)
+        {
+            int sum = 0;
+            for (int t = 0; t < taps; ++t)
+                sum += static_cast<int>(rows[t][x + t * stride]) * k[t];
+            dst[x] = roundQ12(sum);
+        }
+    }
+
+#if defined(CONV_HAS_SSE2)
+    template <int FR>
+    int rowU8Sse2(const uint8_t *const *rows, int stride, uint8_t *dst, int x0, int x1, const int32_t *pairs, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        const int npairs = (taps + 1) / 2;
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi32(2048);
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m128i accLo = bias;
+            __m128i accHi = bias;
+            for (int p = 0; p < npairs; ++p)
+            {
+                const int t = 2 * p;
+                const int t1 = std::min(t + 1, taps - 1); // odd tail: weight is zero
+                const __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[t] + x + t * stride)), zero);
+                const __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[t1] + x + t1 * stride)), zero);
+                const __m128i wp = _mm_set1_epi32(pairs[p]);
+                accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wp));
+                accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wp));
+            }
+            const __m128i s16 = _mm_packs_epi32(_mm_srai_epi32(accLo, 12), _mm_srai_epi32(accHi, 12));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(s16, s16));
+        }
+        return x;
+    }
+
+    template <int FR>
+    CONV_TARGET_AVX2 int rowU8Avx2(const uint8_t *const *rows, int stride, uint8_t *dst, int x0, int x1, const int32_t *pairs, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        const int npairs = (taps + 1) / 2;
+        const __m256i bias = _mm256_set1_epi32(2048);
+        int x = x0;
+        for (; x + 16 <= x1; x += 16)
+        {
+            __m256i accLo = bias;
+            __m256i accHi = bias;
+            for (int p = 0; p < npairs; ++p)
+            {
+                const int t = 2 * p;
+                const int t1 = std::min(t + 1, taps - 1);
+                const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[t] + x + t * stride)));
+                const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[t1] + x + t1 * stride)));
+                const __m256i wp = _mm256_set1_epi32(pairs[p]);
+                accLo = _mm256_add_epi32(accLo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), wp));
+                accHi = _mm256_add_epi32(accHi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), wp));
+            }
+            // In-lane packs keep pixel order per 128-bit lane; gather the two low quadwords
+            const __m256i s16 = _mm256_packs_epi32(_mm256_srai_epi32(accLo, 12), _mm256_srai_epi32(accHi, 12));
+            const __m256i u8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(s16, s16), 0xD8);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm256_castsi256_si128(u8));
+        }
+        return x;
+    }
+#endif
+
+    template <int FR>
+    void rowU8(const uint8_t *const *rows, int stride, uint8_t *dst, int x0, int x1,
+               const int16_t *k, const int32_t *pairs, int rr)
+    {
+        int x = x0;
+#if defined(CONV_HAS_SSE2)
+        if (hasAvx2())
+            x = rowU8Avx2<FR>(rows, stride, dst, x, x1, pairs, rr);
+        x = rowU8Sse2<FR>(rows, stride, dst, x, x1, pairs, rr);
+#else
+        (void)pairs;
+#endif
+        rowU8Scalar<FR>(rows, stride, dst, x, x1, k, rr);
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Float rows, same addressing scheme as the 8-bit rows
+    // ---------------------------------------------------------------------------------
+
+    template <int FR>
+    void rowF32Scalar(const float *const *rows, int stride, float *dst, int x0, int x1, const float *k, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        for (int x = x0; x < x1; ++x)
+        {
+            float sum = 0.0f;
+            for (int t = 0; t < taps; ++t)
+                sum += rows[t][x + t * stride] * k[t];
+            dst[x] = sum;
+        }
+    }
+
+#if defined(CONV_HAS_SSE2)
+    template <int FR>
+    int rowF32Sse2(const float *const *rows, int stride, float *dst, int x0, int x1, const float *k, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        int x = x0;
+        for (; x + 4 <= x1; x += 4)
+        {
+            __m128 acc = _mm_setzero_ps();
+            for (int t = 0; t < taps; ++t)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[t] + x + t * stride), _mm_set1_ps(k[t])));
+            _mm_storeu_ps(dst + x, acc);
+        }
+        return x;
+    }
+
+    template <int FR>
+    CONV_TARGET_AVX2 int rowF32Avx2(const float *const *rows, int stride, float *dst, int x0, int x1, const float *k, int rr)
+    {
+        const int taps = 2 * (FR > 0 ? FR : rr) + 1;
+        int x = x0;
+        for (; x + 8 <= x1; x += 8)
+        {
+            __m256 acc = _mm256_setzero_ps();
+            for (int t = 0; t < taps; ++t)
+                acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(rows[t] + x + t * stride), _mm256_set1_ps(k[t])));
+            _mm256_storeu_ps(dst + x, acc);
+        }
+        return x;
+    }
+#endif
+
+    template <int FR>
+    void rowF32(const float *const *rows, int stride, float *dst, int x0, int x1, const float *k, int rr)
+    {
+        int x = x0;
+#if defined(CONV_HAS_SSE2)
+        if (hasAvx2())
+            x = rowF32Avx2<FR>(rows, stride, dst, x, x1, k, rr);
+        x = rowF32Sse2<FR>(rows, stride, dst, x, x1, k, rr);
+#endif
+        rowF32Scalar<FR>(rows, stride, dst, x, x1, k, rr);
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Two-pass drivers. Horizontal: pad each row once, then every tap reads pad + t
+    // (rows[t] == pad, stride 1). Vertical: rows[t] are the clamped source rows for this
+    // output row (stride 0), walked in column strips so the window stays in cache.
+    // ---------------------------------------------------------------------------------
+
+    template <int FR>
+    void convolveU8Impl(const uint8_t *src, uint8_t *dst, int w, int h, const ConvKernelQ12 &kernel)
+    {
+        const int r = kernel.radius;
+        const int taps = 2 * r + 1;
+        const int16_t *k = kernel.weights.data();
+        const std::vector<int32_t> pairs = makeTapPairs(kernel.weights);
+        std::vector<uint8_t> tmp(static_cast<size_t>(w) * static_cast<size_t>(h));
+
+        parallelForRows(h, w, [&](int y0, int y1) {
+            std::vector<uint8_t> pad(static_cast<size_t>(w + 2 * r + kRowSlack));
+            std::vector<const uint8_t *> rows(static_cast<size_t>(taps), pad.data());
+            for (int y = y0; y < y1; ++y)
+            {
+                padRow(src + static_cast<size_t>(y) * static_cast<size_t>(w), w, r, pad.data());
+                rowU8<FR>(rows.data(), 1, tmp.data() + static_cast<size_t>(y) * static_cast<size_t>(w), 0, w, k, pairs.data(), r);
+            }
+        });
+
+        parallelForRows(h, w, [&](int y0, int y1) {
+            std::vector<const uint8_t *> rows(static_cast<size_t>(taps));
+            for (int xs = 0; xs < w; xs += kStripU8)
+            {
+                const int xe = std::min(w, xs + kStripU8);
+                for (int y = y0; y < y1; ++y)
+                {
+                    for (int t = 0; t < taps; ++t)
+                        rows[static_cast<size_t>(t)] = tmp.data() + static_cast<size_t>(clampi(y + t - r, 0, h - 1)) * static_cast<size_t>(w);
+                    rowU8<FR>(rows.data(), 0, dst + static_cast<size_t>(y) * static_cast<size_t>(w), xs, xe, k, pairs.data(), r);
+                }
+            }
+        });
+    }
+
+    template <int FR>
+    void convolveF32Impl(const float *src, float *dst, int w, int h, const std::vector<float> &kernel, int r)
+    {
+        const int taps = 2 * r + 1;
+        const float *k = kernel.data();
+        std::vector<float> tmp(static_cast<size_t>(w) * static_cast<size_t>(h));
+
+        parallelForRows(h, w, [&](int y0, int y1) {
+            std::vector<float> pad(static_cast<size_t>(w + 2 * r + kRowSlack));
+            std::vector<const float *> rows(static_cast<size_t>(taps), pad.data());
+            for (int y = y0; y < y1; ++y)
+            {
+                padRow(src + static_cast<size_t>(y) * static_cast<size_t>(w), w, r, pad.data());
+                rowF32<FR>(rows.data(), 1, tmp.data() + static_cast<size_t>(y) * static_cast<size_t>(w), 0, w, k, r);
+            }
+        });
+
+        parallelForRows(h, w, [&](int y0, int y1) {
+            std::vector<const float *> rows(static_cast<size_t>(taps));
+            for (int xs = 0; xs < w; xs += kStripF32)
+            {
+                const int xe = std::min(w, xs + kStripF32);
+                for (int y = y0; y < y1; ++y)
+                {
+                    for (int t = 0; t < taps; ++t)
+                        rows[static_cast<size_t>(t)] = tmp.data() + static_cast<size_t>(clampi(y + t - r, 0, h - 1)) * static_cast<size_t>(w);
+                    rowF32<FR>(rows.data(), 0, dst + static_cast<size_t>(y) * static_cast<size_t>(w), xs, xe, k, r);
+                }
+            }
+        });
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Recursive Gaussian (Young & van Vliet, 1995)
+    // ---------------------------------------------------------------------------------
+
+    struct YvvCoeffs
+    {
+        float B{1.0f};
+        float a1{0.0f}, a2{0.0f}, a3{0.0f}; // b1/b0, b2/b0, b3/b0
+    };
+
+    YvvCoeffs makeYvvCoeffs(float sigma)
+    {
+        sigma = std::max(0.5f, sigma);
+        double q = (sigma >= 2.5f)
+                       ? 0.98711 * sigma - 0.96330
+                       : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * sigma);
+        const double q2 = q * q, q3 = q2 * q;
+        const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+        const double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+        const double b2 = -(1.4281 * q2 + 1.26661 * q3);
+        const double b3 = 0.422205 * q3;
+        YvvCoeffs c;
+        c.B = static_cast<float>(1.0 - (b1 + b2 + b3) / b0);
+        c.a1 = static_cast<float>(b1 / b0);
+        c.a2 = static_cast<float>(b2 / b0);
+        c.a3 = static_cast<float>(b3 / b0);
+        return c;
+    }
+
+    // out = B * in + a1 * p1 + a2 * p2 + a3 * p3 over [x0, x1); out may alias in
+    inline void yvvRow(const float *in, const float *p1, const float *p2, const float *p3, float *out,
+                       int x0, int x1, const YvvCoeffs &c)
+    {
+        int x = x0;
+#if defined(CONV_HAS_SSE2)
+        const __m128 vB = _mm_set1_ps(c.B), v1 = _mm_set1_ps(c.a1), v2 = _mm_set1_ps(c.a2), v3 = _mm_set1_ps(c.a3);
+        for (; x + 4 <= x1; x += 4)
+        {
+            __m128 acc = _mm_mul_ps(vB, _mm_loadu_ps(in + x));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v1, _mm_loadu_ps(p1 + x)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v2, _mm_loadu_ps(p2 + x)));
+            acc = _mm_add_ps(acc, _mm_mul_ps(v3, _mm_loadu_ps(p3 + x)));
+            _mm_storeu_ps(out + x, acc);
+        }
+#endif
+        for (; x < x1; ++x)
+            out[x] = c.B * in[x] + c.a1 * p1[x] + c.a2 * p2[x] + c.a3 * p3[x];
+    }
+
+    // In-place causal + anti-causal recursion down the columns of a w x h image. Columns are
+    // independent, so strips of them run in parallel and every step is a row-wide vector op.
+    // Boundaries use the steady state of a constant extension (edge value replicated).
+    void yvvColumns(float *data, int w, int h, const YvvCoeffs &c)
+    {
+        constexpr int kStrip = 256;
+        const size_t W = static_cast<size_t>(w);
+        const size_t strips = (static_cast<size_t>(w) + kStrip - 1) / kStrip;
+        parallelFor(0, strips, 1, [&](size_t s0, size_t s1) {
+            for (size_t s = s0; s < s1; ++s)
+            {
+                const int x0 = static_cast<int>(s) * kStrip;
+                const int x1 = std::min(w, x0 + kStrip);
+                float *first = data;
+                float *last = data + static_cast<size_t>(h - 1) * W;
+                auto row = [&](int y) -> float * {
+                    return (y < 0) ? first : (y >= h ? last : data + static_cast<size_t>(y) * W);
+                };
+
+                // Causal pass: rows above the image read the (unchanged) first row
+                std::vector<float> edge(first + x0, first + x1);
+                const float *e = edge.data() - x0;
+                for (int y = 0; y < h; ++y)
+                {
+                    const float *p1 = (y >= 1) ? row(y - 1) : e;
+                    const float *p2 = (y >= 2) ? row(y - 2) : e;
+                    const float *p3 = (y >= 3) ? row(y - 3) : e;
+                    yvvRow(row(y), p1, p2, p3, row(y), x0, x1, c);
+                }
+
+                // Anti-causal pass: rows below the image hold the last causal output
+                edge.assign(last + x0, last + x1);
+                for (int y = h - 1; y >= 0; --y)
+                {
+                    const float *p1 = (y + 1 < h) ? row(y + 1) : e;
+                    const float *p2 = (y + 2 < h) ? row(y + 2) : e;
+                    const float *p3 = (y + 3 < h) ? row(y + 3) : e;
+                    yvvRow(row(y), p1, p2, p3, row(y), x0, x1, c);
+                }
+            }
+        });
+    }
+
+    // dst (h x w) = transpose of src (w x h), 32x32 blocks, block rows in parallel
+    void transposeF32(const float *src, float *dst, int w, int h)
+    {
+        constexpr int kBlock = 32;
+        const size_t blockRows = (static_cast<size_t>(h) + kBlock - 1) / kBlock;
+        parallelFor(0, blockRows, 1, [&](size_t b0, size_t b1) {
+            for (size_t b = b0; b < b1; ++b)
+            {
+                const int y0 = static_cast<int>(b) * kBlock;
+                const int y1 = std::min(h, y0 + kBlock);
+                for (int x0 = 0; x0 < w; x0 += kBlock)
+                {
+                    const int x1 = std::min(w, x0 + kBlock);
+                    for (int y = y0; y < y1; ++y)
+                        for (int x = x0; x < x1; ++x)
+                            dst[static_cast<size_t>(x) * static_cast<size_t>(h) + static_cast<size_t>(y)] =
+                                src[static_cast<size_t>(y) * static_cast<size_t>(w) + static_cast<size_t>(x)];
+                }
+            }
+        });
+    }
+
+    // ---------------------------------------------------------------------------------
+    // Running-sum box blur (8-bit)
+    // ---------------------------------------------------------------------------------
+
+    // Box widths whose stacked variance matches sigma (Kovesi / Wells)
+    std::vector<int> boxRadiiForGauss(float sigma, int passes)
+    {
+        const double s2 = static_cast<double>(sigma) * sigma;
+        const double wIdeal = std::sqrt(12.0 * s2 / passes + 1.0);
+        int wl = static_cast<int>(std::floor(wIdeal));
+        if (wl % 2 == 0)
+            --wl;
+        wl = std::max(1, wl);
+        const int wu = wl + 2;
+        const double mIdeal = (12.0 * s2 - passes * wl * wl - 4.0 * passes * wl - 3.0 * passes) / (-4.0 * wl - 4.0);
+        const int m = static_cast<int>(std::lround(mIdeal));
+        std::vector<int> radii(static_cast<size_t>(passes));
+        for (int i = 0; i < passes; ++i)
+            radii[static_cast<size_t>(i)] = ((i < m ? wl : wu) - 1) / 2;
+        return radii;
+    }
+
+    void boxHorizontalU8(const uint8_t *src, uint8_t *dst, int w, int h, int r)
+    {
+        const int n = 2 * r + 1;
+        const float inv = 1.0f / static_cast<float>(n);
+        parallelForRows(h, w, [&](int y0, int y1) {
+            std::vector<uint8_t> pad(static_cast<size_t>(w + 2 * r + kRowSlack));
+            for (int y = y0; y < y1; ++y)
+            {
+                padRow(src + static_cast<size_t>(y) * static_cast<size_t>(w), w, r, pad.data());
+                uint8_t *out = dst + static_cast<size_t>(y) * static_cast<size_t>(w);
+                int sum = 0;
+                for (int i = 0; i < n; ++i)
+                    sum += pad[static_cast<size_t>(i)];
+                for (int x = 0; x < w; ++x)
+                {
+                    out[x] = static_cast<uint8_t>(static_cast<float>(sum) * inv + 0.5f);
+                    sum += static_cast<int>(pad[static_cast<size_t>(x + n)]) - static_cast<int>(pad[static_cast<size_t>(x)]);
+                }
+            }
+        });
+    }
+
+    // Column sums are carried down the full height of each column strip, so priming the
+    // window is paid once per strip; every step is a strip-wide add/sub
+    void boxVerticalU8(const uint8_t *src, uint8_t *dst, int w, int h, int r)
+    {
+        constexpr int kStrip = 1024;
+        const int n = 2 * r + 1;
+        const float inv = 1.0f / static_cast<float>(n);
+        const size_t W = static_cast<size_t>(w);
+        auto row = [&](int y) { return src + static_cast<size_t>(clampi(y, 0, h - 1)) * W; };
+        const size_t strips = (W + kStrip - 1) / kStrip;
+        parallelFor(0, strips, 1, [&](size_t s0, size_t s1) {
+            std::vector<int32_t> sums(kStrip);
+            for (size_t s = s0; s < s1; ++s)
+            {
+                const size_t x0 = s * kStrip;
+                const size_t x1 = std::min(W, x0 + kStrip);
+                std::fill(sums.begin(), sums.end(), 0);
+                int32_t *sum = sums.data() - x0;
+                for (int t = -r; t <= r; ++t)
+                {
+                    const uint8_t *in = row(t);
+                    for (size_t x = x0; x < x1; ++x)
+                        sum[x] += in[x];
+                }
+                for (int y = 0; y < h; ++y)
+                {
+                    uint8_t *out = dst + static_cast<size_t>(y) * W;
+                    for (size_t x = x0; x < x1; ++x)
+                        out[x] = static_cast<uint8_t>(static_cast<float>(sum[x]) * inv + 0.5f);
+                    const uint8_t *add = row(y + r + 1);
+                    const uint8_t *sub = row(y - r);
+                    for (size_t x = x0; x < x1; ++x)
+                        sum[x] += static_cast<int32_t>(add[x]) - static_cast<int32_t>(sub[x]);
+                }
+            }
+        });
+    }
+}
+
+ConvKernelQ12 makeGaussianKernelQ12(int radius)
+{
+    ConvKernelQ12 kernel;
+    kernel.radius = std::max(0, radius);
+    const std::vector<float> f = makeGaussianKernelF32(kernel.radius);
+
+    // Round to Q12, keep every tap contributing, then put the rounding residue on the
+    // centre tap so the weights sum to exactly 4096 and normalization is a shift
+    const int scale = 4096;
+    int sum = 0;
+    kernel.weights.resize(f.size());
+    for (size_t i = 0; i < f.size(); ++i)
+    {
+        int v = static_cast<int>(std::lround(f[i] * static_cast<float>(scale)));
+        v = std::max(1, v);
+        kernel.weights[i] = static_cast<int16_t>(v);
+        sum += v;
+    }
+    int centre = kernel.weights[static_cast<size_t>(kernel.radius)] + (scale - sum);
+    kernel.weights[static_cast<size_t>(kernel.radius)] = static_cast<int16_t>(std::max(1, centre));
+    return kernel;
+}
+
+std::vector<float> makeGaussianKernelF32(int radius)
+{
+    radius = std::max(0, radius);
+    const int size = 2 * radius + 1;
+    std::vector<float> kernel(static_cast<size_t>(size));
+    if (radius == 0)
+    {
+        kernel[0] = 1.0f;
+        return kernel;
+    }
+
+    // Derive sigma from radius (radius ~ 3*sigma)
+    const float sigma = std::max(0.5f, static_cast<float>(radius) / 3.0f);
+    const float twoSigma2 = 2.0f * sigma * sigma;
+    float sum = 0.0f;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        const float x = static_cast<float>(i);
+        const float w = std::exp(-(x * x) / twoSigma2);
+        kernel[static_cast<size_t>(i + radius)] = w;
+        sum += w;
+    }
+    for (float &v : kernel)
+        v /= sum;
+    return kernel;
+}
+
+void convolveSeparableU8(const uint8_t *src, uint8_t *dst, int width, int height, const ConvKernelQ12 &kernel)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    switch (kernel.radius)
+    {
+    case 0:
+        std::memcpy(dst, src, static_cast<size_t>(width) * static_cast<size_t>(height));
+        break;
+    case 1: convolveU8Impl<1>(src, dst, width, height, kernel); break;
+    case 2: convolveU8Impl<2>(src, dst, width, height, kernel); break;
+    case 3: convolveU8Impl<3>(src, dst, width, height, kernel); break;
+    case 4: convolveU8Impl<4>(src, dst, width, height, kernel); break;
+    default: convolveU8Impl<0>(src, dst, width, height, kernel); break;
+    }
+}
+
+void convolveSeparableF32(const float *src, float *dst, int width, int height, const std::vector<float> &kernel)
+{
+    if (width <= 0 || height <= 0 || kernel.empty())
+        return;
+    const int r = static_cast<int>(kernel.size() / 2);
+    switch (r)
+    {
+    case 0:
+        for (size_t i = 0; i < static_cast<size_t>(width) * static_cast<size_t>(height); ++i)
+            dst[i] = src[i] * kernel[0] * kernel[0];
+        break;
+    case 1: convolveF32Impl<1>(src, dst, width, height, kernel, r); break;
+    case 2: convolveF32Impl<2>(src, dst, width, height, kernel, r); break;
+    case 3: convolveF32Impl<3>(src, dst, width, height, kernel, r); break;
+    case 4: convolveF32Impl<4>(src, dst, width, height, kernel, r); break;
+    default: convolveF32Impl<0>(src, dst, width, height, kernel, r); break;
+    }
+}
+
+void gaussianRecursiveF32(const float *src, float *dst, int width, int height, float sigma)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    const size_t n = static_cast<size_t>(width) * static_cast<size_t>(height);
+    const YvvCoeffs c = makeYvvCoeffs(sigma);
+
+    // Vertical axis directly on the output, then the horizontal axis as columns of the transpose
+    if (dst != src)
+        std::memcpy(dst, src, n * sizeof(float));
+    yvvColumns(dst, width, height, c);
+
+    std::vector<float> t(n);
+    transposeF32(dst, t.data(), width, height);
+    yvvColumns(t.data(), height, width, c);
+    transposeF32(t.data(), dst, height, width);
+}
+
+void boxBlurStackedU8(const uint8_t *src, uint8_t *dst, int width, int height, float sigma, int passes)
+{
+    if (width <= 0 || height <= 0)
+        return;
+    const size_t n = static_cast<size_t>(width) * static_cast<size_t>(height);
+    passes = std::max(1, passes);
+    const std::vector<int> radii = boxRadiiForGauss(sigma, passes);
+
+    std::vector<uint8_t> tmp(n);
+    const uint8_t *cur = src;
+    for (int r : radii)
+    {
+        if (r <= 0)
+            continue;
+        boxHorizontalU8(cur, tmp.data(), width, height, r);
+        boxVerticalU8(tmp.data(), dst, width, height, r);
+        cur = dst;
+    }
+    if (cur != dst)
+        std::memcpy(dst, src, n);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Shared separable convolution kernels for the blur-type filters (Blur, Float Blur, Canny).
+//
+// Borders are clamp-to-edge. Rows are padded once so the inner loops never clamp, the
+// vertical pass walks rows (not columns) in cache-sized column strips, radii 1..4 get
+// fully unrolled instantiations, and SSE2/AVX2 paths are picked at runtime.
+
+// Fixed-point kernel for 8-bit images: Q12 weights that sum to exactly 4096
+struct ConvKernelQ12
+{
+    int radius{0};
+    std::vector<int16_t> weights; // 2 * radius + 1 taps
+};
+
+// Gaussian with sigma = max(0.5, radius / 3), the convention used by all blur filters
+ConvKernelQ12 makeGaussianKernelQ12(int radius);
+std::vector<float> makeGaussianKernelF32(int radius);
+
+// dst = (src * kx) * ky with the same 1D kernel on both axes. src and dst must not alias.
+// The 8-bit path rounds to 8 bits between the passes.
+void convolveSeparableU8(const uint8_t *src, uint8_t *dst, int width, int height, const ConvKernelQ12 &kernel);
+void convolveSeparableF32(const float *src, float *dst, int width, int height, const std::vector<float> &kernel);
+
+// Constant-cost Gaussian approximations for large radii; runtime does not depend on sigma.
+//
+// Young / van Vliet third-order recursive Gaussian. Both axes run as vertical recursions
+// over whole rows (vectorized across columns); the horizontal axis goes through a blocked
+// transpose. In-place (src == dst) is allowed.
+void gaussianRecursiveF32(const float *src, float *dst, int width, int height, float sigma);
+
+// Stack of 'passes' running-sum box blurs whose widths approximate a Gaussian of sigma
+void boxBlurStackedU8(const uint8_t *src, uint8_t *dst, int width, int height, float sigma, int passes = 3);
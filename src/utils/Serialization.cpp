@@ -1,5 +1,6 @@
 #include "utils/Serialization.h"
 
+#include <cmath>
 #include <fstream>
 #include <sstream>
 #include <filesystem>
@@ -15,9 +16,6 @@
 #include "filters/bitmap/TraceFilter.h"
 #include "filters/pathset/SimplifyFilter.h"
 
-#include "Camera.h"
-#include "Renderer.h"
-
 
 using nlohmann::json;
 
@@ -70,30 +68,45 @@ static void from_json(const json &j, Mat3 &m)
     }
 }
 
-static void to_json(json &j, const Path &p)
+// Paths keep the per-path {closed, points} layout on disk; in memory they are flat
+static void to_json(json &j, const PathView &p)
 {
+    json pts = json::array();
+    for (const Vec2 &v : p.points)
+        pts.push_back(v);
     j = json{
         {"closed", p.closed},
-        {"points", p.points}};
-}
-
-static void from_json(const json &j, Path &p)
-{
-    p.closed = j.value("closed", false);
-    p.points = j.value("points", std::vector<Vec2>{});
+        {"points", std::move(pts)}};
 }
 
 static void to_json(json &j, const PathSet &ps)
 {
+    json paths = json::array();
+    for (const PathView &p : ps)
+        paths.push_back(p);
     j = json{
         {"color", ps.color},
-        {"paths", ps.paths}};
+        {"paths", std::move(paths)}};
 }
 
 static void from_json(const json &j, PathSet &ps)
 {
     ps.color = j.value("color", Color{});
-    ps.paths = j.value("paths", std::vector<Path>{});
+    ps.clear();
+    auto it = j.find("paths");
+    if (it != j.end() && it->is_array())
+    {
+        for (const json &jp : *it)
+        {
+            auto pts = jp.find("points");
+            if (pts != jp.end() && pts->is_array())
+            {
+                for (const json &jv : *pts)
+                    ps.addPoint(jv.get<Vec2>());
+            }
+            ps.endPath(jp.value("closed", false));
+        }
+    }
     // AABB can be recomputed lazily
 }
 
@@ -191,80 +204,43 @@ namespace serialization
 
     static constexpr int kSchemaVersion = 2;
 
-    bool savePageModel(const PageModel &model, const std::string &filePath, std::string *errorOut)
+    static json pageToJson(const PageModel &model)
     {
-        try
+        // Serialize entities directly (avoid copying Entities; FilterChain does not copy filters)
+        json entities = json::array();
+        entities.get_ptr<json::array_t*>()->reserve(model.entities.size());
+        for (const auto &kv : model.entities)
         {
-            // Serialize entities directly (avoid copying Entities; FilterChain does not copy filters)
-            json entities = json::array();
-            entities.get_ptr<json::array_t*>()->reserve(model.entities.size());
-            for (const auto &kv : model.entities)
-            {
-                json je;
-                to_json(je, kv.second);
-                entities.push_back(std::move(je));
-            }
-
-            json j = {
-                {"version", kSchemaVersion},
-                {"page_size_mm", json{{"w", model.page_width_mm}, {"h", model.page_height_mm}}},
-                {"mouse_pixel", model.mouse_pixel},
-                {"mouse_page_mm", model.mouse_page_mm},
-                {"entities", entities}};
-
-            std::ofstream ofs(filePath, std::ios::binary | std::ios::trunc);
-            if (!ofs)
-            {
-                if (errorOut)
-                    *errorOut = "Failed to open file for writing: " + filePath;
-                return false;
-            }
-            ofs << j.dump(2);
-            return true;
-        }
-        catch (const std::exception &ex)
-        {
-            if (errorOut)
-                *errorOut = ex.what();
-            return false;
+            json je;
+            to_json(je, kv.second);
+            entities.push_back(std::move(je));
         }
+
+        return json{
+            {"version", kSchemaVersion},
+            {"page_size_mm", json{{"w", model.page_width_mm}, {"h", model.page_height_mm}}},
+            {"mouse_pixel", model.mouse_pixel},
+            {"mouse_page_mm", model.mouse_page_mm},
+            {"entities", entities}};
     }
 
-    bool loadPageModel(PageModel &model, const std::string &filePath, std::string *errorOut)
+    static void pageFromJson(const json &j, PageModel &model)
     {
-        try
-        {
-            if (!std::filesystem::exists(filePath))
-            {
-                if (errorOut)
-                    *errorOut = "File does not exist: " + filePath;
-                return false;
-            }
-            std::ifstream ifs(filePath, std::ios::binary);
-            if (!ifs)
-            {
-                if (errorOut)
-                    *errorOut = "Failed to open file for reading: " + filePath;
-                return false;
-            }
-            json j;
-            ifs >> j;
-
-            // optional version check
-            int version = j.value("version", 1);
-            (void)version; // keep reserved for future migrations
+        // optional version check
+        int version = j.value("version", 1);
+        (void)version; // keep reserved for future migrations
 
-            model.mouse_pixel = j.value("mouse_pixel", Vec2{});
-            model.mouse_page_mm = j.value("mouse_page_mm", Vec2{});
+        model.mouse_pixel = j.value("mouse_pixel", Vec2{});
+        model.mouse_page_mm = j.value("mouse_page_mm", Vec2{});
 
-            model.entities.clear();
-            if (j.contains("entities") && j["entities"].is_array())
-            {
-                for (const auto &je : j["entities"])
-                {
-                    Entity e = je.get<Entity>();
-                    // Ensure filter chain base is set after payload deserialization
-                    e.refreshFilterBase();
+        model.entities.clear();
+        if (!j.contains("entities") || !j["entities"].is_array())
+            return;
+        for (const auto &je : j["entities"])
+        {
+            Entity e = je.get<Entity>();
+            // Ensure filter chain base is set after payload deserialization
+            e.refreshFilterBase();
 
             // Rebuild filter chain if present
             if (je.contains("filters") && je["filters"].is_array())
@@ -314,88 +290,172 @@ namespace serialization
 
                     if (f)
                     {
+                        // Mask filters used to threshold a bitmap themselves (Skeletonize and
+                        // Trace with their own "threshold", Blobs at 128). Keep that cut as
+                        // an explicit Threshold in front of them.
+                        const size_t n = e.filterChain.filterCount();
+                        const LayerKind upstream = n == 0 ? e.filterChain.baseKind()
+                                                          : e.filterChain.filterAt(n - 1)->outputKind();
+                        if (f->inputKind() == LayerKind::Mask && upstream == LayerKind::Bitmap)
+                        {
+                            auto threshold = std::make_unique<ThresholdFilter>();
+                            const auto it = params.find("threshold");
+                            threshold->setInkBelow(it != params.end() && it->is_number()
+                                                       ? static_cast<int>(std::lround(it->get<float>()))
+                                                       : kImplicitInkCut);
+                            size_t idx = e.filterChain.addFilter(std::move(threshold));
+                            e.filterChain.setFilterEnabled(idx, enabled);
+                        }
                         size_t idx = e.filterChain.addFilter(std::move(f));
                         e.filterChain.setFilterEnabled(idx, enabled);
                     }
                 }
             }
-                    // Move to avoid copying Entity (FilterChain copy does not copy filters)
-                    model.entities[e.id] = std::move(e);
-                }
-            }
-            return true;
-        }
-        catch (const std::exception &ex)
-        {
-            if (errorOut)
-                *errorOut = ex.what();
-            return false;
+            // Move to avoid copying Entity (FilterChain copy does not copy filters)
+            model.entities[e.id] = std::move(e);
         }
     }
 
-    bool saveProject(const PageModel &model, const Camera &camera, const Renderer &renderer,
-                     const PlotterConfig &plotter,
-                     const std::string &filePath, std::string *errorOut)
+    static json plotterToJson(const PlotterConfig &plotter)
     {
-        try
-        {
-            // reuse page serialization
-            json entities = json::array();
-            entities.get_ptr<json::array_t*>()->reserve(model.entities.size());
-            for (const auto &kv : model.entities)
-            {
-                json je;
-                to_json(je, kv.second);
-                entities.push_back(std::move(je));
-            }
+        return json{
+            {"pen_up_pos", plotter.penUpPos},
+            {"pen_down_pos", plotter.penDownPos},
+            {"draw_speed_percent", plotter.drawSpeedPercent},
+            {"travel_speed_percent", plotter.travelSpeedPercent},
+            // mm-based planner settings
+            {"draw_speed_mm_s", plotter.drawSpeedMmPerS},
+            {"travel_speed_mm_s", plotter.travelSpeedMmPerS},
+            {"accel_draw_mm_s2", plotter.accelDrawMmPerS2},
+            {"accel_travel_mm_s2", plotter.accelTravelMmPerS2},
+            {"cornering", plotter.cornering},
+            {"time_slice_ms", plotter.timeSliceMs},
+            {"max_step_rate_per_axis", plotter.maxStepRatePerAxis},
+            {"min_segment_mm", plotter.minSegmentMm},
+            {"junction_speed_floor_percent", plotter.junctionSpeedFloorPercent},
+            {"s_curve", plotter.sCurve},
+            {"jerk_mm_s3", plotter.jerkMmPerS3},
+            {"low_level_moves", plotter.lowLevelMoves},
+            {"fifo_streaming", plotter.fifoStreaming},
+            {"device_buffer_ms", plotter.deviceBufferMs},
+            {"pen_overlap", plotter.penOverlap},
+            {"pen_lift_clear_ms", plotter.penLiftClearMs},
+            {"pen_drop_lead_ms", plotter.penDropLeadMs}
+        };
+    }
 
-            json j = {
-                {"version", kSchemaVersion},
-                {"page_size_mm", json{{"w", model.page_width_mm}, {"h", model.page_height_mm}}},
-                {"mouse_pixel", model.mouse_pixel},
-                {"mouse_page_mm", model.mouse_page_mm},
-                {"entities", entities}
-            };
+    static void plotterFromJson(const json &p, PlotterConfig &plotter)
+    {
+        plotter.penUpPos = p.value("pen_up_pos", plotter.penUpPos);
+        plotter.penDownPos = p.value("pen_down_pos", plotter.penDownPos);
+        plotter.drawSpeedPercent = p.value("draw_speed_percent", plotter.drawSpeedPercent);
+        plotter.travelSpeedPercent = p.value("travel_speed_percent", plotter.travelSpeedPercent);
+        // mm-based planner settings (with defaults)
+        plotter.drawSpeedMmPerS = p.value("draw_speed_mm_s", plotter.drawSpeedMmPerS);
+        plotter.travelSpeedMmPerS = p.value("travel_speed_mm_s", plotter.travelSpeedMmPerS);
+        plotter.accelDrawMmPerS2 = p.value("accel_draw_mm_s2", plotter.accelDrawMmPerS2);
+        plotter.accelTravelMmPerS2 = p.value("accel_travel_mm_s2", plotter.accelTravelMmPerS2);
+        plotter.cornering = p.value("cornering", plotter.cornering);
+        plotter.timeSliceMs = p.value("time_slice_ms", plotter.timeSliceMs);
+        plotter.maxStepRatePerAxis = p.value("max_step_rate_per_axis", plotter.maxStepRatePerAxis);
+        plotter.minSegmentMm = p.value("min_segment_mm", plotter.minSegmentMm);
+        plotter.junctionSpeedFloorPercent = p.value("junction_speed_floor_percent", plotter.junctionSpeedFloorPercent);
+        plotter.sCurve = p.value("s_curve", plotter.sCurve);
+        plotter.jerkMmPerS3 = p.value("jerk_mm_s3", plotter.jerkMmPerS3);
+        plotter.lowLevelMoves = p.value("low_level_moves", plotter.lowLevelMoves);
+        plotter.fifoStreaming = p.value("fifo_streaming", plotter.fifoStreaming);
+        plotter.deviceBufferMs = p.value("device_buffer_ms", plotter.deviceBufferMs);
+        plotter.penOverlap = p.value("pen_overlap", plotter.penOverlap);
+        plotter.penLiftClearMs = p.value("pen_lift_clear_ms", plotter.penLiftClearMs);
+        plotter.penDropLeadMs = p.value("pen_drop_lead_ms", plotter.penDropLeadMs);
+    }
 
+    static json projectToJson(const PageModel &model, const PlotterConfig &plotter, const ProjectView *view)
+    {
+        json j = pageToJson(model);
+
+        if (view)
+        {
             // Camera state
-            Vec2 camCenter = camera.center();
             j["camera"] = json{
-                {"center", camCenter},
-                {"zoom", camera.zoom()}
+                {"center", view->cameraCenter},
+                {"zoom", view->cameraZoom}
             };
 
             // Renderer state
             j["render"] = json{
-                {"line_width", renderer.lineWidth()},
-                {"node_diameter_px", renderer.nodeDiameterPx()}
+                {"line_width", view->lineWidth},
+                {"node_diameter_px", view->nodeDiameterPx}
             };
+        }
 
-            // Plotter config
-            j["plotter"] = json{
-                {"pen_up_pos", plotter.penUpPos},
-                {"pen_down_pos", plotter.penDownPos},
-                {"draw_speed_percent", plotter.drawSpeedPercent},
-                {"travel_speed_percent", plotter.travelSpeedPercent},
-                // mm-based planner settings
-                {"draw_speed_mm_s", plotter.drawSpeedMmPerS},
-                {"travel_speed_mm_s", plotter.travelSpeedMmPerS},
-                {"accel_draw_mm_s2", plotter.accelDrawMmPerS2},
-                {"accel_travel_mm_s2", plotter.accelTravelMmPerS2},
-                {"cornering", plotter.cornering},
-                {"time_slice_ms", plotter.timeSliceMs},
-                {"max_step_rate_per_axis", plotter.maxStepRatePerAxis},
-                {"min_segment_mm", plotter.minSegmentMm},
-                {"junction_speed_floor_percent", plotter.junctionSpeedFloorPercent}
-            };
+        // Plotter config
+        j["plotter"] = plotterToJson(plotter);
+        return j;
+    }
 
-            std::ofstream ofs(filePath, std::ios::binary | std::ios::trunc);
-            if (!ofs)
+    static void projectFromJson(const json &j, PageModel &model, PlotterConfig &plotter, ProjectView *view)
+    {
+        pageFromJson(j, model);
+
+        if (view)
+        {
+            // Optional camera
+            view->hasCamera = j.contains("camera");
+            if (view->hasCamera)
             {
-                if (errorOut) *errorOut = "Failed to open file for writing: " + filePath;
-                return false;
+                view->cameraCenter = j["camera"].value("center", view->cameraCenter);
+                view->cameraZoom = j["camera"].value("zoom", view->cameraZoom);
             }
-            ofs << j.dump(2);
-            return true;
+
+            // Optional renderer
+            view->hasRender = j.contains("render");
+            if (view->hasRender)
+            {
+                view->lineWidth = j["render"].value("line_width", view->lineWidth);
+                view->nodeDiameterPx = j["render"].value("node_diameter_px", view->nodeDiameterPx);
+            }
+        }
+
+        // Plotter config (supports new key and legacy "axidraw")
+        if (j.contains("plotter"))
+            plotterFromJson(j["plotter"], plotter);
+    }
+
+    static bool writeJson(const json &j, const std::string &filePath, std::string *errorOut)
+    {
+        std::ofstream ofs(filePath, std::ios::binary | std::ios::trunc);
+        if (!ofs)
+        {
+            if (errorOut) *errorOut = "Failed to open file for writing: " + filePath;
+            return false;
+        }
+        ofs << j.dump(2);
+        return true;
+    }
+
+    static bool readJson(json &j, const std::string &filePath, std::string *errorOut)
+    {
+        if (!std::filesystem::exists(filePath))
+        {
+            if (errorOut) *errorOut = "File does not exist: " + filePath;
+            return false;
+        }
+        std::ifstream ifs(filePath, std::ios::binary);
+        if (!ifs)
+        {
+            if (errorOut) *errorOut = "Failed to open file for reading: " + filePath;
+            return false;
+        }
+        ifs >> j;
+        return true;
+    }
+
+    bool savePageModel(const PageModel &model, const std::string &filePath, std::string *errorOut)
+    {
+        try
+        {
+            return writeJson(pageToJson(model), filePath, errorOut);
         }
         catch (const std::exception &ex)
         {
@@ -404,123 +464,76 @@ namespace serialization
         }
     }
 
-    bool loadProject(PageModel &model, Camera &camera, Renderer &renderer,
-                     PlotterConfig &plotter,
-                     const std::string &filePath, std::string *errorOut)
+    bool loadPageModel(PageModel &model, const std::string &filePath, std::string *errorOut)
     {
         try
         {
-            if (!std::filesystem::exists(filePath))
-            {
-                if (errorOut) *errorOut = "File does not exist: " + filePath;
-                return false;
-            }
-            std::ifstream ifs(filePath, std::ios::binary);
-            if (!ifs)
-            {
-                if (errorOut) *errorOut = "Failed to open file for reading: " + filePath;
+            json j;
+            if (!readJson(j, filePath, errorOut))
                 return false;
-            }
-            json j; ifs >> j;
-
-            // Load page model using existing logic
-            // optional version check
-            int version = j.value("version", 1);
-            (void)version;
-
-            model.mouse_pixel = j.value("mouse_pixel", Vec2{});
-            model.mouse_page_mm = j.value("mouse_page_mm", Vec2{});
-
-            model.entities.clear();
-            if (j.contains("entities") && j["entities"].is_array())
-            {
-                for (const auto &je : j["entities"])
-                {
-                    Entity e = je.get<Entity>();
-                    e.refreshFilterBase();
-
-                    if (je.contains("filters") && je["filters"].is_array())
-                    {
-                        for (const auto &jf : je["filters"])
-                        {
-                            std::unique_ptr<FilterBase> f;
-                            std::string type = jf.value("type", std::string{});
-                            bool enabled = jf.value("enabled", true);
-                            const json &params = jf.contains("params") ? jf["params"] : json::object();
-
-                            {
-                                const auto &all = FilterRegistry::instance().all();
-                                for (const auto &info : all)
-                                {
-                                    if (info.name == type)
-                                    {
-                                        f = info.factory();
-                                        break;
-                                    }
-                                }
-                            }
-                            if (!f)
-                            {
-                                if (type == "Blur") f = std::make_unique<BlurFilter>();
-                                else if (type == "Threshold") f = std::make_unique<ThresholdFilter>();
-                                else if (type == "Trace") f = std::make_unique<TraceFilter>();
-                                else if (type == "Simplify") f = std::make_unique<SimplifyFilter>();
-                            }
-                            if (f)
-                            {
-                                for (auto it = params.begin(); it != params.end(); ++it)
-                                {
-                                    if (it.value().is_number()) f->setParameter(it.key(), it.value().get<float>());
-                                }
-                            }
-                            if (f)
-                            {
-                                size_t idx = e.filterChain.addFilter(std::move(f));
-                                e.filterChain.setFilterEnabled(idx, enabled);
-                            }
-                        }
-                    }
-                    model.entities[e.id] = std::move(e);
-                }
-            }
+            pageFromJson(j, model);
+            return true;
+        }
+        catch (const std::exception &ex)
+        {
+            if (errorOut) *errorOut = ex.what();
+            return false;
+        }
+    }
 
-            // Optional camera
-            if (j.contains("camera"))
-            {
-                Vec2 center = j["camera"].value("center", camera.center());
-                float zoom = j["camera"].value("zoom", camera.zoom());
-                camera.setCenterAndZoom(center, zoom);
-            }
+    bool saveProject(const PageModel &model, const PlotterConfig &plotter, const ProjectView *view,
+                     const std::string &filePath, std::string *errorOut)
+    {
+        try
+        {
+            return writeJson(projectToJson(model, plotter, view), filePath, errorOut);
+        }
+        catch (const std::exception &ex)
+        {
+            if (errorOut) *errorOut = ex.what();
+            return false;
+        }
+    }
 
-            // Optional renderer
-            if (j.contains("render"))
-            {
-                float lw = j["render"].value("line_width", renderer.lineWidth());
-                float nodePx = j["render"].value("node_diameter_px", renderer.nodeDiameterPx());
-                renderer.setLineWidth(lw);
-                renderer.setNodeDiameterPx(nodePx);
-            }
+    bool loadProject(PageModel &model, PlotterConfig &plotter, ProjectView *view,
+                     const std::string &filePath, std::string *errorOut)
+    {
+        try
+        {
+            json j;
+            if (!readJson(j, filePath, errorOut))
+                return false;
+            projectFromJson(j, model, plotter, view);
+            return true;
+        }
+        catch (const std::exception &ex)
+        {
+            if (errorOut) *errorOut = ex.what();
+            return false;
+        }
+    }
 
-            // Plotter config (supports new key and legacy "axidraw")
-            if (j.contains("plotter"))
-            {
-                const json &p = j["plotter"];
-                plotter.penUpPos = p.value("pen_up_pos", plotter.penUpPos);
-                plotter.penDownPos = p.value("pen_down_pos", plotter.penDownPos);
-                plotter.drawSpeedPercent = p.value("draw_speed_percent", plotter.drawSpeedPercent);
-                plotter.travelSpeedPercent = p.value("travel_speed_percent", plotter.travelSpeedPercent);
-                // mm-based planner settings (with defaults)
-                plotter.drawSpeedMmPerS = p.value("draw_speed_mm_s", plotter.drawSpeedMmPerS);
-                plotter.travelSpeedMmPerS = p.value("travel_speed_mm_s", plotter.travelSpeedMmPerS);
-                plotter.accelDrawMmPerS2 = p.value("accel_draw_mm_s2", plotter.accelDrawMmPerS2);
-                plotter.accelTravelMmPerS2 = p.value("accel_travel_mm_s2", plotter.accelTravelMmPerS2);
-                plotter.cornering = p.value("cornering", plotter.cornering);
-                plotter.timeSliceMs = p.value("time_slice_ms", plotter.timeSliceMs);
-                plotter.maxStepRatePerAxis = p.value("max_step_rate_per_axis", plotter.maxStepRatePerAxis);
-                plotter.minSegmentMm = p.value("min_segment_mm", plotter.minSegmentMm);
-                plotter.junctionSpeedFloorPercent = p.value("junction_speed_floor_percent", plotter.junctionSpeedFloorPercent);
-            }
+    bool projectToString(const PageModel &model, const PlotterConfig &plotter, std::string &out,
+                         std::string *errorOut)
+    {
+        try
+        {
+            out = projectToJson(model, plotter, nullptr).dump();
+            return true;
+        }
+        catch (const std::exception &ex)
+        {
+            if (errorOut) *errorOut = ex.what();
+            return false;
+        }
+    }
 
+    bool projectFromString(PageModel &model, PlotterConfig &plotter, const std::string &text,
+                           std::string *errorOut)
+    {
+        try
+        {
+            projectFromJson(json::parse(text), model, plotter, nullptr);
             return true;
         }
         catch (const std::exception &ex)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "core/Vec2.h"
 #include "plotters/PlotterConfig.h"
 
 struct PageModel;
@@ -9,6 +10,18 @@ class Renderer;
 
 namespace serialization {
 
+// View state stored alongside a project. Only the GUI has one; loading fills in
+// whichever parts the file has and leaves the rest untouched.
+struct ProjectView
+{
+    bool hasCamera{false};
+    Vec2 cameraCenter;
+    float cameraZoom{1.0f};
+    bool hasRender{false};
+    float lineWidth{1.0f};
+    float nodeDiameterPx{0.0f};
+};
+
 // Save PageModel to JSON file at path. Pretty prints.
 // Returns true on success; false and fills errorOut on failure.
 bool savePageModel(const PageModel& model, const std::string& filePath, std::string* errorOut = nullptr);
@@ -17,7 +30,21 @@ bool savePageModel(const PageModel& model, const std::string& filePath, std::str
 // Returns true on success; false and fills errorOut on failure.
 bool loadPageModel(PageModel& model, const std::string& filePath, std::string* errorOut = nullptr);
 
+// Save/Load a project (page + plotter config, and the view state when there is one).
+// These do not touch any GL state, so headless tools can use them.
+bool saveProject(const PageModel& model, const PlotterConfig& plotter, const ProjectView* view,
+                 const std::string& filePath, std::string* errorOut = nullptr);
+bool loadProject(PageModel& model, PlotterConfig& plotter, ProjectView* view,
+                 const std::string& filePath, std::string* errorOut = nullptr);
+
+// Same project JSON as a string, without view state
+bool projectToString(const PageModel& model, const PlotterConfig& plotter, std::string& out,
+                     std::string* errorOut = nullptr);
+bool projectFromString(PageModel& model, PlotterConfig& plotter, const std::string& text,
+                       std::string* errorOut = nullptr);
+
 // Save/Load full project (page + camera + renderer + plotter config) to JSON file.
+// Defined in SerializationView.cpp, which is only built into the GUI.
 bool saveProject(const PageModel& model, const Camera& camera, const Renderer& renderer,
                  const PlotterConfig& plotter,
                  const std::string& filePath, std::string* errorOut = nullptr);
@@ -26,5 +53,3 @@ bool loadProject(PageModel& model, Camera& camera, Renderer& renderer,
                  const std::string& filePath, std::string* errorOut = nullptr);
 
 }
-
-
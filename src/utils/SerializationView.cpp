@@ -0,0 +1,48 @@
+#include "utils/Serialization.h"
+
+#include "Camera.h"
+#include "Renderer.h"
+
+// The GUI flavour of project save/load: the headless core plus camera and renderer state
+
+namespace serialization
+{
+
+    bool saveProject(const PageModel &model, const Camera &camera, const Renderer &renderer,
+                     const PlotterConfig &plotter,
+                     const std::string &filePath, std::string *errorOut)
+    {
+        ProjectView view;
+        view.hasCamera = true;
+        view.cameraCenter = camera.center();
+        view.cameraZoom = camera.zoom();
+        view.hasRender = true;
+        view.lineWidth = renderer.lineWidth();
+        view.nodeDiameterPx = renderer.nodeDiameterPx();
+        return saveProject(model, plotter, &view, filePath, errorOut);
+    }
+
+    bool loadProject(PageModel &model, Camera &camera, Renderer &renderer,
+                     PlotterConfig &plotter,
+                     const std::string &filePath, std::string *errorOut)
+    {
+        // Defaults are the current state, so keys missing from the file keep it
+        ProjectView view;
+        view.cameraCenter = camera.center();
+        view.cameraZoom = camera.zoom();
+        view.lineWidth = renderer.lineWidth();
+        view.nodeDiameterPx = renderer.nodeDiameterPx();
+        if (!loadProject(model, plotter, &view, filePath, errorOut))
+            return false;
+
+        if (view.hasCamera)
+            camera.setCenterAndZoom(view.cameraCenter, view.cameraZoom);
+        if (view.hasRender)
+        {
+            renderer.setLineWidth(view.lineWidth);
+            renderer.setNodeDiameterPx(view.nodeDiameterPx);
+        }
+        return true;
+    }
+
+} // namespace serialization
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+// Bounded single-producer / single-consumer ring buffer.
+//
+// One thread calls tryPush, one other thread calls tryPop; neither ever blocks or
+// takes a lock. The capacity is rounded up to a power of two and the head/tail
+// counters live on separate cache lines so the two sides do not false-share.
+// T must be default constructible and copy assignable.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity)
+    {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        m_mask = cap - 1;
+        m_slots = std::make_unique<T[]>(cap);
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return m_mask + 1; }
+
+    // Producer side. Returns false when the ring is full.
+    bool tryPush(const T &v)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_headCache > m_mask)
+        {
+            m_headCache = m_head.load(std::memory_order_acquire);
+            if (tail - m_headCache > m_mask) return false;
+        }
+        m_slots[tail & m_mask] = v;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Returns false when the ring is empty.
+    bool tryPop(T &out)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tailCache)
+        {
+            m_tailCache = m_tail.load(std::memory_order_acquire);
+            if (head == m_tailCache) return false;
+        }
+        out = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called while the other side is running
+    size_t size() const
+    {
+        const size_t tail = m_tail.load(std::memory_order_acquire);
+        const size_t head = m_head.load(std::memory_order_acquire);
+        return tail - head;
+    }
+    bool empty() const { return size() == 0; }
+    bool full() const { return size() > m_mask; }
+
+    // Only valid while neither side is running
+    void clear()
+    {
+        m_head.store(0, std::memory_order_relaxed);
+        m_tail.store(0, std::memory_order_relaxed);
+        m_headCache = 0;
+        m_tailCache = 0;
+    }
+
+private:
+    static constexpr size_t kCacheLine = 64;
+
+    std::unique_ptr<T[]> m_slots;
+    size_t m_mask{0};
+
+    // Consumer-owned
+    alignas(kCacheLine) std::atomic<size_t> m_head{0};
+    size_t m_tailCache{0};
+
+    // Producer-owned
+    alignas(kCacheLine) std::atomic<size_t> m_tail{0};
+    size_t m_headCache{0};
+};
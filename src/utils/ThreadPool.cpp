@@ -0,0 +1,167 @@
+#include "ThreadPool.h"
+
+namespace
+{
+    // Queue owned by the current thread in t_pool: 0 for non-pool threads, i + 1 for worker i
+    thread_local const ThreadPool *t_pool = nullptr;
+    thread_local size_t t_queueIndex = 0;
+}
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool g_instance;
+    return g_instance;
+}
+
+ThreadPool::ThreadPool()
+    : ThreadPool(std::thread::hardware_concurrency() > 1 ? std::thread::hardware_concurrency() - 1 : 0)
+{
+}
+
+ThreadPool::ThreadPool(size_t n)
+{
+    m_queues.reserve(n + 1);
+    for (size_t i = 0; i < n + 1; ++i)
+        m_queues.emplace_back(std::make_unique<Worker>());
+
+    m_workers.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+        m_workers.emplace_back([this, i]() { workerLoop(i + 1); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    shutdown();
+}
+
+void ThreadPool::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lk(m_sleepMutex);
+        m_stop = true;
+    }
+    m_sleepCv.notify_all();
+    for (auto &t : m_workers)
+    {
+        if (t.joinable())
+            t.join();
+    }
+}
+
+void ThreadPool::push(size_t queueIndex, const Task &t)
+{
+    {
+        std::lock_guard<std::mutex> lk(m_queues[queueIndex]->mutex);
+        m_queues[queueIndex]->tasks.push_back(t);
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+    // Taking the sleep mutex orders this notify after a sleeper's predicate check
+    {
+        std::lock_guard<std::mutex> lk(m_sleepMutex);
+    }
+    m_sleepCv.notify_one();
+}
+
+bool ThreadPool::popLocal(size_t queueIndex, Task &out)
+{
+    Worker &w = *m_queues[queueIndex];
+    std::lock_guard<std::mutex> lk(w.mutex);
+    if (w.tasks.empty())
+        return false;
+    out = w.tasks.back();
+    w.tasks.pop_back();
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool ThreadPool::steal(size_t thiefIndex, Task &out)
+{
+    const size_t n = m_queues.size();
+    for (size_t k = 1; k <= n; ++k)
+    {
+        size_t victim = (thiefIndex + k) % n;
+        Worker &w = *m_queues[victim];
+        std::lock_guard<std::mutex> lk(w.mutex);
+        if (w.tasks.empty())
+            continue;
+        // Oldest entries are the largest unsplit ranges
+        out = w.tasks.front();
+        w.tasks.pop_front();
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(size_t queueIndex, Task t)
+{
+    // Split off the upper half until the remaining range fits the grain
+    while (t.end - t.begin > t.grain)
+    {
+        size_t mid = t.begin + (t.end - t.begin) / 2;
+        Task upper = t;
+        upper.begin = mid;
+        t.end = mid;
+        t.loop->pending.fetch_add(1, std::memory_order_relaxed);
+        push(queueIndex, upper);
+    }
+    if (!t.loop->failed.load(std::memory_order_relaxed))
+    {
+        try
+        {
+            t.fn(t.ctx, t.begin, t.end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lk(t.loop->errorMutex);
+            if (!t.loop->error)
+                t.loop->error = std::current_exception();
+            t.loop->failed.store(true, std::memory_order_relaxed);
+        }
+    }
+    t.loop->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ThreadPool::run(size_t begin, size_t end, size_t grain, RangeFn fn, void *ctx)
+{
+    if (end <= begin)
+        return;
+
+    // A thread of another pool helps here as a non-worker
+    const size_t self = t_pool == this ? t_queueIndex : 0;
+    Loop loop;
+    execute(self, Task{fn, ctx, begin, end, grain, &loop});
+
+    // Help until every chunk of this loop has finished
+    while (loop.pending.load(std::memory_order_acquire) != 0)
+    {
+        Task t;
+        if (popLocal(self, t) || steal(self, t))
+            execute(self, t);
+        else
+            std::this_thread::yield();
+    }
+    if (loop.error)
+        std::rethrow_exception(loop.error);
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    t_pool = this;
+    t_queueIndex = index;
+    for (;;)
+    {
+        Task t;
+        if (popLocal(index, t) || steal(index, t))
+        {
+            execute(index, t);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(m_sleepMutex);
+        m_sleepCv.wait(lk, [this]() { return m_stop || m_queued.load(std::memory_order_acquire) > 0; });
+        // Stopping, a worker still drains what is queued
+        if (m_stop && m_queued.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Process-wide work-stealing job system for data-parallel loops.
+//
+// Each worker owns a deque: it pushes and pops split-off work at the back and
+// idle workers steal from the front of others. A range is split recursively
+// until it is at most 'grain' long, so uneven rows/paths balance themselves.
+// The calling thread participates while it waits, which makes nested
+// parallelFor calls (e.g. from a FilterEvaluator job) safe.
+class ThreadPool
+{
+public:
+    using RangeFn = void (*)(void *ctx, size_t begin, size_t end);
+
+    static ThreadPool &instance();
+
+    // A private pool with 'workers' threads besides the caller (tests, tools)
+    explicit ThreadPool(size_t workers);
+    ~ThreadPool();
+
+    // Number of threads that execute work, including the calling thread
+    size_t concurrency() const { return m_workers.size() + 1; }
+
+    // Run fn(ctx, b, e) over [begin, end) in chunks of at most 'grain' and block until done.
+    // If a chunk throws, chunks not yet started are skipped and the first exception is
+    // rethrown here once the rest have finished.
+    void run(size_t begin, size_t end, size_t grain, RangeFn fn, void *ctx);
+
+    // Workers finish the work already queued, then exit. Loops still running, or started
+    // later, complete on their calling threads. Also done by the destructor.
+    void shutdown();
+
+private:
+    // One run() call, shared by its chunks
+    struct Loop
+    {
+        std::atomic<size_t> pending{1};
+        std::atomic<bool> failed{false};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+    };
+
+    struct Task
+    {
+        RangeFn fn{nullptr};
+        void *ctx{nullptr};
+        size_t begin{0};
+        size_t end{0};
+        size_t grain{1};
+        Loop *loop{nullptr};
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void workerLoop(size_t index);
+    void push(size_t queueIndex, const Task &t);
+    bool popLocal(size_t queueIndex, Task &out);
+    bool steal(size_t thiefIndex, Task &out);
+    void execute(size_t queueIndex, Task t);
+
+    // Queue 0 is shared by threads that are not pool workers (UI, filter evaluator);
+    // worker i owns queue i + 1. Tasks are self-contained, so whoever pops one may run it.
+    std::vector<std::unique_ptr<Worker>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<size_t> m_queued{0};
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCv;
+    bool m_stop{false};
+};
+
+// parallelFor(begin, end, grain, fn): fn(b, e) is invoked on disjoint sub-ranges
+// covering [begin, end). Small ranges run inline on the calling thread.
+template <typename Fn>
+inline void parallelFor(size_t begin, size_t end, size_t grain, Fn &&fn)
+{
+    if (end <= begin)
+        return;
+    grain = std::max<size_t>(1, grain);
+    if (end - begin <= grain)
+    {
+        fn(begin, end);
+        return;
+    }
+    using F = std::remove_reference_t<Fn>;
+    ThreadPool::instance().run(begin, end, grain, [](void *ctx, size_t b, size_t e) { (*static_cast<F *>(ctx))(b, e); },
+                               const_cast<void *>(static_cast<const void *>(&fn)));
+}
+
+// Row ranges of an image: fn(y0, y1). The grain targets roughly 64K pixels per task.
+template <typename Fn>
+inline void parallelForRows(int height, int width, Fn &&fn)
+{
+    if (height <= 0)
+        return;
+    const size_t grain = std::max<size_t>(1, 65536 / static_cast<size_t>(std::max(1, width)));
+    parallelFor(0, static_cast<size_t>(height), grain, [&](size_t b, size_t e) { fn(static_cast<int>(b), static_cast<int>(e)); });
+}
+
+// Rectangular tiles: fn(tx, ty) once per tile of a tilesX x tilesY grid
+template <typename Fn>
+inline void parallelForTiles(int tilesX, int tilesY, Fn &&fn)
+{
+    if (tilesX <= 0 || tilesY <= 0)
+        return;
+    const size_t count = static_cast<size_t>(tilesX) * static_cast<size_t>(tilesY);
+    parallelFor(0, count, 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            fn(static_cast<int>(i % static_cast<size_t>(tilesX)), static_cast<int>(i / static_cast<size_t>(tilesX)));
+    });
+}
+
+// Independent items such as paths: fn(i) for every index, split into chunks of 'grain'
+template <typename Fn>
+inline void parallelForEach(size_t count, size_t grain, Fn &&fn)
+{
+    parallelFor(0, count, grain, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+            fn(i);
+    });
+}
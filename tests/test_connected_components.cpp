@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "../src/utils/ConnectedComponents.h"
+
+// Flood-fill reference: labels in raster order of first pixel
+static std::vector<int32_t> referenceLabels(const Mask &m, bool eight, std::vector<uint32_t> &areas)
+{
+    const int W = static_cast<int>(m.width_px), H = static_cast<int>(m.height_px);
+    std::vector<int32_t> lab(static_cast<size_t>(W * H), 0);
+    int32_t next = 0;
+    std::vector<int> stack;
+    for (int y = 0; y < H; ++y)
+        for (int x = 0; x < W; ++x)
+        {
+            if (!m.get(x, y) || lab[y * W + x]) continue;
+            ++next;
+            areas.push_back(0);
+            stack.assign(1, y * W + x);
+            lab[y * W + x] = next;
+            while (!stack.empty())
+            {
+                const int p = stack.back();
+                stack.pop_back();
+                ++areas.back();
+                const int px = p % W, py = p / W;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        if ((dx == 0 && dy == 0) || (!eight && dx != 0 && dy != 0)) continue;
+                        const int nx = px + dx, ny = py + dy;
+                        if (nx < 0 || ny < 0 || nx >= W || ny >= H) continue;
+                        if (!m.get(nx, ny) || lab[ny * W + nx]) continue;
+                        lab[ny * W + nx] = next;
+                        stack.push_back(ny * W + nx);
+                    }
+            }
+        }
+    return lab;
+}
+
+TEST(connected_components, MatchesFloodFill)
+{
+    std::mt19937 rng(9);
+    for (int w : {1, 63, 64, 65, 200})
+        for (int h : {1, 37, 300})
+            for (int density : {10, 45, 60})
+                for (bool eight : {false, true})
+                {
+                    Mask m;
+                    m.resize(w, h);
+                    for (int y = 0; y < h; ++y)
+                        for (int x = 0; x < w; ++x)
+                            if (static_cast<int>(rng() % 100) < density) m.set(x, y, true);
+
+                    std::vector<uint32_t> refAreas;
+                    const std::vector<int32_t> ref = referenceLabels(m, eight, refAreas);
+                    ComponentLabels cc;
+                    labelComponents(m, eight ? Connectivity::Eight : Connectivity::Four, cc);
+
+                    ASSERT_EQ(cc.count, refAreas.size()) << w << "x" << h << " eight=" << eight;
+                    ASSERT_EQ(cc.labels, ref) << w << "x" << h << " eight=" << eight;
+                    ASSERT_EQ(cc.areas, refAreas);
+                    for (size_t l = 1; l <= cc.count; ++l)
+                    {
+                        ASSERT_EQ(cc.end(l) - cc.begin(l), cc.areas[l - 1]);
+                        const ComponentBox &b = cc.boxes[l - 1];
+                        for (size_t k = cc.begin(l); k < cc.end(l); ++k)
+                        {
+                            const int x = cc.pixels[k] % w, y = cc.pixels[k] / w;
+                            ASSERT_EQ(ref[cc.pixels[k]], static_cast<int32_t>(l));
+                            ASSERT_TRUE(x >= b.minX && x <= b.maxX && y >= b.minY && y <= b.maxY);
+                        }
+                    }
+                }
+}
+
+TEST(connected_components, DropsSmallComponents)
+{
+    Mask m;
+    m.resize(10, 3);
+    m.set(0, 0, true);                            // area 1
+    for (int x = 4; x < 9; ++x) m.set(x, 1, true); // area 5
+    ComponentLabels cc;
+    labelComponents(m, Connectivity::Four, cc, 2);
+    ASSERT_EQ(cc.count, 1u);
+    EXPECT_EQ(cc.areas[0], 5u);
+    EXPECT_EQ(cc.labels[0], 0);
+    EXPECT_EQ(cc.labels[1 * 10 + 4], 1);
+    EXPECT_EQ(cc.pixels.size(), 5u);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../src/utils/SeparableConvolution.h"
+
+static int clampi(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// Straightforward clamp-to-edge reference for the 8-bit path (rounds between passes)
+static std::vector<uint8_t> referenceU8(const std::vector<uint8_t> &src, int w, int h, const ConvKernelQ12 &k)
+{
+    const int r = k.radius;
+    std::vector<uint8_t> tmp(src.size()), out(src.size());
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            int a = 0;
+            for (int i = -r; i <= r; ++i) a += src[y * w + clampi(x + i, 0, w - 1)] * k.weights[i + r];
+            tmp[y * w + x] = static_cast<uint8_t>(clampi((a + 2048) >> 12, 0, 255));
+        }
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+        {
+            int a = 0;
+            for (int i = -r; i <= r; ++i) a += tmp[clampi(y + i, 0, h - 1) * w + x] * k.weights[i + r];
+            out[y * w + x] = static_cast<uint8_t>(clampi((a + 2048) >> 12, 0, 255));
+        }
+    return out;
+}
+
+TEST(convolution, KernelQ12SumsToScale)
+{
+    for (int r = 0; r <= 30; ++r)
+    {
+        ConvKernelQ12 k = makeGaussianKernelQ12(r);
+        ASSERT_EQ(k.weights.size(), static_cast<size_t>(2 * r + 1));
+        int sum = 0;
+        for (int16_t v : k.weights) sum += v;
+        EXPECT_EQ(sum, 4096) << "radius " << r;
+    }
+}
+
+TEST(convolution, U8MatchesReference)
+{
+    std::mt19937 rng(7);
+    for (int r : {1, 2, 3, 4, 5, 11, 20})
+        for (int w : {1, 7, 16, 25, 41, 130})
+            for (int h : {1, 3, 19})
+            {
+                std::vector<uint8_t> src(static_cast<size_t>(w * h)), dst(src.size());
+                for (auto &v : src) v = static_cast<uint8_t>(rng() & 0xFF);
+                ConvKernelQ12 k = makeGaussianKernelQ12(r);
+                convolveSeparableU8(src.data(), dst.data(), w, h, k);
+                ASSERT_EQ(dst, referenceU8(src, w, h, k)) << "r=" << r << " w=" << w << " h=" << h;
+            }
+}
+
+TEST(convolution, F32MatchesReference)
+{
+    std::mt19937 rng(11);
+    for (int r : {1, 3, 4, 9})
+        for (int w : {1, 5, 8, 27, 300})
+            for (int h : {2, 17})
+            {
+                std::vector<float> src(static_cast<size_t>(w * h)), dst(src.size()), tmp(src.size());
+                for (auto &v : src) v = static_cast<float>(rng() % 1000) * 0.01f;
+                std::vector<float> k = makeGaussianKernelF32(r);
+                convolveSeparableF32(src.data(), dst.data(), w, h, k);
+
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x)
+                    {
+                        float a = 0.0f;
+                        for (int i = -r; i <= r; ++i) a += src[y * w + clampi(x + i, 0, w - 1)] * k[i + r];
+                        tmp[y * w + x] = a;
+                    }
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x)
+                    {
+                        float a = 0.0f;
+                        for (int i = -r; i <= r; ++i) a += tmp[clampi(y + i, 0, h - 1) * w + x] * k[i + r];
+                        ASSERT_NEAR(dst[y * w + x], a, 1e-3f) << "r=" << r << " w=" << w << " h=" << h;
+                    }
+            }
+}
+
+TEST(convolution, RecursiveGaussianTracksFir)
+{
+    // Smooth random field: interior of the IIR result should be close to the exact FIR one
+    const int w = 160, h = 120, r = 15;
+    std::mt19937 rng(3);
+    std::vector<float> src(static_cast<size_t>(w * h)), fir(src.size()), iir(src.size());
+    for (auto &v : src) v = static_cast<float>(rng() % 1000) * 0.001f;
+    convolveSeparableF32(src.data(), fir.data(), w, h, makeGaussianKernelF32(r));
+    gaussianRecursiveF32(src.data(), iir.data(), w, h, r / 3.0f);
+    for (int y = 2 * r; y < h - 2 * r; ++y)
+        for (int x = 2 * r; x < w - 2 * r; ++x)
+            ASSERT_NEAR(iir[y * w + x], fir[y * w + x], 0.02f) << x << "," << y;
+
+    // Constant images stay constant, borders included (in place)
+    std::vector<float> flat(static_cast<size_t>(w * h), 0.75f);
+    gaussianRecursiveF32(flat.data(), flat.data(), w, h, 30.0f);
+    for (float v : flat) ASSERT_NEAR(v, 0.75f, 1e-3f);
+}
+
+TEST(convolution, BoxStackTracksFir)
+{
+    const int w = 97, h = 64, r = 12;
+    std::vector<uint8_t> src(static_cast<size_t>(w * h)), fir(src.size()), box(src.size());
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x) src[y * w + x] = ((x / 16 + y / 16) & 1) ? 255 : 0;
+    convolveSeparableU8(src.data(), fir.data(), w, h, makeGaussianKernelQ12(r));
+    boxBlurStackedU8(src.data(), box.data(), w, h, r / 3.0f);
+    for (int y = r; y < h - r; ++y)
+        for (int x = r; x < w - r; ++x)
+            ASSERT_NEAR(box[y * w + x], fir[y * w + x], 8) << x << "," << y;
+
+    std::vector<uint8_t> flat(src.size(), 200), out(src.size());
+    boxBlurStackedU8(flat.data(), out.data(), w, h, 25.0f);
+    ASSERT_EQ(out, flat);
+}
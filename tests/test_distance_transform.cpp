@@ -0,0 +1,48 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "../src/utils/DistanceTransform.h"
+
+static float bruteSigned(const std::vector<uint8_t> &m, int w, int h, int x, int y)
+{
+    const bool in = m[y * w + x] != 0;
+    float best = 1e30f;
+    for (int yy = 0; yy < h; ++yy)
+        for (int xx = 0; xx < w; ++xx)
+            if ((m[yy * w + xx] != 0) != in)
+                best = std::min(best, std::hypot(static_cast<float>(xx - x), static_cast<float>(yy - y)));
+    return in ? -best : best;
+}
+
+TEST(distance_transform, MatchesBruteForce)
+{
+    std::mt19937 rng(5);
+    for (int w : {1, 3, 17, 40})
+        for (int h : {1, 2, 23, 35})
+            for (int density : {2, 10, 60})
+            {
+                std::vector<uint8_t> m(static_cast<size_t>(w * h));
+                for (auto &v : m) v = (rng() % 100) < static_cast<unsigned>(density) ? 1 : 0;
+                m[0] = 1;
+                m.back() = 0;
+                if (m.size() == 1) continue;
+
+                std::vector<float> d(m.size());
+                ASSERT_TRUE(signedDistanceTransform(m.data(), w, h, d.data()));
+                for (int y = 0; y < h; ++y)
+                    for (int x = 0; x < w; ++x)
+                        ASSERT_NEAR(d[y * w + x], bruteSigned(m, w, h, x, y), 1e-4f)
+                            << "w=" << w << " h=" << h << " at " << x << "," << y;
+            }
+}
+
+TEST(distance_transform, SingleClassIsZero)
+{
+    std::vector<uint8_t> m(64, 1);
+    std::vector<float> d(64, 3.0f);
+    EXPECT_FALSE(signedDistanceTransform(m.data(), 8, 8, d.data()));
+    for (float v : d) EXPECT_EQ(v, 0.0f);
+}
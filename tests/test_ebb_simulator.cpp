@@ -0,0 +1,329 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "../src/plotters/AxidrawController.h"
+#include "../src/plotters/EbbSimulator.h"
+#include "../src/plotters/PenCalibration.h"
+#include "../src/plotters/PlotProgram.h"
+#include "../src/plotters/PlotSpooler.h"
+#include "../src/serial/SerialController.h"
+
+namespace
+{
+
+struct SpooledRun
+{
+    double deviceMs{0.0}; // start of the job until the spooler stopped, on the simulator's clock
+    PlotSpooler::Stats stats{};
+};
+
+// Plots a compiled program with PlotSpooler's FIFO streamer on an in-process simulator.
+// The streamer runs on the simulator's manual clock, so the job takes its device time in
+// virtual time and moments of wall time. 'retune', if given, is passed to updateConfig
+// right after the start, with the first second or so of the job already queued.
+SpooledRun spool(std::shared_ptr<const PlotProgram> program, EbbSimulator &sim, PlotterConfig cfg,
+                 const PlotterConfig *retune = nullptr)
+{
+    using SteadyTime = std::chrono::steady_clock::time_point;
+    VirtualClock &clock = sim.clock();
+    SerialController serial;
+    serial.connectLoopback([&sim](std::string_view bytes) { return sim.feed(bytes); }, "simulator");
+    AxiDrawState state;
+    state.penUpPos = cfg.penUpPos;
+    state.penDownPos = cfg.penDownPos;
+    AxiDrawController axidraw(serial, state);
+    PlotSpooler spooler(serial, axidraw);
+    spooler.setStreamClock({[&clock]() { return SteadyTime(std::chrono::microseconds(clock.nowUs())); },
+                            [&clock](SteadyTime t) {
+                                clock.waitUntilUs(std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count());
+                            }});
+
+    cfg.fifoStreaming = true;
+    sim.resetStats();
+    SpooledRun r;
+    const double t0 = clock.nowMs();
+    EXPECT_TRUE(spooler.startProgram(std::move(program), cfg));
+    if (retune)
+    {
+        PlotterConfig next = *retune;
+        next.fifoStreaming = true;
+        spooler.updateConfig(next);
+    }
+    for (int i = 0; i < 60000 && spooler.isRunning(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_FALSE(spooler.isRunning());
+    spooler.cancel(); // joins the finished worker
+    r.deviceMs = clock.nowMs() - t0;
+    r.stats = spooler.stats();
+    return r;
+}
+
+} // namespace
+
+TEST(ebb_simulator, QueuesMotionThroughFifo)
+{
+    EbbSimulator::Options opt;
+    opt.fifoDepth = 2;
+    EbbSimulator sim(opt);
+
+    EXPECT_EQ(sim.handle("SP,0,100"), "OK\r\n");
+    EXPECT_EQ(sim.feed("SM,100,80,80\rSM,100,-80,0\r"), "OK\r\nOK\r\n");
+    // Pen move running, two moves waiting: the next one has to wait for a slot
+    EXPECT_EQ(sim.handle("SM,50,0,40"), "OK\r\n");
+    EXPECT_EQ(sim.stats().fifoFullWaits, 1);
+    EXPECT_DOUBLE_EQ(sim.clock().nowMs(), 100.0);
+    EXPECT_EQ(sim.handle("QM"), "QM,1,1,1,1\r\n");
+
+    // Too fast for the motors, and not a command at all
+    EXPECT_EQ(sim.handle("SM,1,100,0")[0], '!');
+    EXPECT_EQ(sim.handle("XX")[0], '!');
+    EXPECT_EQ(sim.stats().rateViolations, 1);
+    EXPECT_EQ(sim.stats().errors, 2);
+
+    sim.runUntilIdle();
+    EXPECT_DOUBLE_EQ(sim.clock().nowMs(), 350.0);
+    EXPECT_EQ(sim.handle("QM"), "QM,0,0,0,0\r\n");
+    EXPECT_EQ(sim.motor1Position(), 0);
+    EXPECT_EQ(sim.motor2Position(), 120);
+    EXPECT_TRUE(sim.penIsDown());
+    ASSERT_EQ(sim.trajectory().size(), 5u);
+    EXPECT_FLOAT_EQ(sim.trajectory()[2].yMm, 1.0f);
+}
+
+TEST(ebb_simulator, StreamsCompiledProgramsInVirtualTime)
+{
+    // A long job: 1500 hatch lines over a 200 mm square plus a curve
+    PathSet paths;
+    std::vector<int> entity;
+    for (int i = 0; i < 1500; ++i)
+    {
+        const float y = 10.0f + 0.13f * float(i);
+        paths.addPath(i % 2 ? std::vector<Vec2>{Vec2(210.0f, y), Vec2(10.0f, y)} : std::vector<Vec2>{Vec2(10.0f, y), Vec2(210.0f, y)});
+        entity.push_back(0);
+    }
+    std::vector<Vec2> curve;
+    for (int i = 0; i <= 400; ++i) curve.push_back(Vec2(110.0f + 60.0f * std::cos(0.05f * i), 110.0f + 40.0f * std::sin(0.07f * i)));
+    paths.addPath(curve);
+    entity.push_back(1);
+
+    for (bool lowLevel : {false, true})
+    {
+        PlotterConfig cfg;
+        cfg.lowLevelMoves = lowLevel;
+        PlotCompileOptions copt;
+        copt.refineBudgetMs = 0.0;
+        std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, cfg, copt);
+        ASSERT_TRUE(prog);
+
+        EbbSimulator sim;
+        const auto wall0 = std::chrono::steady_clock::now();
+        const SpooledRun r = spool(prog, sim, cfg);
+        const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall0).count();
+
+        EXPECT_EQ(sim.stats().errors, 0);
+        EXPECT_EQ(r.stats.underruns, 0);
+        const double planned = static_cast<double>(prog->totals().totalMs);
+        if (lowLevel)
+        {
+            // An LM slice aims at half a step past its count, so the device ends each one a
+            // little early; paced by the plan, it idles that slack away a few ms at a time
+            EXPECT_LT(sim.stats().idleGapMs, planned * 0.002);
+        }
+        else
+        {
+            EXPECT_EQ(sim.stats().idleGaps, 0);
+        }
+        EXPECT_EQ(r.stats.commandsSent, static_cast<int>(prog->totals().commands));
+        EXPECT_EQ(sim.stats().rateViolations, 0);
+        // Back home, on the program's own timeline
+        EXPECT_EQ(sim.motor1Position(), 0);
+        EXPECT_EQ(sim.motor2Position(), 0);
+        EXPECT_NEAR(r.deviceMs, planned, planned * 0.01 + 5.0) << (lowLevel ? "LM" : "SM");
+        // Much faster than real time
+        EXPECT_LT(wallS * 1000.0 * 50.0, r.deviceMs);
+
+        double downMm = 0.0;
+        const auto &tr = sim.trajectory();
+        for (size_t i = 1; i < tr.size(); ++i)
+            if (tr[i].penDown) downMm += std::hypot(tr[i].xMm - tr[i - 1].xMm, tr[i].yMm - tr[i - 1].yMm);
+        EXPECT_NEAR(downMm, prog->totals().penDownMm, prog->totals().penDownMm * 0.005);
+    }
+}
+
+TEST(ebb_simulator, AppliesSpeedChangesMidJob)
+{
+    // Short strokes with travel between them, so there are many points to switch at
+    PathSet paths;
+    std::vector<int> entity;
+    for (int i = 0; i < 300; ++i)
+    {
+        const float x = 10.0f + 12.0f * float(i % 15), y = 10.0f + 9.0f * float(i / 15);
+        paths.addPath({Vec2(x, y), Vec2(x + 8.0f, y + 3.0f), Vec2(x + 4.0f, y + 6.0f)});
+        entity.push_back(i % 2);
+    }
+    PlotterConfig cfg;
+    PlotCompileOptions copt;
+    copt.refineBudgetMs = 0.0;
+    std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, cfg, copt);
+    ASSERT_TRUE(prog);
+
+    PlotterConfig fast = cfg;
+    fast.drawSpeedMmPerS *= 2.0f;
+    fast.travelSpeedMmPerS *= 1.5f;
+    fast.accelDrawMmPerS2 *= 2.0f;
+    EbbSimulator sim;
+    const SpooledRun r = spool(prog, sim, cfg, &fast);
+
+    EXPECT_EQ(sim.stats().errors, 0);
+    EXPECT_EQ(sim.stats().rateViolations, 0);
+    EXPECT_EQ(sim.motor1Position(), 0);
+    EXPECT_EQ(sim.motor2Position(), 0);
+    // Sooner than planned, and on the replanned timeline
+    const double planned = static_cast<double>(prog->totals().totalMs);
+    EXPECT_LT(r.deviceMs, planned * 0.9);
+    EXPECT_LT(r.stats.plannedMs, prog->totals().totalMs);
+    EXPECT_NEAR(r.deviceMs, r.stats.plannedMs, r.stats.plannedMs * 0.01 + 5.0);
+
+    // Every stroke drawn once
+    double downMm = 0.0;
+    const auto &tr = sim.trajectory();
+    for (size_t i = 1; i < tr.size(); ++i)
+        if (tr[i].penDown) downMm += std::hypot(tr[i].xMm - tr[i - 1].xMm, tr[i].yMm - tr[i - 1].yMm);
+    EXPECT_NEAR(downMm, prog->totals().penDownMm, prog->totals().penDownMm * 0.005);
+}
+
+TEST(ebb_simulator, OverlapsPenMovesWithTravel)
+{
+    // Short strokes with 20 mm of travel between them, so pen moves dominate
+    PathSet paths;
+    for (int i = 0; i < 300; ++i)
+    {
+        const float x = 10.0f + 20.0f * float(i % 15), y = 10.0f + 20.0f * float(i / 15);
+        paths.addPath(std::vector<Vec2>{Vec2(x, y), Vec2(x + 3.0f, y + 2.0f)});
+    }
+    const std::vector<int> entity(paths.size(), 0);
+    PlotCompileOptions copt;
+    copt.refineBudgetMs = 0.0;
+
+    // Servo as slow as the pen delay; the tip touches in the lower 30% of its travel
+    PlotterConfig cfg;
+    auto plot = [&](const PlotterConfig &c, double &paperMm) {
+        std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, c, copt);
+        EbbSimulator::Options opt;
+        opt.servoMoveMs = static_cast<int>(prog->totals().penMoveMs);
+        EbbSimulator sim(opt);
+        const SpooledRun r = spool(prog, sim, c);
+        EXPECT_EQ(sim.stats().errors, 0);
+        EXPECT_EQ(r.stats.commandsSent, static_cast<int>(prog->totals().commands));
+        EXPECT_EQ(sim.motor1Position(), 0);
+        EXPECT_EQ(sim.motor2Position(), 0);
+        const double planned = static_cast<double>(prog->totals().totalMs);
+        EXPECT_NEAR(r.deviceMs, planned, planned * 0.01 + 5.0);
+        paperMm = sim.stats().paperMm;
+        return prog;
+    };
+
+    double plainMm = 0.0, overlapMm = 0.0, rushedMm = 0.0;
+    const auto plain = plot(cfg, plainMm);
+    EXPECT_EQ(plain->totals().penOverlapMs, 0u);
+    EXPECT_NEAR(plainMm, plain->totals().penDownMm, 0.1);
+
+    // Within the pen's limits: the same lines, and the hidden servo time comes off the job
+    cfg.penOverlap = true;
+    const auto overlap = plot(cfg, overlapMm);
+    EXPECT_NEAR(overlapMm, plain->totals().penDownMm, 0.1);
+    EXPECT_EQ(overlap->totals().lifts, plain->totals().lifts);
+    EXPECT_EQ(overlap->totals().totalMs + overlap->totals().penOverlapMs, plain->totals().totalMs);
+    EXPECT_GT(overlap->totals().penOverlapMs, overlap->totals().lifts * 100u);
+
+    // Travelling before the tip has cleared the paper drags it along
+    cfg.penLiftClearMs = 20;
+    cfg.penDropLeadMs = 200;
+    const auto rushed = plot(cfg, rushedMm);
+    EXPECT_GT(rushedMm, plain->totals().penDownMm + 100.0);
+}
+
+TEST(ebb_simulator, CalibratesPenOverlapWithTestCard)
+{
+    PlotterConfig cfg;
+    const PenOverlapCard card;
+    std::shared_ptr<PlotProgram> prog = compilePenOverlapCard(cfg, card);
+    ASSERT_TRUE(prog);
+    ASSERT_EQ(prog->entities().size(), static_cast<size_t>(card.rows));
+    EXPECT_EQ(prog->paths().size(), static_cast<size_t>(card.rows * card.ticks));
+
+    // Plotted with a servo that needs 30% of its move to clear and 70% to land, the
+    // later rows smear
+    EbbSimulator::Options opt;
+    opt.servoMoveMs = static_cast<int>(prog->totals().penMoveMs);
+    EbbSimulator sim(opt);
+    spool(prog, sim, cfg);
+    EXPECT_EQ(sim.stats().errors, 0);
+    EXPECT_GT(sim.stats().paperMm, prog->totals().penDownMm + 1.0);
+    EXPECT_EQ(sim.motor1Position(), 0);
+
+    // Rows up to 4 of 8 are clean for both; those settings plot the card's last row cleanly
+    applyPenOverlapCalibration(cfg, 4, 4, card.rows);
+    EXPECT_TRUE(cfg.penOverlap);
+    PlotterConfig last = penOverlapRowConfig(cfg, card.rows - 1, card.rows);
+    EXPECT_LT(last.penLiftClearMs, cfg.penLiftClearMs);
+    EXPECT_GT(last.penDropLeadMs, cfg.penDropLeadMs);
+
+    PathSet ticks;
+    for (int t = 0; t < card.ticks; ++t)
+        ticks.addPath(std::vector<Vec2>{Vec2(20.0f + card.pitchMm * float(t), 20.0f), Vec2(20.0f + card.pitchMm * float(t), 26.0f)});
+    std::shared_ptr<PlotProgram> tuned = PlotProgram::compile(ticks, std::vector<int>(ticks.size(), 0), cfg, {});
+    EbbSimulator sim2(opt);
+    spool(tuned, sim2, cfg);
+    EXPECT_EQ(sim2.stats().errors, 0);
+    EXPECT_NEAR(sim2.stats().paperMm, tuned->totals().penDownMm, 0.05);
+    EXPECT_GT(tuned->totals().penOverlapMs, 0u);
+}
+
+#ifdef __linux__
+TEST(ebb_simulator, ServesTheSerialPathOverPty)
+{
+    EbbSimulator sim({}, VirtualClock(1.0));
+    EbbPtyServer server(sim);
+    std::string err;
+    ASSERT_TRUE(server.start(&err)) << err;
+
+    SerialController serial;
+    ASSERT_TRUE(serial.connect(server.devicePath(), 115200, &err)) << err;
+    AxiDrawState state;
+    AxiDrawController ax(serial, state);
+    ax.batchPen(false, 20);
+    ax.batchStepperMove(30, 80, 40);
+    ax.batchLowLevelMove(85899346, 100, 0, 85899346, -100, 0); // 1000 steps/s, 100 ms
+    ax.batchStepperMove(30, -180, 60);
+    ASSERT_TRUE(ax.flushBatch(&err)) << err;
+    for (int i = 0; i < 50 && ax.unackedCommands() > 0; ++i) ASSERT_TRUE(ax.readAcks(20, &err)) << err;
+    EXPECT_EQ(ax.unackedCommands(), 0);
+
+    AxiDrawController::MotionStatus ms;
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(ax.queryMotion(ms, 200, &err)) << err;
+        if (ms.idle()) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_TRUE(ms.idle());
+
+    // One-off commands wait for their reply, so a device error is the caller's
+    ASSERT_TRUE(ax.penUp(20, &err)) << err;
+    EXPECT_FALSE(ax.stepperMove(0, 10, 10, &err));
+    EXPECT_NE(err.find("Device error"), std::string::npos) << err;
+    serial.disconnect();
+    server.stop();
+
+    EXPECT_EQ(sim.stats().motionCommands, 5);
+    EXPECT_EQ(sim.stats().errors, 1);
+    EXPECT_EQ(sim.motor1Position(), 0);
+    EXPECT_EQ(sim.motor2Position(), 0);
+    EXPECT_GE(sim.clock().nowMs(), 180.0);
+}
+#endif
@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "../src/filters/FilterChain.h"
+
+namespace
+{
+
+// Moves every point right by 'offset' mm. While 'hold' is set it waits, polling for a cancel.
+struct GateFilter : public FilterTyped<PathSet, PathSet>
+{
+    static inline std::atomic<bool> hold{false};
+    static inline std::atomic<int> runs{0};
+    static inline std::atomic<int> cancelledRuns{0};
+    static inline std::atomic<bool> ranOnCaller{false};
+    static inline std::thread::id caller{};
+
+    GateFilter() { m_parameters["offset"] = FilterParameter{"Offset (mm)", 0.0f, 100.0f, 0.0f}; }
+
+    const char *name() const override { return "TestGate"; }
+    uint64_t paramVersion() const override { return m_version.load(); }
+
+    void applyTyped(const PathSet &in, PathSet &out) const override
+    {
+        runs++;
+        if (std::this_thread::get_id() == caller) ranOnCaller = true;
+        while (hold.load() && !cancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if (cancelled())
+        {
+            cancelledRuns++;
+            return;
+        }
+        out = in;
+        for (Vec2 &p : out.points) p.x += m_parameters.at("offset").value;
+    }
+
+    static void reset()
+    {
+        hold = false;
+        runs = 0;
+        cancelledRuns = 0;
+        ranOnCaller = false;
+        caller = std::this_thread::get_id();
+        FilterRegistry::instance().registerFilter(
+            FilterInfo{"TestGate", LayerKind::PathSet, LayerKind::PathSet, []() { return std::make_unique<GateFilter>(); }});
+    }
+};
+
+std::shared_ptr<PathSet> segment()
+{
+    auto ps = std::make_shared<PathSet>();
+    ps->addPath(std::vector<Vec2>{Vec2(0.0f, 0.0f), Vec2(1.0f, 0.0f)});
+    return ps;
+}
+
+// First x of a chain output, or -1 while it still shows the base
+float firstX(const LayerPtr &layer, const LayerPtr &base)
+{
+    const PathSet *ps = asPathSetConstPtr(layer);
+    return (layer == base || !ps || ps->points.empty()) ? -1.0f : ps->points[0].x;
+}
+
+template <typename Pred>
+bool pollUntil(FilterChain &chain, Pred done, int timeoutMs = 5000)
+{
+    for (int t = 0; t < timeoutMs; ++t)
+    {
+        chain.output();
+        if (done()) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+template <typename Pred>
+bool waitFor(Pred done, int timeoutMs = 5000)
+{
+    for (int t = 0; t < timeoutMs && !done(); ++t) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return done();
+}
+
+} // namespace
+
+TEST(filter_chain, EvaluatesInTheBackground)
+{
+    GateFilter::reset();
+    const LayerPtr base = segment();
+    FilterChain chain;
+    chain.setBase(base, 1);
+    auto filter = std::make_unique<GateFilter>();
+    filter->setParameter("offset", 5.0f);
+    chain.addFilter(std::move(filter));
+
+    // Nothing has landed yet: the display falls back to the base, the plot source is null
+    GateFilter::hold = true;
+    EXPECT_EQ(chain.output(), base);
+    EXPECT_TRUE(chain.isEvaluating());
+    EXPECT_EQ(chain.outputLayer(), nullptr);
+    GateFilter::hold = false;
+
+    ASSERT_TRUE(pollUntil(chain, [&]() { return firstX(chain.output(), base) == 5.0f; }));
+    EXPECT_FALSE(GateFilter::ranOnCaller.load());
+    EXPECT_EQ(chain.outputLayer(), chain.output());
+    EXPECT_EQ(chain.filterAt(0)->lastPathCount(), 1u);
+
+    // Up to date: polling again runs nothing
+    const int runs = GateFilter::runs.load();
+    chain.output();
+    EXPECT_FALSE(chain.isEvaluating());
+    EXPECT_EQ(GateFilter::runs.load(), runs);
+}
+
+TEST(filter_chain, NewParametersSupersedeARunningSnapshot)
+{
+    GateFilter::reset();
+    const LayerPtr base = segment();
+    FilterChain chain;
+    chain.setBase(base, 1);
+    chain.addFilter(std::make_unique<GateFilter>());
+    chain.filterAt(0)->setParameter("offset", 5.0f);
+
+    GateFilter::hold = true;
+    chain.output();
+    ASSERT_TRUE(waitFor([]() { return GateFilter::runs.load() == 1; }));
+
+    // The edit cancels the held run; its result is never shown
+    chain.filterAt(0)->setParameter("offset", 7.0f);
+    chain.output();
+    GateFilter::hold = false;
+    bool sawStale = false;
+    ASSERT_TRUE(pollUntil(chain, [&]() {
+        const float x = firstX(chain.output(), base);
+        sawStale = sawStale || x == 5.0f;
+        return x == 7.0f;
+    }));
+    EXPECT_FALSE(sawStale);
+    EXPECT_EQ(GateFilter::cancelledRuns.load(), 1);
+    EXPECT_EQ(GateFilter::runs.load(), 2);
+    EXPECT_EQ(firstX(chain.outputLayer(), base), 7.0f);
+}
+
+TEST(filter_chain, CancelsARunWhenTheChainGoesAway)
+{
+    GateFilter::reset();
+    const LayerPtr base = segment();
+    {
+        FilterChain chain;
+        chain.setBase(base, 1);
+        chain.addFilter(std::make_unique<GateFilter>());
+        GateFilter::hold = true;
+        chain.output();
+        ASSERT_TRUE(waitFor([]() { return GateFilter::runs.load() == 1; }));
+    }
+    // The filter sees the cancel at its next poll and the evaluator thread is free again
+    ASSERT_TRUE(waitFor([]() { return GateFilter::cancelledRuns.load() == 1; }));
+    GateFilter::hold = false;
+
+    FilterChain next;
+    next.setBase(base, 1);
+    next.addFilter(std::make_unique<GateFilter>());
+    next.filterAt(0)->setParameter("offset", 2.0f);
+    ASSERT_TRUE(pollUntil(next, [&]() { return firstX(next.output(), base) == 2.0f; }));
+}
@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../src/Page.h"
+#include "../src/daemon/JobServer.h"
+#include "../src/plotters/PlotProgramCache.h"
+#include "../src/utils/Serialization.h"
+
+#ifdef __linux__
+#include "../src/plotters/EbbSimulator.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using nlohmann::json;
+
+namespace
+{
+
+// A project with a few short strokes starting at x0
+std::string smallProject(float x0, int strokes)
+{
+    PathSet ps;
+    for (int i = 0; i < strokes; ++i)
+    {
+        const float x = x0 + 5.0f * float(i);
+        ps.addPath(std::vector<Vec2>{Vec2(x, 10.0f), Vec2(x + 3.0f, 14.0f)});
+    }
+    PageModel page;
+    page.addPathSet(ps);
+    std::string text, err;
+    EXPECT_TRUE(serialization::projectToString(page, PlotterConfig(), text, &err)) << err;
+    return text;
+}
+
+json call(JobServer &server, const std::string &line)
+{
+    return json::parse(server.request(line));
+}
+
+int submit(JobServer &server, const std::string &fields)
+{
+    const json r = call(server, "{\"cmd\":\"submit\"," + fields + "}");
+    EXPECT_TRUE(r.value("ok", false)) << r.dump();
+    return r.value("job", -1);
+}
+
+bool waitFor(JobServer &server, int job, JobServer::JobState state, int timeoutMs = 10000)
+{
+    for (int t = 0; t < timeoutMs; t += 10)
+    {
+        if (server.jobState(job) == state) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return false;
+}
+
+double msSince(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// A job's time on the device against its compiled plan. The server notices each change
+// within a tick, a job starts with a few round trips to set the device up, and one that
+// follows another first waits out the closing pen up of the one before.
+void expectPlannedTime(double wallMs, const json &stats, bool afterAnotherJob)
+{
+    const PlotterConfig cfg;
+    const double plannedMs = stats["planned_ms"].get<double>() + (afterAnotherJob ? penMoveMs(cfg.penUpPos, cfg.penDownPos) : 0);
+    EXPECT_GT(plannedMs, 0.0);
+    EXPECT_NEAR(wallMs, plannedMs, plannedMs * 0.02 + 150.0);
+}
+
+} // namespace
+
+TEST(job_server, RejectsBadRequests)
+{
+    JobServer server;
+    EXPECT_FALSE(call(server, "not json").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"fly\"}").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"submit\"}").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"submit\",\"project\":{},\"device\":3}").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"cancel\",\"job\":42}").value("ok", true));
+    // Fields of the wrong type
+    EXPECT_FALSE(call(server, "{\"cmd\":5}").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"submit\",\"entity\":\"x\",\"project\":{}}").value("ok", true));
+    EXPECT_FALSE(call(server, "{\"cmd\":\"pause\",\"job\":\"1\"}").value("ok", true));
+    const json r = call(server, "{\"cmd\":\"devices\",\"tag\":7}");
+    EXPECT_TRUE(r.value("ok", false));
+    EXPECT_EQ(r["tag"], 7);
+    EXPECT_TRUE(r["devices"].empty());
+}
+
+#ifdef __linux__
+TEST(job_server, RunsQueuedJobsByPriority)
+{
+    PlotProgramCache::instance().setDirectory("");
+    EbbSimulator sim(EbbSimulator::Options(), VirtualClock(1.0));
+    EbbPtyServer pty(sim);
+    std::string err;
+    ASSERT_TRUE(pty.start(&err)) << err;
+
+    JobServer server;
+    ASSERT_EQ(server.addDevice(pty.devicePath(), &err), 0) << err;
+    ASSERT_TRUE(server.start(&err)) << err;
+
+    // A compiled program on disk, for the second kind of job
+    const std::string programPath = (std::filesystem::temp_directory_path() / "minotaurd_test.mpp").string();
+    {
+        PageModel page;
+        PlotterConfig cfg;
+        ASSERT_TRUE(serialization::projectFromString(page, cfg, smallProject(60.0f, 1), &err)) << err;
+        auto program = PlotProgramCache::instance().get(page, cfg, PlotSpooler::compileOptions(true));
+        ASSERT_TRUE(program);
+        ASSERT_TRUE(program->save(programPath, &err)) << err;
+    }
+
+    const int a = submit(server, "\"project\":" + smallProject(10.0f, 2));
+    ASSERT_TRUE(waitFor(server, a, JobServer::JobState::Running));
+    auto t0 = std::chrono::steady_clock::now();
+    const int b = submit(server, "\"program_file\":\"" + programPath + "\"");
+    const int c = submit(server, "\"priority\":5,\"project\":" + smallProject(30.0f, 1));
+    const int d = submit(server, "\"priority\":9,\"project\":" + smallProject(40.0f, 1));
+    // Held jobs stay in the queue whatever their priority
+    EXPECT_TRUE(call(server, "{\"cmd\":\"pause\",\"job\":" + std::to_string(d) + "}").value("ok", false));
+
+    ASSERT_TRUE(waitFor(server, a, JobServer::JobState::Done));
+    const double aMs = msSince(t0);
+    ASSERT_TRUE(waitFor(server, c, JobServer::JobState::Running));
+    t0 = std::chrono::steady_clock::now();
+    EXPECT_EQ(server.jobState(b), JobServer::JobState::Queued);
+    EXPECT_TRUE(call(server, "{\"cmd\":\"cancel\",\"job\":" + std::to_string(d) + "}").value("ok", false));
+    EXPECT_EQ(server.jobState(d), JobServer::JobState::Cancelled);
+
+    ASSERT_TRUE(waitFor(server, c, JobServer::JobState::Done));
+    const double cMs = msSince(t0);
+    ASSERT_TRUE(waitFor(server, b, JobServer::JobState::Running));
+    t0 = std::chrono::steady_clock::now();
+    ASSERT_TRUE(waitFor(server, b, JobServer::JobState::Done));
+    const double bMs = msSince(t0);
+
+    const json jobs = call(server, "{\"cmd\":\"jobs\"}")["jobs"];
+    ASSERT_EQ(jobs.size(), 4u);
+    EXPECT_FLOAT_EQ(jobs[0]["stats"]["percent_complete"].get<float>(), 1.0f);
+    EXPECT_GT(jobs[1]["stats"]["commands_sent"].get<int>(), 0);
+    expectPlannedTime(aMs, jobs[0]["stats"], false);
+    expectPlannedTime(bMs, jobs[1]["stats"], true);
+    expectPlannedTime(cMs, jobs[2]["stats"], true);
+
+    server.stop();
+    pty.stop();
+    std::filesystem::remove(programPath);
+    EXPECT_EQ(sim.stats().errors, 0);
+    EXPECT_EQ(sim.motor1Position(), 0);
+    EXPECT_EQ(sim.motor2Position(), 0);
+}
+
+TEST(job_server, CancelDoesNotWaitForTheDevice)
+{
+    PlotProgramCache::instance().setDirectory("");
+    EbbSimulator sim(EbbSimulator::Options(), VirtualClock(1.0));
+    EbbPtyServer pty(sim);
+    std::string err;
+    ASSERT_TRUE(pty.start(&err)) << err;
+
+    JobServer server;
+    ASSERT_EQ(server.addDevice(pty.devicePath(), &err), 0) << err;
+    ASSERT_TRUE(server.start(&err)) << err;
+
+    const int a = submit(server, "\"project\":" + smallProject(10.0f, 30));
+    ASSERT_TRUE(waitFor(server, a, JobServer::JobState::Running));
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    // The reply comes back while the spooler is still winding down
+    const auto t0 = std::chrono::steady_clock::now();
+    EXPECT_TRUE(call(server, "{\"cmd\":\"cancel\",\"job\":" + std::to_string(a) + "}").value("ok", false));
+    EXPECT_TRUE(call(server, "{\"cmd\":\"devices\"}").value("ok", false));
+    const double replyMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    EXPECT_LT(replyMs, 50.0);
+
+    ASSERT_TRUE(waitFor(server, a, JobServer::JobState::Cancelled));
+    const json devices = call(server, "{\"cmd\":\"devices\"}")["devices"];
+    ASSERT_EQ(devices.size(), 1u);
+    EXPECT_FALSE(devices[0].contains("job"));
+
+    server.stop();
+    pty.stop();
+}
+
+TEST(job_server, LeavesFilesThatAreNotSocketsAlone)
+{
+    const std::string path = (std::filesystem::temp_directory_path() / "minotaurd_test_file.sock").string();
+    {
+        std::ofstream f(path);
+        f << "keep me";
+    }
+    JobServer::Options opt;
+    opt.socketPath = path;
+    JobServer server(opt);
+    std::string err;
+    EXPECT_FALSE(server.start(&err));
+    EXPECT_NE(err.find("Not a socket"), std::string::npos) << err;
+    EXPECT_TRUE(std::filesystem::is_regular_file(path));
+    std::filesystem::remove(path);
+}
+
+TEST(job_server, StreamsEventsOverTheSocket)
+{
+    PlotProgramCache::instance().setDirectory("");
+    EbbSimulator sim(EbbSimulator::Options(), VirtualClock(1.0));
+    EbbPtyServer pty(sim);
+    std::string err;
+    ASSERT_TRUE(pty.start(&err)) << err;
+
+    JobServer::Options opt;
+    opt.socketPath = (std::filesystem::temp_directory_path() / "minotaurd_test.sock").string();
+    opt.statsIntervalMs = 100;
+    JobServer server(opt);
+    ASSERT_EQ(server.addDevice(pty.devicePath(), &err), 0) << err;
+    ASSERT_TRUE(server.start(&err)) << err;
+    // Only the owner may connect
+    EXPECT_EQ(std::filesystem::status(opt.socketPath).permissions() & std::filesystem::perms::all,
+              std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", opt.socketPath.c_str());
+    ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)), 0);
+
+    const std::string req = "{\"cmd\":\"watch\"}\n{\"cmd\":\"submit\",\"tag\":\"t1\",\"project\":" + smallProject(10.0f, 2) + "}\n";
+    ASSERT_EQ(write(fd, req.data(), req.size()), static_cast<ssize_t>(req.size()));
+
+    // Replies and events, one JSON object per line, until the job is done
+    std::vector<json> lines;
+    std::string buf;
+    bool done = false;
+    auto runningAt = std::chrono::steady_clock::now();
+    double runMs = 0.0;
+    timeval tv{10, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    while (!done)
+    {
+        char chunk[4096];
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        ASSERT_GT(n, 0);
+        buf.append(chunk, static_cast<size_t>(n));
+        size_t nl;
+        while ((nl = buf.find('\n')) != std::string::npos)
+        {
+            lines.push_back(json::parse(buf.substr(0, nl)));
+            buf.erase(0, nl + 1);
+            const json &l = lines.back();
+            if (l.value("event", "") == "job" && l.value("state", "") == "running")
+                runningAt = std::chrono::steady_clock::now();
+            if (!done && l.value("event", "") == "job" && l.value("state", "") == "done")
+            {
+                runMs = msSince(runningAt);
+                done = true;
+            }
+        }
+    }
+    close(fd);
+    server.stop();
+    pty.stop();
+
+    ASSERT_GE(lines.size(), 4u);
+    EXPECT_TRUE(lines[0].value("ok", false));
+    EXPECT_EQ(lines[1]["tag"], "t1");
+    bool sawRunning = false;
+    json lastStats;
+    for (const json &l : lines)
+    {
+        sawRunning = sawRunning || l.value("state", "") == "running";
+        if (l.value("event", "") == "stats" && !l["jobs"].empty()) lastStats = l["jobs"][0]["stats"];
+    }
+    EXPECT_TRUE(sawRunning);
+    ASSERT_FALSE(lastStats.is_null());
+    expectPlannedTime(runMs, lastStats, false);
+    EXPECT_FALSE(std::filesystem::exists(opt.socketPath));
+    EXPECT_EQ(sim.stats().errors, 0);
+}
+#endif
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../src/plotters/JobSharding.h"
+
+#ifdef __linux__
+#include "../src/plotters/AxidrawController.h"
+#include "../src/plotters/EbbSimulator.h"
+#include "../src/plotters/MultiPlotSpooler.h"
+#include "../src/plotters/PlotProgramCache.h"
+#include "../src/serial/SerialController.h"
+#endif
+
+namespace
+{
+
+float penDownMm(const PathSet &paths)
+{
+    float len = 0.0f;
+    for (const PathView &path : paths)
+    {
+        const size_t n = path.points.size();
+        for (size_t k = 0; k + 1 < n; ++k) len += std::hypot(path.points[k + 1].x - path.points[k].x, path.points[k + 1].y - path.points[k].y);
+        if (path.closed && n > 2) len += std::hypot(path.points[0].x - path.points[n - 1].x, path.points[0].y - path.points[n - 1].y);
+    }
+    return len;
+}
+
+// Dense hatching on the left third of a 300 mm wide job, a sparse grid on the rest
+PathSet skewedJob(std::vector<int> &entity)
+{
+    PathSet paths;
+    for (int i = 0; i < 200; ++i)
+    {
+        const float y = 10.0f + 0.5f * float(i);
+        paths.addPath(std::vector<Vec2>{Vec2(10.0f, y), Vec2(110.0f, y)});
+        entity.push_back(0);
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+        const float x = 110.0f + 20.0f * float(i);
+        paths.addPath(std::vector<Vec2>{Vec2(x, 10.0f), Vec2(x, 110.0f)});
+        entity.push_back(1);
+    }
+    paths.addPath(std::vector<Vec2>{Vec2(20.0f, 150.0f), Vec2(300.0f, 150.0f), Vec2(300.0f, 200.0f), Vec2(20.0f, 200.0f)}, true);
+    entity.push_back(2);
+    return paths;
+}
+
+} // namespace
+
+TEST(job_sharding, StripsKeepTheGeometry)
+{
+    std::vector<int> entity;
+    const PathSet paths = skewedJob(entity);
+    const float total = penDownMm(paths);
+    PlotterConfig cfg;
+
+    for (ShardMode mode : {ShardMode::Tiles, ShardMode::Balanced})
+    {
+        const std::vector<JobShard> shards = shardJob(paths, entity, 3, mode, cfg);
+        ASSERT_EQ(shards.size(), 3u);
+        float sum = 0.0f;
+        for (size_t d = 0; d < shards.size(); ++d)
+        {
+            const JobShard &s = shards[d];
+            EXPECT_EQ(s.pathEntity.size(), s.paths.size());
+            sum += penDownMm(s.paths);
+            // Shifted back to the job's left edge, and only as wide as the strip
+            const float stripEnd = d + 1 < shards.size() ? shards[d + 1].offsetXMm + 10.0f : 300.0f;
+            for (const Vec2 &p : s.paths.points)
+            {
+                EXPECT_GE(p.x, 10.0f - 1e-3f);
+                EXPECT_LE(p.x + s.offsetXMm, stripEnd + 1e-3f);
+            }
+        }
+        EXPECT_NEAR(sum, total, total * 1e-4f);
+    }
+
+    // Lines on the strip edges, and one ending on an edge, are plotted exactly once
+    PathSet edgeLines;
+    std::vector<int> edgeEntity;
+    for (float x : {0.0f, 100.0f, 200.0f, 300.0f})
+    {
+        edgeLines.addPath(std::vector<Vec2>{Vec2(x, 0.0f), Vec2(x, 50.0f)});
+        edgeEntity.push_back(0);
+    }
+    edgeLines.addPath(std::vector<Vec2>{Vec2(50.0f, 80.0f), Vec2(100.0f, 80.0f)});
+    edgeEntity.push_back(1);
+    const std::vector<JobShard> edgeShards = shardJob(edgeLines, edgeEntity, 3, ShardMode::Tiles, cfg);
+    ASSERT_EQ(edgeShards.size(), 3u);
+    size_t edgePaths = 0;
+    float edgeSum = 0.0f;
+    for (const JobShard &s : edgeShards)
+    {
+        edgePaths += s.paths.size();
+        edgeSum += penDownMm(s.paths);
+    }
+    EXPECT_EQ(edgeShards[0].paths.size(), 2u);
+    EXPECT_EQ(edgeShards[2].paths.size(), 2u);
+    EXPECT_EQ(edgePaths, edgeLines.size());
+    EXPECT_NEAR(edgeSum, penDownMm(edgeLines), 1e-3f);
+
+    // Paths with a segment lying on an edge: the segment goes to the strip on the right
+    PathSet onEdge;
+    std::vector<int> onEdgeEntity{0, 0, 1, 2};
+    onEdge.addPath(std::vector<Vec2>{Vec2(0.0f, 0.0f)});
+    onEdge.addPath(std::vector<Vec2>{Vec2(300.0f, 0.0f)});
+    onEdge.addPath(std::vector<Vec2>{Vec2(50.0f, 0.0f), Vec2(100.0f, 0.0f), Vec2(100.0f, 50.0f)});
+    onEdge.addPath(std::vector<Vec2>{Vec2(60.0f, 100.0f), Vec2(100.0f, 100.0f), Vec2(100.0f, 140.0f), Vec2(60.0f, 140.0f)}, true);
+    const std::vector<JobShard> onEdgeShards = shardJob(onEdge, onEdgeEntity, 3, ShardMode::Tiles, cfg);
+    ASSERT_EQ(onEdgeShards.size(), 3u);
+    EXPECT_NEAR(penDownMm(onEdgeShards[0].paths), 50.0f + 40.0f * 3.0f, 1e-3f);
+    EXPECT_NEAR(penDownMm(onEdgeShards[1].paths), 50.0f + 40.0f, 1e-3f);
+    EXPECT_NEAR(penDownMm(onEdgeShards[2].paths), 0.0f, 1e-3f);
+
+    const std::vector<JobShard> copies = shardJob(paths, entity, 2, ShardMode::Copy, cfg);
+    ASSERT_EQ(copies.size(), 2u);
+    EXPECT_EQ(copies[1].paths.size(), paths.size());
+    EXPECT_EQ(copies[1].offsetXMm, 0.0f);
+}
+
+TEST(job_sharding, BalancedEvensOutPlotTime)
+{
+    std::vector<int> entity;
+    const PathSet paths = skewedJob(entity);
+    PlotterConfig cfg;
+    PlotCompileOptions copt;
+    copt.refineBudgetMs = 0.0;
+
+    // Slowest device over the fastest one
+    auto spread = [&](ShardMode mode) {
+        double lo = 1e30, hi = 0.0;
+        for (const JobShard &s : shardJob(paths, entity, 3, mode, cfg))
+        {
+            std::shared_ptr<PlotProgram> prog = PlotProgram::compile(s.paths, s.pathEntity, cfg, copt);
+            const double ms = prog ? static_cast<double>(prog->totals().totalMs) : 0.0;
+            lo = std::min(lo, ms);
+            hi = std::max(hi, ms);
+        }
+        return hi / std::max(1.0, lo);
+    };
+    const double tiles = spread(ShardMode::Tiles);
+    const double balanced = spread(ShardMode::Balanced);
+    EXPECT_GT(tiles, 2.0);
+    EXPECT_LT(balanced, 1.1);
+}
+
+#ifdef __linux__
+TEST(job_sharding, PlotsOnSeveralSimulatedDevices)
+{
+    PlotProgramCache::instance().setDirectory("");
+
+    constexpr int kDevices = 3;
+    std::vector<std::unique_ptr<EbbSimulator>> sims;
+    std::vector<std::unique_ptr<EbbPtyServer>> servers;
+    std::vector<std::unique_ptr<SerialController>> serials;
+    std::vector<std::unique_ptr<AxiDrawState>> states;
+    std::vector<std::unique_ptr<AxiDrawController>> axidraws;
+    std::vector<MultiPlotSpooler::Device> devices;
+    std::string err;
+    for (int i = 0; i < kDevices; ++i)
+    {
+        sims.push_back(std::make_unique<EbbSimulator>(EbbSimulator::Options(), VirtualClock(1.0)));
+        servers.push_back(std::make_unique<EbbPtyServer>(*sims.back()));
+        ASSERT_TRUE(servers.back()->start(&err)) << err;
+        serials.push_back(std::make_unique<SerialController>());
+        ASSERT_TRUE(serials.back()->connect(servers.back()->devicePath(), 115200, &err)) << err;
+        states.push_back(std::make_unique<AxiDrawState>());
+        axidraws.push_back(std::make_unique<AxiDrawController>(*serials.back(), *states.back()));
+        devices.push_back({serials.back().get(), axidraws.back().get()});
+    }
+
+    // A short job, so that it runs in about a second on the wall clock
+    PathSet paths;
+    std::vector<int> entity;
+    for (int i = 0; i < 6; ++i)
+    {
+        const float x = 10.0f + 6.0f * float(i);
+        paths.addPath(std::vector<Vec2>{Vec2(x, 10.0f), Vec2(x + 4.0f, 14.0f)});
+        entity.push_back(0);
+    }
+
+    PlotterConfig cfg;
+    MultiPlotSpooler spooler(devices);
+    ASSERT_EQ(spooler.deviceCount(), size_t(kDevices));
+    const auto wall0 = std::chrono::steady_clock::now();
+    ASSERT_TRUE(spooler.startPaths(paths, entity, cfg, ShardMode::Tiles, true, &err)) << err;
+    for (int i = 0; i < 1000 && spooler.isRunning(); ++i) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    ASSERT_FALSE(spooler.isRunning());
+    const double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall0).count();
+
+    const MultiPlotSpooler::Stats st = spooler.stats();
+    ASSERT_EQ(st.devices.size(), size_t(kDevices));
+    int sent = 0;
+    int plannedMs = 0;
+    for (const PlotSpooler::Stats &d : st.devices)
+    {
+        EXPECT_GT(d.commandsSent, 0);
+        sent += d.commandsSent;
+        plannedMs = std::max(plannedMs, d.plannedMs);
+    }
+    EXPECT_EQ(st.total.commandsSent, sent);
+    // The devices plot side by side: the job takes as long as the longest shard
+    EXPECT_GE(wallMs, plannedMs);
+    EXPECT_LT(wallMs, plannedMs * 1.02 + 150.0);
+    EXPECT_NEAR(st.total.plannedPenDownMm, penDownMm(paths), 0.05f);
+
+    for (int i = 0; i < kDevices; ++i)
+    {
+        serials[i]->disconnect();
+        servers[i]->stop();
+        EXPECT_EQ(sims[i]->stats().errors, 0);
+        EXPECT_EQ(sims[i]->motor1Position(), 0);
+        EXPECT_EQ(sims[i]->motor2Position(), 0);
+        // In real time, the device is kept busy from its first move to the end: the plan
+        // plus the spooler's closing pen up
+        const EbbSimulator::Stats &ds = sims[i]->stats();
+        const int shardMs = st.devices[i].plannedMs;
+        EXPECT_NEAR(ds.busyMs + ds.idleGapMs - axidraws[i]->penMoveMs(), shardMs, shardMs * 0.02 + 20.0) << "device " << i;
+    }
+}
+#endif
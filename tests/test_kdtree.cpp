@@ -1,11 +1,16 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <ctime>
-#include <iostream>
 #include "../src/utils/nanoflann.hpp"
 #include "../src/core/Vec2.h"
+#include "../src/utils/KdTree2D.h"
+#include <limits>
+#include <random>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 
 struct PointCloud
@@ -46,8 +51,8 @@ void generateRandomPointCloudRanges(
     pc.pts.resize(N);
     for (size_t i = 0; i < N; i++)
     {
-        pc.pts[i].x = max_range_x * (rand() % 1000) / T(1000);
-        pc.pts[i].y = max_range_y * (rand() % 1000) / T(1000);
+        pc.pts[i].x = max_range_x * (rand() % 1000) / float(1000);
+        pc.pts[i].y = max_range_y * (rand() % 1000) / float(1000);
     }
 }
 
@@ -59,110 +64,144 @@ void generateRandomPointCloud(
 }
 
 
-inline void dump_mem_usage()
+// Indices of the k live points nearest q, by brute force, nearest first
+std::vector<size_t> bruteNearest(const PointCloud &cloud, const std::vector<bool> &alive, const float *q, size_t k)
 {
-    FILE* f = fopen("/proc/self/statm", "rt");
-    if (!f) return;
-    char   str[300];
-    size_t n = fread(str, 1, 200, f);
-    str[n]   = 0;
-    printf("MEM: %s\n", str);
-    fclose(f);
+    std::vector<std::pair<float, size_t>> all;
+    for (size_t i = 0; i < cloud.pts.size(); ++i)
+    {
+        if (!alive[i]) continue;
+        const float dx = cloud.pts[i].x - q[0], dy = cloud.pts[i].y - q[1];
+        all.emplace_back(dx * dx + dy * dy, i);
+    }
+    std::sort(all.begin(), all.end());
+    std::vector<size_t> out;
+    for (size_t i = 0; i < k && i < all.size(); ++i) out.push_back(all[i].second);
+    return out;
+}
+
+float dist2(const PointCloud &cloud, size_t i, const float *q)
+{
+    const float dx = cloud.pts[i].x - q[0], dy = cloud.pts[i].y - q[1];
+    return dx * dx + dy * dy;
 }
 
 void kdtree_demo(const size_t N)
 {
     PointCloud cloud;
 
-    // construct a kd-tree index:
+    // construct a kd-tree index; it indexes whatever the cloud holds at this point,
+    // so it starts empty and the points are added below
     using my_kd_tree_t = nanoflann::KDTreeSingleIndexDynamicAdaptor<
         nanoflann::L2_Simple_Adaptor<float, PointCloud>,
         PointCloud, 2 /* dim */
         >;
 
-    dump_mem_usage();
-
-    my_kd_tree_t index(3 /*dim*/, cloud, {10 /* max leaf */});
-
+    my_kd_tree_t index(2 /*dim*/, cloud, {10 /* max leaf */});
 
-    float query_pt[3] = {0.5, 0.5};
+    srand(7);
+    generateRandomPointCloud<float>(cloud, N);
 
     // add points in chunks at a time
-    size_t chunk_size = 100;
+    const size_t chunk_size = 100;
     for (size_t i = 0; i < N; i = i + chunk_size)
     {
-        size_t end = std::min<size_t>(i + chunk_size, N - 1);
-        // Inserts all points from [i, end]
-        index.addPoints(i, end);
+        const size_t end = std::min<size_t>(i + chunk_size, N);
+        // Inserts all points from [i, end - 1]
+        index.addPoints(i, end - 1);
     }
 
     // remove a point
-    size_t removePointIndex = N - 1;
+    std::vector<bool> alive(N, true);
+    const size_t removePointIndex = N - 1;
     index.removePoint(removePointIndex);
+    alive[removePointIndex] = false;
 
-    dump_mem_usage();
+    const float queries[][2] = {{0.5f, 0.5f}, {5.0f, 5.0f}, {cloud.pts[N - 1].x, cloud.pts[N - 1].y}, {12.0f, -3.0f}};
+    for (const auto &query_pt : queries)
     {
-        std::cout << "Searching for 1 element..." << std::endl;
-        // do a knn search
-        const size_t num_results = 1;
-        size_t ret_index;
-        float out_dist_sqr;
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        resultSet.init(&ret_index, &out_dist_sqr);
-        index.findNeighbors(resultSet, query_pt, {10});
-
-        std::cout << "knnSearch(nn=" << num_results << "): \n";
-        std::cout << "ret_index=" << ret_index
-                  << " out_dist_sqr=" << out_dist_sqr << std::endl;
-        std::cout << "point: ("
-                  << "point: (" << cloud.pts[ret_index].x << ", "
-                  << cloud.pts[ret_index].y << ")" << std::endl;
-        std::cout << std::endl;
-    }
-    {
-        // do a knn search searching for more than one result
-        const size_t num_results = 5;
-        std::cout << "Searching for " << num_results << " elements"
-                  << std::endl;
-        size_t ret_index[num_results];
-        float out_dist_sqr[num_results];
-        nanoflann::KNNResultSet<float> resultSet(num_results);
-        resultSet.init(ret_index, out_dist_sqr);
-        index.findNeighbors(resultSet, query_pt);
-
-        std::cout << "knnSearch(nn=" << num_results << "): \n";
-        std::cout << "Results: " << std::endl;
-        for (size_t i = 0; i < resultSet.size(); ++i)
+        // knn search for one and for several results; ties may come back in either
+        // order, so distances are compared
+        for (size_t num_results : {size_t(1), size_t(5)})
         {
-            std::cout << "#" << i << ",\t"
-                      << "index: " << ret_index[i] << ",\t"
-                      << "dist: " << out_dist_sqr[i] << ",\t"
-                      << "point: (" << cloud.pts[ret_index[i]].x << ", "
-                      << cloud.pts[ret_index[i]].y <<  ")" << std::endl;
+            std::vector<size_t> ret_index(num_results);
+            std::vector<float> out_dist_sqr(num_results);
+            nanoflann::KNNResultSet<float> resultSet(num_results);
+            resultSet.init(ret_index.data(), out_dist_sqr.data());
+            index.findNeighbors(resultSet, query_pt);
+
+            const std::vector<size_t> want = bruteNearest(cloud, alive, query_pt, num_results);
+            ASSERT_EQ(resultSet.size(), want.size());
+            for (size_t i = 0; i < want.size(); ++i)
+            {
+                EXPECT_TRUE(alive[ret_index[i]]);
+                EXPECT_FLOAT_EQ(out_dist_sqr[i], dist2(cloud, want[i], query_pt)) << i;
+                EXPECT_FLOAT_EQ(dist2(cloud, ret_index[i], query_pt), out_dist_sqr[i]) << i;
+            }
         }
-        std::cout << std::endl;
-    }
-    {
-        // Unsorted radius search:
-        std::cout << "Unsorted radius search" << std::endl;
+
+        // Unsorted radius search
         const float radiusSqr = 1;
         std::vector<nanoflann::ResultItem<size_t, float>> indices_dists;
-        nanoflann::RadiusResultSet<float, size_t> resultSet(
-            radiusSqr, indices_dists);
-
+        nanoflann::RadiusResultSet<float, size_t> resultSet(radiusSqr, indices_dists);
         index.findNeighbors(resultSet, query_pt);
-
-        nanoflann::ResultItem<size_t, float> worst_pair =
-            resultSet.worst_item();
-        std::cout << "Worst pair: idx=" << worst_pair.first
-                  << " dist=" << worst_pair.second << std::endl;
-        std::cout << "point: (" << cloud.pts[worst_pair.first].x << ", "
-                  << cloud.pts[worst_pair.first].y << ")" << std::endl;
-        std::cout << std::endl;
+        size_t inside = 0;
+        for (size_t i = 0; i < N; ++i)
+            if (alive[i] && dist2(cloud, i, query_pt) < radiusSqr) ++inside;
+        EXPECT_EQ(indices_dists.size(), inside);
+        for (const auto &item : indices_dists)
+        {
+            EXPECT_TRUE(alive[item.first]);
+            EXPECT_LT(item.second, radiusSqr);
+        }
     }
 }
 
 TEST(kdtree, Basic)
 {
-    kdtree_demo(1000000);
-}
\ No newline at end of file
+    kdtree_demo(2000);
+}
+
+static float d2(const Vec2 &a, const Vec2 &b)
+{
+    const float dx = a.x - b.x, dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+TEST(kdtree2d, NearestWithRemovals)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> u(-50.0f, 250.0f);
+    std::vector<Vec2> pts(3000);
+    for (auto &p : pts) p = Vec2(u(rng), u(rng) * 0.1f);
+
+    KdTree2D tree;
+    tree.build(pts);
+    std::vector<bool> alive(pts.size(), true);
+    for (size_t step = 0; step < pts.size(); ++step)
+    {
+        const Vec2 q(u(rng) * 1.5f, u(rng));
+        float bestD = std::numeric_limits<float>::infinity();
+        uint32_t best = KdTree2D::npos;
+        for (uint32_t i = 0; i < pts.size(); ++i)
+            if (alive[i] && d2(pts[i], q) < bestD) { bestD = d2(pts[i], q); best = i; }
+
+        float gotD = 0.0f;
+        const uint32_t got = tree.nearest(q, &gotD);
+        ASSERT_EQ(got, best) << "step " << step;
+        if (got == KdTree2D::npos)
+            break;
+        ASSERT_FLOAT_EQ(gotD, bestD);
+
+        std::vector<uint32_t> knn;
+        tree.nearestK(q, 5, knn);
+        ASSERT_FALSE(knn.empty());
+        EXPECT_FLOAT_EQ(d2(pts[knn[0]], q), bestD);
+        for (size_t k = 1; k < knn.size(); ++k)
+            EXPECT_LE(d2(pts[knn[k - 1]], q), d2(pts[knn[k]], q));
+
+        const uint32_t victim = (step % 3 == 0) ? got : static_cast<uint32_t>(rng() % pts.size());
+        EXPECT_EQ(tree.remove(victim), alive[victim]);
+        alive[victim] = false;
+    }
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "../src/Page.h"
+#include "../src/core/Mask.h"
+#include "../src/filters/FilterRegistry.h"
+#include "../src/utils/Serialization.h"
+
+static Bitmap noiseBitmap(size_t w, size_t h, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    Bitmap bm;
+    bm.width_px = w;
+    bm.height_px = h;
+    bm.pixel_size_mm = 0.25f;
+    bm.pixels.resize(w * h);
+    for (uint8_t &p : bm.pixels) p = static_cast<uint8_t>(rng() & 0xFF);
+    return bm;
+}
+
+TEST(mask, PackAndUnpackAcrossWordBorders)
+{
+    // Widths on both sides of each word boundary
+    for (size_t w : {1u, 63u, 64u, 65u, 127u, 128u, 130u})
+    {
+        const Bitmap bm = noiseBitmap(w, 5, static_cast<uint32_t>(w));
+        Mask m;
+        maskFromBitmap(bm, m, 100);
+        ASSERT_EQ(m.wordsPerRow, (w + 63) / 64);
+        EXPECT_EQ(m.pixel_size_mm, bm.pixel_size_mm);
+
+        size_t ink = 0;
+        for (size_t y = 0; y < bm.height_px; ++y)
+            for (size_t x = 0; x < w; ++x)
+            {
+                const bool want = bm.pixels[y * w + x] < 100;
+                ASSERT_EQ(m.get(x, y), want) << "w " << w << " at " << x << "," << y;
+                ink += want ? 1 : 0;
+            }
+        EXPECT_EQ(m.countSet(), ink);
+
+        // Padding past the last pixel stays clear
+        for (size_t y = 0; y < bm.height_px; ++y)
+            EXPECT_EQ(m.row(y)[m.wordsPerRow - 1] & ~m.tailMask(), 0u);
+
+        Bitmap back;
+        bitmapFromMask(m, back);
+        ASSERT_EQ(back.pixels.size(), bm.pixels.size());
+        for (size_t i = 0; i < bm.pixels.size(); ++i)
+            ASSERT_EQ(back.pixels[i], bm.pixels[i] < 100 ? 0 : 255);
+    }
+}
+
+TEST(mask, SetAndGetOnWordEdges)
+{
+    Mask m;
+    m.resize(130, 3);
+    EXPECT_EQ(m.tailMask(), 0x3u);
+    for (size_t x : {0u, 63u, 64u, 127u, 128u, 129u}) m.set(x, 1, true);
+    EXPECT_EQ(m.countSet(), 6u);
+    EXPECT_EQ(m.row(1)[0], (uint64_t(1) << 63) | 1u);
+    EXPECT_EQ(m.row(1)[1], (uint64_t(1) << 63) | 1u);
+    EXPECT_EQ(m.row(1)[2], 0x3u);
+    EXPECT_EQ(m.row(0)[0] | m.row(2)[2], 0u);
+
+    m.set(64, 1, false);
+    EXPECT_FALSE(m.get(64, 1));
+    EXPECT_TRUE(m.get(63, 1));
+    EXPECT_EQ(m.countSet(), 5u);
+
+    Mask whole;
+    whole.resize(128, 1);
+    EXPECT_EQ(whole.tailMask(), ~uint64_t(0));
+}
+
+TEST(mask, WordHelpers)
+{
+    EXPECT_EQ(maskbits::popcount(0), 0);
+    EXPECT_EQ(maskbits::popcount(~uint64_t(0)), 64);
+    EXPECT_EQ(maskbits::popcount(0x8000000000000001ull), 2);
+    EXPECT_EQ(maskbits::lowestBit(1), 0);
+    EXPECT_EQ(maskbits::lowestBit(uint64_t(1) << 63), 63);
+    EXPECT_EQ(maskbits::lowestBit(0xF0ull), 4);
+
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 1000; ++i)
+    {
+        const uint64_t v = rng() | 1u << (i & 7);
+        int bits = 0, lowest = -1;
+        for (int b = 63; b >= 0; --b)
+            if ((v >> b) & 1u)
+            {
+                ++bits;
+                lowest = b;
+            }
+        ASSERT_EQ(maskbits::popcount(v), bits);
+        ASSERT_EQ(maskbits::lowestBit(v), lowest);
+    }
+}
+
+TEST(mask, NeighbourWordsMatchPixels)
+{
+    for (size_t w : {1u, 63u, 64u, 65u, 130u})
+    {
+        const size_t h = 6;
+        Mask m;
+        maskFromBitmap(noiseBitmap(w, h, static_cast<uint32_t>(w) + 3), m, 170);
+        auto ink = [&](long x, long y) {
+            return x >= 0 && y >= 0 && x < static_cast<long>(w) && y < static_cast<long>(h) && m.get(static_cast<size_t>(x), static_cast<size_t>(y));
+        };
+        for (size_t y = 0; y < h; ++y)
+        {
+            const uint64_t *up = y > 0 ? m.row(y - 1) : nullptr;
+            const uint64_t *down = y + 1 < h ? m.row(y + 1) : nullptr;
+            for (size_t i = 0; i < m.wordsPerRow; ++i)
+            {
+                const uint64_t west = maskbits::west(m.row(y), i);
+                const uint64_t east = maskbits::east(m.row(y), i, m.wordsPerRow);
+                const uint64_t edge = maskbits::edge4(up, m.row(y), down, i, m.wordsPerRow);
+                for (size_t b = 0; b < 64 && i * 64 + b < w; ++b)
+                {
+                    const long x = static_cast<long>(i * 64 + b), yy = static_cast<long>(y);
+                    ASSERT_EQ((west >> b) & 1u, ink(x - 1, yy) ? 1u : 0u) << "w " << w << " at " << x << "," << y;
+                    ASSERT_EQ((east >> b) & 1u, ink(x + 1, yy) ? 1u : 0u) << "w " << w << " at " << x << "," << y;
+                    const bool isEdge = ink(x, yy) && !(ink(x - 1, yy) && ink(x + 1, yy) && ink(x, yy - 1) && ink(x, yy + 1));
+                    ASSERT_EQ((edge >> b) & 1u, isEdge ? 1u : 0u) << "w " << w << " at " << x << "," << y;
+                }
+                // Nothing leaks into the padding
+                if (i + 1 == m.wordsPerRow)
+                {
+                    EXPECT_EQ(east & ~m.tailMask(), 0u);
+                    EXPECT_EQ(edge & ~m.tailMask(), 0u);
+                }
+            }
+        }
+    }
+}
+
+TEST(mask, LoadsTheTracingFiltersOldThreshold)
+{
+    FilterRegistry::initDefaults();
+    PageModel page;
+    page.addBitmap(noiseBitmap(16, 16, 1));
+    PlotterConfig cfg;
+    std::string text, err;
+    ASSERT_TRUE(serialization::projectToString(page, cfg, text, &err)) << err;
+
+    // A project from before Trace took a mask: it thresholded the bitmap itself
+    nlohmann::json j = nlohmann::json::parse(text);
+    for (auto &je : j["entities"])
+        je["filters"] = nlohmann::json::array({{{"type", "Trace"}, {"enabled", false}, {"params", {{"threshold", 90.0}}}}});
+
+    PageModel loaded;
+    ASSERT_TRUE(serialization::projectFromString(loaded, cfg, j.dump(), &err)) << err;
+    ASSERT_EQ(loaded.entities.size(), 1u);
+    const FilterChain &chain = loaded.entities.begin()->second.filterChain;
+    ASSERT_EQ(chain.filterCount(), 2u);
+    const FilterBase *threshold = chain.filterAt(0);
+    EXPECT_EQ(std::string(threshold->name()), "Threshold");
+    EXPECT_EQ(threshold->m_parameters.at("min").value, 0.0f);
+    EXPECT_EQ(threshold->m_parameters.at("max").value, 89.0f);
+    EXPECT_FALSE(chain.isFilterEnabled(0));
+    EXPECT_EQ(std::string(chain.filterAt(1)->name()), "Trace");
+}
@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+#include "../src/plotters/MotionPlanner.h"
+
+static int totalMs(const std::vector<MoveSlice> &moves)
+{
+    int t = 0;
+    for (const MoveSlice &m : moves) t += m.dtMs;
+    return t;
+}
+
+TEST(motion_stream, ChainedStrokesDoNotStop)
+{
+    PlannerSettings s;
+    // Ten collinear 20 mm strokes, end to end
+    std::vector<std::vector<Vec2>> strokes;
+    for (int i = 0; i < 10; ++i)
+        strokes.push_back({Vec2(20.0f * i, 0.0f), Vec2(20.0f * (i + 1), 0.0f)});
+
+    std::vector<MoveSlice> separate;
+    Vec2 at(0.0f, 0.0f);
+    for (const auto &st : strokes)
+    {
+        std::vector<MoveSlice> m = planPath(s, st, false, at);
+        separate.insert(separate.end(), m.begin(), m.end());
+        at = st.back();
+    }
+
+    MotionStream stream(s);
+    stream.reset(Vec2(0.0f, 0.0f));
+    std::vector<MoveSlice> joined;
+    size_t emittedEarly = 0;
+    for (const auto &st : strokes)
+    {
+        stream.add(st, false);
+        stream.flushReady(joined);
+        if (emittedEarly == 0) emittedEarly = joined.size();
+    }
+    EXPECT_GT(emittedEarly, 0u); // slices come out before the end of the input
+    stream.finish(joined);
+    EXPECT_TRUE(stream.idle());
+
+    // Same displacement, without the accelerate / brake at every joint
+    int aS = 0, bS = 0, aJ = 0, bJ = 0;
+    for (const MoveSlice &m : separate) { aS += m.aSteps; bS += m.bSteps; }
+    for (const MoveSlice &m : joined) { aJ += m.aSteps; bJ += m.bSteps; }
+    EXPECT_EQ(aJ, aS);
+    EXPECT_EQ(bJ, bS);
+    EXPECT_EQ(aJ, 200 * s.stepsPerMm);
+    EXPECT_LT(totalMs(joined), totalMs(separate) * 85 / 100);
+}
+
+TEST(motion_stream, ReturnsExactlyHome)
+{
+    PlannerSettings s;
+    MotionStream stream(s);
+    stream.reset(Vec2(0.0f, 0.0f));
+    std::vector<MoveSlice> out;
+    // Coordinates that do not land on whole steps, plus a point closer than minSegmentMm
+    std::vector<Vec2> pts{Vec2(0.013f, 0.007f), Vec2(13.337f, 4.211f), Vec2(13.34f, 4.2f), Vec2(-2.718f, 9.871f)};
+    stream.add(pts, false);
+    const Vec2 home(0.0f, 0.0f);
+    stream.add(Span<const Vec2>(&home, 1), true);
+    stream.finish(out);
+    int a = 0, b = 0;
+    for (const MoveSlice &m : out) { a += m.aSteps; b += m.bSteps; }
+    EXPECT_EQ(a, 0);
+    EXPECT_EQ(b, 0);
+}
+
+TEST(motion_stream, SCurveLimitsJerk)
+{
+    PlannerSettings s;
+    s.timeSliceMs = 5;
+    std::vector<Vec2> line{Vec2(0.0f, 0.0f), Vec2(60.0f, 0.0f)};
+    std::vector<MoveSlice> trap = planPath(s, line, false, Vec2(0.0f, 0.0f));
+    s.sCurve = true;
+    s.jerkMmPerS3 = 5000.0f;
+    std::vector<MoveSlice> smooth = planPath(s, line, false, Vec2(0.0f, 0.0f));
+
+    int aT = 0, aS = 0;
+    for (const MoveSlice &m : trap) aT += m.aSteps;
+    for (const MoveSlice &m : smooth) aS += m.aSteps;
+    EXPECT_EQ(aS, aT);
+    EXPECT_GT(totalMs(smooth), totalMs(trap));
+
+    // Acceleration ramps in instead of jumping to its limit, so the first
+    // slices of the S-curve cover noticeably less ground
+    int firstT = 0, firstS = 0;
+    for (size_t i = 0; i < 10; ++i) { firstT += trap[i].aSteps; firstS += smooth[i].aSteps; }
+    EXPECT_LT(firstS * 2, firstT);
+}
+
+// Ticks of the EBB step clock until an LM axis has taken its steps, or -1 if it stalls
+static int lowLevelTicks(int steps, uint32_t rate, int32_t accel)
+{
+    const int64_t one = int64_t(1) << 31;
+    int64_t acc = 0, r = rate;
+    int taken = 0, ticks = 0;
+    while (taken < std::abs(steps))
+    {
+        if (++ticks > 10 * 25000) return -1;
+        r += accel;
+        if (r < 0) r = 0;
+        acc += r;
+        if (acc >= one) { acc -= one; ++taken; }
+    }
+    return ticks;
+}
+
+TEST(motion_stream, LowLevelMovesMatchSlices)
+{
+    PlannerSettings s;
+    std::vector<Vec2> curve;
+    for (int i = 0; i <= 200; ++i)
+    {
+        const float t = 0.05f * i;
+        curve.push_back(Vec2(40.0f * std::cos(t), 25.0f * std::sin(t)) + Vec2(t * 8.0f, 0.0f));
+    }
+    std::vector<MoveSlice> sliced = planPath(s, curve, false, curve.front());
+    s.lowLevelMoves = true;
+    std::vector<MoveSlice> lm = planPath(s, curve, false, curve.front());
+    ASSERT_FALSE(lm.empty());
+    EXPECT_LT(lm.size(), sliced.size());
+
+    int aS = 0, bS = 0, aL = 0, bL = 0;
+    for (const MoveSlice &m : sliced) { aS += m.aSteps; bS += m.bSteps; }
+    for (const MoveSlice &m : lm)
+    {
+        ASSERT_TRUE(m.lowLevel);
+        aL += m.aSteps;
+        bL += m.bSteps;
+        // The registers take every step within the planned duration (give or take the
+        // last half step and the ms rounding)
+        const int ta = lowLevelTicks(m.aSteps, m.rateA, m.accelA);
+        const int tb = lowLevelTicks(m.bSteps, m.rateB, m.accelB);
+        ASSERT_GE(ta, 0);
+        ASSERT_GE(tb, 0);
+        EXPECT_NEAR(std::max(ta, tb) / 25.0, m.dtMs, 5.0);
+    }
+    EXPECT_EQ(aL, aS);
+    EXPECT_EQ(bL, bS);
+    EXPECT_NEAR(totalMs(lm), totalMs(sliced), totalMs(sliced) * 0.02 + 10.0);
+}
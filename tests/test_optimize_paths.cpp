@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../src/filters/pathset/OptimizePathsFilter.h"
+
+static PathSet mergeOnly(const PathSet &in, float mergeDistanceMm)
+{
+    OptimizePathsFilter f;
+    f.setParameter("mergeEnabled", 1.0f);
+    f.setParameter("mergeDistanceMm", mergeDistanceMm);
+    f.setParameter("reorder", 0.0f);
+    PathSet out;
+    f.applyTyped(in, out);
+    return out;
+}
+
+static std::vector<Vec2> pointsOf(const PathView &p)
+{
+    return std::vector<Vec2>(p.points.begin(), p.points.end());
+}
+
+static bool samePoints(const std::vector<Vec2> &a, const std::vector<Vec2> &b)
+{
+    return a.size() == b.size() &&
+           std::equal(a.begin(), a.end(), b.begin(), [](const Vec2 &p, const Vec2 &q) { return p.x == q.x && p.y == q.y; });
+}
+
+TEST(optimize_paths, MergeJoinsPiecesEndToEnd)
+{
+    // A staircase cut into unit segments, shuffled, every other one drawn backwards
+    std::vector<Vec2> stairs;
+    for (int i = 0; i < 12; ++i)
+        stairs.emplace_back(static_cast<float>((i + 1) / 2), static_cast<float>(i / 2));
+
+    std::vector<size_t> order(stairs.size() - 1);
+    for (size_t k = 0; k < order.size(); ++k) order[k] = k;
+    std::mt19937 rng(3);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    PathSet in;
+    for (size_t k : order)
+    {
+        if (k % 2)
+            in.addSegment(stairs[k + 1], stairs[k]);
+        else
+            in.addSegment(stairs[k], stairs[k + 1]);
+    }
+
+    const PathSet out = mergeOnly(in, 0.1f);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_FALSE(out[0].closed);
+
+    // Each piece is copied whole, so the joints repeat; backwards pieces come out flipped
+    std::vector<Vec2> expected;
+    for (size_t k = 0; k + 1 < stairs.size(); ++k)
+    {
+        expected.push_back(stairs[k]);
+        expected.push_back(stairs[k + 1]);
+    }
+    std::vector<Vec2> got = pointsOf(out[0]);
+    if (!samePoints(got, expected)) std::reverse(got.begin(), got.end());
+    EXPECT_TRUE(samePoints(got, expected));
+}
+
+TEST(optimize_paths, MergeNeverClosesAChainOnItself)
+{
+    // A U whose own ends lie within the merge distance stays one open path
+    PathSet u;
+    u.addPath(std::vector<Vec2>{Vec2(0.0f, 0.0f), Vec2(0.0f, 5.0f), Vec2(1.0f, 5.0f), Vec2(1.0f, 0.0f)});
+    PathSet out = mergeOnly(u, 2.0f);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_FALSE(out[0].closed);
+    EXPECT_TRUE(samePoints(pointsOf(out[0]), pointsOf(u[0])));
+
+    // A triangle of three sides with small gaps: once two sides are joined, the third
+    // must not be taken twice, and the finished chain's two ends are left apart
+    PathSet tri;
+    tri.addSegment(Vec2(0.0f, 0.0f), Vec2(4.0f, 0.0f));
+    tri.addSegment(Vec2(4.05f, 0.0f), Vec2(2.0f, 3.0f));
+    tri.addSegment(Vec2(2.0f, 3.05f), Vec2(0.0f, 0.05f));
+    out = mergeOnly(tri, 0.1f);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_FALSE(out[0].closed);
+    EXPECT_EQ(out.pointCount(), 6u);
+
+    // Closed paths are left out of merging, even when an open end touches them
+    PathSet mixed;
+    mixed.addPath(std::vector<Vec2>{Vec2(0.0f, 0.0f), Vec2(2.0f, 0.0f), Vec2(2.0f, 2.0f), Vec2(0.0f, 0.0f)}, true);
+    mixed.addSegment(Vec2(0.0f, 0.0f), Vec2(-3.0f, 0.0f));
+    mixed.addSegment(Vec2(2.0f, 2.0f), Vec2(5.0f, 2.0f));
+    out = mergeOnly(mixed, 0.5f);
+    ASSERT_EQ(out.size(), 3u);
+    EXPECT_TRUE(out[0].closed);
+    EXPECT_TRUE(samePoints(pointsOf(out[0]), pointsOf(mixed[0])));
+    EXPECT_FALSE(out[1].closed);
+    EXPECT_FALSE(out[2].closed);
+    EXPECT_EQ(out.pointCount(), mixed.pointCount());
+}
@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "../src/utils/PathOrdering.h"
+
+static float d2(const Vec2 &a, const Vec2 &b)
+{
+    const float dx = a.x - b.x, dy = a.y - b.y;
+    return dx * dx + dy * dy;
+}
+
+TEST(path_ordering, MatchesBruteForceGreedy)
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> u(0.0f, 300.0f);
+    PathSet ps;
+    for (int i = 0; i < 2000; ++i)
+    {
+        const Vec2 a(u(rng), u(rng));
+        const int n = 1 + static_cast<int>(rng() % 4);
+        for (int k = 0; k < n; ++k) ps.addPoint(a + Vec2(u(rng) * 0.05f, u(rng) * 0.05f));
+        ps.endPath(n > 2 && rng() % 3 == 0);
+    }
+    ps.endPath(false); // an empty path is skipped
+
+    // Reference: O(n^2) scan over every candidate entry point
+    std::vector<PathOrderEntry> ref;
+    std::vector<bool> used(ps.size(), false);
+    Vec2 pen(0.0f, 0.0f);
+    for (;;)
+    {
+        float best = std::numeric_limits<float>::infinity();
+        size_t bi = ps.size();
+        bool flip = false;
+        uint32_t startAt = 0;
+        for (size_t i = 0; i < ps.size(); ++i)
+        {
+            const PathView p = ps[i];
+            if (used[i] || p.points.empty()) continue;
+            if (p.closed)
+            {
+                // Any vertex of a loop; the pen goes round and leaves from there again
+                for (size_t k = 0; k < p.points.size(); ++k)
+                {
+                    const float dk = d2(pen, p.points[k]);
+                    if (dk < best) { best = dk; bi = i; flip = false; startAt = static_cast<uint32_t>(k); }
+                }
+                continue;
+            }
+            const float ds = d2(pen, p.points.front()), de = d2(pen, p.points.back());
+            if (ds < best) { best = ds; bi = i; flip = false; }
+            if (p.points.size() > 1 && de < best) { best = de; bi = i; flip = true; }
+        }
+        if (bi == ps.size()) break;
+        used[bi] = true;
+        const PathView p = ps[bi];
+        const uint32_t s = p.closed ? startAt : 0;
+        ref.push_back(PathOrderEntry{static_cast<uint32_t>(bi), flip, s});
+        if (p.closed)
+            pen = p.points[s];
+        else
+            pen = flip ? p.points.front() : p.points.back();
+    }
+
+    const std::vector<PathOrderEntry> order = orderPathsGreedy(ps, Vec2(0.0f, 0.0f));
+    ASSERT_EQ(order.size(), ref.size());
+    for (size_t k = 0; k < ref.size(); ++k)
+    {
+        ASSERT_EQ(order[k].index, ref[k].index) << "at " << k;
+        ASSERT_EQ(order[k].reversed, ref[k].reversed) << "at " << k;
+        ASSERT_EQ(order[k].start, ref[k].start) << "at " << k;
+    }
+
+    // Loops (these have no repeated closing point) gain their closing point, rotated or not
+    size_t loops = 0;
+    for (const PathOrderEntry &o : order)
+        loops += ps.closed(o.index) ? 1 : 0;
+    PathSet out;
+    applyPathOrder(ps, order, out);
+    EXPECT_EQ(out.size(), ps.size() - 1);
+    EXPECT_EQ(out.pointCount(), ps.pointCount() + loops);
+}
+
+TEST(path_ordering, RefineKeepsPermutationAndNeverSlower)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> u(0.0f, 300.0f);
+    PathSet ps;
+    for (int i = 0; i < 3000; ++i)
+    {
+        Vec2 p(u(rng), u(rng));
+        const int n = 1 + static_cast<int>(rng() % 5);
+        for (int k = 0; k < n; ++k)
+        {
+            ps.addPoint(p);
+            p = p + Vec2(u(rng) * 0.02f - 3.0f, u(rng) * 0.02f - 3.0f);
+        }
+        ps.endPath(n > 2 && rng() % 4 == 0);
+    }
+
+    const TravelCostModel model = TravelCostModel::fromConfig(PlotterConfig{});
+    const Vec2 home(0.0f, 0.0f);
+    std::vector<PathOrderEntry> order = orderPathsGreedy(ps, home);
+    const double greedy = estimatePlotSeconds(ps, order, home, model);
+    refinePathOrder(ps, order, home, model, 10000.0);
+    const double refined = estimatePlotSeconds(ps, order, home, model);
+    EXPECT_LT(refined, greedy);
+
+    ASSERT_EQ(order.size(), ps.size());
+    std::vector<int> seen(ps.size(), 0);
+    for (const PathOrderEntry &o : order)
+    {
+        ASSERT_LT(o.index, ps.size());
+        EXPECT_EQ(seen[o.index]++, 0);
+        if (ps.closed(o.index))
+        {
+            EXPECT_FALSE(o.reversed);
+        }
+    }
+
+    // A zero budget leaves the order alone
+    std::vector<PathOrderEntry> same = orderPathsGreedy(ps, home);
+    refinePathOrder(ps, same, home, model, 0.0);
+    EXPECT_DOUBLE_EQ(estimatePlotSeconds(ps, same, home, model), greedy);
+}
+
+TEST(path_ordering, RefineReversesRangesThroughClosedLoops)
+{
+    // Two rows of small loops, out along the top and back along the bottom, visited with
+    // two crossing hops in the middle. Uncrossing them reverses a run of six loops;
+    // smaller moves can not fix it without flipping the loops' run as well.
+    PathSet ps;
+    auto loop = [&](float x, float y) {
+        ps.addPath(std::vector<Vec2>{Vec2(x, y), Vec2(x + 1.0f, y), Vec2(x + 1.0f, y + 1.0f), Vec2(x, y + 1.0f)}, true);
+    };
+    for (int k = 0; k < 6; ++k) loop(20.0f * static_cast<float>(k + 1), 40.0f); // top, paths 0..5
+    for (int k = 0; k < 6; ++k) loop(20.0f * static_cast<float>(k + 1), 0.0f);  // bottom, paths 6..11
+    const TravelCostModel model = TravelCostModel::fromConfig(PlotterConfig{});
+    const Vec2 home(0.0f, 20.0f);
+
+    auto entries = [](std::initializer_list<uint32_t> idx) {
+        std::vector<PathOrderEntry> out;
+        for (uint32_t i : idx) out.push_back(PathOrderEntry{i, false, 0});
+        return out;
+    };
+    const std::vector<PathOrderEntry> best = entries({0, 1, 2, 3, 4, 5, 11, 10, 9, 8, 7, 6});
+    std::vector<PathOrderEntry> order = entries({0, 1, 2, 9, 10, 11, 5, 4, 3, 8, 7, 6});
+
+    refinePathOrder(ps, order, home, model, 10000.0);
+    EXPECT_LE(estimatePlotSeconds(ps, order, home, model), estimatePlotSeconds(ps, best, home, model) + 1e-4);
+    for (const PathOrderEntry &o : order)
+        EXPECT_FALSE(o.reversed);
+}
+
+TEST(path_ordering, ClosedLoopsEnterAtNearestVertex)
+{
+    // A large contour with its closing point repeated, and a small one without
+    PathSet ps;
+    const int n = 20000;
+    for (int k = 0; k <= n; ++k)
+    {
+        const float a = 6.2831853f * static_cast<float>(k % n) / n;
+        ps.addPoint(Vec2(100.0f + 50.0f * std::cos(a), 100.0f + 50.0f * std::sin(a)));
+    }
+    ps.endPath(true);
+    ps.addPath(std::vector<Vec2>{Vec2(0, 0), Vec2(10, 0), Vec2(10, 10), Vec2(0, 10)}, true);
+
+    // Enter the square at (10, 10) and leave from there after going all the way round
+    const Vec2 home(12.0f, 12.0f);
+    std::vector<PathOrderEntry> order = orderPathsGreedy(ps, home);
+    ASSERT_EQ(order.size(), 2u);
+    EXPECT_EQ(order[0].index, 1u);
+    EXPECT_EQ(order[0].start, 2u);
+    EXPECT_EQ(order[1].index, 0u);
+    uint32_t nearest = 0;
+    for (uint32_t k = 1; k < static_cast<uint32_t>(n); ++k)
+        if (d2(ps[0].points[k], Vec2(10, 10)) < d2(ps[0].points[nearest], Vec2(10, 10))) nearest = k;
+    EXPECT_EQ(order[1].start, nearest);
+
+    // pickLoopEntries agrees for a different pen position, via the per-loop index
+    std::vector<PathOrderEntry> far{{0, false, 0}};
+    pickLoopEntries(ps, far, Vec2(100.0f, 200.0f));
+    EXPECT_EQ(far[0].start, static_cast<uint32_t>(n / 4));
+
+    PathSet out;
+    applyPathOrder(ps, far, out);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_TRUE(out.closed(0));
+    EXPECT_EQ(out.pathSize(0), ps.pathSize(0));
+    EXPECT_EQ(out[0].points.front().x, ps[0].points[n / 4].x);
+    EXPECT_EQ(out[0].points.back().x, ps[0].points[n / 4].x);
+}
+
+TEST(path_ordering, RotatedPlainLoopKeepsItsShape)
+{
+    // A square without its closing point repeated, entered at (10, 10)
+    PathSet ps;
+    ps.addPath(std::vector<Vec2>{Vec2(0, 0), Vec2(10, 0), Vec2(10, 10), Vec2(0, 10)}, true);
+    const Vec2 home(12.0f, 12.0f);
+    std::vector<PathOrderEntry> order = orderPathsGreedy(ps, home);
+    ASSERT_EQ(order.size(), 1u);
+    EXPECT_EQ(order[0].start, 2u);
+
+    // Drawn as a polyline, the output covers the same four edges and ends where it began
+    PathSet out;
+    applyPathOrder(ps, order, out);
+    ASSERT_EQ(out.size(), 1u);
+    const std::vector<Vec2> want{Vec2(10, 10), Vec2(0, 10), Vec2(0, 0), Vec2(10, 0), Vec2(10, 10)};
+    ASSERT_EQ(out.pathSize(0), want.size());
+    for (size_t k = 0; k < want.size(); ++k)
+    {
+        EXPECT_EQ(out[0].points[k].x, want[k].x);
+        EXPECT_EQ(out[0].points[k].y, want[k].y);
+    }
+
+    // ...so the estimate counts all four edges, the same as the explicitly closed square
+    PathSet closedForm;
+    closedForm.addPath(std::vector<Vec2>{Vec2(0, 0), Vec2(10, 0), Vec2(10, 10), Vec2(0, 10), Vec2(0, 0)}, true);
+    const TravelCostModel model = TravelCostModel::fromConfig(PlotterConfig{});
+    EXPECT_DOUBLE_EQ(estimatePlotSeconds(ps, order, home, model),
+                     estimatePlotSeconds(closedForm, order, home, model));
+
+    // Left at vertex 0 the loop is closed the same way
+    std::vector<PathOrderEntry> atZero{{0, false, 0}};
+    applyPathOrder(ps, atZero, out);
+    ASSERT_EQ(out.pathSize(0), 5u);
+    EXPECT_EQ(out[0].points.back().x, 0.0f);
+    EXPECT_EQ(out[0].points.back().y, 0.0f);
+    EXPECT_DOUBLE_EQ(estimatePlotSeconds(ps, atZero, home, model),
+                     estimatePlotSeconds(closedForm, atZero, home, model));
+
+    // A loop that already repeats its first point is not closed twice
+    applyPathOrder(closedForm, atZero, out);
+    EXPECT_EQ(out.pathSize(0), 5u);
+}
@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "../src/core/Pathset.h"
+
+TEST(pathset, BuildsFlatLayout)
+{
+    PathSet ps;
+    EXPECT_TRUE(ps.empty());
+    ASSERT_EQ(ps.offsets.size(), 1u);
+
+    ps.addSegment(Vec2(0.0f, 0.0f), Vec2(1.0f, 0.0f));
+    std::vector<Vec2> tri{Vec2(0.0f, 0.0f), Vec2(2.0f, 0.0f), Vec2(0.0f, 2.0f)};
+    ps.addPath(tri, true);
+    ps.addPoint(Vec2(5.0f, 5.0f));
+    ps.discardPath();
+    ps.addPoint(Vec2(3.0f, 3.0f));
+    ps.addPoint(Vec2(4.0f, 4.0f));
+    ps.endPath();
+
+    ASSERT_EQ(ps.size(), 3u);
+    EXPECT_EQ(ps.pointCount(), 7u);
+    EXPECT_EQ(ps.offsets.back(), 7u);
+    EXPECT_FALSE(ps[0].closed);
+    EXPECT_TRUE(ps[1].closed);
+    ASSERT_EQ(ps[1].points.size(), 3u);
+    EXPECT_FLOAT_EQ(ps[1].points[2].y, 2.0f);
+    EXPECT_FLOAT_EQ(ps[2].points.front().x, 3.0f);
+
+    size_t visited = 0;
+    for (const PathView &p : ps)
+        visited += p.points.size();
+    EXPECT_EQ(visited, ps.pointCount());
+
+    ps.computeAABB();
+    EXPECT_FLOAT_EQ(ps.aabb.max.x, 4.0f);
+    EXPECT_FLOAT_EQ(ps.aabb.max.y, 4.0f);
+}
+
+TEST(pathset, AppendAndReverse)
+{
+    PathSet a;
+    a.addSegment(Vec2(0.0f, 0.0f), Vec2(1.0f, 1.0f));
+    PathSet b;
+    std::vector<Vec2> line{Vec2(0.0f, 0.0f), Vec2(1.0f, 0.0f), Vec2(2.0f, 0.0f)};
+    b.addPath(line);
+    b.addPathReversed(b[0]);
+
+    a.append(b);
+    ASSERT_EQ(a.size(), 3u);
+    EXPECT_EQ(a.pathSize(1), 3u);
+    EXPECT_FLOAT_EQ(a[2].points.front().x, 2.0f);
+    EXPECT_FLOAT_EQ(a[2].points.back().x, 0.0f);
+
+    Span<Vec2> pts = a.pathPoints(1);
+    for (Vec2 &v : pts) v.y = 7.0f;
+    EXPECT_FLOAT_EQ(a.toPath(1).points[1].y, 7.0f);
+    EXPECT_FLOAT_EQ(a[0].points[1].y, 1.0f);
+
+    a.clear();
+    EXPECT_TRUE(a.empty());
+    EXPECT_EQ(a.offsets.size(), 1u);
+}
@@ -0,0 +1,295 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "../src/plotters/PlotProgram.h"
+#include "../src/plotters/PlotProgramCache.h"
+#include "../src/utils/PathOrdering.h"
+
+namespace
+{
+
+// Strokes, some touching end to start, plus a closed square; entity = i % 3
+void makeJob(PathSet &paths, std::vector<int> &entity)
+{
+    for (int i = 0; i < 40; ++i)
+    {
+        const float x = 10.0f + 7.0f * float(i % 8), y = 10.0f + 9.0f * float(i / 8);
+        paths.addPath({Vec2(x, y), Vec2(x + 3.3f, y + 1.7f), Vec2(x + 5.1f, y - 0.9f)});
+        if (i % 5 == 0)
+            paths.addPath({Vec2(x + 5.1f, y - 0.9f), Vec2(x + 6.0f, y + 4.0f)});
+    }
+    paths.addPath({Vec2(100.0f, 100.0f), Vec2(120.0f, 100.0f), Vec2(120.0f, 120.0f), Vec2(100.0f, 120.0f)}, true);
+    for (size_t i = 0; i < paths.size(); ++i) entity.push_back(int(i % 3));
+}
+
+std::vector<PlotProgram::Command> decodeAll(const PlotProgram &p)
+{
+    std::vector<PlotProgram::Command> out;
+    PlotProgram::Reader r = p.reader();
+    PlotProgram::Command c;
+    while (r.next(c)) out.push_back(c);
+    EXPECT_TRUE(r.atEnd());
+    return out;
+}
+
+// One MotionStream over the whole job, stopping only at pen changes
+std::vector<PlotProgram::Command> planSequential(const PathSet &in, const PlotterConfig &cfg, bool liftPen)
+{
+    std::vector<PathOrderEntry> order = orderPathsGreedy(in, Vec2(0.0f, 0.0f));
+    PathSet paths;
+    applyPathOrder(in, order, paths);
+
+    std::vector<PlotProgram::Command> out;
+    std::vector<MoveSlice> slices;
+    MotionStream motion(plannerSettingsFromConfig(cfg, 80));
+    motion.reset(Vec2(0.0f, 0.0f));
+    auto take = [&]() {
+        for (const MoveSlice &m : slices) out.push_back({PlotProgram::Op::Move, m});
+        slices.clear();
+    };
+    bool penDown = false;
+    auto pen = [&](bool down) {
+        motion.finish(slices);
+        take();
+        out.push_back({down ? PlotProgram::Op::PenDown : PlotProgram::Op::PenUp, {}});
+        penDown = down;
+    };
+    if (liftPen) out.push_back({PlotProgram::Op::PenUp, {}});
+    for (const PathView &path : paths)
+    {
+        const Vec2 &start = path.points.front();
+        const Vec2 &at = motion.position();
+        const bool continues = std::hypot(at.x - start.x, at.y - start.y) < 1.0f / 80.0f;
+        if (liftPen && !(penDown && continues))
+        {
+            if (penDown) pen(false);
+            motion.add(Span<const Vec2>(&start, 1), true);
+            pen(true);
+        }
+        else if (!liftPen)
+        {
+            motion.add(Span<const Vec2>(&start, 1), true);
+        }
+        motion.add(path.points, false);
+        motion.flushReady(slices);
+        take();
+    }
+    if (liftPen && penDown) pen(false);
+    const Vec2 home(0.0f, 0.0f);
+    motion.add(Span<const Vec2>(&home, 1), true);
+    motion.finish(slices);
+    take();
+    return out;
+}
+
+} // namespace
+
+TEST(plot_program, MatchesSequentialPlanning)
+{
+    PathSet paths;
+    std::vector<int> entity;
+    makeJob(paths, entity);
+    PlotterConfig cfg;
+    cfg.timeSliceMs = 10;
+
+    // Lifting, not lifting, and lifting with LM moves
+    for (int variant : {0, 1, 2})
+    {
+        const bool liftPen = variant != 1;
+        cfg.lowLevelMoves = variant == 2;
+        PlotCompileOptions opt;
+        opt.liftPen = liftPen;
+        opt.refineBudgetMs = 0.0; // greedy order only, so the reference sees the same order
+        std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, cfg, opt);
+        ASSERT_TRUE(prog);
+
+        const std::vector<PlotProgram::Command> got = decodeAll(*prog);
+        const std::vector<PlotProgram::Command> want = planSequential(paths, cfg, liftPen);
+        ASSERT_EQ(got.size(), want.size());
+        int64_t ms = 0;
+        for (size_t i = 0; i < got.size(); ++i)
+        {
+            ASSERT_EQ(int(got[i].op), int(want[i].op)) << i;
+            if (got[i].op == PlotProgram::Op::Move)
+            {
+                EXPECT_EQ(got[i].move.aSteps, want[i].move.aSteps) << i;
+                EXPECT_EQ(got[i].move.bSteps, want[i].move.bSteps) << i;
+                EXPECT_EQ(got[i].move.dtMs, want[i].move.dtMs) << i;
+                EXPECT_EQ(got[i].move.lowLevel, cfg.lowLevelMoves) << i;
+                EXPECT_EQ(got[i].move.rateA, want[i].move.rateA) << i;
+                EXPECT_EQ(got[i].move.accelB, want[i].move.accelB) << i;
+                ms += got[i].move.dtMs;
+            }
+            else
+            {
+                ms += prog->totals().penMoveMs;
+            }
+        }
+        EXPECT_EQ(prog->totals().totalMs, ms);
+        EXPECT_EQ(prog->totals().commands, got.size());
+
+        // Entity totals add up to the job, less the return home and the first pen up
+        int64_t entityMs = 0;
+        uint32_t lifts = 0, entityPaths = 0;
+        for (const PlotProgram::EntityStats &es : prog->entities())
+        {
+            entityMs += es.totalMs;
+            lifts += es.lifts;
+            entityPaths += es.paths;
+        }
+        EXPECT_EQ(entityPaths, paths.size());
+        EXPECT_EQ(lifts, prog->totals().lifts);
+        EXPECT_LE(entityMs, prog->totals().totalMs);
+        EXPECT_GT(entityMs, prog->totals().totalMs * 8 / 10);
+
+        // Index offsets are command boundaries in drawing order
+        uint64_t last = 0;
+        for (const PlotProgram::PathEntry &pe : prog->paths())
+        {
+            EXPECT_GE(pe.offset, last);
+            last = pe.offset;
+            PlotProgram::Reader r = prog->reader(pe.offset);
+            PlotProgram::Command c;
+            EXPECT_TRUE(r.next(c) || r.atEnd());
+        }
+    }
+}
+
+TEST(plot_program, RoundTripsThroughFile)
+{
+    PathSet paths;
+    std::vector<int> entity;
+    makeJob(paths, entity);
+    std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, PlotterConfig{}, PlotCompileOptions{});
+    ASSERT_TRUE(prog);
+    prog->geometryHash = 0x1234;
+    prog->configHash = 0x5678;
+
+    const std::string file = (std::filesystem::temp_directory_path() / "minotaur_test_program.mtpg").string();
+    ASSERT_TRUE(prog->save(file));
+    std::shared_ptr<PlotProgram> loaded = PlotProgram::load(file);
+    ASSERT_TRUE(loaded);
+    EXPECT_EQ(loaded->geometryHash, 0x1234u);
+    EXPECT_EQ(loaded->configHash, 0x5678u);
+    EXPECT_EQ(loaded->totals().totalMs, prog->totals().totalMs);
+    EXPECT_EQ(loaded->paths().size(), prog->paths().size());
+    EXPECT_EQ(loaded->entities().size(), prog->entities().size());
+    ASSERT_EQ(loaded->stream().size(), prog->stream().size());
+    EXPECT_TRUE(std::equal(loaded->stream().begin(), loaded->stream().end(), prog->stream().begin()));
+    EXPECT_EQ(loaded->drawPaths().points.size(), prog->drawPaths().points.size());
+    EXPECT_EQ(loaded->drawPaths().offsets, prog->drawPaths().offsets);
+    EXPECT_EQ(loaded->restPathAt(prog->stream().size() / 2), prog->restPathAt(prog->stream().size() / 2));
+    loaded.reset();
+    std::remove(file.c_str());
+}
+
+TEST(plot_program, ReplansTheRestOfAJob)
+{
+    PathSet paths;
+    std::vector<int> entity;
+    makeJob(paths, entity);
+    PlotterConfig cfg;
+    cfg.timeSliceMs = 10;
+    PlotCompileOptions opt;
+    opt.refineBudgetMs = 0.0;
+    std::shared_ptr<PlotProgram> prog = PlotProgram::compile(paths, entity, cfg, opt);
+    ASSERT_TRUE(prog);
+    ASSERT_EQ(prog->drawPaths().size(), prog->paths().size());
+
+    const size_t first = prog->restPathAt(prog->stream().size() / 2);
+    ASSERT_LT(first, prog->paths().size());
+    const uint64_t cut = prog->paths()[first].offset;
+    EXPECT_GE(cut, prog->stream().size() / 2);
+    PlotProgram::Command c;
+    ASSERT_TRUE(prog->reader(cut).next(c));
+    EXPECT_EQ(int(c.op), int(PlotProgram::Op::Move)); // the travel to path first
+
+    // Same settings: a pen up, then exactly the old stream from the cut
+    std::shared_ptr<PlotProgram> same = prog->replanFrom(first, cfg);
+    ASSERT_TRUE(same);
+    PlotProgram::Reader r = same->reader();
+    ASSERT_TRUE(r.next(c));
+    EXPECT_EQ(int(c.op), int(PlotProgram::Op::PenUp));
+    const Span<const uint8_t> tail = same->stream();
+    ASSERT_EQ(tail.size() - r.offset(), prog->stream().size() - cut);
+    EXPECT_TRUE(std::equal(tail.begin() + r.offset(), tail.end(), prog->stream().begin() + cut));
+    EXPECT_EQ(prog->paths()[first].startMs + same->totals().totalMs,
+              prog->totals().totalMs + int64_t(prog->totals().penMoveMs));
+    ASSERT_EQ(same->paths().size(), prog->paths().size() - first);
+    EXPECT_EQ(same->paths().back().entityId, prog->paths().back().entityId);
+
+    // Faster drawing only changes the rest of the job
+    PlotterConfig fast = cfg;
+    fast.drawSpeedMmPerS *= 2.0f;
+    std::shared_ptr<PlotProgram> faster = prog->replanFrom(first, fast);
+    ASSERT_TRUE(faster);
+    EXPECT_LT(faster->totals().totalMs, same->totals().totalMs);
+    EXPECT_NEAR(faster->totals().penDownMm, same->totals().penDownMm, same->totals().penDownMm * 0.001f);
+
+    // Nothing to cut at without pen lifts
+    opt.liftPen = false;
+    std::shared_ptr<PlotProgram> noLift = PlotProgram::compile(paths, entity, cfg, opt);
+    ASSERT_TRUE(noLift);
+    EXPECT_EQ(noLift->restPathAt(0), noLift->paths().size());
+}
+
+TEST(plot_program, CacheDirectoryDropsLeastRecentlyUsed)
+{
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "minotaur_test_cache";
+    fs::remove_all(dir);
+    PlotProgramCache &cache = PlotProgramCache::instance();
+    cache.clear();
+    cache.setDirectory(dir.string());
+
+    // Three jobs of the same size, shifted apart
+    auto job = [](float dx, PathSet &paths, std::vector<int> &entity) {
+        makeJob(paths, entity);
+        for (Vec2 &p : paths.points) p.x += dx;
+    };
+    PathSet a, b, c;
+    std::vector<int> ea, eb, ec;
+    job(0.0f, a, ea);
+    job(1.0f, b, eb);
+    job(2.0f, c, ec);
+    auto stored = [&]() {
+        std::vector<fs::path> files;
+        for (const fs::directory_entry &e : fs::directory_iterator(dir)) files.push_back(e.path());
+        return files;
+    };
+
+    const PlotterConfig cfg;
+    ASSERT_TRUE(cache.get(a, ea, cfg, PlotCompileOptions{}));
+    ASSERT_EQ(stored().size(), 1u);
+    const fs::path fileA = stored()[0];
+    const uintmax_t bytes = fs::file_size(fileA);
+    cache.setDiskLimit(bytes * 5 / 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache.get(b, eb, cfg, PlotCompileOptions{}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    // Loading a from disk makes it the most recently used, so b goes when c is stored
+    cache.clear();
+    ASSERT_TRUE(cache.get(a, ea, cfg, PlotCompileOptions{}));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    ASSERT_TRUE(cache.get(c, ec, cfg, PlotCompileOptions{}));
+    const std::vector<fs::path> left = stored();
+    EXPECT_EQ(left.size(), 2u);
+    EXPECT_NE(std::find(left.begin(), left.end(), fileA), left.end());
+    for (const fs::path &p : left) EXPECT_EQ(p.extension(), ".mtpg");
+
+    cache.clear();
+    ASSERT_TRUE(cache.get(b, eb, cfg, PlotCompileOptions{})); // compiled again
+    EXPECT_EQ(stored().size(), 2u);
+
+    cache.clear();
+    cache.setDirectory("");
+    cache.setDiskLimit(512ull << 20);
+    fs::remove_all(dir);
+}
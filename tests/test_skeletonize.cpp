@@ -0,0 +1,232 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../src/filters/bitmap/SkeletonizeFilter.h"
+
+namespace
+{
+
+struct Image
+{
+    int w = 0, h = 0;
+    std::vector<uint8_t> px;
+};
+
+Image imageFromRows(const std::vector<std::string> &rows)
+{
+    Image im;
+    im.w = static_cast<int>(rows[0].size());
+    im.h = static_cast<int>(rows.size());
+    im.px.assign(static_cast<size_t>(im.w * im.h), 0);
+    for (int y = 0; y < im.h; ++y)
+        for (int x = 0; x < im.w; ++x)
+            im.px[static_cast<size_t>(y * im.w + x)] = rows[static_cast<size_t>(y)][static_cast<size_t>(x)] == '#' ? 1 : 0;
+    return im;
+}
+
+// The filter's thinning before the lookup tables, kept verbatim apart from being lifted
+// out of applyTyped: candidates are tested with the B/A/phase conditions worked out
+// directly, and the next candidates are the border neighbours of deleted pixels
+const struct { int x; int y; } kN8[8] = {{0,-1},{1,-1},{1,0},{1,1},{0,1},{-1,1},{-1,0},{-1,-1}};
+
+size_t idxOf(int x, int y, int w) { return static_cast<size_t>(y) * static_cast<size_t>(w) + static_cast<size_t>(x); }
+
+bool hasBackgroundNeighbor(const std::vector<uint8_t> &img, int x, int y, int w, int h)
+{
+    for (const auto &d : kN8)
+    {
+        int nx = x + d.x, ny = y + d.y;
+        if (nx < 0 || ny < 0 || nx >= w || ny >= h) return true;
+        if (!img[idxOf(nx,ny,w)]) return true;
+    }
+    return false;
+}
+
+void referenceThin(std::vector<uint8_t> &img, int w, int h)
+{
+    // Build initial candidate set: edge foreground pixels
+    std::vector<int> cand; cand.reserve(static_cast<size_t>(w*h/8 + 1));
+    for (int y = 1; y < h - 1; ++y)
+    {
+        for (int x = 1; x < w - 1; ++x)
+        {
+            if (!img[idxOf(x,y,w)]) continue;
+            if (hasBackgroundNeighbor(img, x, y, w, h)) cand.push_back(static_cast<int>(idxOf(x,y,w)));
+        }
+    }
+    if (cand.empty()) return;
+    std::vector<int> del; del.reserve(cand.size());
+    std::vector<int> nextCand; nextCand.reserve(cand.size());
+    std::vector<uint8_t> inNext(static_cast<size_t>(w * h), 0);
+
+    auto phaseDelete = [&](int phase) -> bool {
+        del.clear();
+        for (int id : cand)
+        {
+            const int y = id / w; const int x = id % w;
+            if (!img[idxOf(x,y,w)]) continue;
+            uint8_t p[9]; p[0] = 1; // center is foreground by construction
+            for (int k = 0; k < 8; ++k) p[k+1] = img[idxOf(x + kN8[k].x, y + kN8[k].y, w)];
+            int B = 0; for (int k = 1; k <= 8; ++k) B += (p[k] != 0);
+            if (B < 2 || B > 6) continue;
+            int A = 0; for (int k = 1; k <= 8; ++k) { int k1 = (k % 8) + 1; if (p[k] == 0 && p[k1] == 1) ++A; }
+            if (A != 1) continue;
+            if (phase == 0)
+            {
+                if (p[1] * p[3] * p[5] != 0) continue;
+                if (p[3] * p[5] * p[7] != 0) continue;
+            }
+            else
+            {
+                if (p[1] * p[3] * p[7] != 0) continue;
+                if (p[1] * p[5] * p[7] != 0) continue;
+            }
+            del.push_back(id);
+        }
+        if (del.empty()) return false;
+        // Delete and seed next candidates
+        for (int idd : del)
+        {
+            const int y = idd / w; const int x = idd % w;
+            img[idxOf(x,y,w)] = 0;
+            for (const auto &d : kN8)
+            {
+                int nx = x + d.x, ny = y + d.y;
+                if (nx <= 0 || ny <= 0 || nx >= w-1 || ny >= h-1) continue;
+                if (!img[idxOf(nx,ny,w)]) continue;
+                const size_t ni = idxOf(nx,ny,w);
+                if (!inNext[ni] && hasBackgroundNeighbor(img, nx, ny, w, h))
+                {
+                    nextCand.push_back(static_cast<int>(ni));
+                    inNext[ni] = 1;
+                }
+            }
+        }
+        cand.swap(nextCand);
+        nextCand.clear(); std::fill(inNext.begin(), inNext.end(), 0);
+        return true;
+    };
+
+    int guard = 8 * (w + h); // perimeter-scale safety cap
+    while (guard-- > 0)
+    {
+        bool any = false;
+        any |= phaseDelete(0);
+        any |= phaseDelete(1);
+        if (!any) break;
+        if (cand.empty()) break;
+    }
+}
+
+std::string render(const std::vector<uint8_t> &img, int w)
+{
+    std::string s;
+    for (size_t i = 0; i < img.size(); ++i)
+    {
+        s += img[i] ? '#' : '.';
+        if (static_cast<int>(i % static_cast<size_t>(w)) == w - 1) s += '\n';
+    }
+    return s;
+}
+
+void expectMatchesReference(const Image &im)
+{
+    std::vector<uint8_t> fast = im.px, ref = im.px;
+    thinActive(fast, im.w, im.h);
+    referenceThin(ref, im.w, im.h);
+    EXPECT_EQ(render(fast, im.w), render(ref, im.w));
+}
+
+} // namespace
+
+TEST(skeletonize, ThinningMatchesReferenceOnShapes)
+{
+    // A solid block, a thick ring, a plus, a thick diagonal and an open letter shape
+    expectMatchesReference(imageFromRows({
+        "..............",
+        ".############.",
+        ".############.",
+        ".############.",
+        ".############.",
+        ".############.",
+        "..............",
+    }));
+    expectMatchesReference(imageFromRows({
+        "...............",
+        "..###########..",
+        ".#############.",
+        ".####.....####.",
+        ".####.....####.",
+        ".####.....####.",
+        ".#############.",
+        "..###########..",
+        "...............",
+    }));
+    expectMatchesReference(imageFromRows({
+        ".............",
+        ".....###.....",
+        ".....###.....",
+        ".....###.....",
+        ".###########.",
+        ".###########.",
+        ".###########.",
+        ".....###.....",
+        ".....###.....",
+        ".....###.....",
+        ".............",
+    }));
+    expectMatchesReference(imageFromRows({
+        "............",
+        ".####.......",
+        "..####......",
+        "...####.....",
+        "....####....",
+        ".....####...",
+        "......####..",
+        "............",
+    }));
+    expectMatchesReference(imageFromRows({
+        "..............",
+        ".####....####.",
+        ".####....####.",
+        ".####....####.",
+        ".############.",
+        ".############.",
+        ".####....####.",
+        ".####....####.",
+        "..............",
+    }));
+}
+
+TEST(skeletonize, ThinningMatchesReferenceOnNoise)
+{
+    // Smoothed noise gives thick blobs with holes, spurs and pixels on the frame
+    std::mt19937 rng(11);
+    for (int density : {35, 50, 65})
+    {
+        Image im;
+        im.w = 48;
+        im.h = 40;
+        std::vector<int> noise(static_cast<size_t>(im.w * im.h));
+        for (int &v : noise) v = static_cast<int>(rng() % 100) < density ? 1 : 0;
+        im.px.assign(noise.size(), 0);
+        for (int y = 0; y < im.h; ++y)
+            for (int x = 0; x < im.w; ++x)
+            {
+                int sum = 0;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        const int sx = x + dx, sy = y + dy;
+                        if (sx >= 0 && sy >= 0 && sx < im.w && sy < im.h) sum += noise[static_cast<size_t>(sy * im.w + sx)];
+                    }
+                im.px[static_cast<size_t>(y * im.w + x)] = sum >= 5 ? 1 : 0;
+            }
+        SCOPED_TRACE("density " + std::to_string(density));
+        expectMatchesReference(im);
+    }
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+
+#include "../src/utils/SpscRing.h"
+
+TEST(spsc_ring, FillAndDrain)
+{
+    SpscRing<int> ring(5);
+    EXPECT_EQ(ring.capacity(), 8u);
+    for (int i = 0; i < 8; ++i) EXPECT_TRUE(ring.tryPush(i));
+    EXPECT_TRUE(ring.full());
+    EXPECT_FALSE(ring.tryPush(99));
+
+    int v = -1;
+    for (int i = 0; i < 8; ++i)
+    {
+        ASSERT_TRUE(ring.tryPop(v));
+        EXPECT_EQ(v, i);
+    }
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.tryPop(v));
+}
+
+TEST(spsc_ring, TwoThreadsKeepOrder)
+{
+    SpscRing<uint32_t> ring(64);
+    const uint32_t n = 200000;
+    std::thread producer([&]() {
+        for (uint32_t i = 0; i < n;)
+            if (ring.tryPush(i)) ++i; else std::this_thread::yield();
+    });
+
+    uint32_t expected = 0;
+    bool inOrder = true;
+    while (expected < n)
+    {
+        uint32_t v;
+        if (!ring.tryPop(v)) { std::this_thread::yield(); continue; }
+        inOrder = inOrder && v == expected;
+        ++expected;
+    }
+    producer.join();
+    EXPECT_TRUE(inOrder);
+    EXPECT_TRUE(ring.empty());
+}
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../src/utils/ThreadPool.h"
+
+namespace
+{
+
+// parallelFor on a given pool instead of the process-wide one
+template <typename Fn>
+void runOn(ThreadPool &pool, size_t begin, size_t end, size_t grain, Fn &&fn)
+{
+    using F = std::remove_reference_t<Fn>;
+    pool.run(begin, end, grain, [](void *ctx, size_t b, size_t e) { (*static_cast<F *>(ctx))(b, e); }, &fn);
+}
+
+bool allOnce(const std::vector<std::atomic<int>> &hits)
+{
+    for (const auto &h : hits)
+        if (h.load() != 1) return false;
+    return true;
+}
+
+} // namespace
+
+TEST(thread_pool, EveryRowRunsOnce)
+{
+    for (int h : {1, 7, 300, 4096})
+    {
+        std::vector<std::atomic<int>> hits(static_cast<size_t>(h));
+        // 64 pixels a row: 1024 rows a task
+        parallelForRows(h, 64, [&](int y0, int y1) {
+            for (int y = y0; y < y1; ++y) hits[static_cast<size_t>(y)]++;
+        });
+        EXPECT_TRUE(allOnce(hits)) << h;
+    }
+
+    std::vector<std::atomic<int>> cells(12 * 5);
+    parallelForTiles(12, 5, [&](int tx, int ty) { cells[static_cast<size_t>(ty * 12 + tx)]++; });
+    EXPECT_TRUE(allOnce(cells));
+}
+
+TEST(thread_pool, NestedLoopsFromWorkers)
+{
+    ThreadPool pool(3);
+    constexpr size_t kOuter = 16, kInner = 1000;
+    std::vector<std::atomic<int>> hits(kOuter * kInner);
+    std::atomic<int> onWorkers{0};
+    const std::thread::id caller = std::this_thread::get_id();
+    runOn(pool, 0, kOuter, 1, [&](size_t o0, size_t o1) {
+        if (std::this_thread::get_id() != caller) onWorkers++;
+        for (size_t o = o0; o < o1; ++o)
+            runOn(pool, 0, kInner, 16, [&](size_t i0, size_t i1) {
+                for (size_t i = i0; i < i1; ++i) hits[o * kInner + i]++;
+            });
+    });
+    EXPECT_TRUE(allOnce(hits));
+    if (std::thread::hardware_concurrency() > 1)
+    {
+        EXPECT_GT(onWorkers.load(), 0);
+    }
+}
+
+TEST(thread_pool, RethrowsOnTheCaller)
+{
+    ThreadPool pool(3);
+    std::atomic<int> ran{0};
+    auto throwing = [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i)
+        {
+            if (i == 37) throw std::runtime_error("chunk 37");
+            ran++;
+        }
+    };
+    try
+    {
+        runOn(pool, 0, 200, 1, throwing);
+        ADD_FAILURE() << "no exception";
+    }
+    catch (const std::runtime_error &e)
+    {
+        EXPECT_STREQ(e.what(), "chunk 37");
+    }
+    EXPECT_LT(ran.load(), 200);
+
+    // The same through the helpers, and the pool keeps working afterwards
+    EXPECT_THROW(parallelForEach(500, 1, [](size_t i) { if (i == 321) throw std::logic_error("x"); }), std::logic_error);
+    std::vector<std::atomic<int>> hits(200);
+    runOn(pool, 0, hits.size(), 1, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) hits[i]++;
+    });
+    EXPECT_TRUE(allOnce(hits));
+}
+
+TEST(thread_pool, ShutdownFinishesQueuedWork)
+{
+    ThreadPool pool(2);
+    std::vector<std::atomic<int>> hits(64);
+    std::atomic<int> started{0};
+    std::atomic<bool> gate{false};
+    std::thread caller([&]() {
+        runOn(pool, 0, hits.size(), 1, [&](size_t b, size_t e) {
+            started++;
+            while (!gate.load()) std::this_thread::yield();
+            for (size_t i = b; i < e; ++i) hits[i]++;
+        });
+    });
+    while (started.load() == 0) std::this_thread::yield();
+
+    // Workers are stopped while most chunks are still queued behind the gate
+    std::thread stopper([&]() { pool.shutdown(); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    gate.store(true);
+    stopper.join();
+    caller.join();
+    EXPECT_TRUE(allOnce(hits));
+
+    // Without workers a loop runs on its caller
+    std::vector<std::atomic<int>> after(100);
+    runOn(pool, 0, after.size(), 4, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e; ++i) after[i]++;
+    });
+    EXPECT_TRUE(allOnce(after));
+}
@@ -0,0 +1,343 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../src/filters/bitmap/TraceBlobsFilter.h"
+
+namespace
+{
+
+using PixelSet = std::vector<std::pair<int, int>>; // (x, y), sorted
+
+Mask maskFromRows(const std::vector<std::string> &rows)
+{
+    Mask m;
+    m.pixel_size_mm = 0.5f;
+    m.resize(rows[0].size(), rows.size());
+    for (size_t y = 0; y < rows.size(); ++y)
+        for (size_t x = 0; x < rows[y].size(); ++x)
+            m.set(x, y, rows[y][x] == '#');
+    return m;
+}
+
+// Every border pixel set the 8-connected tracer should produce: for each ink blob
+// (8-connected) and each background region (4-connected, the frame around the image
+// included) touching it, the blob pixels with a 4-neighbour in that region. That is the
+// blob's outer border for the region around it and a hole border for a region it
+// encloses. One-pixel borders give no path.
+std::vector<PixelSet> referenceBorders(const Mask &m)
+{
+    const int W = static_cast<int>(m.width_px), H = static_cast<int>(m.height_px);
+    const int PW = W + 2, PH = H + 2;
+    auto ink = [&](int px, int py) {
+        return px >= 1 && py >= 1 && px <= W && py <= H && m.get(px - 1, py - 1);
+    };
+    std::vector<int> inkLab(static_cast<size_t>(PW * PH), -1), bgLab(static_cast<size_t>(PW * PH), -1);
+    int inkCount = 0, bgCount = 0;
+    std::vector<int> stack;
+    for (int y = 0; y < PH; ++y)
+        for (int x = 0; x < PW; ++x)
+        {
+            const bool isInk = ink(x, y);
+            std::vector<int> &lab = isInk ? inkLab : bgLab;
+            if (lab[y * PW + x] >= 0) continue;
+            const int label = isInk ? inkCount++ : bgCount++;
+            lab[y * PW + x] = label;
+            stack.assign(1, y * PW + x);
+            while (!stack.empty())
+            {
+                const int p = stack.back();
+                stack.pop_back();
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        if ((dx == 0 && dy == 0) || (!isInk && dx != 0 && dy != 0)) continue;
+                        const int nx = p % PW + dx, ny = p / PW + dy;
+                        if (nx < 0 || ny < 0 || nx >= PW || ny >= PH) continue;
+                        if (ink(nx, ny) != isInk || lab[ny * PW + nx] >= 0) continue;
+                        lab[ny * PW + nx] = label;
+                        stack.push_back(ny * PW + nx);
+                    }
+            }
+        }
+
+    std::vector<std::vector<PixelSet>> sets(static_cast<size_t>(inkCount), std::vector<PixelSet>(static_cast<size_t>(bgCount)));
+    for (int y = 1; y <= H; ++y)
+        for (int x = 1; x <= W; ++x)
+        {
+            if (!ink(x, y)) continue;
+            const int c = inkLab[y * PW + x];
+            const int n4[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+            for (const auto &d : n4)
+            {
+                const int g = bgLab[(y + d[1]) * PW + x + d[0]];
+                if (g < 0) continue;
+                PixelSet &s = sets[static_cast<size_t>(c)][static_cast<size_t>(g)];
+                if (s.empty() || s.back() != std::make_pair(x - 1, y - 1)) s.emplace_back(x - 1, y - 1);
+            }
+        }
+
+    std::vector<PixelSet> out;
+    for (auto &perBlob : sets)
+        for (PixelSet &s : perBlob)
+        {
+            std::sort(s.begin(), s.end());
+            s.erase(std::unique(s.begin(), s.end()), s.end());
+            if (s.size() >= 2) out.push_back(std::move(s));
+        }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Every outline pixel set the default, 4-connected tracer should produce. For each ink blob
+// (4-connected) taken on its own, its pixels with a 4-neighbour in the background outside
+// it; and for each background region it encloses (4-connected, other blobs inside counted
+// as background), that region's pixels with a 4-neighbour in the blob. One-pixel outlines
+// give no path.
+std::vector<PixelSet> referenceOutlines4(const Mask &m)
+{
+    const int W = static_cast<int>(m.width_px), H = static_cast<int>(m.height_px);
+    const int PW = W + 2, PH = H + 2;
+    const int n4[4][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+    auto ink = [&](int px, int py) {
+        return px >= 1 && py >= 1 && px <= W && py <= H && m.get(px - 1, py - 1);
+    };
+    // 4-connected flood over the padded grid from 'seed' through cells where pass() holds
+    auto flood = [&](int seed, std::vector<int> &lab, int label, auto pass) {
+        std::vector<int> stack(1, seed);
+        lab[static_cast<size_t>(seed)] = label;
+        while (!stack.empty())
+        {
+            const int p = stack.back();
+            stack.pop_back();
+            for (const auto &d : n4)
+            {
+                const int nx = p % PW + d[0], ny = p / PW + d[1];
+                if (nx < 0 || ny < 0 || nx >= PW || ny >= PH) continue;
+                if (lab[static_cast<size_t>(ny * PW + nx)] >= 0 || !pass(nx, ny)) continue;
+                lab[static_cast<size_t>(ny * PW + nx)] = label;
+                stack.push_back(ny * PW + nx);
+            }
+        }
+    };
+
+    std::vector<int> blob(static_cast<size_t>(PW * PH), -1);
+    int blobs = 0;
+    for (int i = 0; i < PW * PH; ++i)
+        if (blob[static_cast<size_t>(i)] < 0 && ink(i % PW, i / PW))
+            flood(i, blob, blobs++, ink);
+
+    std::vector<PixelSet> out;
+    auto add = [&](PixelSet &s) {
+        std::sort(s.begin(), s.end());
+        if (s.size() >= 2) out.push_back(std::move(s));
+    };
+    std::vector<int> region(static_cast<size_t>(PW * PH), -1);
+    for (int b = 0; b < blobs; ++b)
+    {
+        // The blob's box grown by one cell, so the outside is one region around it
+        int x0 = PW, y0 = PH, x1 = -1, y1 = -1;
+        for (int i = 0; i < PW * PH; ++i)
+            if (blob[static_cast<size_t>(i)] == b)
+            {
+                x0 = std::min(x0, i % PW - 1); x1 = std::max(x1, i % PW + 1);
+                y0 = std::min(y0, i / PW - 1); y1 = std::max(y1, i / PW + 1);
+            }
+        auto inBox = [&](int x, int y) { return x >= x0 && y >= y0 && x <= x1 && y <= y1; };
+        auto inBlob = [&](int x, int y) { return blob[static_cast<size_t>(y * PW + x)] == b; };
+        std::fill(region.begin(), region.end(), -1); // 0 = outside, then the holes
+        int regions = 0;
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x)
+                if (region[static_cast<size_t>(y * PW + x)] < 0 && !inBlob(x, y))
+                    flood(y * PW + x, region, regions++, [&](int nx, int ny) { return inBox(nx, ny) && !inBlob(nx, ny); });
+
+        std::vector<PixelSet> sets(static_cast<size_t>(regions) + 1); // [regions] = the blob
+        for (int y = y0 + 1; y < y1; ++y)
+            for (int x = x0 + 1; x < x1; ++x)
+            {
+                const int r = region[static_cast<size_t>(y * PW + x)];
+                for (const auto &d : n4)
+                {
+                    const int nr = region[static_cast<size_t>((y + d[1]) * PW + x + d[0])];
+                    if (r < 0 && nr == 0) { sets[static_cast<size_t>(regions)].emplace_back(x - 1, y - 1); break; }
+                    if (r > 0 && nr < 0) { sets[static_cast<size_t>(r)].emplace_back(x - 1, y - 1); break; }
+                }
+            }
+        add(sets[static_cast<size_t>(regions)]);
+        for (int r = 1; r < regions; ++r)
+            add(sets[static_cast<size_t>(r)]);
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// The pixels each traced path visits, back from pixel-centre millimetres
+std::vector<PixelSet> tracedBorders(const PathSet &paths, float pxMm)
+{
+    std::vector<PixelSet> out;
+    for (const PathView &p : paths)
+    {
+        EXPECT_TRUE(p.closed);
+        PixelSet s;
+        for (const Vec2 &v : p.points)
+            s.emplace_back(static_cast<int>(std::lround(v.x / pxMm - 0.5f)), static_cast<int>(std::lround(v.y / pxMm - 0.5f)));
+        std::sort(s.begin(), s.end());
+        s.erase(std::unique(s.begin(), s.end()), s.end());
+        out.push_back(std::move(s));
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+PathSet trace(const Mask &m, bool eight = true)
+{
+    TraceBlobsFilter f;
+    f.setEightConnected(eight);
+    f.setTolerancePx(0.0f);
+    f.setTurdSizePx(0.0f);
+    f.setTraceHoles(true);
+    PathSet out;
+    f.applyTyped(m, out);
+    return out;
+}
+
+void expectMatchesReference(const Mask &m)
+{
+    EXPECT_EQ(tracedBorders(trace(m), m.pixel_size_mm), referenceBorders(m));
+    EXPECT_EQ(tracedBorders(trace(m, false), m.pixel_size_mm), referenceOutlines4(m));
+}
+
+} // namespace
+
+TEST(trace_blobs, HolesAndNestedBlobs)
+{
+    // A ring around a blob that has a hole of its own, and a ring with a one-pixel hole
+    const Mask m = maskFromRows({
+        "...........................",
+        ".###########......#####....",
+        ".#.........#......#.#.#....",
+        ".#..#####..#......#####....",
+        ".#..#...#..#...............",
+        ".#..#...#..#...............",
+        ".#..#####..#...............",
+        ".#.........#...............",
+        ".###########...............",
+    });
+    const PathSet out = trace(m);
+    EXPECT_EQ(tracedBorders(out, m.pixel_size_mm), referenceBorders(m));
+
+    // Three outer borders and four holes (the nested blob's own hole included). Every blob
+    // is followed by its holes: first the big ring and the hole it was traced around.
+    ASSERT_EQ(out.size(), 7u);
+    const float px = m.pixel_size_mm;
+    EXPECT_FLOAT_EQ(out[0].points[0].x, 1.5f * px);
+    EXPECT_FLOAT_EQ(out[0].points[0].y, 1.5f * px);
+    EXPECT_FLOAT_EQ(out[1].points[0].x, 1.5f * px);
+    EXPECT_FLOAT_EQ(out[1].points[0].y, 2.5f * px);
+    EXPECT_EQ(out[1].points.size(), 2u * (9u + 6u) + 1u); // inside of the ring, cutting its corners
+
+    // Outer borders and holes wind opposite ways
+    auto winding = [&](size_t k) {
+        double a2 = 0.0;
+        const PathView p = out[k];
+        for (size_t i = 0; i + 1 < p.points.size(); ++i)
+            a2 += p.points[i].x * p.points[i + 1].y - p.points[i + 1].x * p.points[i].y;
+        return a2;
+    };
+    EXPECT_LT(winding(0) * winding(1), 0.0);
+}
+
+TEST(trace_blobs, OnePixelBlobs)
+{
+    // Single pixels give no path; two pixels, straight or diagonal, make a closed 2-gon
+    const Mask m = maskFromRows({
+        "#.....#.",
+        "...#....",
+        "........",
+        ".##...#.",
+        ".......#",
+    });
+    const PathSet out = trace(m);
+    EXPECT_EQ(tracedBorders(out, m.pixel_size_mm), referenceBorders(m));
+    ASSERT_EQ(out.size(), 2u);
+    for (const PathView &p : out)
+        EXPECT_EQ(p.points.size(), 3u);
+}
+
+TEST(trace_blobs, BlobsTouchingTheEdge)
+{
+    // Blobs on every edge and corner; the big one has a hole and reaches three edges
+    expectMatchesReference(maskFromRows({
+        "##########",
+        "#........#",
+        "#.####...#",
+        "#.#..#...#",
+        "#.####...#",
+        "#.......##",
+        "........##",
+        "###......#",
+    }));
+    // A fully inked image is one blob whose border is the image frame
+    Mask full;
+    full.resize(70, 3);
+    for (size_t y = 0; y < 3; ++y)
+        for (size_t x = 0; x < 70; ++x) full.set(x, y, true);
+    const PathSet out = trace(full);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(tracedBorders(out, full.pixel_size_mm), referenceBorders(full));
+}
+
+TEST(trace_blobs, MatchesReferenceOnNoise)
+{
+    // Random masks across word boundaries, with blobs spanning the whole image
+    std::mt19937 rng(5);
+    for (int w : {7, 64, 130})
+        for (int density : {20, 45, 60})
+        {
+            Mask m;
+            m.resize(static_cast<size_t>(w), 300);
+            for (size_t y = 0; y < m.height_px; ++y)
+                for (size_t x = 0; x < m.width_px; ++x)
+                    if (static_cast<int>(rng() % 100) < density) m.set(x, y, true);
+            SCOPED_TRACE(std::to_string(w) + " wide, density " + std::to_string(density));
+            expectMatchesReference(m);
+        }
+}
+
+TEST(trace_blobs, DefaultKeepsFourConnectedBlobsAndBackgroundHoles)
+{
+    // Pixels touching at a corner are separate blobs, and a hole is outlined around its
+    // own background pixels, starting at its first one and going clockwise
+    const Mask m = maskFromRows({
+        "........",
+        ".######.",
+        ".#....#.",
+        ".#....#.",
+        ".######.",
+        "........",
+        "......#.",
+        ".....#..",
+    });
+    const PathSet out = trace(m, false);
+    EXPECT_EQ(tracedBorders(out, m.pixel_size_mm), referenceOutlines4(m));
+    ASSERT_EQ(out.size(), 2u); // the ring and its hole; the diagonal pixels give no path
+    const float px = m.pixel_size_mm;
+    const PathView hole = out[1];
+    ASSERT_EQ(hole.points.size(), 2u * (4u + 2u) - 4u + 1u);
+    EXPECT_FLOAT_EQ(hole.points[0].x, 2.5f * px);
+    EXPECT_FLOAT_EQ(hole.points[0].y, 2.5f * px);
+    EXPECT_FLOAT_EQ(hole.points[1].x, 3.5f * px);
+    EXPECT_FLOAT_EQ(hole.points[1].y, 2.5f * px);
+
+    // With 8-connectivity the corner pixels form a 2-gon and the hole follows the ink
+    const PathSet eight = trace(m, true);
+    ASSERT_EQ(eight.size(), 3u);
+    EXPECT_FLOAT_EQ(eight[1].points[0].x, 1.5f * px);
+    EXPECT_FLOAT_EQ(eight[1].points[0].y, 2.5f * px);
+}